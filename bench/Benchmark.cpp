@@ -0,0 +1,551 @@
+/*
+TensorUtils Version 0.1
+
+Copyright 2022 Christoph Widder
+
+This file is part of TensorUtils.
+
+TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+the GNU General Public License as published by the Free Software Foundation, either
+version 3 of the License, or (at your option) any later version.
+
+TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with TensorUtils.
+If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include "Benchmark.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+
+using namespace std;
+using namespace TensorUtils;
+using namespace Bench;
+
+/*
+    The peak FLOP/s are measured by independent multiply-add chains that are compiled for the same instruction
+    sets as the kernels of the library, see src/Simd.cpp.
+*/
+#if defined(__has_attribute)
+#if __has_attribute(target_clones) && defined(__x86_64__) && defined(__ELF__)
+#define PROBE_KERNEL __attribute__((target_clones("avx512f","avx2","default")))
+#endif
+#endif
+
+#ifndef PROBE_KERNEL
+#define PROBE_KERNEL
+#endif
+
+/**
+    REFERENCE
+**/
+
+namespace
+{
+    constexpr size_t CHAINS = 64;
+    constexpr int SAMPLES = 7;
+
+    double seconds_since(chrono::steady_clock::time_point start)
+    {
+        return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    }
+}
+
+#define DEFINE_PROBE(NAME,T) \
+PROBE_KERNEL static T NAME(size_t n, T x) \
+{ \
+    T acc[CHAINS]; \
+    for(size_t k=0; k<CHAINS; k++) \
+    { \
+        acc[k] = x + T(k)*T(1e-3); \
+    } \
+    const T m = T(0.999), c = T(1e-3); \
+    for(size_t i=0; i<n; i++) \
+    { \
+        for(size_t k=0; k<CHAINS; k++) \
+        { \
+            acc[k] = acc[k]*m + c; \
+        } \
+    } \
+    T sum = 0; \
+    for(size_t k=0; k<CHAINS; k++) \
+    { \
+        sum += acc[k]; \
+    } \
+    return sum; \
+}
+
+DEFINE_PROBE(probe_f32,float)
+DEFINE_PROBE(probe_f64,double)
+
+PROBE_KERNEL static void axpy(double* a, const double* b, size_t n)
+{
+    for(size_t i=0; i<n; i++)
+    {
+        a[i] += 0.5*b[i];
+    }
+}
+
+// best of a few runs on all threads of the library
+template<class F>
+static double best_rate(double work_per_thread, F kernel)
+{
+    const size_t threads = Parallel::num_threads();
+    double best = 0.0;
+    for(int rep=0; rep<5; rep++)
+    {
+        const auto start = chrono::steady_clock::now();
+        Parallel::for_range(threads, [&](size_t begin, size_t end)
+        {
+            for(size_t t=begin; t<end; t++)
+            {
+                kernel();
+            }
+        }, size_t(-1)/threads);
+        best = max(best, work_per_thread*threads/seconds_since(start));
+    }
+    return best;
+}
+
+static Reference measure_reference()
+{
+    Reference ref;
+    const size_t n = size_t(1)<<22;
+    volatile float sink_f32 = 0;
+    volatile double sink_f64 = 0;
+    ref.gflops_f32 = best_rate(2.0*CHAINS*n, [&]{ sink_f32 = sink_f32 + probe_f32(n, 1.0f); })*1e-9;
+    ref.gflops_f64 = best_rate(2.0*CHAINS*n, [&]{ sink_f64 = sink_f64 + probe_f64(n, 1.0); })*1e-9;
+
+    // a += s*b moves the same bytes per component as the in-place operations of the library and, unlike a triad,
+    // does not read the destination for ownership without counting it. Measured from 96 KiB to 192 MiB of traffic
+    // per pass, on the same number of bytes for every size.
+    for(size_t len=size_t(1)<<12; len<=(size_t(1)<<23); len*=4)
+    {
+        vector<double, Memory::Allocator<double>> a(len, 1.0), b(len, 2.0);
+        double* pa = a.data();
+        const double* pb = b.data();
+        const size_t repeat = max<size_t>(1, (size_t(1)<<23)/len);
+        double best = 0.0;
+        for(int rep=0; rep<5; rep++)
+        {
+            const auto start = chrono::steady_clock::now();
+            for(size_t r=0; r<repeat; r++)
+            {
+                Parallel::for_range(len, [pa,pb](size_t begin, size_t end)
+                {
+                    axpy(pa+begin, pb+begin, end-begin);
+                });
+            }
+            best = max(best, 3.0*sizeof(double)*len*repeat/seconds_since(start));
+        }
+        ref.working_set.push_back(3.0*sizeof(double)*len);
+        ref.gbs.push_back(best*1e-9);
+    }
+    return ref;
+}
+
+double Reference::bandwidth(double bytes) const
+{
+    for(size_t i=0; i<working_set.size(); i++)
+    {
+        if(working_set[i] >= bytes)
+        {
+            return gbs[i];
+        }
+    }
+    return gbs.empty() ? 0.0 : gbs.back();
+}
+
+/**
+    HELPERS
+**/
+
+Case Bench::make_case(
+    const string                                &group,
+    const string                                &name,
+    const string                                &dtype,
+    const vector<size_t>                        &shape,
+    double                                      flops,
+    double                                      bytes,
+    double                                      elements,
+    Bound                                       bound,
+    function<function<void()>(Case&)>           setup)
+{
+    Case c;
+    c.group = group;
+    c.name = name;
+    c.dtype = dtype;
+    c.shape = shape;
+    c.flops = flops;
+    c.bytes = bytes;
+    c.elements = elements;
+    c.bound = bound;
+    c.setup = setup;
+    return c;
+}
+
+vector<size_t> Bench::equal_shape(size_t rank, size_t n)
+{
+    vector<size_t> shape;
+    size_t remaining = n;
+    for(size_t dim=0; dim<rank; dim++)
+    {
+        const size_t extent = max<size_t>(1, size_t(llround(pow(double(remaining), 1.0/double(rank-dim)))));
+        shape.push_back(extent);
+        remaining = max<size_t>(1, remaining/extent);
+    }
+    return shape;
+}
+
+size_t Bench::volume(const vector<size_t> &shape)
+{
+    size_t n = 1;
+    for(auto it=shape.begin(); it!=shape.end(); it++)
+    {
+        n *= *it;
+    }
+    return n;
+}
+
+static string shape_string(const vector<size_t> &shape, const char* open, const char* close)
+{
+    string s = open;
+    for(size_t dim=0; dim<shape.size(); dim++)
+    {
+        s += (dim ? "," : "") + to_string(shape[dim]);
+    }
+    return s + close;
+}
+
+static string key(const Case &c)
+{
+    return c.group + "/" + c.name + "/" + c.dtype;
+}
+
+/**
+    MEASUREMENT
+**/
+
+// calibrates the iterations per sample to about min_time/SAMPLES and returns the median and minimum of SAMPLES samples
+static Result measure(Case c, double min_time, const Reference &ref, bool with_reference)
+{
+    function<void()> run = c.setup(c);
+    run();
+
+    auto start = chrono::steady_clock::now();
+    run();
+    const double once = max(seconds_since(start), 1e-9);
+    const size_t per_sample = max<size_t>(1, size_t(min_time/SAMPLES/once));
+
+    vector<double> samples;
+    for(int s=0; s<SAMPLES; s++)
+    {
+        start = chrono::steady_clock::now();
+        for(size_t it=0; it<per_sample; it++)
+        {
+            run();
+        }
+        samples.push_back(seconds_since(start)*1e9/double(per_sample));
+    }
+    sort(samples.begin(), samples.end());
+
+    Result r;
+    r.c = c;
+    r.c.setup = nullptr;
+    r.iterations = per_sample*SAMPLES;
+    r.ns_median = samples[SAMPLES/2];
+    r.ns_min = samples[0];
+    r.roof = -1.0;
+    if(with_reference && c.bound != Bound::IO)
+    {
+        const double peak = (c.dtype == "f32") ? ref.gflops_f32 : ref.gflops_f64;
+        if(c.flops > 0.0)
+        {
+            const double attainable = (c.bytes > 0.0) ? min(peak, c.flops/c.bytes*ref.bandwidth(c.bytes)) : peak;
+            r.roof = (c.flops/r.ns_median)/attainable;
+        }
+        else if(c.bytes > 0.0)
+        {
+            r.roof = (c.bytes/r.ns_median)/ref.bandwidth(c.bytes);
+        }
+    }
+    return r;
+}
+
+/**
+    OUTPUT
+**/
+
+static string json_escape(const string &s)
+{
+    string result;
+    for(char ch : s)
+    {
+        if(ch == '"' || ch == '\\')
+        {
+            result += '\\';
+        }
+        result += ch;
+    }
+    return result;
+}
+
+// one result per line, such that --compare can read the file back without a JSON parser
+static void write_json(const string &path, const vector<Result> &results, const Reference &ref, double min_time)
+{
+    ofstream out(path);
+    if(!out)
+    {
+        throw runtime_error("Bench::write_json:: Cannot open " + path + "!");
+    }
+    char buffer[1024];
+    out << "{\n";
+    out << "  \"suite\": \"tensor_utils\",\n";
+    out << "  \"version\": \"0.1\",\n";
+    out << "  \"compiler\": \"" << json_escape(__VERSION__) << "\",\n";
+    out << "  \"threads\": " << Parallel::num_threads() << ",\n";
+    out << "  \"min_time\": " << min_time << ",\n";
+    snprintf(buffer, sizeof(buffer), "  \"reference\": {\"gflops_f32\": %.3f, \"gflops_f64\": %.3f, \"bandwidth\": [",
+             ref.gflops_f32, ref.gflops_f64);
+    out << buffer;
+    for(size_t i=0; i<ref.gbs.size(); i++)
+    {
+        snprintf(buffer, sizeof(buffer), "%s{\"bytes\": %.0f, \"gbs\": %.3f}", i ? ", " : "", ref.working_set[i], ref.gbs[i]);
+        out << buffer;
+    }
+    out << "]},\n";
+    out << "  \"results\": [\n";
+    for(size_t i=0; i<results.size(); i++)
+    {
+        const Result &r = results[i];
+        snprintf(buffer, sizeof(buffer),
+                 "    {\"key\": \"%s\", \"group\": \"%s\", \"name\": \"%s\", \"dtype\": \"%s\", \"shape\": %s, "
+                 "\"iterations\": %zu, \"ns_per_iter\": %.3f, \"ns_min\": %.3f, \"ns_per_element\": %.6f, "
+                 "\"gflops\": %.6f, \"gbs\": %.6f, \"roof\": %.4f}%s\n",
+                 json_escape(key(r.c)).c_str(), json_escape(r.c.group).c_str(), json_escape(r.c.name).c_str(),
+                 r.c.dtype.c_str(), shape_string(r.c.shape, "[", "]").c_str(), r.iterations, r.ns_median, r.ns_min,
+                 r.ns_median/r.c.elements, r.c.flops/r.ns_median, r.c.bytes/r.ns_median, r.roof,
+                 (i+1 < results.size()) ? "," : "");
+        out << buffer;
+    }
+    out << "  ]\n}\n";
+}
+
+static void print_header(const Reference &ref, bool with_reference)
+{
+    printf("tensor_utils benchmarks, %u threads, %s\n", Parallel::num_threads(), __VERSION__);
+    if(with_reference)
+    {
+        printf("reference: %.1f GFLOP/s f32, %.1f GFLOP/s f64, axpy", ref.gflops_f32, ref.gflops_f64);
+        for(size_t i=0; i<ref.gbs.size(); i++)
+        {
+            printf(" %.0f KiB: %.1f GB/s%s", ref.working_set[i]/1024, ref.gbs[i], (i+1 < ref.gbs.size()) ? "," : "\n");
+        }
+    }
+    printf("%-12s %-28s %-6s %-20s %12s %10s %9s %9s %6s\n",
+           "group", "name", "dtype", "shape", "ns/iter", "ns/elem", "GFLOP/s", "GB/s", "roof");
+}
+
+static void print_result(const Result &r)
+{
+    char roof[16] = "-";
+    if(r.roof >= 0.0)
+    {
+        snprintf(roof, sizeof(roof), "%.0f%%", 100.0*r.roof);
+    }
+    printf("%-12s %-28s %-6s %-20s %12.1f %10.3f %9.2f %9.2f %6s\n",
+           r.c.group.c_str(), r.c.name.c_str(), r.c.dtype.c_str(), shape_string(r.c.shape, "{", "}").c_str(),
+           r.ns_median, r.ns_median/r.c.elements, r.c.flops/r.ns_median, r.c.bytes/r.ns_median, roof);
+    fflush(stdout);
+}
+
+/**
+    REGRESSIONS
+**/
+
+// value of "field": in a line written by write_json
+static string json_field(const string &line, const string &field)
+{
+    const string pattern = "\"" + field + "\": ";
+    size_t pos = line.find(pattern);
+    if(pos == string::npos)
+    {
+        return "";
+    }
+    pos += pattern.size();
+    if(line[pos] == '"')
+    {
+        return line.substr(pos+1, line.find('"', pos+1)-pos-1);
+    }
+    return line.substr(pos, line.find_first_of(",}", pos)-pos);
+}
+
+// returns the number of cases that are slower than in the baseline by more than tolerance
+static int compare(const string &path, const vector<Result> &results, double tolerance)
+{
+    ifstream in(path);
+    if(!in)
+    {
+        throw runtime_error("Bench::compare:: Cannot open " + path + "!");
+    }
+    map<string,double> baseline;
+    string line;
+    while(getline(in, line))
+    {
+        const string k = json_field(line, "key");
+        if(!k.empty())
+        {
+            baseline[k] = atof(json_field(line, "ns_per_iter").c_str());
+        }
+    }
+    int regressions = 0;
+    printf("\ncomparison with %s (tolerance %.0f%%)\n", path.c_str(), 100.0*tolerance);
+    for(auto it=results.begin(); it!=results.end(); it++)
+    {
+        auto base = baseline.find(key(it->c));
+        if(base == baseline.end() || base->second <= 0.0)
+        {
+            continue;
+        }
+        const double ratio = it->ns_median/base->second;
+        const char* verdict = "";
+        if(ratio > 1.0+tolerance)
+        {
+            verdict = "REGRESSION";
+            regressions++;
+        }
+        else if(ratio < 1.0/(1.0+tolerance))
+        {
+            verdict = "faster";
+        }
+        printf("%-50s %12.1f -> %12.1f ns  x%.2f  %s\n", key(it->c).c_str(), base->second, it->ns_median, ratio, verdict);
+    }
+    return regressions;
+}
+
+/**
+    SUITE
+**/
+
+void Suite::add(const Case &c)
+{
+    cases.push_back(c);
+}
+
+const string& Suite::scratch() const
+{
+    return dir;
+}
+
+static void usage(const char* program)
+{
+    printf("usage: %s [options]\n"
+           "  --filter TEXT       run the cases whose group/name/dtype contains TEXT, may be repeated\n"
+           "  --list              list the cases and exit\n"
+           "  --min-time SECONDS  measurement time per case, default 0.25\n"
+           "  --threads N         threads of the library, default: all\n"
+           "  --json FILE         write the results as JSON\n"
+           "  --compare FILE      compare with the JSON results of a previous run, exits with 2 on regressions\n"
+           "  --tolerance X       relative slowdown that counts as regression, default 0.10\n"
+           "  --no-reference      skip the roofline measurement\n"
+           "  --dir PATH          directory for the files of the I/O cases, default: system temporary directory\n",
+           program);
+}
+
+int Suite::main(int argc, char** argv)
+{
+    vector<string> filters;
+    string json_path, compare_path;
+    double min_time = 0.25;
+    double tolerance = 0.10;
+    bool list = false;
+    bool with_reference = true;
+    dir = (filesystem::temp_directory_path() / "tensor_utils_bench").string();
+    for(int i=1; i<argc; i++)
+    {
+        const string arg = argv[i];
+        const bool has_value = i+1 < argc;
+        if(arg == "--filter" && has_value)          {filters.push_back(argv[++i]);}
+        else if(arg == "--list")                    {list = true;}
+        else if(arg == "--min-time" && has_value)   {min_time = atof(argv[++i]);}
+        else if(arg == "--threads" && has_value)    {Parallel::set_num_threads(unsigned(atoi(argv[++i])));}
+        else if(arg == "--json" && has_value)       {json_path = argv[++i];}
+        else if(arg == "--compare" && has_value)    {compare_path = argv[++i];}
+        else if(arg == "--tolerance" && has_value)  {tolerance = atof(argv[++i]);}
+        else if(arg == "--no-reference")            {with_reference = false;}
+        else if(arg == "--dir" && has_value)        {dir = argv[++i];}
+        else
+        {
+            usage(argv[0]);
+            return (arg == "--help" || arg == "-h") ? 0 : 1;
+        }
+    }
+
+    vector<const Case*> selected;
+    for(auto it=cases.begin(); it!=cases.end(); it++)
+    {
+        bool match = filters.empty();
+        for(auto f=filters.begin(); f!=filters.end() && !match; f++)
+        {
+            match = key(*it).find(*f) != string::npos;
+        }
+        if(match)
+        {
+            selected.push_back(&*it);
+        }
+    }
+    if(list)
+    {
+        for(auto it=selected.begin(); it!=selected.end(); it++)
+        {
+            printf("%s %s\n", key(**it).c_str(), shape_string((*it)->shape, "{", "}").c_str());
+        }
+        return 0;
+    }
+
+    const bool own_dir = !filesystem::exists(dir);
+    filesystem::create_directories(dir);
+    const Reference ref = with_reference ? measure_reference() : Reference();
+    print_header(ref, with_reference);
+    vector<Result> results;
+    for(auto it=selected.begin(); it!=selected.end(); it++)
+    {
+        results.push_back(measure(**it, min_time, ref, with_reference));
+        print_result(results.back());
+    }
+    if(own_dir)
+    {
+        filesystem::remove_all(dir);
+    }
+
+    if(!json_path.empty())
+    {
+        write_json(json_path, results, ref, min_time);
+    }
+    if(!compare_path.empty() && compare(compare_path, results, tolerance) > 0)
+    {
+        return 2;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    Suite suite;
+    add_elementwise(suite);
+    add_linalg(suite);
+    add_io(suite);
+    return suite.main(argc, argv);
+}
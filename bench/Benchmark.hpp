@@ -0,0 +1,164 @@
+/*
+TensorUtils Version 0.1
+
+Copyright 2022 Christoph Widder
+
+This file is part of TensorUtils.
+
+TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+the GNU General Public License as published by the Free Software Foundation, either
+version 3 of the License, or (at your option) any later version.
+
+TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with TensorUtils.
+If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+
+#include "TensorUtils.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/*
+    Microbenchmarks of the library. Every case describes the work of a single iteration: the number of
+    floating point operations, the bytes that must be moved at least and the number of components.
+    The harness derives GFLOP/s, GB/s and ns per component from the measured time and relates them to the
+    roofline of the machine, i.e. min(peak FLOP/s, arithmetic intensity * peak bandwidth), which is
+    measured once at startup.
+*/
+namespace Bench
+{
+    // what limits a case: the roofline for COMPUTE and MEMORY, no roofline for IO
+    enum class Bound
+    {
+        COMPUTE,
+        MEMORY,
+        IO
+    };
+
+    struct Case
+    {
+        std::string group;
+        std::string name;
+        std::string dtype;
+        std::vector<size_t> shape;
+        double flops = 0.0;         // per iteration
+        double bytes = 0.0;         // per iteration
+        double elements = 1.0;      // per iteration
+        Bound bound = Bound::MEMORY;
+
+        // allocates the operands and returns one iteration, the operands are released after the case.
+        // May update the work of the case, e.g. the size of a file that is only known once it is written.
+        std::function<std::function<void()>(Case&)> setup;
+    };
+
+    struct Result
+    {
+        Case c;
+        size_t iterations;
+        double ns_median;           // per iteration
+        double ns_min;              // per iteration
+        double roof;                // fraction of the attainable performance, negative if not applicable
+    };
+
+    // peak numbers of the machine that the results are compared with
+    struct Reference
+    {
+        double gflops_f32 = 0.0;
+        double gflops_f64 = 0.0;
+
+        // bandwidth for increasing amounts of traffic, such that data that stays in a cache is compared
+        // with the bandwidth of that cache
+        std::vector<double> working_set;
+        std::vector<double> gbs;
+
+        // bandwidth for the smallest measured traffic of at least bytes
+        double bandwidth(double bytes) const;
+    };
+
+    class Suite
+    {
+        public:
+            void add(const Case &c);
+
+            // runs all cases that match the command line, see usage() in Benchmark.cpp
+            int main(int argc, char** argv);
+
+            // directory for the files of the I/O cases
+            const std::string& scratch() const;
+
+        private:
+            std::vector<Case> cases;
+            std::string dir;
+    };
+
+    Case make_case(
+        const std::string                               &group,
+        const std::string                               &name,
+        const std::string                               &dtype,
+        const std::vector<size_t>                       &shape,
+        double                                          flops,
+        double                                          bytes,
+        double                                          elements,
+        Bound                                           bound,
+        std::function<std::function<void()>(Case&)>     setup);
+
+    // components with a fixed sequence of values in [-1,1), such that every run sees the same data
+    template<class T>
+    TensorUtils::TensorBase<T> random_tensor(const std::vector<size_t> &shape, unsigned seed = 42)
+    {
+        TensorUtils::TensorBase<T> result(shape);
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<double> dist(-1.0, 1.0);
+        for(auto it=result.begin(); it!=result.end(); it++)
+        {
+            *it = static_cast<T>(dist(rng));
+        }
+        return result;
+    }
+
+    // shape of the given rank with about n components and extents as equal as possible
+    std::vector<size_t> equal_shape(size_t rank, size_t n);
+
+    // number of components of shape
+    size_t volume(const std::vector<size_t> &shape);
+
+    template<class T>
+    const char* dtype_name()
+    {
+        if constexpr(std::is_same<T,float>::value)
+        {
+            return "f32";
+        }
+        else if constexpr(std::is_same<T,double>::value)
+        {
+            return "f64";
+        }
+        else if constexpr(std::is_same<T,long double>::value)
+        {
+            return "f80";
+        }
+        else
+        {
+            return "int";
+        }
+    }
+
+    // registration of the cases per group, see bench_*.cpp
+    void add_elementwise(Suite &suite);
+    void add_linalg(Suite &suite);
+    void add_io(Suite &suite);
+}
+
+#endif // BENCHMARK_HPP
@@ -0,0 +1,124 @@
+/*
+TensorUtils Version 0.1
+
+Copyright 2022 Christoph Widder
+
+This file is part of TensorUtils.
+
+TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+the GNU General Public License as published by the Free Software Foundation, either
+version 3 of the License, or (at your option) any later version.
+
+TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with TensorUtils.
+If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include "Benchmark.hpp"
+
+#include <memory>
+
+using namespace std;
+using namespace TensorUtils;
+using namespace Bench;
+
+/**
+    ELEMENT-WISE OPERATIONS
+**/
+
+template<class T>
+static void add_type(Suite &suite, const vector<size_t> &shape, const string &suffix)
+{
+    const double n = double(volume(shape));
+    const double s = sizeof(T);
+    const string dtype = dtype_name<T>();
+
+    suite.add(make_case("elementwise", "add_assign" + suffix, dtype, shape, n, 3*n*s, n, Bound::MEMORY, [shape](Case&)
+    {
+        auto A = make_shared<TensorBase<T>>(random_tensor<T>(shape, 1));
+        auto B = make_shared<TensorBase<T>>(random_tensor<T>(shape, 2));
+        return [A,B]{ *A += *B; };
+    }));
+    if(!suffix.empty())
+    {
+        return; // the ranks only differ in the metadata, which is covered by add_assign
+    }
+    suite.add(make_case("elementwise", "scale", dtype, shape, n, 2*n*s, n, Bound::MEMORY, [shape](Case&)
+    {
+        auto A = make_shared<TensorBase<T>>(random_tensor<T>(shape, 1));
+        return [A]{ *A *= T(1); };
+    }));
+    suite.add(make_case("elementwise", "expression", dtype, shape, 2*n, 3*n*s, n, Bound::MEMORY, [shape](Case&)
+    {
+        auto A = make_shared<TensorBase<T>>(shape);
+        auto B = make_shared<TensorBase<T>>(random_tensor<T>(shape, 2));
+        auto C = make_shared<TensorBase<T>>(random_tensor<T>(shape, 3));
+        return [A,B,C]{ *A = *B + *C*T(2); };
+    }));
+    suite.add(make_case("elementwise", "init", dtype, shape, 0, n*s, n, Bound::MEMORY, [shape](Case&)
+    {
+        auto A = make_shared<TensorBase<T>>(shape);
+        return [A]{ A->init(T(1)); };
+    }));
+}
+
+static void add_conversion(Suite &suite, const vector<size_t> &shape)
+{
+    const double n = double(volume(shape));
+    suite.add(make_case("elementwise", "convert_f32_to_f64", "f64", shape, 0, n*(sizeof(float)+sizeof(double)), n, Bound::MEMORY,
+    [shape](Case&)
+    {
+        auto A = make_shared<TensorBase<double>>(shape);
+        auto B = make_shared<TensorBase<float>>(random_tensor<float>(shape, 2));
+        return [A,B]{ *A = *B; };
+    }));
+}
+
+/**
+    REDUCTIONS
+**/
+
+template<class T>
+static void add_reductions(Suite &suite, const vector<size_t> &shape)
+{
+    const double n = double(volume(shape));
+    const double s = sizeof(T);
+    const string dtype = dtype_name<T>();
+
+    suite.add(make_case("reduce", "sum", dtype, shape, n, n*s, n, Bound::MEMORY, [shape](Case&)
+    {
+        auto A = make_shared<TensorBase<T>>(random_tensor<T>(shape, 1));
+        auto sink = make_shared<T>(0);
+        return [A,sink]{ *sink += A->sum(); };
+    }));
+    suite.add(make_case("reduce", "norm2", dtype, shape, 2*n, n*s, n, Bound::MEMORY, [shape](Case&)
+    {
+        auto A = make_shared<TensorBase<T>>(random_tensor<T>(shape, 1));
+        auto sink = make_shared<T>(0);
+        return [A,sink]{ *sink += A->norm2(); };
+    }));
+    suite.add(make_case("reduce", "sum_axis0", dtype, shape, n, n*s, n, Bound::MEMORY, [shape](Case&)
+    {
+        auto A = make_shared<TensorBase<T>>(random_tensor<T>(shape, 1));
+        auto B = make_shared<TensorBase<T>>();
+        return [A,B]{ *B = A->sum({0}); };
+    }));
+}
+
+void Bench::add_elementwise(Suite &suite)
+{
+    const vector<size_t> shape = {1024, 4096};
+    add_type<float>(suite, shape, "");
+    add_type<double>(suite, shape, "");
+    add_conversion(suite, shape);
+    for(size_t rank=0; rank<=8; rank++)
+    {
+        add_type<double>(suite, equal_shape(rank, size_t(1)<<20), "/rank" + to_string(rank));
+    }
+    add_reductions<float>(suite, shape);
+    add_reductions<double>(suite, shape);
+}
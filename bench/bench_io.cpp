@@ -0,0 +1,80 @@
+/*
+TensorUtils Version 0.1
+
+Copyright 2022 Christoph Widder
+
+This file is part of TensorUtils.
+
+TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+the GNU General Public License as published by the Free Software Foundation, either
+version 3 of the License, or (at your option) any later version.
+
+TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with TensorUtils.
+If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include "Benchmark.hpp"
+
+#include <filesystem>
+#include <memory>
+
+using namespace std;
+using namespace TensorUtils;
+using namespace Bench;
+
+/**
+    FILES
+**/
+
+// size of the file and of its shape file, if the format has one
+static double file_bytes(const string &dir, const string &name)
+{
+    double bytes = 0.0;
+    for(auto &entry : filesystem::directory_iterator(dir))
+    {
+        if(entry.path().filename().string().rfind(name, 0) == 0)
+        {
+            bytes += double(entry.file_size());
+        }
+    }
+    return bytes;
+}
+
+// files of double components are written and read in every format, the page cache keeps them in memory
+static void add_format(Suite &suite, const string &extension, const vector<size_t> &shape)
+{
+    const double n = double(volume(shape));
+    const string name = "tensor" + extension;
+
+    suite.add(make_case("io", "write" + extension, "f64", shape, 0, 0, n, Bound::IO, [&suite,shape,name](Case &c)
+    {
+        auto A = make_shared<TensorBase<double>>(random_tensor<double>(shape, 1));
+        const string dir = suite.scratch();
+        A->write(name, dir);
+        c.bytes = file_bytes(dir, name);
+        return [A,name,dir]{ A->write(name, dir); };
+    }));
+    suite.add(make_case("io", "read" + extension, "f64", shape, 0, 0, n, Bound::IO, [&suite,shape,name](Case &c)
+    {
+        const string dir = suite.scratch();
+        random_tensor<double>(shape, 1).write(name, dir);
+        c.bytes = file_bytes(dir, name);
+        auto A = make_shared<TensorBase<double>>();
+        const string path = (filesystem::path(dir) / name).string();
+        return [A,path]{ A->read(path); };
+    }));
+}
+
+void Bench::add_io(Suite &suite)
+{
+    const vector<size_t> shape = {512, 512};
+    for(const char* extension : {".txt", ".f32", ".f64", ".f80", ".int", ".uc", ".tu"})
+    {
+        add_format(suite, extension, shape);
+    }
+}
@@ -0,0 +1,165 @@
+/*
+TensorUtils Version 0.1
+
+Copyright 2022 Christoph Widder
+
+This file is part of TensorUtils.
+
+TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+the GNU General Public License as published by the Free Software Foundation, either
+version 3 of the License, or (at your option) any later version.
+
+TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with TensorUtils.
+If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include "Benchmark.hpp"
+
+#include <memory>
+
+using namespace std;
+using namespace TensorUtils;
+using namespace Bench;
+
+/**
+    PRODUCTS
+**/
+
+template<class T>
+static void add_products(Suite &suite)
+{
+    const double s = sizeof(T);
+    const string dtype = dtype_name<T>();
+
+    for(size_t n : {size_t(3), size_t(64), size_t(256), size_t(1024)})
+    {
+        const vector<size_t> shape = {n, n};
+        const double nn = double(n*n);
+        suite.add(make_case("dot", "matmul_" + to_string(n), dtype, shape, 2*nn*n, 3*nn*s, nn, Bound::COMPUTE, [shape](Case&)
+        {
+            auto A = make_shared<TensorBase<T>>(random_tensor<T>(shape, 1));
+            auto B = make_shared<TensorBase<T>>(random_tensor<T>(shape, 2));
+            auto C = make_shared<TensorBase<T>>();
+            return [A,B,C]{ *C = A->dot(*B, {1,-1}, {-1,2}); };
+        }));
+    }
+
+    // the index analysis is done once, so small products only pay for the kernel
+    const vector<size_t> small = {3, 3};
+    suite.add(make_case("plan", "matmul_3", dtype, small, 54, 27*s, 9, Bound::COMPUTE, [small](Case&)
+    {
+        auto A = make_shared<TensorBase<T>>(random_tensor<T>(small, 1));
+        auto B = make_shared<TensorBase<T>>(random_tensor<T>(small, 2));
+        auto C = make_shared<TensorBase<T>>();
+        auto plan = make_shared<ContractionPlan>(small, vector<int>{1,-1}, small, vector<int>{-1,2});
+        return [A,B,C,plan]{ plan->execute(*A, *B, *C); };
+    }));
+
+    const vector<size_t> rank4 = {24, 24, 24, 24};
+    const double n4 = double(volume(rank4));
+    suite.add(make_case("dot", "rank4_gemm", dtype, rank4, 2*n4*24*24, 3*n4*s, n4, Bound::COMPUTE, [rank4](Case&)
+    {
+        auto A = make_shared<TensorBase<T>>(random_tensor<T>(rank4, 1));
+        auto B = make_shared<TensorBase<T>>(random_tensor<T>(rank4, 2));
+        auto C = make_shared<TensorBase<T>>();
+        return [A,B,C]{ *C = A->dot(*B, {1,2,-1,-2}, {-1,-2,3,4}); };
+    }));
+    suite.add(make_case("dot", "rank4_permuted", dtype, rank4, 2*n4*24*24, 3*n4*s, n4, Bound::COMPUTE, [rank4](Case&)
+    {
+        auto A = make_shared<TensorBase<T>>(random_tensor<T>(rank4, 1));
+        auto B = make_shared<TensorBase<T>>(random_tensor<T>(rank4, 2));
+        auto C = make_shared<TensorBase<T>>();
+        return [A,B,C]{ *C = A->dot(*B, {1,-1,2,-2}, {-2,3,-1,4}); };
+    }));
+
+    // A*(B*C) instead of (A*B)*C, see ContractionPath
+    const vector<size_t> chain = {1000, 10};
+    suite.add(make_case("path", "chain3", dtype, chain, 4e5, 4e4*s, 1e4, Bound::COMPUTE, [](Case&)
+    {
+        auto A = make_shared<TensorBase<T>>(random_tensor<T>({1000, 10}, 1));
+        auto B = make_shared<TensorBase<T>>(random_tensor<T>({10, 1000}, 2));
+        auto C = make_shared<TensorBase<T>>(random_tensor<T>({1000, 10}, 3));
+        auto Z = make_shared<TensorBase<T>>();
+        auto path = make_shared<ContractionPath>(vector<vector<size_t>>{A->shape, B->shape, C->shape},
+                                                 vector<vector<int>>{{1,-1},{-1,-2},{-2,2}});
+        return [A,B,C,Z,path]{ path->execute({A.get(), B.get(), C.get()}, *Z); };
+    }));
+
+    const vector<size_t> cube = {48, 48, 48, 48};
+    suite.add(make_case("contract", "trace", dtype, cube, 48.0*48*48, 48.0*48*48*s, 48.0*48*48, Bound::MEMORY, [cube](Case&)
+    {
+        auto A = make_shared<TensorBase<T>>(random_tensor<T>(cube, 1));
+        auto B = make_shared<TensorBase<T>>();
+        return [A,B]{ *B = A->contract({1,2,-1,-1}); };
+    }));
+    const vector<size_t> all = {32, 32, 32, 32};
+    const double na = double(volume(all));
+    suite.add(make_case("contract", "full_sum", dtype, all, na, na*s, na, Bound::MEMORY, [all](Case&)
+    {
+        auto A = make_shared<TensorBase<T>>(random_tensor<T>(all, 1));
+        auto B = make_shared<TensorBase<T>>();
+        return [A,B]{ *B = A->contract({-1,-2,-3,-4}); };
+    }));
+}
+
+/**
+    PERMUTATIONS AND SUB-TENSORS
+**/
+
+template<class T>
+static void add_transpose(Suite &suite, const vector<size_t> &shape, const vector<unsigned> &axes, const string &name)
+{
+    const double n = double(volume(shape));
+    suite.add(make_case("transpose", name, dtype_name<T>(), shape, 0, 2*n*sizeof(T), n, Bound::MEMORY, [shape,axes](Case&)
+    {
+        auto A = make_shared<TensorBase<T>>(random_tensor<T>(shape, 1));
+        auto B = make_shared<TensorBase<T>>();
+        return [A,B,axes]{ *B = A->transpose(axes); };
+    }));
+}
+
+template<class T>
+static void add_slice(Suite &suite)
+{
+    const vector<size_t> shape = {256, 64, 256};
+    const double n = 64.0*256;
+    suite.add(make_case("slice", "copy", dtype_name<T>(), shape, 0, 2*n*sizeof(T), n, Bound::MEMORY, [shape](Case&)
+    {
+        auto A = make_shared<TensorBase<T>>(random_tensor<T>(shape, 1));
+        auto B = make_shared<TensorBase<T>>();
+        return [A,B]{ *B = A->slice({100}); };
+    }));
+    suite.add(make_case("slice", "view", dtype_name<T>(), shape, 0, 0, 1, Bound::MEMORY, [shape](Case&)
+    {
+        auto A = make_shared<TensorBase<T>>(random_tensor<T>(shape, 1));
+        auto V = make_shared<TensorView<T>>();
+        return [A,V]{ *V = A->view().slice({100}); };
+    }));
+}
+
+void Bench::add_linalg(Suite &suite)
+{
+    add_products<float>(suite);
+    add_products<double>(suite);
+
+    add_transpose<float>(suite, {2048, 2048}, {1,0}, "matrix");
+    add_transpose<double>(suite, {2048, 2048}, {1,0}, "matrix");
+    add_transpose<double>(suite, {128, 128, 256}, {0,2,1}, "inner_pair");
+    for(unsigned rank=1; rank<=8; rank++)
+    {
+        vector<unsigned> reverse;
+        for(unsigned dim=rank; dim>0; dim--)
+        {
+            reverse.push_back(dim-1);
+        }
+        add_transpose<double>(suite, equal_shape(rank, size_t(1)<<20), reverse, "reverse/rank" + to_string(rank));
+    }
+
+    add_slice<float>(suite);
+    add_slice<double>(suite);
+}
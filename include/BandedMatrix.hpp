@@ -0,0 +1,156 @@
+/**
+\internal
+    TensorUtils Version 0.1
+
+    Copyright 2022 Christoph Widder
+
+    This file is part of TensorUtils.
+
+    TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+    the GNU General Public License as published by the Free Software Foundation, either
+    version 3 of the License, or (at your option) any later version.
+
+    TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+    without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+    PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along with TensorUtils.
+    If not, see <https://www.gnu.org/licenses/>.
+\endinternal
+**/
+
+
+#ifndef BANDEDMATRIX_HPP
+#define BANDEDMATRIX_HPP
+
+#include "TensorBase.hpp"
+
+#include <initializer_list>
+#include <vector>
+
+namespace TensorUtils
+{
+    /*!
+        \addtogroup TensorUtils
+        @{
+    */
+
+    //! Matrix that stores only the components of a band around its main diagonal, e.g. diagonal or tridiagonal matrices.
+    /*!
+        The component (i,j) is stored if i-j <= \ref lower and j-i <= \ref upper, all other components are zero.
+        A diagonal matrix has lower = upper = 0. \ref values holds one row of lower+upper+1 components per row of the
+        matrix, where (i,j) is stored at i*(lower+upper+1) + j-i+lower. Slots of the rows that lie outside the matrix are zero.
+
+        \ref dot and \ref contract take the same index labels as \ref TensorBase::dot and \ref TensorBase::contract and
+        return a dense tensor. Their cost is proportional to the number of stored components: every stored component
+        is multiplied with the indices of the dense operand that do not occur in the matrix, with contiguous inner loops,
+        and the rows of the matrix are processed concurrently if they write to different parts of the result.
+        Throws \ref ErrorHandler::ShapeMismatch with the same conditions as \ref TensorBase::dot and \ref TensorBase::contract.
+        \code
+        #include "TensorUtils.hpp"
+
+        int main()
+        {
+            using namespace TensorUtils;
+
+            BandedMatrix<double> K({1000,1000}, 1, 1);          // tridiagonal: 3000 instead of 10^6 components
+            for(size_t i=0; i<1000; i++)
+            {
+                K.set(i, i, 2.0);
+                if(i > 0)   K.set(i, i-1, -1.0);
+                if(i < 999) K.set(i, i+1, -1.0);
+            }
+
+            tensor<double> U({1000,16}, 1.0), F;
+            F = K.dot(U, {1,-1}, {-1,2});                       // F has shape {1000,16}
+            F = K.dot(U, {-1,1}, {-1,2});                       // product with the transpose of K
+
+            tensor<double> d({1000}, 0.5);
+            BandedMatrix<double> D = BandedMatrix<double>::diagonal(d);
+            TensorBase<double> trace = K.contract({-1,-1});     // 2000
+
+            return 0;
+        }
+        \endcode
+    */
+    template<class T>
+    class BandedMatrix
+    {
+        public:
+            //! Stored component type.
+            typedef T value_type;
+
+            //! Empty matrix of shape {0,0}.
+            BandedMatrix();
+
+            /*!
+                Matrix of the given shape and bandwidths with all components zero.
+                Throws \ref ErrorHandler::ShapeMismatch if the shape does not have two indices.
+            */
+            BandedMatrix(const std::vector<size_t> &shape, size_t lower, size_t upper);
+
+            //! Same as \ref BandedMatrix(const std::vector<size_t>&,size_t,size_t), resolves the ambiguity of braced shapes, e.g. BandedMatrix<double>({4,4},1,1).
+            BandedMatrix(std::initializer_list<size_t> shape, size_t lower, size_t upper);
+
+            /*!
+                Stores the components of the band of \p dense, the other components are not read.
+                Throws \ref ErrorHandler::ShapeMismatch if \p dense is not a matrix.
+            */
+            BandedMatrix(const TensorBase<T> &dense, size_t lower, size_t upper);
+
+            //! Square matrix with the components of \p diag on its main diagonal.
+            static BandedMatrix<T> diagonal(const TensorBase<T> &diag);
+
+            //! Sets the shape and the bandwidths and all components to zero.
+            void alloc(const std::vector<size_t> &shape, size_t lower, size_t upper);
+
+            //! Number of stored diagonals below the main diagonal.
+            size_t lower() const;
+
+            //! Number of stored diagonals above the main diagonal.
+            size_t upper() const;
+
+            //! Number of stored components including the unused slots, see \ref BandedMatrix.
+            size_t stored() const;
+
+            //! Value of the component (row,col), zero outside of the band. Throws std::out_of_range if THROW_EXCEPTIONS is enabled and an index exceeds its range.
+            T operator()(size_t row, size_t col) const;
+
+            //! Sets the component (row,col). Throws std::out_of_range if it is outside of the band or the matrix.
+            void set(size_t row, size_t col, const T &val);
+
+            //! Stored components, see \ref BandedMatrix.
+            std::vector<T>& values();
+
+            //! Stored components, see \ref BandedMatrix.
+            const std::vector<T>& values() const;
+
+            //! Dense matrix with all components.
+            TensorBase<T> dense() const;
+
+            /*!
+                Generalized tensor product with a dense tensor, see \ref TensorBase::dot and \ref BandedMatrix.
+                The operands can be swapped together with their labels to compute dense-banded products.
+            */
+            TensorBase<T> dot(
+                const TensorBase<T>         &rhs,
+                const std::vector<int>      &idx_lhs,
+                const std::vector<int>      &idx_rhs) const;
+
+            //! Sum over specified axes, e.g. the trace for {-1,-1}, see \ref TensorBase::contract.
+            TensorBase<T> contract(const std::vector<int> &idx_lhs) const;
+
+            //! Number of rows and columns (read-only by convention, use \ref alloc to change it), see \ref TensorBase::shape.
+            std::vector<size_t> shape;
+
+        private:
+            // result += (*this) x rhs for rhs != nullptr, otherwise the contraction of all stored components
+            void multiply(const TensorBase<T>* rhs, const std::vector<int> &idx_lhs, const std::vector<int> &idx_rhs, TensorBase<T> &result) const;
+
+            size_t lo, up;
+            std::vector<T> vals;
+    };
+    /*! @} */
+}
+
+#endif // BANDEDMATRIX_HPP
@@ -0,0 +1,182 @@
+/**
+\internal
+    TensorUtils Version 0.1
+
+    Copyright 2022 Christoph Widder
+
+    This file is part of TensorUtils.
+
+    TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+    the GNU General Public License as published by the Free Software Foundation, either
+    version 3 of the License, or (at your option) any later version.
+
+    TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+    without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+    PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along with TensorUtils.
+    If not, see <https://www.gnu.org/licenses/>.
+\endinternal
+**/
+
+#ifndef CONTRACTIONPATH_HPP
+#define CONTRACTIONPATH_HPP
+
+#include "ContractionPlan.hpp"
+#include "TensorBase.hpp"
+
+#include <utility>
+#include <vector>
+
+namespace TensorUtils
+{
+    /*!
+        \addtogroup TensorUtils
+        @{
+    */
+
+    //! Order of pairwise products for the contraction of several tensors.
+    /*!
+        Every operand has one label per index, which are interpreted as for \ref TensorBase::dot, but across all operands:
+        equal labels are identified, negative labels are summed over and the result has the non-negative labels in
+        increasing order. Three or more operands are contracted by a sequence of pairwise products. Their order does not
+        change the result, but it can change the number of operations and the size of the intermediates by orders of magnitude.
+
+        The path is searched once, when it is constructed. The cost of a pairwise product is the number of its multiply-adds,
+        i.e. the product of the ranges of all labels of both operands, and indices are summed over as early as possible:
+        - Strategy::OPTIMAL finds the cheapest order by dynamic programming over all subsets of operands, which takes
+          O(3^n) steps for n operands.
+        - Strategy::GREEDY repeatedly contracts the pair with a common label that shrinks the total size the most.
+        - Strategy::AUTO selects OPTIMAL for at most \ref OPTIMAL_LIMIT operands and GREEDY otherwise.
+
+        Every pairwise product is planned once by a \ref ContractionPlan, so \ref execute runs the matrix-matrix kernels of
+        \ref TensorBase::dot without any further analysis. Intermediates are stored in a few buffers that are reused by the
+        following steps. Throws \ref ErrorHandler::ShapeMismatch if the labels do not match the shapes or there are more
+        than 64 distinct labels.
+        \code
+        #include "TensorUtils.hpp"
+
+        int main()
+        {
+            using namespace TensorUtils;
+
+            tensor<double> A({1000,10}, 1.0);
+            tensor<double> B({10,1000}, 1.0);
+            tensor<double> C({1000,10}, 1.0);
+            tensor<double> Z;
+
+            Z = contract({{1,-1},{-1,-2},{-2,2}}, A, B, C);     // A*(B*C): Z has shape {1000,10}, A*B is never formed
+
+            ContractionPath path({A.shape, B.shape, C.shape}, {{1,-1},{-1,-2},{-2,2}});
+            for(int n=0; n<100; n++)
+            {
+                path.execute({&A, &B, &C}, Z);                  // same as above without repeating the search
+            }
+            double speedup = path.naive_flops()/path.flops();   // compared to the order of the operands
+
+            return 0;
+        }
+        \endcode
+    */
+    class ContractionPath
+    {
+        public:
+            //! Search strategy, see \ref ContractionPath.
+            enum class Strategy
+            {
+                AUTO,
+                GREEDY,
+                OPTIMAL
+            };
+
+            //! Largest number of operands for which Strategy::AUTO searches the optimal path.
+            static constexpr size_t OPTIMAL_LIMIT = 10;
+
+            //! Empty path. Must be assigned before \ref execute is called.
+            ContractionPath();
+
+            /*!
+                Path for the contraction of operands with the given shapes and labels.
+                \param shapes       Shapes of all operands.
+                \param labels       Indices of all operands represented by signed integers.
+                \param strategy     Search strategy.
+            */
+            ContractionPath(
+                const std::vector<std::vector<size_t>>  &shapes,
+                const std::vector<std::vector<int>>     &labels,
+                Strategy                                strategy=Strategy::AUTO);
+
+            //! Number of operands.
+            size_t operands() const;
+
+            /*!
+                Pairwise products in the order of execution, in the same form as numpy.einsum_path: every step contracts the
+                operands at the positions first < second of the current list, removes them and appends the product.
+            */
+            const std::vector<std::pair<size_t,size_t>>& steps() const;
+
+            //! Shape of the result.
+            const std::vector<size_t>& shape() const;
+
+            //! Number of multiply-adds of the path.
+            double flops() const;
+
+            //! Number of multiply-adds of the products in the order of the operands, for comparison.
+            double naive_flops() const;
+
+            //! Number of components of the largest intermediate, not counting the result.
+            size_t largest_intermediate() const;
+
+            /*!
+                Contracts \p operands, which must have the planned shapes, and stores the result in \p result.
+                \p result is only reallocated if its shape differs from \ref shape().
+            */
+            template<class T>
+            void execute(const std::vector<const TensorBase<T>*> &operands, TensorBase<T> &result) const;
+
+        private:
+            size_t n_operands;
+            std::vector<std::pair<size_t,size_t>> path;
+            std::vector<ContractionPlan> plans;     // one per step, or a single contraction for one operand
+            std::vector<size_t> result_shape;
+            double path_flops;
+            double order_flops;
+            size_t max_intermediate;
+    };
+
+    /*!
+        Contracts all \p operands with the given \p labels along the cheapest path. See \ref ContractionPath.
+        \code
+        #include "TensorUtils.hpp"
+
+        int main()
+        {
+            using namespace TensorUtils;
+
+            tensor<double> X({8,8,8}, 1.0);
+            tensor<double> Y({8,8}, 2.0);
+            tensor<double> Z;
+
+            Z = contract({{1,-1,-2},{-1,-3},{-2,-3,2}}, X, Y, X);   // Z has shape {8,8}
+
+            return 0;
+        }
+        \endcode
+    */
+    template<class T, class... TENSORS>
+    TensorBase<T> contract(const std::vector<std::vector<int>> &labels, const TensorBase<T> &first, const TENSORS&... rest)
+    {
+        const std::vector<const TensorBase<T>*> operands = {&first, &rest...};
+        std::vector<std::vector<size_t>> shapes;
+        for(auto it=operands.begin(); it!=operands.end(); it++)
+        {
+            shapes.push_back((*it)->shape);
+        }
+        TensorBase<T> result;
+        ContractionPath(shapes, labels).execute(operands, result);
+        return result;
+    }
+    /*! @} */
+}
+
+#endif // CONTRACTIONPATH_HPP
@@ -0,0 +1,255 @@
+/**
+\internal
+    TensorUtils Version 0.1
+
+    Copyright 2022 Christoph Widder
+
+    This file is part of TensorUtils.
+
+    TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+    the GNU General Public License as published by the Free Software Foundation, either
+    version 3 of the License, or (at your option) any later version.
+
+    TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+    without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+    PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along with TensorUtils.
+    If not, see <https://www.gnu.org/licenses/>.
+\endinternal
+**/
+
+#ifndef CONTRACTIONPLAN_HPP
+#define CONTRACTIONPLAN_HPP
+
+#include "TensorBase.hpp"
+#include "TensorView.hpp"
+
+#include <vector>
+#include <memory>
+
+namespace TensorUtils
+{
+    /*!
+        \addtogroup TensorUtils
+        @{
+    */
+
+    //! Precompiled schedule of a generalized tensor product, see \ref TensorBase::dot and \ref TensorBase::contract.
+    /*!
+        The index labels are interpreted exactly as for \ref TensorBase::dot and \ref TensorBase::contract.
+        All labels and shapes are analyzed and validated once, when the plan is constructed.
+        Plans for strided operands, e.g. of a \ref TensorView, are constructed from their shapes and strides.
+        Afterwards, \ref execute runs the precomputed loop schedule on new operands of the same shapes
+        without any further analysis. If the result already has the correct shape, no memory is allocated.
+        Plans are immutable after construction and may be shared and copied cheaply.
+        Every thread keeps its last few plans, so constructing a plan with the same arguments again, e.g. by calling
+        \ref TensorBase::dot in a loop, does not repeat the analysis.
+        \code
+        #include "TensorUtils.hpp"
+
+        int main()
+        {
+            using namespace TensorUtils;
+
+            tensor<double> X({2,3,7,7},1);
+            tensor<double> Y({7,5,3,11},2);
+            tensor<double> Z;
+
+            ContractionPlan plan(X.shape, {3,2,-5,-5}, Y.shape, {-5,4,2,1}); // same as X.dot(Y,{3,2,-5,-5},{-5,4,2,1})
+
+            for(int n=0; n<100; n++)
+            {
+                X.init(n);
+                plan.execute(X, Y, Z); // Z has shape {11,3,2,5} == plan.shape()
+            }
+
+            ContractionPlan trace(X.shape, {1,2,-1,-1}); // same as X.contract({1,2,-1,-1})
+            trace.execute(X, Z);
+
+            return 0;
+        }
+        \endcode
+    */
+    class ContractionPlan
+    {
+        public:
+            //! Empty plan. Must be assigned before \ref execute is called.
+            ContractionPlan();
+
+            /*!
+                Plan for the generalized tensor product of two operands, see \ref TensorBase::dot.
+                Throws \ref ErrorHandler::ShapeMismatch if the indices do not match the shapes.
+                \param shape_lhs    Shape of the first operand.
+                \param idx_lhs      Indices of the first operand represented by signed integers.
+                \param shape_rhs    Shape of the second operand.
+                \param idx_rhs      Indices of the second operand represented by signed integers.
+                \param idx_at       Indices specifying the sub-tensor to be computed.
+            */
+            ContractionPlan(
+                const std::vector<size_t>   &shape_lhs,
+                const std::vector<int>      &idx_lhs,
+                const std::vector<size_t>   &shape_rhs,
+                const std::vector<int>      &idx_rhs,
+                const std::vector<size_t>   &idx_at={});
+
+            /*!
+                Plan for the contraction of a single operand, see \ref TensorBase::contract.
+                Throws \ref ErrorHandler::ShapeMismatch if the indices do not match the shape.
+                \param shape_lhs    Shape of the operand.
+                \param idx_lhs      Indices of the operand represented by signed integers.
+                \param idx_at       Indices specifying the sub-tensor to be computed.
+            */
+            ContractionPlan(
+                const std::vector<size_t>   &shape_lhs,
+                const std::vector<int>      &idx_lhs,
+                const std::vector<size_t>   &idx_at={});
+
+            /*!
+                Plan for the generalized tensor product of two strided operands, e.g. of two \ref TensorView.
+                Throws \ref ErrorHandler::ShapeMismatch if the indices do not match the shapes.
+                \param shape_lhs    Shape of the first operand.
+                \param incr_lhs     Strides of the first operand.
+                \param idx_lhs      Indices of the first operand represented by signed integers.
+                \param shape_rhs    Shape of the second operand.
+                \param incr_rhs     Strides of the second operand.
+                \param idx_rhs      Indices of the second operand represented by signed integers.
+                \param idx_at       Indices specifying the sub-tensor to be computed.
+            */
+            ContractionPlan(
+                const std::vector<size_t>   &shape_lhs,
+                const std::vector<size_t>   &incr_lhs,
+                const std::vector<int>      &idx_lhs,
+                const std::vector<size_t>   &shape_rhs,
+                const std::vector<size_t>   &incr_rhs,
+                const std::vector<int>      &idx_rhs,
+                const std::vector<size_t>   &idx_at={});
+
+            /*!
+                Plan for the contraction of a single strided operand, e.g. of a \ref TensorView.
+                Throws \ref ErrorHandler::ShapeMismatch if the indices do not match the shape.
+                \param shape_lhs    Shape of the operand.
+                \param incr_lhs     Strides of the operand.
+                \param idx_lhs      Indices of the operand represented by signed integers.
+                \param idx_at       Indices specifying the sub-tensor to be computed, pass {} for the full result.
+            */
+            ContractionPlan(
+                const std::vector<size_t>   &shape_lhs,
+                const std::vector<size_t>   &incr_lhs,
+                const std::vector<int>      &idx_lhs,
+                const std::vector<size_t>   &idx_at);
+
+            //! Shape of the result.
+            const std::vector<size_t>& shape() const;
+
+            //! Number of components of the result.
+            size_t size() const;
+
+            //! True for plans of two operands, false for contractions of a single operand.
+            bool binary() const;
+
+            /*!
+                Computes the generalized tensor product of \p lhs and \p rhs and stores it in \p result.
+                Throws \ref ErrorHandler::ShapeMismatch if the shapes of the operands differ from the planned shapes.
+                \p result is only reallocated if its shape differs from \ref shape().
+            */
+            template<class T, class T2>
+            void execute(const TensorBase<T> &lhs, const TensorBase<T2> &rhs, TensorBase<T> &result) const;
+
+            /*!
+                Computes the contraction of \p lhs and stores it in \p result.
+                Throws \ref ErrorHandler::ShapeMismatch if the shape of the operand differs from the planned shape.
+                \p result is only reallocated if its shape differs from \ref shape().
+            */
+            template<class T>
+            void execute(const TensorBase<T> &lhs, TensorBase<T> &result) const;
+
+            //! Same as \ref execute(const TensorBase<T>&, const TensorBase<T2>&, TensorBase<T>&) const for views. Strides must match the planned strides.
+            template<class T, class T2>
+            void execute(const TensorView<T> &lhs, const TensorView<T2> &rhs, TensorBase<T> &result) const;
+
+            //! Same as \ref execute(const TensorBase<T>&, TensorBase<T>&) const for views. Strides must match the planned strides.
+            template<class T>
+            void execute(const TensorView<T> &lhs, TensorBase<T> &result) const;
+
+            /*!
+                Same as \ref execute(const TensorBase<T>&, const TensorBase<T2>&, TensorBase<T>&) const on raw memory
+                with the planned strides. \p result must provide \ref size() components. No error-handling!
+            */
+            template<class T, class T2>
+            void execute(const T* lhs, const T2* rhs, T* result) const;
+
+            /*!
+                Same as \ref execute(const TensorBase<T>&, TensorBase<T>&) const on raw memory
+                with the planned strides. \p result must provide \ref size() components. No error-handling!
+            */
+            template<class T>
+            void execute(const T* lhs, T* result) const;
+
+            /*!
+                Same as \ref execute(const T*, const T2*, T*) const, but stores alpha times the product plus beta times the
+                previous components of \p result, i.e. scaling and accumulation are fused into the write of the result.
+                \p result is not read if beta is zero. No error-handling!
+                \code
+                #include "TensorUtils.hpp"
+
+                int main()
+                {
+                    using namespace TensorUtils;
+
+                    tensor<double> X({64,32}, 1.0), Y({32,48}, 2.0), Z({64,48}, 1.0);
+
+                    ContractionPlan plan(X.shape, {1,-1}, Y.shape, {-1,2});
+                    plan.execute(X.data(), Y.data(), Z.data(), 0.5, 1.0);   // Z += 0.5*X.dot(Y,{1,-1},{-1,2})
+
+                    return 0;
+                }
+                \endcode
+            */
+            template<class T, class T2>
+            void execute(const T* lhs, const T2* rhs, T* result, const T &alpha, const T &beta) const;
+
+            //! Same as \ref execute(const T*, T*) const with the epilogue of \ref execute(const T*, const T2*, T*, const T&, const T&) const.
+            template<class T>
+            void execute(const T* lhs, T* result, const T &alpha, const T &beta) const;
+
+            /*!
+                Computes the sub-tensors at all prefixes \p idx_at[n], n=0,1,..., in a single call and stores them one
+                after each other in \p result, which must provide idx_at.size()*\ref size() components. The plan must be
+                constructed with an idx_at of the same length, e.g. zeros. All prefixes are validated once up front,
+                large batches are partitioned across threads.
+                \code
+                #include "TensorUtils.hpp"
+
+                int main()
+                {
+                    using namespace TensorUtils;
+
+                    tensor<double> X({100,3,3}, 1.0);
+                    tensor<double> Y({3,3}, 2.0);
+                    tensor<double> Z({2,3,3});
+
+                    ContractionPlan plan(X.shape, {0,1,-1}, Y.shape, {-1,2}, {0}); // Z({n}) = X({n}).dot(Y,{1,-1},{-1,2})
+                    plan.execute(X.data(), Y.data(), Z.data(), {{7},{42}});          // matrices 7 and 42
+
+                    return 0;
+                }
+                \endcode
+            */
+            template<class T, class T2>
+            void execute(const T* lhs, const T2* rhs, T* result, const std::vector<std::vector<size_t>> &idx_at) const;
+
+            //! Same as \ref execute(const T*, const T2*, T*, const std::vector<std::vector<size_t>>&) const for a contraction of a single operand.
+            template<class T>
+            void execute(const T* lhs, T* result, const std::vector<std::vector<size_t>> &idx_at) const;
+
+            //! \private
+            struct Schedule;
+
+        private:
+            std::shared_ptr<const Schedule> schedule;
+    };
+    /*! @} */
+}
+
+#endif // CONTRACTIONPLAN_HPP
@@ -0,0 +1,152 @@
+/**
+\internal
+    TensorUtils Version 0.1
+
+    Copyright 2022 Christoph Widder
+
+    This file is part of TensorUtils.
+
+    TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+    the GNU General Public License as published by the Free Software Foundation, either
+    version 3 of the License, or (at your option) any later version.
+
+    TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+    without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+    PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along with TensorUtils.
+    If not, see <https://www.gnu.org/licenses/>.
+\endinternal
+**/
+
+#ifndef DEVICE_HPP
+#define DEVICE_HPP
+
+#include "Memory.hpp"
+
+#include <cstddef>
+
+namespace TensorUtils
+{
+    //! Runtime of the GPU backend, see \ref DeviceTensor.
+    /*!
+        If the library is built with ENABLE_CUDA=1, i.e. `make CUDA=1` after `make clean`, device memory, streams and
+        transfers use the CUDA runtime and the kernels of \ref DeviceTensor use cuBLAS and cuTENSOR. Otherwise the
+        backend runs on the host: \ref count returns 0, device memory is ordinary host memory, all operations are
+        executed immediately by the host kernels and \ref DeviceTensor keeps the same semantics. Code written for the
+        backend therefore compiles and runs with and without a GPU.
+
+        All device operations of a thread are queued on its current \ref Stream, which is selected like the resource
+        of \ref Memory: a \ref Scope changes it for the current thread until the scope ends, otherwise the per-thread
+        default stream is used. Operations on different streams may overlap, e.g. the upload of the next operand
+        with the contraction of the current one. \ref Stream::wait orders the work of two streams.
+
+        Transfers between the host and the device are asynchronous only if the host tensor is allocated from
+        \ref pinned memory. The host must not access its tensor before the stream of the transfer is synchronized.
+        \code
+        #include "TensorUtils.hpp"
+
+        int main()
+        {
+            using namespace TensorUtils;
+
+            Memory::Scope pinned_scope(Device::pinned());   // page-locked host tensors: transfers are asynchronous
+            tensor<float> X({512,512}, 1.0f), Y({512,512}, 2.0f), Z;
+
+            Device::Stream copy, compute;
+            DeviceTensor<float> dX, dY, dZ;
+            {
+                Device::Scope scope(copy);
+                dX.upload(X);
+                dY.upload(Y);
+            }
+            {
+                Device::Scope scope(compute);
+                compute.wait(copy);                         // contraction starts after both uploads
+                dZ = dX.dot(dY, {1,-1}, {-1,2});
+                dZ.download(Z);
+            }
+            compute.synchronize();                          // Z is valid now
+
+            return 0;
+        }
+        \endcode
+    */
+    namespace Device
+    {
+        //! True if the library was built with a GPU backend (ENABLE_CUDA=1).
+        bool enabled();
+
+        //! Number of visible devices, 0 without a GPU backend.
+        int count();
+
+        //! Selects the device of the calling thread. Throws std::runtime_error if \p device is invalid.
+        void select(int device);
+
+        //! Device of the calling thread.
+        int current_device();
+
+        //! Waits until all work on the device of the calling thread has finished.
+        void synchronize();
+
+        //! Resource of page-locked host memory, see \ref Memory. Uses \ref Memory::aligned without a GPU backend.
+        Memory::Resource* pinned();
+
+        //! Ordered queue of device operations.
+        class Stream
+        {
+            public:
+                //! New stream on the device of the calling thread.
+                Stream();
+
+                //! Waits for all queued work and destroys the stream.
+                ~Stream();
+
+                Stream(const Stream&) = delete;
+                Stream& operator=(const Stream&) = delete;
+
+                //! Blocks until all work queued on this stream has finished.
+                void synchronize();
+
+                //! True if all work queued on this stream has finished.
+                bool ready() const;
+
+                //! Work queued on this stream afterwards starts only after all work queued on \p other so far.
+                void wait(const Stream &other);
+
+                //! \private Native handle, e.g. cudaStream_t.
+                void* native() const;
+
+                //! Per-thread default stream.
+                static Stream& per_thread();
+
+            private:
+                explicit Stream(void* handle);
+
+                void* handle;
+                bool owned;
+        };
+
+        //! Stream of the calling thread: the innermost \ref Scope or \ref Stream::per_thread.
+        Stream& current();
+
+        //! Selects a stream for the device operations of the current thread during its lifetime. Scopes can be nested.
+        class Scope
+        {
+            public:
+                //! Selects \p stream for the current thread.
+                explicit Scope(Stream &stream);
+
+                //! Restores the previous stream of the current thread.
+                ~Scope();
+
+                Scope(const Scope&) = delete;
+                Scope& operator=(const Scope&) = delete;
+
+            private:
+                Stream* previous;
+        };
+    }
+}
+
+#endif // DEVICE_HPP
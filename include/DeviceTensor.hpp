@@ -0,0 +1,210 @@
+/**
+\internal
+    TensorUtils Version 0.1
+
+    Copyright 2022 Christoph Widder
+
+    This file is part of TensorUtils.
+
+    TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+    the GNU General Public License as published by the Free Software Foundation, either
+    version 3 of the License, or (at your option) any later version.
+
+    TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+    without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+    PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along with TensorUtils.
+    If not, see <https://www.gnu.org/licenses/>.
+\endinternal
+**/
+
+#ifndef DEVICETENSOR_HPP
+#define DEVICETENSOR_HPP
+
+#include "Device.hpp"
+#include "TensorBase.hpp"
+
+#include <initializer_list>
+#include <type_traits>
+#include <vector>
+
+namespace TensorUtils
+{
+    /*!
+        \addtogroup TensorUtils
+        @{
+    */
+
+    //! Tensor whose components reside in device memory, see \ref Device.
+    /*!
+        T must be float or double. The components are laid out like those of \ref TensorBase, i.e. row-major with
+        the strides \ref incr. All operations are queued on the current \ref Device::Stream of the calling thread and
+        return before they have finished, the host only waits in \ref host and \ref Device::Stream::synchronize.
+
+        \ref dot and \ref contract take the same index labels as \ref TensorBase::dot and \ref TensorBase::contract
+        and are validated by a \ref ContractionPlan. With ENABLE_CUDA=1, products run as one cuTENSOR contraction and
+        contractions as one cuTENSOR reduction or permutation. Labels that occur twice in the same operand, i.e. diagonals and traces,
+        are evaluated on the host through pinned buffers. The element-wise operations use cuBLAS: \ref axpby,
+        \ref operator+ and \ref operator- are a single pass over the operands without temporaries.
+
+        Device tensors are copied and moved like tensors. They must not be destroyed while another stream
+        still uses them.
+        \code
+        #include "TensorUtils.hpp"
+
+        int main()
+        {
+            using namespace TensorUtils;
+
+            tensor<double> X({2,3,7,7}, 1.0), Y({7,5,3,11}, 2.0), Z;
+
+            DeviceTensor<double> dX(X), dY(Y);                          // explicit uploads
+            DeviceTensor<double> dZ = dX.dot(dY, {3,2,-5,-5}, {-5,4,2,1}); // same labels as X.dot(Y,...)
+            dZ *= 0.5;
+            dZ = dZ + dZ.contract({1,2,3,4});                           // single pass, no temporaries
+
+            Z = dZ.host();                                              // waits and downloads
+
+            return 0;
+        }
+        \endcode
+    */
+    template<class T>
+    class DeviceTensor
+    {
+        static_assert(std::is_same<T,float>::value || std::is_same<T,double>::value, "DeviceTensor<T> requires T=float or T=double!");
+
+        public:
+            //! Empty tensor.
+            DeviceTensor();
+
+            //! Allocates a tensor of the given shape with all components initialized to zero.
+            explicit DeviceTensor(const std::vector<size_t> &shape);
+
+            //! Same as \ref DeviceTensor(const std::vector<size_t>&), resolves the ambiguity of braced shapes, e.g. DeviceTensor<float>({2,3}).
+            explicit DeviceTensor(std::initializer_list<size_t> shape);
+
+            //! Allocates a tensor of the shape of \p host and uploads its components, see \ref upload.
+            explicit DeviceTensor(const TensorBase<T> &host);
+
+            //! Device-to-device copy on the current stream.
+            DeviceTensor(const DeviceTensor<T> &other);
+
+            //! Takes over the storage. \p other is left as an empty tensor.
+            DeviceTensor(DeviceTensor<T> &&other) noexcept;
+
+            //! Device-to-device copy on the current stream. Reallocates only if the sizes differ.
+            DeviceTensor<T>& operator=(const DeviceTensor<T> &other);
+
+            //! Takes over the storage. \p other is left as an empty tensor.
+            DeviceTensor<T>& operator=(DeviceTensor<T> &&other) noexcept;
+
+            //! Frees the device memory in stream order.
+            ~DeviceTensor();
+
+            //! Sets the shape and allocates uninitialized components. Reallocates only if the size changes.
+            void alloc(const std::vector<size_t> &shape);
+
+            //! Frees the device memory and leaves an empty tensor.
+            void clear();
+
+            //! Sets all components to zero.
+            void zero();
+
+            //! Pointer to the first component in device memory.
+            T* data();
+
+            //! Pointer to the first component in device memory.
+            const T* data() const;
+
+            //! Number of components.
+            size_t size() const;
+
+            //! Number of indices.
+            size_t rank() const;
+
+            /*!
+                Copies the components of \p host to the device and adopts its shape.
+                Asynchronous if \p host is allocated from \ref Device::pinned, otherwise it returns once \p host
+                may be modified again.
+            */
+            void upload(const TensorBase<T> &host);
+
+            /*!
+                Copies the components to \p host, which is reallocated if its shape differs.
+                Asynchronous if \p host is allocated from \ref Device::pinned: \p host must not be accessed
+                before the current stream is synchronized.
+            */
+            void download(TensorBase<T> &host) const;
+
+            //! Waits for the current stream and returns the components as a host tensor.
+            TensorBase<T> host() const;
+
+            /*!
+                Generalized tensor product with the index labels of \ref TensorBase::dot.
+                Throws \ref ErrorHandler::ShapeMismatch if the labels do not match the shapes.
+            */
+            DeviceTensor<T> dot(const DeviceTensor<T> &rhs, const std::vector<int> &idx_lhs, const std::vector<int> &idx_rhs) const;
+
+            /*!
+                Contraction with the index labels of \ref TensorBase::contract.
+                Throws \ref ErrorHandler::ShapeMismatch if the labels do not match the shape.
+            */
+            DeviceTensor<T> contract(const std::vector<int> &idx) const;
+
+            //! Sets this tensor to alpha*x + beta*(*this) in a single pass. Throws \ref ErrorHandler::ShapeMismatch if the shapes differ.
+            DeviceTensor<T>& axpby(const T &alpha, const DeviceTensor<T> &x, const T &beta);
+
+            //! Adds \p rhs to this tensor. Throws \ref ErrorHandler::ShapeMismatch if the shapes differ.
+            DeviceTensor<T>& operator+=(const DeviceTensor<T> &rhs);
+
+            //! Substracts \p rhs from this tensor. Throws \ref ErrorHandler::ShapeMismatch if the shapes differ.
+            DeviceTensor<T>& operator-=(const DeviceTensor<T> &rhs);
+
+            //! Multiplies all components with \p val.
+            DeviceTensor<T>& operator*=(const T &val);
+
+            //! Divides all components by \p val.
+            DeviceTensor<T>& operator/=(const T &val);
+
+            //! Shape of the tensor (read-only by convention, use \ref alloc to change it).
+            std::vector<size_t> shape;
+
+            //! Strides of the tensor, see \ref TensorBase::incr.
+            std::vector<size_t> incr;
+
+        private:
+            // result = alpha*a + beta*b in a single pass
+            static void combine(const T &alpha, const DeviceTensor<T> &a, const T &beta, const DeviceTensor<T> &b, DeviceTensor<T> &result);
+
+            void release();
+
+            T*      ptr;
+            size_t  count;
+
+            template<class U>
+            friend DeviceTensor<U> operator+(const DeviceTensor<U> &lhs, const DeviceTensor<U> &rhs);
+            template<class U>
+            friend DeviceTensor<U> operator-(const DeviceTensor<U> &lhs, const DeviceTensor<U> &rhs);
+    };
+
+    //! Element-wise sum in a single pass. Throws \ref ErrorHandler::ShapeMismatch if the shapes differ.
+    template<class T>
+    DeviceTensor<T> operator+(const DeviceTensor<T> &lhs, const DeviceTensor<T> &rhs);
+
+    //! Element-wise difference in a single pass. Throws \ref ErrorHandler::ShapeMismatch if the shapes differ.
+    template<class T>
+    DeviceTensor<T> operator-(const DeviceTensor<T> &lhs, const DeviceTensor<T> &rhs);
+
+    //! Product of all components with \p val.
+    template<class T>
+    DeviceTensor<T> operator*(const DeviceTensor<T> &lhs, const T &val);
+
+    //! Product of all components with \p val.
+    template<class T>
+    DeviceTensor<T> operator*(const T &val, const DeviceTensor<T> &rhs);
+    /*! @} */
+}
+
+#endif // DEVICETENSOR_HPP
@@ -0,0 +1,117 @@
+/**
+\internal
+    TensorUtils Version 0.1
+
+    Copyright 2022 Christoph Widder
+
+    This file is part of TensorUtils.
+
+    TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+    the GNU General Public License as published by the Free Software Foundation, either
+    version 3 of the License, or (at your option) any later version.
+
+    TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+    without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+    PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along with TensorUtils.
+    If not, see <https://www.gnu.org/licenses/>.
+\endinternal
+**/
+
+
+#ifndef DISTRIBUTED_HPP
+#define DISTRIBUTED_HPP
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace TensorUtils
+{
+    //! Runtime of the distributed backend, see \ref DistributedTensor.
+    /*!
+        If the library is built with ENABLE_MPI=1, i.e. `make MPI=1` after `make clean`, all ranks of MPI_COMM_WORLD
+        share every \ref DistributedTensor, and its collective operations must be called by all ranks in the same order.
+        Otherwise the backend consists of a single rank: \ref size returns 1, every distributed tensor is held
+        completely by its only rank and code written for the backend compiles and runs without MPI.
+
+        MPI is initialized by an \ref Environment, or by the first call of any collective operation. In the latter
+        case MPI is finalized at exit. Applications that initialize MPI themselves must request at least
+        MPI_THREAD_FUNNELED, since the local kernels run on the thread pool of \ref Parallel.
+
+        Tensors are distributed in blocks: the grid assigns a number of parts to every index, each index is
+        split into parts of equal size up to one, and rank r holds the block at the r-th grid coordinate in
+        lexicographical order. If the grid has fewer blocks than there are ranks, rank r holds a copy of the block
+        r modulo the number of blocks, e.g. every rank holds a copy of a scalar.
+        \code
+        #include "TensorUtils.hpp"
+
+        int main(int argc, char** argv)
+        {
+            using namespace TensorUtils;
+
+            Distributed::Environment mpi(argc, argv);       // initializes and finalizes MPI
+
+            std::vector<size_t> grid = Distributed::grid({4096,4096}, {0,1});  // e.g. {2,2} on 4 ranks
+
+            DistributedTensor<double> A({4096,4096}, grid, 1.0);
+            DistributedTensor<double> B = A.dot(A, {1,-1}, {-1,2});
+
+            if(Distributed::rank() == 0)
+            {
+                // B.local() is the block of rank 0
+            }
+
+            return 0;
+        }
+        \endcode
+    */
+    namespace Distributed
+    {
+        //! True if the library was built with MPI (ENABLE_MPI=1).
+        bool enabled();
+
+        //! Rank of the calling process, 0 without MPI.
+        int rank();
+
+        //! Number of ranks, 1 without MPI.
+        int size();
+
+        //! Blocks until all ranks have called it.
+        void barrier();
+
+        /*!
+            Balanced grid for \p ranks ranks that distributes the indices \p axes of a tensor of the given shape,
+            all indices if \p axes is empty. The prime factors of \p ranks are assigned one after each other to the
+            index with the largest blocks, such that the blocks are as close to cubes as possible.
+            Throws \ref ErrorHandler::ShapeMismatch if an axis is out of range.
+        */
+        std::vector<size_t> grid(const std::vector<size_t> &shape, const std::vector<size_t> &axes={}, int ranks=size());
+
+        //! Range [first,last) of the indices of block \p part of an index of size \p n that is split into \p parts blocks.
+        std::pair<size_t,size_t> block(size_t n, size_t parts, size_t part);
+
+        //! Initializes MPI during its lifetime, if it is not initialized yet.
+        class Environment
+        {
+            public:
+                //! Initializes MPI with the arguments of main, if it is not initialized yet.
+                Environment(int &argc, char** &argv);
+
+                //! Same as \ref Environment(int&,char**&) without arguments.
+                Environment();
+
+                //! Finalizes MPI if it was initialized by this environment.
+                ~Environment();
+
+                Environment(const Environment&) = delete;
+                Environment& operator=(const Environment&) = delete;
+
+            private:
+                bool owned;
+        };
+    }
+}
+
+#endif // DISTRIBUTED_HPP
@@ -0,0 +1,169 @@
+/**
+\internal
+    TensorUtils Version 0.1
+
+    Copyright 2022 Christoph Widder
+
+    This file is part of TensorUtils.
+
+    TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+    the GNU General Public License as published by the Free Software Foundation, either
+    version 3 of the License, or (at your option) any later version.
+
+    TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+    without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+    PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along with TensorUtils.
+    If not, see <https://www.gnu.org/licenses/>.
+\endinternal
+**/
+
+
+#ifndef DISTRIBUTEDTENSOR_HPP
+#define DISTRIBUTEDTENSOR_HPP
+
+#include "Distributed.hpp"
+#include "TensorBase.hpp"
+
+#include <string>
+#include <vector>
+
+namespace TensorUtils
+{
+    /*!
+        \addtogroup TensorUtils
+        @{
+    */
+
+    //! Tensor that is partitioned into blocks across the ranks of \ref Distributed.
+    /*!
+        Every rank holds one block of the global tensor as an ordinary tensor, see \ref local, whose first component is
+        at the global indices \ref offset. The blocks are given by the grid, which assigns a number of parts to every
+        index, see \ref Distributed. All member functions except \ref local, \ref owner, \ref size and \ref rank are
+        collective: they must be called by all ranks with the same arguments.
+
+        \ref dot and \ref contract take the same index labels as \ref TensorBase::dot and \ref TensorBase::contract and
+        are validated by a \ref ContractionPlan on every rank. Products with a summation index of both operands and an
+        index of the result that only occurs in one operand use SUMMA on a two-dimensional grid of ranks: the operands
+        are redistributed once, then every step broadcasts one panel of each operand along the rows and the columns
+        of the grid, while the local product of the previous panels is computed. Every rank thereby receives
+        only |lhs|/rows + |rhs|/columns components, and the shape of the grid is chosen to minimize that volume.
+        All other products and contractions are partitioned along a single index label: the operands are
+        redistributed such that every rank holds the components of its range of the label, and the partial results
+        of a summation index are reduced across the ranks. The result is distributed as chosen by the algorithm,
+        \ref redistribute changes the grid.
+
+        \ref read and \ref write access the container format ".tu" and the extension based binary files of
+        \ref TensorBase::read with MPI-IO: every rank reads or writes only the components of its block.
+        Containers written in parallel have no checksum table, which \ref TensorBase::read accepts. All other formats,
+        e.g. compressed or sparse containers and text files, are read or written by rank 0 and scattered or gathered.
+        \code
+        #include "TensorUtils.hpp"
+
+        int main(int argc, char** argv)
+        {
+            using namespace TensorUtils;
+
+            Distributed::Environment mpi(argc, argv);
+
+            tensor<double> X({256,128}, 1.0);
+            DistributedTensor<double> A = DistributedTensor<double>::scatter(X, Distributed::grid(X.shape));
+            DistributedTensor<double> B({128,64}, Distributed::grid({128,64}), 2.0);
+
+            DistributedTensor<double> C = A.dot(B, {1,-1}, {-1,2});    // SUMMA, C has shape {256,64}
+            DistributedTensor<double> t = C.contract({-1,-2});         // sum of all components, on every rank
+
+            C.write("C.tu", ".");                                       // collective, every rank writes its block
+            C.read("C.tu", {0});                                        // every rank reads rows of C
+            TensorBase<double> Y = C.gather();                          // global tensor on rank 0
+
+            return 0;
+        }
+        \endcode
+    */
+    template<class T>
+    class DistributedTensor
+    {
+        public:
+            //! Scalar zero held by every rank.
+            DistributedTensor();
+
+            /*!
+                Tensor of the given shape distributed by \p grid with all components initialized to zero.
+                Throws \ref ErrorHandler::RankMismatch if the grid has another rank than the shape and
+                std::invalid_argument if it has a zero or more blocks than there are ranks.
+            */
+            DistributedTensor(const std::vector<size_t> &shape, const std::vector<size_t> &grid);
+
+            //! Same as \ref DistributedTensor(const std::vector<size_t>&, const std::vector<size_t>&) with all components initialized to \p val.
+            DistributedTensor(const std::vector<size_t> &shape, const std::vector<size_t> &grid, const T &val);
+
+            //! Distributes \p global of rank \p root by \p grid. Only the argument of rank \p root is read.
+            static DistributedTensor<T> scatter(const TensorBase<T> &global, const std::vector<size_t> &grid, int root=0);
+
+            //! Collects the global tensor on rank \p root, all other ranks return an empty tensor.
+            TensorBase<T> gather(int root=0) const;
+
+            //! Same tensor distributed by \p grid, see \ref DistributedTensor(const std::vector<size_t>&, const std::vector<size_t>&).
+            DistributedTensor<T> redistribute(const std::vector<size_t> &grid) const;
+
+            //! Number of components of the global tensor.
+            size_t size() const;
+
+            //! Number of indices.
+            size_t rank() const;
+
+            //! Block of the calling rank. Its shape must not be changed.
+            TensorBase<T>& local();
+
+            //! Block of the calling rank.
+            const TensorBase<T>& local() const;
+
+            //! Lowest rank that holds the component at the global indices \p idx.
+            int owner(const std::vector<size_t> &idx) const;
+
+            /*!
+                Distributed generalized tensor product with the index labels of \ref TensorBase::dot, see \ref DistributedTensor.
+                Throws \ref ErrorHandler::ShapeMismatch if the labels do not match the shapes.
+            */
+            DistributedTensor<T> dot(const DistributedTensor<T> &rhs, const std::vector<int> &idx_lhs, const std::vector<int> &idx_rhs) const;
+
+            /*!
+                Distributed contraction with the index labels of \ref TensorBase::contract, see \ref DistributedTensor.
+                Throws \ref ErrorHandler::ShapeMismatch if the labels do not match the shape.
+            */
+            DistributedTensor<T> contract(const std::vector<int> &idx) const;
+
+            /*!
+                Reads a tensor in any file format of \ref TensorBase::read and distributes the indices \p axes,
+                all indices if empty, see \ref Distributed::grid. Every rank reads only its block of the binary formats.
+                Throws the exceptions of \ref TensorBase::read on all ranks.
+            */
+            void read(const std::string &path, const std::vector<size_t> &axes={});
+
+            /*!
+                Writes the global tensor in any file format of \ref TensorBase::write. Every rank writes only its block
+                of a container ".tu" or of the extension based binary file with the component type T.
+                Throws \ref ErrorHandler::UnableToOpenFile on all ranks if the file cannot be created.
+            */
+            void write(const std::string &oname, const std::string &folder);
+
+            //! Shape of the global tensor (read-only).
+            std::vector<size_t> shape;
+
+            //! Number of parts of every index (read-only), see \ref Distributed.
+            std::vector<size_t> grid;
+
+            //! Global indices of the first component of the local block (read-only).
+            std::vector<size_t> offset;
+
+        private:
+            void init(const std::vector<size_t> &shape, const std::vector<size_t> &grid);
+
+            TensorBase<T> block;
+    };
+    /*! @} */
+}
+
+#endif // DISTRIBUTEDTENSOR_HPP
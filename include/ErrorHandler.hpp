@@ -37,8 +37,8 @@ namespace TensorUtils
         \brief This namespace contains error handler classes that inherit from "std::runtime_error".
         Most error handling is enabled only for the debug library "libtensor_utilsd.so".
 
-        TensorUtils provides error handling to trace down rank or shape mismatches, invalid indices
-        and invalid file paths.
+        TensorUtils provides error handling to trace down rank or shape mismatches, invalid indices,
+        invalid file paths and corrupted files.
     */
     namespace ErrorHandler
     {
@@ -80,6 +80,24 @@ namespace TensorUtils
             //! Constructor inherited from std::runtime_error.
             explicit RankMismatch (const std::string& what_arg) : std::runtime_error(what_arg) {};
         };
+
+        //! This error is thrown if a file is not in the expected format or fails its integrity check. Inherits from std::runtime_error.
+        /*!
+            See \ref ErrorHandler for details.
+        */
+        class CorruptedFile : public std::runtime_error
+        {
+            public:
+            //! Constructor inherited from std::runtime_error.
+            explicit CorruptedFile (const std::string& what_arg) : std::runtime_error(what_arg) {};
+        };
+
+        //! True if the linked library checks the indices of the inline element access, i.e. for the debug library "libtensor_utilsd.so".
+        /*!
+            The inline overloads of \ref TensorBase::operator() and \ref TensorView::operator() read this flag, such that
+            their checks are selected by the library that is linked and not by the macros of the application.
+        */
+        extern const bool index_checks;
         /*! @} */
     }
     /*! @} */
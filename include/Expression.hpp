@@ -0,0 +1,308 @@
+/**
+\internal
+    TensorUtils Version 0.1
+
+    Copyright 2022 Christoph Widder
+
+    This file is part of TensorUtils.
+
+    TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+    the GNU General Public License as published by the Free Software Foundation, either
+    version 3 of the License, or (at your option) any later version.
+
+    TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+    without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+    PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along with TensorUtils.
+    If not, see <https://www.gnu.org/licenses/>.
+\endinternal
+**/
+
+#ifndef EXPRESSION_HPP
+#define EXPRESSION_HPP
+
+#include "TensorBase.hpp"
+#include "TensorDerived.hpp"
+#include "Parallel.hpp"
+
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+namespace TensorUtils
+{
+    template<class T, size_t CAPACITY, unsigned MAX_RANK> class SmallTensor;
+
+    /*!
+        \addtogroup TensorUtils
+        @{
+    */
+
+    namespace Expressions
+    {
+        //! \private Throws ErrorHandler::ShapeMismatch if the sizes differ, also for the release library.
+        void check_size(size_t lhs, size_t rhs, const char* op);
+
+        //! \private Throws ErrorHandler::RankMismatch if the ranks differ.
+        void check_rank(size_t rank, size_t N, const char* op);
+
+        //! \private Component operations, the result is converted to the component type of the left operand like for the compound assignments.
+        struct Add          { template<class V, class A, class B> static V apply(const A &a, const B &b) { return static_cast<V>(a + b); } };
+        //! \private
+        struct Substract    { template<class V, class A, class B> static V apply(const A &a, const B &b) { return static_cast<V>(a - b); } };
+        //! \private
+        struct Multiply     { template<class V, class A, class B> static V apply(const A &a, const B &b) { return static_cast<V>(a * b); } };
+        //! \private
+        struct Divide       { template<class V, class A, class B> static V apply(const A &a, const B &b) { return static_cast<V>(a / b); } };
+
+        //! \private True for tensors derived from TensorBase.
+        template<class X, class = void>
+        struct is_tensor : std::false_type {};
+
+        //! \private
+        template<class X>
+        struct is_tensor<X, std::void_t<typename X::value_type>> : std::is_base_of<TensorBase<typename X::value_type>, X> {};
+
+        //! \private True for tensors with inline storage, see \ref SmallTensor.
+        template<class X>
+        struct is_small_tensor : std::false_type {};
+
+        //! \private
+        template<class T, size_t CAPACITY, unsigned MAX_RANK>
+        struct is_small_tensor<SmallTensor<T,CAPACITY,MAX_RANK>> : std::true_type {};
+
+        //! \private True for tensors and expressions.
+        template<class X>
+        struct is_operand : std::integral_constant<bool, is_tensor<X>::value || is_small_tensor<X>::value || std::is_base_of<ExpressionBase, X>::value> {};
+    }
+
+    //! \private Leaf of an expression: the contiguous components of a tensor, referenced without copy. S is the type of its shape.
+    template<class T, class S = std::vector<size_t>>
+    class ExpressionLeaf : public ExpressionBase
+    {
+        public:
+            typedef T value_type;
+
+            template<class X>
+            ExpressionLeaf(const X &tensor) : ptr(tensor.data()), n(tensor.size()), tensor_shape(&tensor.shape) {}
+
+            T operator[](size_t i) const { return ptr[i]; }
+            size_t size() const { return n; }
+            const S& shape() const { return *tensor_shape; }
+
+        private:
+            const T* ptr;
+            size_t n;
+            const S* tensor_shape;
+    };
+
+    namespace Expressions
+    {
+        //! \private Operands are stored by value: tensors as leaves, expressions as they are.
+        template<class X, bool TENSOR = is_tensor<X>::value, bool SMALL = is_small_tensor<X>::value>
+        struct operand { typedef X type; };
+
+        //! \private
+        template<class X>
+        struct operand<X, true, false> { typedef ExpressionLeaf<typename X::value_type> type; };
+
+        //! \private
+        template<class X>
+        struct operand<X, false, true> { typedef ExpressionLeaf<typename X::value_type, typename X::shape_type> type; };
+    }
+
+    //! Lazy component-wise operation of two operands. Has the shape and the component type of the left operand.
+    template<class L, class R, class OP>
+    class BinaryExpression : public ExpressionBase
+    {
+        public:
+            typedef typename L::value_type value_type;
+
+            BinaryExpression(const L &lhs, const R &rhs, const char* name) : lhs(lhs), rhs(rhs)
+            {
+                Expressions::check_size(lhs.size(), rhs.size(), name);
+            }
+
+            value_type operator[](size_t i) const { return OP::template apply<value_type>(lhs[i], rhs[i]); }
+            size_t size() const { return lhs.size(); }
+            decltype(auto) shape() const { return lhs.shape(); }
+
+            //! Evaluates the expression into a new tensor.
+            TensorBase<value_type> eval() const { return TensorBase<value_type>(*this); }
+
+        private:
+            L lhs;
+            R rhs;
+    };
+
+    //! Lazy component-wise operation of an operand and a scalar. The scalar has the component type of the operand.
+    template<class L, class OP>
+    class ScalarExpression : public ExpressionBase
+    {
+        public:
+            typedef typename L::value_type value_type;
+
+            ScalarExpression(const L &lhs, const value_type &rhs) : lhs(lhs), rhs(rhs) {}
+
+            value_type operator[](size_t i) const { return OP::template apply<value_type>(lhs[i], rhs); }
+            size_t size() const { return lhs.size(); }
+            decltype(auto) shape() const { return lhs.shape(); }
+
+            //! Evaluates the expression into a new tensor.
+            TensorBase<value_type> eval() const { return TensorBase<value_type>(*this); }
+
+        private:
+            L lhs;
+            value_type rhs;
+    };
+
+    /*!
+        Lazy sum of two tensors or expressions.
+        Chains of +, -, * and / with tensors, expressions and scalars are evaluated in a single pass
+        without temporaries when they are assigned to a tensor:
+        \code
+        #include "TensorUtils.hpp"
+
+        int main()
+        {
+            using namespace TensorUtils;
+
+            tensor<double> A;
+            tensor<double> B({2,3,5,7}, 1.0);
+            tensor<float>  C({2,3,5,7}, 2.0);
+            tensor<double> D({2,3,5,7}, 3.0);
+
+            A = B + C - D*2.0;          // single fused loop, no temporary tensors
+            A += (B - D)/4.0;           // fused compound assignment
+
+            TensorBase<double> E = B*3.0 + D;   // evaluated on construction
+            (B + D).eval().print();             // explicit evaluation into a temporary tensor
+
+            return 0;
+        }
+        \endcode
+        Expressions reference their tensors and must be evaluated before the tensors are changed or destroyed,
+        i.e. they should not be stored in variables declared with auto.
+        The number of components of both operands must match, else \ref ErrorHandler::ShapeMismatch is thrown.
+        Unlike the compound assignments of two tensors, e.g. \ref TensorBase::operator+=, expressions do not broadcast,
+        i.e. A + b throws for A of shape {3,4} and b of shape {4}. Use A += b to broadcast b instead.
+    */
+    template<class L, class R, typename std::enable_if<Expressions::is_operand<L>::value && Expressions::is_operand<R>::value, int>::type = 0>
+    BinaryExpression<typename Expressions::operand<L>::type, typename Expressions::operand<R>::type, Expressions::Add>
+    operator+(const L &lhs, const R &rhs)
+    {
+        return {lhs, rhs, "operator+"};
+    }
+
+    //! Lazy difference of two tensors or expressions, see \ref operator+.
+    template<class L, class R, typename std::enable_if<Expressions::is_operand<L>::value && Expressions::is_operand<R>::value, int>::type = 0>
+    BinaryExpression<typename Expressions::operand<L>::type, typename Expressions::operand<R>::type, Expressions::Substract>
+    operator-(const L &lhs, const R &rhs)
+    {
+        return {lhs, rhs, "operator-"};
+    }
+
+    //! Lazy scalar multiplication from the right, see \ref operator+.
+    template<class L, typename std::enable_if<Expressions::is_operand<L>::value, int>::type = 0>
+    ScalarExpression<typename Expressions::operand<L>::type, Expressions::Multiply>
+    operator*(const L &lhs, const typename L::value_type &rhs)
+    {
+        return {lhs, rhs};
+    }
+
+    //! Lazy scalar multiplication from the left, see \ref operator+.
+    template<class R, typename std::enable_if<Expressions::is_operand<R>::value, int>::type = 0>
+    ScalarExpression<typename Expressions::operand<R>::type, Expressions::Multiply>
+    operator*(const typename R::value_type &lhs, const R &rhs)
+    {
+        return {rhs, lhs};
+    }
+
+    //! Lazy scalar division, see \ref operator+.
+    template<class L, typename std::enable_if<Expressions::is_operand<L>::value, int>::type = 0>
+    ScalarExpression<typename Expressions::operand<L>::type, Expressions::Divide>
+    operator/(const L &lhs, const typename L::value_type &rhs)
+    {
+        return {lhs, rhs};
+    }
+
+    /*! @} */
+
+    /**
+        EVALUATION
+    **/
+
+    //! \private Evaluates the expression component-wise into dst with OP, partitioned across threads.
+    template<class OP, class T, class E>
+    void evaluate(T* dst, const E &e)
+    {
+        Parallel::for_range(e.size(), [&](size_t begin, size_t end)
+        {
+            for(size_t i=begin; i<end; i++)
+            {
+                dst[i] = OP::template apply<T>(dst[i], e[i]);
+            }
+        });
+    }
+
+    //! \private
+    struct AssignOp { template<class V, class A, class B> static V apply(const A&, const B &b) { return static_cast<V>(b); } };
+
+    template<class T>
+    template<class E, typename std::enable_if<std::is_base_of<ExpressionBase, E>::value, int>::type>
+    TensorBase<T>::TensorBase(const E &rhs) : TensorBase<T>::vector_type()
+    {
+        alloc(rhs.shape());
+        evaluate<AssignOp>(TensorBase<T>::vector_type::data(), rhs);
+    }
+
+    template<class T>
+    template<class E, typename std::enable_if<std::is_base_of<ExpressionBase, E>::value, int>::type>
+    TensorBase<T>& TensorBase<T>::operator=(const E &rhs)
+    {
+        // this tensor may be an operand: it keeps its components then and every component is only read at its own index
+        if(shape != rhs.shape())
+        {
+            alloc(std::vector<size_t>(rhs.shape()));
+        }
+        evaluate<AssignOp>(TensorBase<T>::vector_type::data(), rhs);
+        return *this;
+    }
+
+    template<class T>
+    template<class E, typename std::enable_if<std::is_base_of<ExpressionBase, E>::value, int>::type>
+    TensorBase<T>& TensorBase<T>::operator+=(const E &rhs)
+    {
+        Expressions::check_size(TensorBase<T>::vector_type::size(), rhs.size(), "operator+=");
+        evaluate<Expressions::Add>(TensorBase<T>::vector_type::data(), rhs);
+        return *this;
+    }
+
+    template<class T>
+    template<class E, typename std::enable_if<std::is_base_of<ExpressionBase, E>::value, int>::type>
+    TensorBase<T>& TensorBase<T>::operator-=(const E &rhs)
+    {
+        Expressions::check_size(TensorBase<T>::vector_type::size(), rhs.size(), "operator-=");
+        evaluate<Expressions::Substract>(TensorBase<T>::vector_type::data(), rhs);
+        return *this;
+    }
+
+    template<class T, int N>
+    template<class E, typename std::enable_if<std::is_base_of<ExpressionBase, E>::value, int>::type>
+    TensorDerived<T,N>::TensorDerived(const E &rhs) : TensorBase<T>()
+    {
+        operator=(rhs);
+    }
+
+    template<class T, int N>
+    template<class E, typename std::enable_if<std::is_base_of<ExpressionBase, E>::value, int>::type>
+    TensorDerived<T,N>& TensorDerived<T,N>::operator=(const E &rhs)
+    {
+        Expressions::check_rank(rhs.shape().size(), N, "TensorDerived<T,N>::operator=");
+        TensorBase<T>::operator=(rhs);
+        return *this;
+    }
+}
+
+#endif // EXPRESSION_HPP
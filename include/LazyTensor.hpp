@@ -0,0 +1,230 @@
+/**
+\internal
+    TensorUtils Version 0.1
+
+    Copyright 2022 Christoph Widder
+
+    This file is part of TensorUtils.
+
+    TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+    the GNU General Public License as published by the Free Software Foundation, either
+    version 3 of the License, or (at your option) any later version.
+
+    TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+    without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+    PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along with TensorUtils.
+    If not, see <https://www.gnu.org/licenses/>.
+\endinternal
+**/
+
+#ifndef LAZYTENSOR_HPP
+#define LAZYTENSOR_HPP
+
+#include "TensorBase.hpp"
+#include "TensorDerived.hpp"
+#include "TensorView.hpp"
+
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace TensorUtils
+{
+    /*!
+        \addtogroup TensorUtils
+        @{
+    */
+
+    //! Lazily evaluated chain of transposes, products, contractions, scalings, sums and differences, see \ref lazy.
+    /*!
+        Every operation on a lazy tensor only validates the shapes and adds a node to a small computation graph.
+        The graph is optimized and computed when it is assigned to a tensor, passed to a constructor of a tensor
+        or evaluated explicitly by \ref eval:
+        - transposes of tensors and views become strides of the operands of \ref dot and \ref contract,
+          transposes of products and contractions relabel their indices, i.e. no transpose is ever copied
+        - scalar factors of all operands are folded into the epilogue of the contraction that writes the result
+        - sums and differences accumulate every term directly into the result, such that `C += alpha*A.dot(B)` or
+          `C = A.dot(B) - 2*C` are a single contraction without any temporary
+        Only terms that are used as an operand of another product, e.g. `(A + B).dot(C)`, are computed into a temporary.
+        If the result is an operand of its own expression, the expression is computed into a temporary first.
+
+        T must be a floating point type. Lazy tensors reference their tensors without copy: the tensors must not be changed or destroyed before the
+        expression is evaluated. The shapes are checked when the graph is built, \ref ErrorHandler::ShapeMismatch is
+        thrown with the same conditions as for \ref TensorBase::dot, \ref TensorBase::contract and \ref TensorBase::transpose.
+        \code
+        #include "TensorUtils.hpp"
+
+        int main()
+        {
+            using namespace TensorUtils;
+
+            tensor<double> A({64,32,16}, 1.0), B({32,48}, 2.0), C({16,64,48}, 3.0), D;
+
+            // A is read with permuted strides, alpha is applied when the result is written, C is accumulated: one pass
+            D = lazy(A).transpose({2,0,1}).dot(B, {1,2,-1}, {-1,3}) * 0.5 + C;
+
+            C += lazy(A).dot(B, {1,-1,2}, {-1,3}).transpose({1,0,2}) / 4.0;   // accumulated into C while it is computed
+
+            LazyTensor<double> expr = 2.0*lazy(C).contract({1,2,-1});            // nothing is computed yet
+            TensorBase<double> E = expr.eval();
+
+            return 0;
+        }
+        \endcode
+    */
+    template<class T>
+    class LazyTensor
+    {
+        static_assert(std::is_floating_point<T>::value, "LazyTensor<T> requires a floating point type T!");
+
+        public:
+            //! Leaf that references all components of \p tensor.
+            explicit LazyTensor(const TensorBase<T> &tensor);
+
+            //! Leaf that references the components of \p view.
+            explicit LazyTensor(const TensorView<T> &view);
+
+            //! Shape of the result.
+            const std::vector<size_t>& shape() const;
+
+            //! Number of components of the result.
+            size_t size() const;
+
+            //! Lazy transpose, see \ref TensorBase::transpose.
+            LazyTensor<T> transpose(const std::vector<unsigned> &axes) const;
+
+            //! Lazy generalized tensor product, see \ref TensorBase::dot.
+            LazyTensor<T> dot(const LazyTensor<T> &rhs, const std::vector<int> &idx_lhs, const std::vector<int> &idx_rhs) const;
+
+            //! Lazy generalized tensor product with a tensor, see \ref TensorBase::dot.
+            LazyTensor<T> dot(const TensorBase<T> &rhs, const std::vector<int> &idx_lhs, const std::vector<int> &idx_rhs) const;
+
+            //! Lazy contraction, see \ref TensorBase::contract.
+            LazyTensor<T> contract(const std::vector<int> &idx) const;
+
+            //! Computes the expression into a new tensor.
+            TensorBase<T> eval() const;
+
+            /*!
+                Computes alpha times the expression plus beta times \p result into \p result, which must have the shape
+                of the expression unless beta is zero. This is what the assignments of \ref TensorBase call.
+            */
+            void eval(TensorBase<T> &result, const T &alpha, const T &beta) const;
+
+            //! Lazy sum, see \ref LazyTensor.
+            friend LazyTensor<T> operator+(const LazyTensor<T> &lhs, const LazyTensor<T> &rhs) { return lhs.combine(rhs, T(1)); }
+            //! Lazy sum with a tensor.
+            friend LazyTensor<T> operator+(const LazyTensor<T> &lhs, const TensorBase<T> &rhs) { return lhs.combine(LazyTensor<T>(rhs), T(1)); }
+            //! Lazy sum with a tensor.
+            friend LazyTensor<T> operator+(const TensorBase<T> &lhs, const LazyTensor<T> &rhs) { return LazyTensor<T>(lhs).combine(rhs, T(1)); }
+
+            //! Lazy difference, see \ref LazyTensor.
+            friend LazyTensor<T> operator-(const LazyTensor<T> &lhs, const LazyTensor<T> &rhs) { return lhs.combine(rhs, T(-1)); }
+            //! Lazy difference with a tensor.
+            friend LazyTensor<T> operator-(const LazyTensor<T> &lhs, const TensorBase<T> &rhs) { return lhs.combine(LazyTensor<T>(rhs), T(-1)); }
+            //! Lazy difference with a tensor.
+            friend LazyTensor<T> operator-(const TensorBase<T> &lhs, const LazyTensor<T> &rhs) { return LazyTensor<T>(lhs).combine(rhs, T(-1)); }
+
+            //! Lazy negation.
+            friend LazyTensor<T> operator-(const LazyTensor<T> &rhs) { return rhs.scale(T(-1)); }
+
+            //! Lazy scalar multiplication, folded into the epilogue of the operation that writes the result.
+            friend LazyTensor<T> operator*(const LazyTensor<T> &lhs, const T &rhs) { return lhs.scale(rhs); }
+            //! Lazy scalar multiplication, folded into the epilogue of the operation that writes the result.
+            friend LazyTensor<T> operator*(const T &lhs, const LazyTensor<T> &rhs) { return rhs.scale(lhs); }
+
+            //! Lazy scalar division, folded into the epilogue of the operation that writes the result.
+            friend LazyTensor<T> operator/(const LazyTensor<T> &lhs, const T &rhs) { return lhs.scale(T(1)/rhs); }
+
+            //! \private
+            struct Node;
+
+        private:
+            explicit LazyTensor(std::shared_ptr<const Node> node);
+
+            LazyTensor<T> combine(const LazyTensor<T> &rhs, const T &factor) const;
+            LazyTensor<T> scale(const T &factor) const;
+
+            std::shared_ptr<const Node> node;
+    };
+
+    //! Starts a lazy expression on \p tensor, see \ref LazyTensor.
+    template<class T>
+    LazyTensor<T> lazy(const TensorBase<T> &tensor)
+    {
+        return LazyTensor<T>(tensor);
+    }
+
+    //! Starts a lazy expression on \p view, see \ref LazyTensor.
+    template<class T>
+    LazyTensor<T> lazy(const TensorView<T> &view)
+    {
+        return LazyTensor<T>(view);
+    }
+    /*! @} */
+
+    /**
+        EVALUATION
+    **/
+
+    template<class T>
+    TensorBase<T>::TensorBase(const LazyTensor<T> &rhs) : TensorBase<T>::vector_type()
+    {
+        rhs.eval(*this, T(1), T(0));
+    }
+
+    template<class T>
+    TensorBase<T>& TensorBase<T>::operator=(const LazyTensor<T> &rhs)
+    {
+        rhs.eval(*this, T(1), T(0));
+        return *this;
+    }
+
+    template<class T>
+    TensorBase<T>& TensorBase<T>::operator+=(const LazyTensor<T> &rhs)
+    {
+        rhs.eval(*this, T(1), T(1));
+        return *this;
+    }
+
+    template<class T>
+    TensorBase<T>& TensorBase<T>::operator-=(const LazyTensor<T> &rhs)
+    {
+        rhs.eval(*this, T(-1), T(1));
+        return *this;
+    }
+
+    template<class T, int N>
+    TensorDerived<T,N>::TensorDerived(const LazyTensor<T> &rhs) : TensorBase<T>()
+    {
+        operator=(rhs);
+    }
+
+    template<class T, int N>
+    TensorDerived<T,N>& TensorDerived<T,N>::operator=(const LazyTensor<T> &rhs)
+    {
+        if(N != rhs.shape().size())
+        {
+            throw ErrorHandler::RankMismatch("TensorUtils::TensorDerived<T,N>::operator=:: Rank mismatch!");
+        }
+        TensorBase<T>::operator=(rhs);
+        return *this;
+    }
+
+    template<class T>
+    TensorDerived<T,-1>::TensorDerived(const LazyTensor<T> &rhs) : TensorBase<T>(rhs)
+    {
+        //
+    }
+
+    template<class T>
+    TensorDerived<T,-1>& TensorDerived<T,-1>::operator=(const LazyTensor<T> &rhs)
+    {
+        TensorBase<T>::operator=(rhs);
+        return *this;
+    }
+}
+
+#endif // LAZYTENSOR_HPP
@@ -0,0 +1,150 @@
+/**
+\internal
+    TensorUtils Version 0.1
+
+    Copyright 2022 Christoph Widder
+
+    This file is part of TensorUtils.
+
+    TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+    the GNU General Public License as published by the Free Software Foundation, either
+    version 3 of the License, or (at your option) any later version.
+
+    TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+    without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+    PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along with TensorUtils.
+    If not, see <https://www.gnu.org/licenses/>.
+\endinternal
+**/
+
+#ifndef MAPPEDTENSOR_HPP
+#define MAPPEDTENSOR_HPP
+
+#include "TensorBase.hpp"
+#include "TensorView.hpp"
+
+#include <string>
+#include <vector>
+
+namespace TensorUtils
+{
+    /*!
+        \addtogroup TensorUtils
+        @{
+    */
+
+    //! Memory-mapped binary tensor file, see \ref TensorBase::read for the file format.
+    /*!
+        The file extension must match the component type T, e.g. ".f64" for double, or be ".tu" for
+        self-describing containers whose stored component type and byte order match T and this host.
+        Checksums of containers are not verified. Mapping a container writable removes its checksums,
+        and containers created by a mapping carry no checksums.
+        The header is parsed in place and the components are accessed directly in the mapped file
+        through \ref view, i.e. without any copy and without reading components that are never accessed.
+        The operating system loads pages lazily on first access and may evict them under memory pressure.
+
+        A new file can be created with a given shape. Its size is set once with ftruncate and the components
+        are written through the mapping. Changes of a writable mapping are written back to the file
+        at the latest when the mapping is destroyed, or explicitly by \ref sync.
+
+        Mappings are movable but not copyable. Views must not outlive the mapping.
+        Throws \ref ErrorHandler::UnableToOpenFile if the file cannot be opened or mapped and
+        \ref ErrorHandler::ShapeMismatch if the header does not match the file size.
+        \code
+        #include "TensorUtils.hpp"
+
+        int main()
+        {
+            using namespace TensorUtils;
+
+            {
+                MappedTensor<double> out("foo.f64", {2,3,5,7});   // creates foo.f64
+                tensor<double> src({2,3,5,7});
+                src.arange();
+                out.view().assign(src.view());                      // writes directly to the file
+            }
+
+            MappedTensor<double> in("foo.f64");                     // read-only mapping, no copy
+            TensorView<double> slab = in.view().slice({1});         // only these pages are ever read
+            tensor<double> sum;
+            sum = slab.contract({-1,-2,-3});
+
+            tensor<double> foo;
+            foo = in.view();                                        // single copy into memory
+
+            return 0;
+        }
+        \endcode
+    */
+    template<class T>
+    class MappedTensor
+    {
+        public:
+            //! Empty mapping.
+            MappedTensor();
+
+            /*!
+                Maps an existing file.
+                \param path     Path of the file, the extension must match T.
+                \param writable If true, changes of the components are written to the file.
+                                Otherwise the mapping is private: changes are only visible to this object.
+            */
+            MappedTensor(const std::string &path, bool writable=false);
+
+            /*!
+                Creates (or truncates) the file \p path with the given shape and maps it writable.
+                All components are initialized with zero.
+                \param path     Path of the file, the extension must match T.
+                \param shape    Shape of the tensor.
+            */
+            MappedTensor(const std::string &path, const std::vector<size_t> &shape);
+
+            //! Transfers the mapping.
+            MappedTensor(MappedTensor<T> &&other);
+
+            //! Transfers the mapping. The previous mapping of this object is released.
+            MappedTensor<T>& operator=(MappedTensor<T> &&other);
+
+            MappedTensor(const MappedTensor<T>&) = delete;
+            MappedTensor<T>& operator=(const MappedTensor<T>&) = delete;
+
+            //! Releases the mapping and writes back all changes.
+            ~MappedTensor();
+
+            //! Pointer to the first component in the mapped file.
+            T* data() const;
+
+            //! Number of components.
+            size_t size() const;
+
+            //! True if the mapping can be written.
+            bool writable() const;
+
+            //! Non-owning view of all components.
+            TensorView<T> view() const;
+
+            //! Writes back all changes of a writable mapping and waits until they are stored.
+            void sync();
+
+            //! Shape of the mapped tensor (read-only by convention, changing it does not change the file).
+            std::vector<size_t> shape;
+
+            //! Strides of the mapped tensor, see \ref TensorBase::incr.
+            std::vector<size_t> incr;
+
+        private:
+            void map_file(const std::string &path, bool writable, bool create);
+            void release();
+
+            void*   addr;
+            size_t  length;
+            T*      ptr;
+            size_t  count;
+            bool    is_writable;
+    };
+    /*! @} */
+}
+
+#endif // MAPPEDTENSOR_HPP
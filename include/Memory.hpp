@@ -0,0 +1,217 @@
+/**
+\internal
+    TensorUtils Version 0.1
+
+    Copyright 2022 Christoph Widder
+
+    This file is part of TensorUtils.
+
+    TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+    the GNU General Public License as published by the Free Software Foundation, either
+    version 3 of the License, or (at your option) any later version.
+
+    TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+    without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+    PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along with TensorUtils.
+    If not, see <https://www.gnu.org/licenses/>.
+\endinternal
+**/
+
+#ifndef MEMORY_HPP
+#define MEMORY_HPP
+
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace TensorUtils
+{
+    //! Storage policy of all tensors.
+    /*!
+        The components of every tensor are allocated with \ref Memory::Allocator, which takes the memory from a
+        \ref Memory::Resource. The resource is selected at runtime: \ref set_default changes it for the whole
+        process and a \ref Scope changes it for the current thread until the scope ends. Every block remembers
+        the resource it came from, so tensors can be resized, moved and destroyed after the resource was switched.
+        All blocks are aligned to \ref ALIGNMENT bytes.
+
+        Ready-made resources are:
+        - \ref aligned: operator new with 64-byte alignment, the default
+        - \ref huge_pages: anonymous mappings backed by transparent huge pages for blocks of at least 2 MiB
+        - \ref pool: keeps freed blocks in free lists per size class and reuses them, which removes the
+          malloc/free cost of temporaries that are created in a loop
+        - \ref Arena: hands out memory from large chunks and frees it all at once with \ref Arena::release
+        \code
+        #include "TensorUtils.hpp"
+
+        int main()
+        {
+            using namespace TensorUtils;
+
+            Memory::set_default(Memory::pool());            // reuse the storage of temporaries
+
+            tensor<double> big;
+            {
+                Memory::Scope scope(Memory::huge_pages());  // this thread allocates on huge pages
+                big.alloc({1024,1024,64}, 0.0);
+            }
+
+            Memory::Arena arena;
+            for(int iter=0; iter<100; iter++)
+            {
+                {
+                    Memory::Scope scope(&arena);
+                    tensor<double> tmp({256,256}, 1.0);
+                    tmp = tmp.transpose({1,0});
+                }
+                arena.release();                                // frees all temporaries of the iteration
+            }
+
+            return 0;
+        }
+        \endcode
+    */
+    namespace Memory
+    {
+        //! Alignment in bytes of the storage of all tensors.
+        constexpr size_t ALIGNMENT = 64;
+
+        //! Abstract source of memory for tensor storage. Implementations must be thread-safe unless documented otherwise.
+        class Resource
+        {
+            public:
+                //! \private
+                virtual ~Resource();
+
+                //! Returns a block of at least \p bytes bytes aligned to \ref ALIGNMENT or throws std::bad_alloc.
+                virtual void* allocate(size_t bytes) = 0;
+
+                //! Returns a block that was allocated by this resource with the same size.
+                virtual void deallocate(void* ptr, size_t bytes) = 0;
+        };
+
+        //! Resource that uses operator new with \ref ALIGNMENT. This is the default.
+        Resource* aligned();
+
+        //! Resource that maps blocks of at least 2 MiB on transparent huge pages (Linux) and uses \ref aligned otherwise.
+        Resource* huge_pages();
+
+        //! Process-wide resource that caches freed blocks in size classes of at most 25% waste, see \ref release_pool.
+        Resource* pool();
+
+        //! Returns all blocks that are cached by \ref pool to the system.
+        void release_pool();
+
+        //! Sets the resource for all threads without a \ref Scope. nullptr selects \ref aligned.
+        void set_default(Resource* resource);
+
+        //! Resource of the current thread: the innermost \ref Scope or the default.
+        Resource* current();
+
+        //! Selects a resource for the allocations of the current thread during its lifetime. Scopes can be nested.
+        class Scope
+        {
+            public:
+                //! Selects \p resource for the current thread.
+                explicit Scope(Resource* resource);
+
+                //! Restores the previous resource of the current thread.
+                ~Scope();
+
+                Scope(const Scope&) = delete;
+                Scope& operator=(const Scope&) = delete;
+
+            private:
+                Resource* previous;
+        };
+
+        /*!
+            Bump allocator for temporaries: memory is taken from chunks of at least \p chunk_size bytes,
+            deallocation does nothing and \ref release frees all blocks at once. Tensors allocated from the arena
+            must be destroyed before \ref release is called or the arena is destroyed. Allocation is thread-safe.
+        */
+        class Arena : public Resource
+        {
+            public:
+                //! Arena with chunks of at least \p chunk_size bytes.
+                explicit Arena(size_t chunk_size = size_t(1)<<24);
+
+                //! Frees all chunks.
+                ~Arena();
+
+                Arena(const Arena&) = delete;
+                Arena& operator=(const Arena&) = delete;
+
+                //! \private
+                void* allocate(size_t bytes) override;
+
+                //! \private
+                void deallocate(void* ptr, size_t bytes) override;
+
+                //! Frees all blocks. The chunks are merged into a single chunk that is kept for the next iteration.
+                void release();
+
+                //! Number of bytes handed out since the last \ref release.
+                size_t used() const;
+
+            private:
+                struct Chunk
+                {
+                    char* data;
+                    size_t size;
+                };
+
+                size_t chunk_size;
+                std::vector<Chunk> chunks;
+                size_t offset;
+                size_t in_use;
+                mutable std::mutex m;
+        };
+
+        //! \private Allocates from the current resource and records it in front of the block.
+        void* allocate(size_t bytes);
+
+        //! \private Returns the block to the resource that allocated it.
+        void deallocate(void* ptr, size_t bytes);
+
+        //! Stateless allocator of the tensor storage, see \ref Memory. All instances compare equal.
+        template<class T>
+        class Allocator
+        {
+            public:
+                typedef T value_type;
+                typedef std::true_type is_always_equal;
+                typedef std::true_type propagate_on_container_move_assignment;
+
+                Allocator() noexcept {}
+
+                template<class U>
+                Allocator(const Allocator<U>&) noexcept {}
+
+                T* allocate(size_t n)
+                {
+                    if(n > size_t(-1)/sizeof(T))
+                    {
+                        throw std::bad_array_new_length();
+                    }
+                    return static_cast<T*>(Memory::allocate(n*sizeof(T)));
+                }
+
+                void deallocate(T* ptr, size_t n) noexcept
+                {
+                    Memory::deallocate(ptr, n*sizeof(T));
+                }
+
+                template<class U>
+                bool operator==(const Allocator<U>&) const noexcept { return true; }
+
+                template<class U>
+                bool operator!=(const Allocator<U>&) const noexcept { return false; }
+        };
+    }
+}
+
+#endif // MEMORY_HPP
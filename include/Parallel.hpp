@@ -0,0 +1,90 @@
+/**
+\internal
+    TensorUtils Version 0.1
+
+    Copyright 2022 Christoph Widder
+
+    This file is part of TensorUtils.
+
+    TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+    the GNU General Public License as published by the Free Software Foundation, either
+    version 3 of the License, or (at your option) any later version.
+
+    TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+    without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+    PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along with TensorUtils.
+    If not, see <https://www.gnu.org/licenses/>.
+\endinternal
+**/
+
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <cstddef>
+#include <functional>
+
+namespace TensorUtils
+{
+    //! Execution policy of the multithreaded backend.
+    /*!
+        Element-wise operations, \ref TensorBase::init, \ref TensorBase::arange, type-converting assignments,
+        operations on sub-tensors and views as well as \ref TensorBase::dot and \ref TensorBase::contract
+        partition their work across a pool of threads. The calling thread takes part in the work.
+        Operations with less work than \ref threshold per thread run serially on the calling thread,
+        as do operations that are called concurrently from several threads of the application.
+
+        The number of threads defaults to the environment variable TENSORUTILS_NUM_THREADS if it is set,
+        otherwise to std::thread::hardware_concurrency(). The results do not depend on the number of threads.
+
+        Asynchronous file operations, e.g. \ref TensorBase::write_async and \ref TensorPrefetcher, run on separate
+        background threads in the order they were started, at most \ref num_io_threads of them at a time.
+        \code
+        #include "TensorUtils.hpp"
+
+        int main()
+        {
+            using namespace TensorUtils;
+
+            Parallel::set_num_threads(16);      // use 16 threads for all following operations
+            Parallel::set_threshold(1<<16);     // at least 65536 component operations per thread
+
+            tensor<double> A({1000,1000}, 1.0);
+            tensor<double> B({1000,1000}, 2.0);
+            tensor<double> C;
+            C = A.dot(B, {1,-1}, {-1,2});       // parallel matrix product
+            A += B;                             // parallel element-wise operation
+
+            Parallel::set_num_threads(1);       // serial execution
+
+            return 0;
+        }
+        \endcode
+    */
+    namespace Parallel
+    {
+        //! Sets the number of threads, 0 selects std::thread::hardware_concurrency() and 1 disables multithreading.
+        void set_num_threads(unsigned n);
+
+        //! Number of threads used by all operations.
+        unsigned num_threads();
+
+        //! Sets the minimum amount of work (component operations or multiply-adds) that is assigned to a thread.
+        void set_threshold(size_t n);
+
+        //! Minimum amount of work per thread.
+        size_t threshold();
+
+        //! Sets the number of background I/O operations that run concurrently, see \ref TensorBase::write_async. At least 1, the default is 2.
+        void set_num_io_threads(unsigned n);
+
+        //! Number of background I/O operations that run concurrently.
+        unsigned num_io_threads();
+
+        //! \private Calls f(begin,end) for disjoint ranges that cover [0,n), concurrently if there is enough work. Used by expression templates.
+        void for_range(size_t n, const std::function<void(size_t,size_t)> &f, size_t work_per_item=1);
+    }
+}
+
+#endif // PARALLEL_HPP
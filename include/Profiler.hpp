@@ -0,0 +1,117 @@
+/**
+\internal
+    TensorUtils Version 0.1
+
+    Copyright 2022 Christoph Widder
+
+    This file is part of TensorUtils.
+
+    TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+    the GNU General Public License as published by the Free Software Foundation, either
+    version 3 of the License, or (at your option) any later version.
+
+    TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+    without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+    PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along with TensorUtils.
+    If not, see <https://www.gnu.org/licenses/>.
+\endinternal
+**/
+
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace TensorUtils
+{
+    //! Per-operation counters and trace events of the library.
+    /*!
+        If the library is built with ENABLE_PROFILING=1, every instrumented operation, e.g. \ref TensorBase::dot,
+        \ref ContractionPlan (analysis and execution separately), \ref TensorBase::transpose, \ref TensorBase::slice,
+        reductions, batched operations and all file formats, counts its calls and inclusive wall time on the calling
+        thread. Allocations of tensor storage and bytes read or written are attributed to the innermost running
+        operation. Allocations outside of any operation, e.g. temporaries of element-wise expressions in the code of
+        the application, are collected in the entry "(application)". The debug build enables profiling, the release
+        build does not unless it is built with `make release PROFILING=1` after `make clean`.
+        Without ENABLE_PROFILING the instrumentation is compiled out, \ref enabled returns false and all counters stay empty.
+
+        While a trace is recorded, every operation also emits a trace event with its shapes, which \ref write_trace
+        stores in the Chrome trace-event format that chrome://tracing and Perfetto display as a timeline.
+        \code
+        #include "TensorUtils.hpp"
+
+        int main()
+        {
+            using namespace TensorUtils;
+
+            tensor<double> A({256,256}, 1.0), C;
+
+            Profiler::reset();
+            Profiler::start_trace();
+            for(int n=0; n<10; n++)
+            {
+                C = A.dot(A, {1,-1}, {-1,2});
+            }
+            A.transpose({1,0}).write("A.f64", ".");
+            Profiler::stop_trace();
+
+            Profiler::dump(std::cout);              // table of calls, time, allocations and I/O per operation
+            Profiler::write_trace("trace.json");    // timeline of all operations
+
+            for(const Profiler::Entry &e : Profiler::entries())
+            {
+                // e.name, e.calls, e.seconds, e.allocations, e.allocated_bytes, e.io_bytes
+            }
+
+            return 0;
+        }
+        \endcode
+    */
+    namespace Profiler
+    {
+        //! Counters of one operation.
+        struct Entry
+        {
+            //! Name of the operation, e.g. "TensorBase::dot".
+            std::string name;
+            //! Number of calls.
+            uint64_t calls;
+            //! Inclusive wall time of all calls in seconds.
+            double seconds;
+            //! Number of allocations of tensor storage.
+            uint64_t allocations;
+            //! Bytes of tensor storage allocated.
+            uint64_t allocated_bytes;
+            //! Bytes read from or written to files.
+            uint64_t io_bytes;
+        };
+
+        //! True if the library was built with ENABLE_PROFILING=1.
+        bool enabled();
+
+        //! Counters of all operations that were called since the last \ref reset, sorted by name.
+        std::vector<Entry> entries();
+
+        //! Sets all counters to zero and discards the recorded trace events.
+        void reset();
+
+        //! Writes a table of \ref entries to \p out, sorted by decreasing time.
+        void dump(std::ostream &out);
+
+        //! Starts recording trace events. The events of previous traces are kept until \ref reset.
+        void start_trace();
+
+        //! Stops recording trace events.
+        void stop_trace();
+
+        //! Writes the recorded trace events as a JSON file in the Chrome trace-event format. Throws std::runtime_error on failure.
+        void write_trace(const std::string &path);
+    }
+}
+
+#endif // PROFILER_HPP
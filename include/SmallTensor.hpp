@@ -0,0 +1,335 @@
+/**
+\internal
+    TensorUtils Version 0.1
+
+    Copyright 2022 Christoph Widder
+
+    This file is part of TensorUtils.
+
+    TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+    the GNU General Public License as published by the Free Software Foundation, either
+    version 3 of the License, or (at your option) any later version.
+
+    TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+    without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+    PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along with TensorUtils.
+    If not, see <https://www.gnu.org/licenses/>.
+\endinternal
+**/
+
+#ifndef SMALLTENSOR_HPP
+#define SMALLTENSOR_HPP
+
+#include "ErrorHandler.hpp"
+#include "TensorBase.hpp"
+#include "Expression.hpp"
+#include "ContractionPlan.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <initializer_list>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace TensorUtils
+{
+    /*!
+        \addtogroup TensorUtils
+        @{
+    */
+
+    //! Shape of a \ref SmallTensor with at most MAX_RANK extents, stored inline. Converts to and from std::vector<size_t>.
+    template<unsigned MAX_RANK>
+    class SmallShape
+    {
+        public:
+            //! Shape of a scalar.
+            SmallShape() : n(0) {}
+
+            //! Throws \ref ErrorHandler::RankMismatch if there are more than MAX_RANK extents.
+            SmallShape(std::initializer_list<size_t> extents) { assign(extents.begin(), extents.end()); }
+
+            //! Throws \ref ErrorHandler::RankMismatch if there are more than MAX_RANK extents.
+            SmallShape(const std::vector<size_t> &extents) { assign(extents.begin(), extents.end()); }
+
+            //! Throws \ref ErrorHandler::RankMismatch if there are more than MAX_RANK extents.
+            template<unsigned R2>
+            SmallShape(const SmallShape<R2> &extents) { assign(extents.begin(), extents.end()); }
+
+            //! Copy of the extents.
+            operator std::vector<size_t>() const { return std::vector<size_t>(begin(), end()); }
+
+            size_t size() const { return n; }
+            bool empty() const { return n == 0; }
+            size_t& operator[](size_t dim) { return extents[dim]; }
+            const size_t& operator[](size_t dim) const { return extents[dim]; }
+            const size_t& back() const { return extents[n-1]; }
+            const size_t* begin() const { return extents.data(); }
+            const size_t* end() const { return extents.data()+n; }
+
+        private:
+            template<class IT>
+            void assign(IT first, IT last)
+            {
+                if(size_t(last-first) > MAX_RANK)
+                {
+                    throw ErrorHandler::RankMismatch("TensorUtils::SmallShape:: Rank exceeds MAX_RANK!");
+                }
+                n = std::copy(first, last, extents.begin()) - extents.begin();
+            }
+
+            std::array<size_t,MAX_RANK> extents;
+            unsigned n;
+    };
+
+    //! \private
+    template<unsigned R, unsigned R2>
+    bool operator==(const SmallShape<R> &lhs, const SmallShape<R2> &rhs) { return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end()); }
+    //! \private
+    template<unsigned R>
+    bool operator==(const SmallShape<R> &lhs, const std::vector<size_t> &rhs) { return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end()); }
+    //! \private
+    template<unsigned R>
+    bool operator==(const std::vector<size_t> &lhs, const SmallShape<R> &rhs) { return rhs == lhs; }
+    //! \private
+    template<unsigned R, unsigned R2>
+    bool operator!=(const SmallShape<R> &lhs, const SmallShape<R2> &rhs) { return !(lhs == rhs); }
+    //! \private
+    template<unsigned R>
+    bool operator!=(const SmallShape<R> &lhs, const std::vector<size_t> &rhs) { return !(lhs == rhs); }
+    //! \private
+    template<unsigned R>
+    bool operator!=(const std::vector<size_t> &lhs, const SmallShape<R> &rhs) { return !(rhs == lhs); }
+
+    //! Tensor with at most CAPACITY components and rank MAX_RANK, whose components, shape and strides are stored inline.
+    /*!
+        Creating, copying and destroying a small tensor does not allocate any memory, which removes the allocator
+        from tight loops over many small tensors, e.g. per particle, and its contention between many threads.
+        Small tensors have the same layout as \ref TensorBase and support component access, the element-wise
+        expressions of \ref TensorUtils::operator+ with tensors of any kind, \ref dot and \ref contract.
+        Shapes that exceed the capacity throw \ref ErrorHandler::ShapeMismatch, ranks above MAX_RANK throw
+        \ref ErrorHandler::RankMismatch. Use \ref tensor for large tensors.
+        \code
+        #include "TensorUtils.hpp"
+
+        int main()
+        {
+            using namespace TensorUtils;
+
+            SmallTensor<double,16> A({3,3}), B({3,3}, 1.0);
+            A.arange();
+
+            SmallTensor<double,16> C = A.dot(B, {1,-1}, {-1,2});   // matrix product, no allocation of C
+            SmallTensor<double,16> D = A + 2.0*C;                   // fused element-wise expression
+            double trace = A.contract({-1,-1})();                  // the scalar is a small tensor as well
+
+            tensor<double> E({3,3}, 2.0);
+            D += E;                                                 // mixed with large tensors
+            TensorBase<double> F = D.dot(E, {1,-1}, {-1,2}).to_tensor();
+
+            return 0;
+        }
+        \endcode
+    */
+    template<class T, size_t CAPACITY = 16, unsigned MAX_RANK = 4>
+    class SmallTensor
+    {
+        public:
+            typedef T value_type;
+            typedef SmallShape<MAX_RANK> shape_type;
+
+            //! Empty tensor without components.
+            SmallTensor() : count(0) {}
+
+            //! Tensor of the given shape with all components zero.
+            SmallTensor(const shape_type &shape) : count(0) { alloc(shape); }
+
+            //! Tensor of the given shape with all components initialized with \p val.
+            SmallTensor(const shape_type &shape, const T &val) : count(0) { alloc(shape, val); }
+
+            //! Copy of \p rhs with conversion of the components.
+            template<class T2>
+            explicit SmallTensor(const TensorBase<T2> &rhs) : count(0)
+            {
+                alloc(rhs.shape);
+                std::copy(rhs.begin(), rhs.end(), components.begin());
+            }
+
+            //! Evaluates the element-wise expression \p rhs, see \ref TensorUtils::operator+.
+            template<class E, typename std::enable_if<std::is_base_of<ExpressionBase, E>::value, int>::type = 0>
+            SmallTensor(const E &rhs) : count(0) { operator=(rhs); }
+
+            //! Changes the shape and sets all components to zero.
+            void alloc(const shape_type &shape) { alloc(shape, T(0)); }
+
+            //! Changes the shape and initializes all components with \p val.
+            void alloc(const shape_type &shape, const T &val)
+            {
+                size_t n = 1;
+                for(auto it=shape.begin(); it!=shape.end(); it++)
+                {
+                    n *= *it;
+                }
+                if(n > CAPACITY)
+                {
+                    throw ErrorHandler::ShapeMismatch("TensorUtils::SmallTensor::alloc:: Number of components exceeds CAPACITY!");
+                }
+                this->shape = shape;
+                incr = shape;
+                size_t stride = 1;
+                for(size_t dim=shape.size(); dim-->0;)
+                {
+                    incr[dim] = stride;
+                    stride *= shape[dim];
+                }
+                count = n;
+                std::fill(components.begin(), components.begin()+count, val);
+            }
+
+            //! Initializes all components with \p val.
+            void init(const T &val) { std::fill(begin(), end(), val); }
+
+            //! Initializes all components with lexicographical enumeration starting at \p val.
+            void arange(T val=0)
+            {
+                for(auto it=begin(); it!=end(); it++)
+                {
+                    *it = val;
+                    val++;
+                }
+            }
+
+            //! Number of components.
+            size_t size() const { return count; }
+
+            //! Maximum number of components.
+            static constexpr size_t capacity() { return CAPACITY; }
+
+            T* data() { return components.data(); }
+            const T* data() const { return components.data(); }
+            T* begin() { return components.data(); }
+            const T* begin() const { return components.data(); }
+            T* end() { return components.data()+count; }
+            const T* end() const { return components.data()+count; }
+            T& operator[](size_t n) { return components[n]; }
+            const T& operator[](size_t n) const { return components[n]; }
+
+            //! Access to components with at most MAX_RANK indices, see \ref TensorBase::operator()(const std::vector<size_t> &). No error-handling!
+            template<class... I, typename std::enable_if<(sizeof...(I) <= MAX_RANK) && (std::is_integral<I>::value && ...), int>::type = 0>
+            T& operator()(I... indices) { return components[offset(indices...)]; }
+
+            //! See \ref operator()(I... indices).
+            template<class... I, typename std::enable_if<(sizeof...(I) <= MAX_RANK) && (std::is_integral<I>::value && ...), int>::type = 0>
+            const T& operator()(I... indices) const { return components[offset(indices...)]; }
+
+            /*!
+                Generalized tensor product, see \ref TensorBase::dot. \p rhs may be a small tensor or a \ref TensorBase.
+                The result must fit into the capacity of this type, else \ref ErrorHandler::ShapeMismatch is thrown.
+            */
+            template<class B>
+            SmallTensor dot(
+                const B                     &rhs,
+                const std::vector<int>      &idx_lhs,
+                const std::vector<int>      &idx_rhs,
+                const std::vector<size_t>   &idx_at={}) const
+            {
+                ContractionPlan plan(shape, idx_lhs, std::vector<size_t>(rhs.shape), idx_rhs, idx_at);
+                SmallTensor result;
+                result.alloc(plan.shape());
+                plan.execute(data(), rhs.data(), result.data());
+                return result;
+            }
+
+            //! Contraction of indices, see \ref TensorBase::contract. Throws \ref ErrorHandler::ShapeMismatch if the result does not fit.
+            SmallTensor contract(const std::vector<int> &idx_lhs, const std::vector<size_t> &idx_at={}) const
+            {
+                ContractionPlan plan(shape, idx_lhs, idx_at);
+                SmallTensor result;
+                result.alloc(plan.shape());
+                plan.execute(data(), result.data());
+                return result;
+            }
+
+            //! Evaluates \p rhs, a tensor of any kind or an element-wise expression, and takes its shape.
+            template<class X, typename std::enable_if<Expressions::is_operand<X>::value, int>::type = 0>
+            SmallTensor& operator=(const X &rhs)
+            {
+                const typename Expressions::operand<X>::type e(rhs);
+                if(shape != e.shape())
+                {
+                    alloc(e.shape());
+                }
+                for(size_t i=0; i<count; i++)
+                {
+                    components[i] = static_cast<T>(e[i]);
+                }
+                return *this;
+            }
+
+            //! Adds \p rhs component-wise. Throws \ref ErrorHandler::ShapeMismatch if the number of components differs.
+            template<class X, typename std::enable_if<Expressions::is_operand<X>::value, int>::type = 0>
+            SmallTensor& operator+=(const X &rhs) { return update<Expressions::Add>(rhs, "operator+="); }
+
+            //! Substracts \p rhs component-wise. Throws \ref ErrorHandler::ShapeMismatch if the number of components differs.
+            template<class X, typename std::enable_if<Expressions::is_operand<X>::value, int>::type = 0>
+            SmallTensor& operator-=(const X &rhs) { return update<Expressions::Substract>(rhs, "operator-="); }
+
+            //! Multiplies all components with \p val.
+            SmallTensor& operator*=(const T &val) { for(auto it=begin(); it!=end(); it++) { *it *= val; } return *this; }
+
+            //! Divides all components by \p val.
+            SmallTensor& operator/=(const T &val) { for(auto it=begin(); it!=end(); it++) { *it /= val; } return *this; }
+
+            //! Copy into a tensor with heap storage.
+            TensorBase<T> to_tensor() const
+            {
+                TensorBase<T> result(shape);
+                std::copy(begin(), end(), result.begin());
+                return result;
+            }
+
+            //! Specifies the range for all indices, see \ref TensorBase::shape.
+            shape_type shape;
+
+            //! Strides of all indices, see \ref TensorBase::incr.
+            shape_type incr;
+
+        private:
+            template<class... I>
+            size_t offset(I... indices) const
+            {
+                const size_t idx[] = {size_t(indices)..., 0};
+                size_t off = 0;
+                for(size_t dim=0; dim<sizeof...(I); dim++)
+                {
+                    off += idx[dim]*incr[dim];
+                }
+                return off;
+            }
+
+            template<class OP, class X>
+            SmallTensor& update(const X &rhs, const char* name)
+            {
+                const typename Expressions::operand<X>::type e(rhs);
+                if(e.size() != count)
+                {
+                    throw ErrorHandler::ShapeMismatch(std::string("TensorUtils::SmallTensor::") + name + ":: Shape mismatch!");
+                }
+                for(size_t i=0; i<count; i++)
+                {
+                    components[i] = OP::template apply<T>(components[i], e[i]);
+                }
+                return *this;
+            }
+
+            std::array<T,CAPACITY> components;
+            size_t count;
+    };
+    /*! @} */
+}
+
+#endif // SMALLTENSOR_HPP
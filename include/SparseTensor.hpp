@@ -0,0 +1,188 @@
+/**
+\internal
+    TensorUtils Version 0.1
+
+    Copyright 2022 Christoph Widder
+
+    This file is part of TensorUtils.
+
+    TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+    the GNU General Public License as published by the Free Software Foundation, either
+    version 3 of the License, or (at your option) any later version.
+
+    TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+    without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+    PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along with TensorUtils.
+    If not, see <https://www.gnu.org/licenses/>.
+\endinternal
+**/
+
+#ifndef SPARSETENSOR_HPP
+#define SPARSETENSOR_HPP
+
+#include "TensorBase.hpp"
+
+#include <string>
+#include <vector>
+
+namespace TensorUtils
+{
+    /*!
+        \addtogroup TensorUtils
+        @{
+    */
+
+    //! Tensor that stores only its non-zero components.
+    /*!
+        The stored components are kept as a list of values with their lexicographical indices, i.e. the offsets
+        of the components in a dense tensor of the same \ref shape. Components are added in any order by \ref insert
+        (coordinate format) and sorted by \ref compress, where duplicates are summed and zeros are dropped.
+        Sorted entries are grouped by their first index like the rows of the CSR format, which the kernels use
+        to partition the work across threads. All other member functions compress the tensor if necessary,
+        i.e. an uncompressed tensor must not be shared between threads before \ref compress was called.
+
+        \ref dot and \ref contract accept the same index labels as \ref TensorBase::dot and \ref TensorBase::contract.
+        Their cost is proportional to the number of stored components instead of the number of all index combinations:
+        - sparse-dense products iterate over the stored components and, for each of them, over the indices of the dense
+          operand that do not occur in the sparse operand, with vectorized inner loops
+        - sparse-sparse products look up the stored components of the second operand by their common indices in a sorted table
+          and return a sparse tensor
+        - contractions of a single sparse tensor accumulate every stored component into a dense result
+
+        Sparse tensors are stored in the container format ".tu" with the sparse flag: the values and a table of their
+        indices, both with checksums. \ref TensorBase::read reads such files as dense tensors.
+        \code
+        #include "TensorUtils.hpp"
+
+        int main()
+        {
+            using namespace TensorUtils;
+
+            SparseTensor<double> A({1000,1000,50});
+            A.insert({3,7,2}, 1.5);                             // coordinate format, any order
+            A.insert({999,0,49}, -2.0);
+            A.compress();                                       // sorted and merged, A.nnz() == 2
+
+            tensor<double> B({50,20}, 1.0);
+            tensor<double> C;
+            C = A.dot(B, {1,2,-1}, {-1,3});                     // sparse-dense product: C has shape {1000,1000,20}
+
+            SparseTensor<double> D = A.dot(A, {1,-1,-2}, {2,-1,-2}); // sparse-sparse product: D has shape {1000,1000}
+            C = A.contract({1,-1,-2});                          // sum over the last two indices: C has shape {1000}
+
+            tensor<double> X({30,30,30}, 0.0);
+            X({1,2,3}) = 4.0;
+            SparseTensor<double> S(X);                          // keeps the components with |x| > 0
+            X = S.dense();                                      // and back
+
+            S.write("S.tu", ".");                               // sparse container
+            X.read("./S.tu");                                   // read as a dense tensor
+
+            return 0;
+        }
+        \endcode
+    */
+    template<class T>
+    class SparseTensor
+    {
+        public:
+            //! Stored component type.
+            typedef T value_type;
+
+            //! Empty tensor without components.
+            SparseTensor();
+
+            //! Tensor of the given shape without stored components, i.e. all components are zero.
+            SparseTensor(const std::vector<size_t> &shape);
+
+            //! Stores the components of \p dense with an absolute value larger than \p tolerance.
+            template<class T2>
+            explicit SparseTensor(const TensorBase<T2> &dense, const T &tolerance = T(0));
+
+            //! Sets the shape and removes all stored components.
+            void alloc(const std::vector<size_t> &shape);
+
+            //! Reserves memory for \p nnz stored components.
+            void reserve(size_t nnz);
+
+            /*!
+                Adds \p val to the component at \p indices. The entry is appended, see \ref compress.
+                Throws \ref ErrorHandler::ShapeMismatch if the number of indices differs from the rank
+                and, if THROW_EXCEPTIONS is enabled, std::out_of_range if an index exceeds its range.
+            */
+            void insert(const std::vector<size_t> &indices, const T &val);
+
+            //! Sorts the stored components by their indices, sums duplicates and drops zeros.
+            void compress();
+
+            //! Number of stored components.
+            size_t nnz() const;
+
+            //! Fraction of stored components among all components.
+            double density() const;
+
+            //! Value of the component at \p indices, zero if it is not stored.
+            T operator()(const std::vector<size_t> &indices) const;
+
+            //! Lexicographical indices of the stored components in increasing order.
+            const std::vector<size_t>& offsets() const;
+
+            //! Values of the stored components in the order of \ref offsets.
+            const std::vector<T>& values() const;
+
+            //! Dense tensor with all components.
+            TensorBase<T> dense() const;
+
+            /*!
+                Generalized tensor product with a dense tensor, see \ref TensorBase::dot. The result is dense.
+                The operands can be swapped together with their labels to compute dense-sparse products.
+                Throws \ref ErrorHandler::ShapeMismatch if the labels do not match the ranks or the ranges of equal labels differ.
+            */
+            template<class T2>
+            TensorBase<T> dot(
+                const TensorBase<T2>        &rhs,
+                const std::vector<int>      &idx_lhs,
+                const std::vector<int>      &idx_rhs) const;
+
+            //! Generalized tensor product of two sparse tensors, see \ref TensorBase::dot. The result is sparse.
+            template<class T2>
+            SparseTensor<T> dot(
+                const SparseTensor<T2>      &rhs,
+                const std::vector<int>      &idx_lhs,
+                const std::vector<int>      &idx_rhs) const;
+
+            //! Sum over specified axes, see \ref TensorBase::contract. The result is dense.
+            TensorBase<T> contract(const std::vector<int> &idx_lhs) const;
+
+            /*!
+                Reads a sparse tensor from a container ".tu". The components of dense files are converted as by
+                \ref TensorBase::read and only the non-zero components are stored.
+            */
+            void read(std::string path);
+
+            /*!
+                Writes a sparse container to folder/oname, which must have the extension ".tu".
+                Throws std::runtime_error for other extensions.
+            */
+            void write(std::string oname, std::string folder) const;
+
+            //! Range of all indices, see \ref TensorBase::shape.
+            std::vector<size_t> shape;
+
+            //! Strides of the indices in a dense tensor of the same shape, see \ref TensorBase::incr.
+            std::vector<size_t> incr;
+
+        private:
+            void sort_entries() const;
+
+            // sorted lazily by the const member functions
+            mutable std::vector<size_t> offs;
+            mutable std::vector<T> vals;
+            mutable bool sorted;
+    };
+    /*! @} */
+}
+
+#endif // SPARSETENSOR_HPP
@@ -0,0 +1,180 @@
+/**
+\internal
+    TensorUtils Version 0.1
+
+    Copyright 2022 Christoph Widder
+
+    This file is part of TensorUtils.
+
+    TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+    the GNU General Public License as published by the Free Software Foundation, either
+    version 3 of the License, or (at your option) any later version.
+
+    TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+    without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+    PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along with TensorUtils.
+    If not, see <https://www.gnu.org/licenses/>.
+\endinternal
+**/
+
+
+#ifndef SYMMETRICTENSOR_HPP
+#define SYMMETRICTENSOR_HPP
+
+#include "TensorBase.hpp"
+
+#include <vector>
+
+namespace TensorUtils
+{
+    /*!
+        \addtogroup TensorUtils
+        @{
+    */
+
+    //! Tensor that is symmetric or antisymmetric under all permutations of its indices and stores only its unique components.
+    /*!
+        All indices have the same \ref range n. A symmetric tensor of rank N stores the components with sorted
+        indices i_0 <= ... <= i_{N-1}, i.e. binomial(n+N-1,N) instead of n^N components, and an antisymmetric
+        tensor those with strictly increasing indices, i.e. binomial(n,N) components. All other components are obtained by
+        permuting the indices, with the sign of the permutation for antisymmetric tensors, whose components with
+        repeated indices are zero. \ref values holds the stored components in colexicographical order of their sorted indices.
+
+        \ref dot takes the same index labels as \ref TensorBase::dot and returns a dense tensor. If no label is repeated
+        in the same operand and the operands only have their negative labels in common, e.g. the product of a rank-4
+        tensor with a strain or of a symmetric matrix with vectors, the kernel exploits the symmetry:
+        - the summed indices of the dense operand are accumulated onto their sorted indices once
+        - the product is computed only for the sorted free indices of this tensor, i.e. about k!*m!
+          fewer multiply-adds for k free and m summed indices of this tensor
+        - the result is expanded to all permutations of the free indices of this tensor
+        - products of matrices read every stored component once and apply it to the rows of both of its indices,
+          i.e. half of the memory traffic of a dense matrix
+        All other labels and \ref contract compute the dense tensor first. Throws \ref ErrorHandler::ShapeMismatch with the
+        same conditions as \ref TensorBase::dot and \ref TensorBase::contract.
+        \code
+        #include "TensorUtils.hpp"
+
+        int main()
+        {
+            using namespace TensorUtils;
+
+            SymmetricTensor<double> C(3, 4);                    // 15 instead of 81 components
+            C.set({0,0,1,1}, 2.0);                              // sets all 6 permutations
+            C.set({0,1,2,2}, 0.5);
+
+            tensor<double> eps({3,3}, 1.0), x({3}, 1.0);
+            tensor<double> sigma;
+            sigma = C.dot(eps, {1,2,-1,-2}, {-1,-2});           // sigma has shape {3,3}
+
+            tensor<double> A({3,3}, 1.0);
+            SymmetricTensor<double> S(A);                       // stores A(i,j) for i<=j
+            tensor<double> y;
+            y = S.dot(x, {1,-1}, {-1});                         // symmetric matrix-vector product
+
+            SymmetricTensor<double> F(3, 2, SymmetricTensor<double>::Symmetry::ANTISYMMETRIC);
+            F.set({0,1}, 1.0);                                  // F({1,0}) == -1.0, F({1,1}) == 0.0
+            A = F.dense();
+
+            return 0;
+        }
+        \endcode
+    */
+    template<class T>
+    class SymmetricTensor
+    {
+        public:
+            //! Stored component type.
+            typedef T value_type;
+
+            //! Behaviour of the components under permutations of their indices.
+            enum class Symmetry
+            {
+                SYMMETRIC,      //!< the components do not change
+                ANTISYMMETRIC   //!< the components change their sign for odd permutations
+            };
+
+            //! Scalar, i.e. a tensor of rank zero.
+            SymmetricTensor();
+
+            //! Tensor of the given rank with all indices of range \p range and all components zero.
+            SymmetricTensor(size_t range, size_t rank, Symmetry symmetry=Symmetry::SYMMETRIC);
+
+            /*!
+                Stores the components of \p dense with sorted indices, the other components are not read.
+                Throws \ref ErrorHandler::ShapeMismatch if the indices of \p dense do not have the same range.
+            */
+            explicit SymmetricTensor(const TensorBase<T> &dense, Symmetry symmetry=Symmetry::SYMMETRIC);
+
+            //! Sets the rank, range and symmetry and all components to zero.
+            void alloc(size_t range, size_t rank, Symmetry symmetry=Symmetry::SYMMETRIC);
+
+            //! Symmetry of the tensor.
+            Symmetry symmetry() const;
+
+            //! Number of indices.
+            size_t rank() const;
+
+            //! Range of every index.
+            size_t range() const;
+
+            //! Number of stored components.
+            size_t stored() const;
+
+            /*!
+                Value of the component at \p indices in any order.
+                Throws \ref ErrorHandler::ShapeMismatch if the number of indices differs from the rank
+                and, if THROW_EXCEPTIONS is enabled, std::out_of_range if an index exceeds the range.
+            */
+            T operator()(const std::vector<size_t> &indices) const;
+
+            /*!
+                Sets the component at \p indices and thereby all its permutations. Throws like \ref operator()
+                and std::domain_error if a non-zero value is set at repeated indices of an antisymmetric tensor.
+            */
+            void set(const std::vector<size_t> &indices, const T &val);
+
+            //! Stored components, see \ref SymmetricTensor.
+            std::vector<T>& values();
+
+            //! Stored components, see \ref SymmetricTensor.
+            const std::vector<T>& values() const;
+
+            //! Dense tensor with all components.
+            TensorBase<T> dense() const;
+
+            /*!
+                Generalized tensor product with a dense tensor, see \ref TensorBase::dot and \ref SymmetricTensor.
+                The operands can be swapped together with their labels to compute dense-symmetric products.
+            */
+            TensorBase<T> dot(
+                const TensorBase<T>         &rhs,
+                const std::vector<int>      &idx_lhs,
+                const std::vector<int>      &idx_rhs) const;
+
+            //! Sum over specified axes of the dense tensor, see \ref TensorBase::contract.
+            TensorBase<T> contract(const std::vector<int> &idx_lhs) const;
+
+            //! Range of all indices (read-only by convention, use \ref alloc to change it), see \ref TensorBase::shape.
+            std::vector<size_t> shape;
+
+        private:
+            // offset of sorted indices of the given length, by the combinatorial number system
+            size_t offset(const size_t* sorted, size_t length) const;
+
+            // number of sorted index tuples of the given length
+            size_t count(size_t length) const;
+
+            // sorts indices and returns the sign of the permutation, 0 if the component vanishes
+            T canonical(std::vector<size_t> &indices) const;
+
+            Symmetry sym;
+            size_t extent;
+            std::vector<size_t> binom;  // binom[k*(n+N)+m] = binomial(m,k+1)
+            std::vector<T> vals;
+    };
+    /*! @} */
+}
+
+#endif // SYMMETRICTENSOR_HPP
@@ -22,22 +22,41 @@
 #ifndef TENSORBASE_HPP
 #define TENSORBASE_HPP
 
+#include "ErrorHandler.hpp"
+#include "Memory.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <future>
+#include <stdexcept>
 #include <vector>
 #include <string>
+#include <type_traits>
 
 namespace TensorUtils
 {
     /*!
         \brief This is the main class of this project.
-        It inherits from std::vector<T> and adds methods to make it a tensor.
+        It inherits from std::vector<T, Memory::Allocator<T>> and adds methods to make it a tensor.
+        The components are allocated by the storage policy described in \ref Memory.
+        Since the allocator differs, a tensor no longer binds to std::vector<T>&. Code written for std::vector<T>
+        either takes \ref vector_type, iterators or a pointer from data(), or copies the components with \ref to_vector.
     */
+    template<class T> class TensorView;
+    template<class T> class LazyTensor;
+
+    //! Base of all lazy element-wise expressions, see \ref Expression.hpp.
+    struct ExpressionBase {};
+
     template<class T>
-    class TensorBase : public std::vector<T>
+    class TensorBase : public std::vector<T, Memory::Allocator<T>>
     {
         public:
+            //! Type of the storage this tensor inherits from.
+            typedef std::vector<T, Memory::Allocator<T>> vector_type;
 
             // avoid name hiding of base class constructors
-            using std::vector<T>::vector;
+            using std::vector<T, Memory::Allocator<T>>::vector;
 
             /*!
                 Empty constructor.
@@ -92,9 +111,43 @@ namespace TensorUtils
             */
             TensorBase(const std::vector<size_t> &shape, const T& val);
 
+            /*!
+                Constructor. Evaluates the element-wise expression \p rhs in a single pass, see \ref operator+.
+                \code
+                #include "TensorUtils.hpp"
+
+                int main()
+                {
+                    TensorUtils::tensor<double> foo({2,3,5,7}, 1.0);
+                    TensorUtils::tensor<float> bar({2,3,5,7}, 2.0);
+
+                    TensorUtils::TensorBase<double> baz = foo + bar*3;
+
+                    return 0;
+                }
+                \endcode
+            */
+            template<class E, typename std::enable_if<std::is_base_of<ExpressionBase, E>::value, int>::type = 0>
+            TensorBase(const E &rhs);
+
+            //! Constructor. Computes the lazy expression \p rhs, see \ref LazyTensor.
+            TensorBase(const LazyTensor<T> &rhs);
+
             //! \private
             virtual ~TensorBase();
 
+            //! Copy constructor.
+            TensorBase(const TensorBase<T>&) = default;
+
+            //! Move constructor, takes over the storage. \p rhs is left as an empty tensor.
+            TensorBase(TensorBase<T>&&) = default;
+
+            //! Copy assignment.
+            TensorBase<T>& operator=(const TensorBase<T>&) = default;
+
+            //! Move assignment, takes over the storage. \p rhs is left as an empty tensor.
+            TensorBase<T>& operator=(TensorBase<T>&&) = default;
+
             /*!
                 Allocates the necessary memory and initializes \ref shape and \ref incr accordingly.
                 If an empty shape is received, the tensor is a scalar with exactly one component.
@@ -236,10 +289,13 @@ namespace TensorUtils
                         - .l    long
                         - .ull  unsigned long long
                         - .ll   long long
+                        - .tu   self-describing container, see below
+                        - .tuz  compressed container, see below
 
                 For text files, the first line must contain the shape of the tensor. Empty lines are ignored.
                 The header line is followed by a lexicographical list of all sub-matrices. Vectors are row-vectors.
                 Note that \ref print will display the same format.
+                Text files are parsed independent of the locale in large blocks using std::from_chars.
 
                 Binary files are formatted as follows.
                 The first block contains sizeof(size_t) bytes specifying shape.size().
@@ -247,6 +303,21 @@ namespace TensorUtils
                 The third block contains sizeof(size_t) bytes specifying the container size.
                 The fourth block contains this->size()*sizeof(T) bytes specifying the components of the tensor,
                 where T is the type of the components specified by the extension.
+                If the extension matches the type of this tensor, the components are read in a single pass without an intermediate buffer.
+                Use \ref MappedTensor to access binary files in place without reading them into memory.
+
+                Files with the extension ".tu" are self-describing containers. A header block of 4096 bytes
+                holds a magic number, the format version, the byte order, the stored component type and the shape.
+                The payload follows at offset 4096, such that it is aligned for memory mapping.
+                An optional table of CRC-32C checksums, one per chunk of the payload, is appended after the payload.
+                The components are converted from the stored type and byte order to T, and all checksums are verified.
+                Throws \ref ErrorHandler::CorruptedFile if the header is invalid or a checksum does not match.
+
+                Files with the extension ".tuz" are compressed containers with the same header. The payload is split
+                into chunks of 1 MiB that are compressed independently with LZ4, after a byte shuffle that groups the
+                k-th bytes of all components, which makes smooth floating point fields compressible. The chunks are
+                compressed and decompressed in parallel, see \ref Parallel, and \ref TensorReader decodes only the chunks
+                of the slabs it reads. Compressed containers cannot be memory mapped.
                 \code
                 #include "TensorUtils.hpp"
 
@@ -261,6 +332,8 @@ namespace TensorUtils
                         foo.read("foo.txt");
                         foo.read("foo.f32");
                         foo.read("foo.ull");
+                        foo.read("foo.tu");
+                        foo.read("foo.tuz");
                     }
                     catch(UnableToOpenFile &ex) // unable to open file
                     {
@@ -270,6 +343,10 @@ namespace TensorUtils
                     {
                         //
                     }
+                    catch(CorruptedFile &ex) // invalid container header or checksum mismatch
+                    {
+                        //
+                    }
                     catch(std::exception &ex) // catch any other exception
                     {
                         //
@@ -299,9 +376,13 @@ namespace TensorUtils
                         - .l    long
                         - .ull  unsigned long long
                         - .ll   long long
+                        - .tu   self-describing container with the component type T and chunk checksums
+                        - .tuz  compressed container with the component type T and chunk checksums
                 \param folder   Specifies the output path.
 
                 See \ref read for details on the file format.
+                Text files are formatted independent of the locale using std::to_chars. By default, floating point
+                components are written in scientific notation with the shortest representation that is read back exactly.
                 You may add the number of significant digits when writing text files,
                 see \ref write(std::string,std::string,int).
                 \code
@@ -315,10 +396,12 @@ namespace TensorUtils
 
                     foo.write("foo.txt", ".", 10);  // text file: writes 10 significant digits
 
-                    foo.write("foo.dat", "./"); // text file: if floating point: uses std::numeric_limits<T>::max_digits10
+                    foo.write("foo.dat", "./"); // text file: if floating point: shortest representation that is read back exactly
 
                     foo.write("foo.f32", ".");  // binary file: float
                     foo.write("foo.ull", ".");  // binary file: unsigned long long
+                    foo.write("foo.tu", ".");   // container: double, with checksums
+                    foo.write("foo.tuz", ".");  // compressed container: double, with checksums
 
                     return 0;
                 }
@@ -357,6 +440,54 @@ namespace TensorUtils
             */
             void write(std::string oname, std::string folder, int precision);
 
+            /*!
+                Starts \ref read(std::string) on a background thread, see \ref Parallel::num_io_threads.
+                This tensor must neither be accessed nor destroyed until the returned future is ready.
+                The future rethrows the exceptions of \ref read(std::string) from \c get().
+                Large binary files with a conversion of the component type overlap reading and conversion.
+                \code
+                #include "TensorUtils.hpp"
+
+                int main()
+                {
+                    using namespace TensorUtils;
+
+                    tensor<double> weights, state({1000,1000}, 1.0), snapshot;
+                    std::future<void> loaded = weights.read_async("weights.f32");
+                    std::future<void> saved;
+
+                    for(int step=0; step<100; step++)
+                    {
+                        if(step%10 == 0)
+                        {
+                            if(saved.valid())
+                            {
+                                saved.get();                            // the previous checkpoint is complete
+                            }
+                            snapshot = state;
+                            saved = snapshot.write_async("checkpoint.tu", ".");
+                        }
+                        state *= 0.5;                                   // computes while the checkpoint is written
+                    }
+
+                    loaded.get();                                       // waits and throws if the file could not be read
+                    saved.get();
+                    return 0;
+                }
+                \endcode
+                Use \ref TensorPrefetcher to read a list of files ahead of their use.
+            */
+            std::future<void> read_async(std::string path);
+
+            /*!
+                Starts \ref write(std::string,std::string) on a background thread and returns immediately.
+                This tensor must neither be modified nor destroyed until the returned future is ready, write a copy
+                to continue modifying it. The future rethrows the exceptions of \ref write(std::string,std::string) from \c get().
+                The writes of several calls are carried out in the order of the calls if \ref Parallel::num_io_threads is 1.
+                All writes that were started are completed before the program exits.
+            */
+            std::future<void> write_async(std::string oname, std::string folder);
+
             /*!
                 Permutes the indices of the tensor and returns by value.
                 \param axes Permutation of (0,1,...,N-1), where N is the rank. Indices are transposed accordingly.
@@ -375,7 +506,34 @@ namespace TensorUtils
                 }
                 \endcode
             */
-            TensorBase<T> transpose(const std::vector<unsigned> &axes);
+            TensorBase<T> transpose(const std::vector<unsigned> &axes) &;
+
+            //! Permutes the indices of an expiring tensor with \ref transpose_inplace and returns its storage without a copy.
+            TensorBase<T> transpose(const std::vector<unsigned> &axes) &&;
+
+            /*!
+                Permutes the indices of this tensor in place and returns *this, see \ref transpose.
+                Batches of square transposes, e.g. {1,0} of an n x n matrix or {0,2,1,3} of a {2,5,5,7} tensor,
+                swap tiles of components. All other permutations follow the cycles of the index mapping,
+                which needs one bit of additional memory per component.
+
+                \code
+                #include "TensorUtils.hpp"
+
+                int main()
+                {
+                    TensorUtils::tensor<double> foo({1000,1000});
+                    foo.arange();
+                    foo.transpose_inplace({1,0});       // blocked swap, no additional memory
+
+                    foo.alloc({2,3,5,7});
+                    foo.transpose_inplace({3,1,0,2});   // new shape is {7,3,2,5}
+
+                    return 0;
+                }
+                \endcode
+            */
+            TensorBase<T>& transpose_inplace(const std::vector<unsigned> &axes);
 
             /*!
                 Slices a sub-tensor and returns by value.
@@ -421,6 +579,28 @@ namespace TensorUtils
             */
             TensorBase<T>& reshape(const std::vector<size_t> &shape);
 
+            /*!
+                Returns a non-owning \ref TensorView of all components.
+                Slices, permutations and reshapes of the view do not copy any components.
+                The view is invalidated if this tensor is reallocated.
+
+                \code
+                #include "TensorUtils.hpp"
+
+                int main()
+                {
+                    TensorUtils::tensor<double> foo({2,3,5,7});
+                    foo.arange();
+
+                    TensorUtils::TensorView<double> bar = foo.view().slice({1,2}); // no copy, bar has shape {5,7}
+                    bar *= 2; // modifies foo
+
+                    return 0;
+                }
+                \endcode
+            */
+            TensorView<T> view();
+
             /*!
                 Returns a generalized tensor product by value.
                 Indices are represented by signed integers.
@@ -431,6 +611,9 @@ namespace TensorUtils
                 It is possible to mix summation, element-wise multiplication and the usual tensor product as desired.
                 The order of the return value can be set as desired and is given in increasing order of the resulting indices.
                 Additionally, it is possible to compute only a sub-tensor of the final result by setting the parameter \p idx_at.
+                Products that can be written as (batched) matrix products, i.e. every index occurs at most once per operand
+                and every summation index occurs in both operands, are evaluated by a cache-blocked matrix-matrix kernel.
+                Use \ref ContractionPlan to analyze the indices only once, if the same product is computed repeatedly.
                 \param rhs Second operand.
                 \param idx_lhs Indices of first operand represented by signed intergers.
                 \param idx_rhs Indices of second operand represented by signed integers.
@@ -476,6 +659,7 @@ namespace TensorUtils
                 Indices represented by negative integers are summed over.
                 The order of the return value can be set as desired and is given in increasing order of the resulting indices.
                 Optionally, it is possible to compute only a sub-tensor of the final result by setting the parameter \p idx_at.
+                Use \ref ContractionPlan to analyze the indices only once, if the same contraction is computed repeatedly.
                 \param idx_lhs Indices of first operand represented by signed integers.
                 \param idx_at  Indices specifying the sub-tensor to be computed.
 
@@ -504,86 +688,164 @@ namespace TensorUtils
             TensorBase<T> contract(const std::vector<int> &idx_lhs, const std::vector<size_t> &idx_at={});
 
             /*!
-                Assigns the components in lexicographical order from a vector.
+                Batched form of \ref dot: computes the sub-tensors of the result at all prefixes \p idx_at[n], which must have
+                the same length. The result has the shape {idx_at.size(), ...}, where the sub-tensor n is the result of
+                dot(B, idx_lhs, idx_rhs, idx_at[n]). The indices are analyzed once and the batch is partitioned across threads.
                 \code
                 #include "TensorUtils.hpp"
 
                 int main()
                 {
-                    TensorUtils::tensor<long double> foo({2,3,5,7});
+                    using namespace TensorUtils;
 
-                    foo = std::vector<long double>(foo.size(), 1.0L); // initialize from a vector
+                    tensor<double> X({1000,3,3},1.0);
+                    tensor<double> Y({3,3},2.0);
+                    tensor<double> Z;
+
+                    Z = X.dot_batch(Y, {0,1,-1}, {-1,2}, {{3},{7},{11}}); // products of the matrices 3, 7 and 11 with Y: Z has shape {3,3,3}
+
+                    Z = X.contract_batch({0,-1,-1}, {{3},{7}});            // traces of the matrices 3 and 7: Z has shape {2}
 
                     return 0;
                 }
                 \endcode
             */
-            TensorBase<T>& operator= (const std::vector<T>& rhs);
+            template<class T2>
+            TensorBase<T> dot_batch(
+                const TensorBase<T2>                        &B,
+                const std::vector<int>                      &idx_lhs,
+                const std::vector<int>                      &idx_rhs,
+                const std::vector<std::vector<size_t>>      &idx_at);
+
+            //! Batched form of \ref contract, see \ref dot_batch.
+            TensorBase<T> contract_batch(const std::vector<int> &idx_lhs, const std::vector<std::vector<size_t>> &idx_at);
+
+            //! Same as \ref dot for a strided second operand, which is accessed in place. See \ref TensorView::dot.
+            template<class T2>
+            TensorBase<T> dot(
+                const TensorView<T2>&       rhs,
+                const std::vector<int>      &idx_lhs,
+                const std::vector<int>      &idx_rhs,
+                const std::vector<size_t>   &idx_at={});
 
             /*!
-                Assigns this tensor with \p rhs. If the components have the same type, the default copy assignment is invoked.
+                Returns the sum of all components. The components are added into several independent accumulators
+                by vectorized kernels and the partial sums of blocks are combined pairwise, such that the rounding error
+                grows only logarithmically with the size. Large tensors are reduced in parallel, see \ref Parallel.
+                Unlike \ref contract, no index analysis takes place, which makes norms cheap enough for convergence checks.
+                The same holds for all reductions below. The overloads with \p axes reduce over the given axes only and
+                return the tensor of the remaining axes in their original order. Axes must be distinct and smaller than the rank,
+                else \ref ErrorHandler::ShapeMismatch is thrown. Reductions over all axes return a scalar.
+
                 \code
                 #include "TensorUtils.hpp"
 
                 int main()
                 {
-                    TensorUtils::tensor<long double> foo({2,3,5,7},1.0);
-                    TensorUtils::tensor<float> bar;
+                    TensorUtils::tensor<double> X({3,5,7});
+                    X.arange();
 
-                    bar = foo;
+                    double s = X.sum();                     // same as X.contract({-1,-2,-3})
+                    TensorUtils::tensor<double> Y;
+                    Y = X.sum({0,2});                       // Y has shape {5}
+                    Y = X.max({1});                         // Y has shape {3,7}
+
+                    double r = X.norm2();                   // Euclidean norm
+                    std::vector<size_t> i = X.argmax();     // {2,4,6}
+                    double m = X(i);                        // same as X.max()
 
                     return 0;
                 }
                 \endcode
             */
-            template<class T2> TensorBase<T>&   operator=   (const TensorBase<T2>& rhs);
+            T sum() const;
+
+            //! Sum over \p axes, see \ref sum().
+            TensorBase<T> sum(const std::vector<unsigned> &axes) const;
+
+            //! Mean of all components, see \ref sum().
+            T mean() const;
+
+            //! Mean over \p axes, see \ref sum().
+            TensorBase<T> mean(const std::vector<unsigned> &axes) const;
+
+            //! Largest component, see \ref sum(). The lowest value of T for empty tensors.
+            T max() const;
+
+            //! Largest components along \p axes, see \ref sum().
+            TensorBase<T> max(const std::vector<unsigned> &axes) const;
+
+            //! Smallest component, see \ref sum(). The largest value of T for empty tensors.
+            T min() const;
+
+            //! Smallest components along \p axes, see \ref sum().
+            TensorBase<T> min(const std::vector<unsigned> &axes) const;
+
+            //! Sum of the absolute values of all components, see \ref sum().
+            T norm1() const;
+
+            //! L1 norms along \p axes, see \ref sum().
+            TensorBase<T> norm1(const std::vector<unsigned> &axes) const;
+
+            //! Square root of the sum of squares of all components, see \ref sum().
+            T norm2() const;
+
+            //! L2 norms along \p axes, see \ref sum().
+            TensorBase<T> norm2(const std::vector<unsigned> &axes) const;
+
+            //! Largest absolute value of all components, see \ref sum().
+            T norm_inf() const;
+
+            //! Maximum norms along \p axes, see \ref sum().
+            TensorBase<T> norm_inf(const std::vector<unsigned> &axes) const;
+
+            //! Index of the first largest component. Throws \ref ErrorHandler::ShapeMismatch for empty tensors.
+            std::vector<size_t> argmax() const;
+
+            //! Index of the first smallest component. Throws \ref ErrorHandler::ShapeMismatch for empty tensors.
+            std::vector<size_t> argmin() const;
 
             /*!
-                Add the tensor \p rhs. Number of components must match, else \ref ErrorHandler::ShapeMismatch is thrown.
+                Assigns the components in lexicographical order from a vector.
                 \code
                 #include "TensorUtils.hpp"
 
                 int main()
                 {
-                    TensorUtils::tensor<long double> foo({2,3,5,7},1.0);
-                    TensorUtils::tensor<float> bar({2,3,5,7},1.0);
-
-                    foo += bar;
-
-                    bar.alloc({2*3,5*7},1.0);
+                    TensorUtils::tensor<long double> foo({2,3,5,7});
 
-                    foo += bar;
+                    foo = std::vector<long double>(foo.size(), 1.0L); // initialize from a vector
 
                     return 0;
                 }
                 \endcode
             */
-            template<class T2> TensorBase<T>&   operator+=  (const TensorBase<T2>& rhs);
+            TensorBase<T>& operator= (const std::vector<T>& rhs);
 
             /*!
-                Returns the sum of this tensor \p with rhs. Number of components must match, else \ref ErrorHandler::ShapeMismatch is thrown.
+                Assigns this tensor with \p rhs. If the components have the same type, the default copy assignment is invoked.
                 \code
                 #include "TensorUtils.hpp"
 
                 int main()
                 {
                     TensorUtils::tensor<long double> foo({2,3,5,7},1.0);
-                    TensorUtils::tensor<float> bar({2,3,5,7},1.0);
-
-                    foo = foo + bar;
-
-                    bar.alloc({2*3,5*7},1.0);
+                    TensorUtils::tensor<float> bar;
 
-                    foo = foo + bar;
+                    bar = foo;
 
                     return 0;
                 }
                 \endcode
             */
-            template<class T2> TensorBase<T>    operator+   (const TensorBase<T2>& rhs);
+            template<class T2> TensorBase<T>&   operator=   (const TensorBase<T2>& rhs);
+
+            //! Assigns the components of the view \p rhs. This tensor gets the shape of \p rhs and is contiguous.
+            template<class T2> TensorBase<T>&   operator=   (const TensorView<T2>& rhs);
 
             /*!
-                Substract the tensor \p rhs. Number of components must match, else \ref ErrorHandler::ShapeMismatch is thrown.
+                Assigns the element-wise expression \p rhs, evaluated in a single pass without temporaries, see \ref operator+.
+                This tensor gets the shape of the left-most operand and may be an operand itself.
                 \code
                 #include "TensorUtils.hpp"
 
@@ -592,20 +854,26 @@ namespace TensorUtils
                     TensorUtils::tensor<long double> foo({2,3,5,7},1.0);
                     TensorUtils::tensor<float> bar({2,3,5,7},1.0);
 
-                    foo -= bar;
+                    foo = foo + bar;
+                    foo = foo*2 - bar/4;
 
                     bar.alloc({2*3,5*7},1.0);
 
-                    foo -= bar;
+                    foo = foo + bar;    // foo keeps its shape
 
                     return 0;
                 }
                 \endcode
             */
-            template<class T2> TensorBase<T>&   operator-=  (const TensorBase<T2>& rhs);
+            template<class E, typename std::enable_if<std::is_base_of<ExpressionBase, E>::value, int>::type = 0>
+            TensorBase<T>&                      operator=   (const E& rhs);
+
+            //! Computes the lazy expression \p rhs into this tensor, see \ref LazyTensor.
+            TensorBase<T>&                      operator=   (const LazyTensor<T>& rhs);
 
             /*!
-                Returns the difference of this tensor \p with rhs. Number of components must match, else \ref ErrorHandler::ShapeMismatch is thrown.
+                Add the tensor \p rhs. If the number of components differs, \p rhs is broadcast to the shape of this tensor
+                without a copy, see \ref TensorView::broadcast. If it can not be broadcast, \ref ErrorHandler::ShapeMismatch is thrown.
                 \code
                 #include "TensorUtils.hpp"
 
@@ -614,54 +882,79 @@ namespace TensorUtils
                     TensorUtils::tensor<long double> foo({2,3,5,7},1.0);
                     TensorUtils::tensor<float> bar({2,3,5,7},1.0);
 
-                    foo = foo - bar;
+                    foo += bar;
 
                     bar.alloc({2*3,5*7},1.0);
 
-                    foo = foo - bar;
+                    foo += bar;
+
+                    bar.alloc({5,1},1.0);
+
+                    foo += bar;     // adds bar(i,0) to all foo(:,:,i,:)
 
                     return 0;
                 }
                 \endcode
             */
-            template<class T2> TensorBase<T>    operator-   (const TensorBase<T2>& rhs);
+            template<class T2> TensorBase<T>&   operator+=  (const TensorBase<T2>& rhs);
 
-            /*!
-                Multiply this tensor with \p rhs.
-                \code
-                #include "TensorUtils.hpp"
+            //! Add the view \p rhs. Components are matched in lexicographical order, see \ref TensorView::assign.
+            template<class T2> TensorBase<T>&   operator+=  (const TensorView<T2>& rhs);
 
-                int main()
-                {
-                    TensorUtils::tensor<long double> foo({2,3,5,7},1.0);
+            //! Add the element-wise expression \p rhs in a single pass. Number of components must match, else \ref ErrorHandler::ShapeMismatch is thrown.
+            template<class E, typename std::enable_if<std::is_base_of<ExpressionBase, E>::value, int>::type = 0>
+            TensorBase<T>&                      operator+=  (const E& rhs);
 
-                    foo *= 2;
+            //! Accumulates the lazy expression \p rhs into this tensor while it is computed, see \ref LazyTensor. Shapes must match, else \ref ErrorHandler::ShapeMismatch is thrown.
+            TensorBase<T>&                      operator+=  (const LazyTensor<T>& rhs);
 
-                    return 0;
-                }
-                \endcode
-            */
-            TensorBase<T>&                      operator*=  (const T& rhs);
+            //! Returns the sum of this tensor with the view \p rhs. Components are matched in lexicographical order, see \ref TensorView::assign.
+            template<class T2> TensorBase<T>    operator+   (const TensorView<T2>& rhs) &;
+
+            //! Adds the view \p rhs to an expiring tensor and returns its storage without a copy.
+            template<class T2> TensorBase<T>    operator+   (const TensorView<T2>& rhs) &&;
 
             /*!
-                Scalar multiplication from the right.
+                Substract the tensor \p rhs. If the number of components differs, \p rhs is broadcast to the shape of this tensor
+                without a copy, see \ref TensorView::broadcast. If it can not be broadcast, \ref ErrorHandler::ShapeMismatch is thrown.
                 \code
                 #include "TensorUtils.hpp"
 
                 int main()
                 {
                     TensorUtils::tensor<long double> foo({2,3,5,7},1.0);
+                    TensorUtils::tensor<float> bar({2,3,5,7},1.0);
 
-                    foo = foo*2;
+                    foo -= bar;
+
+                    bar.alloc({2*3,5*7},1.0);
+
+                    foo -= bar;
 
                     return 0;
                 }
                 \endcode
             */
-            TensorBase<T>                       operator*   (const T& rhs);
+            template<class T2> TensorBase<T>&   operator-=  (const TensorBase<T2>& rhs);
+
+            //! Substract the view \p rhs. Components are matched in lexicographical order, see \ref TensorView::assign.
+            template<class T2> TensorBase<T>&   operator-=  (const TensorView<T2>& rhs);
+
+            //! Substract the element-wise expression \p rhs in a single pass. Number of components must match, else \ref ErrorHandler::ShapeMismatch is thrown.
+            template<class E, typename std::enable_if<std::is_base_of<ExpressionBase, E>::value, int>::type = 0>
+            TensorBase<T>&                      operator-=  (const E& rhs);
+
+            //! Substracts the lazy expression \p rhs from this tensor while it is computed, see \ref LazyTensor. Shapes must match, else \ref ErrorHandler::ShapeMismatch is thrown.
+            TensorBase<T>&                      operator-=  (const LazyTensor<T>& rhs);
+
+            //! Returns the difference of this tensor with the view \p rhs. Components are matched in lexicographical order, see \ref TensorView::assign.
+            template<class T2> TensorBase<T>    operator-   (const TensorView<T2>& rhs) &;
+
+            //! Substracts the view \p rhs from an expiring tensor and returns its storage without a copy.
+            template<class T2> TensorBase<T>    operator-   (const TensorView<T2>& rhs) &&;
 
             /*!
-                Divide this tensor with \p rhs.
+                Multiply this tensor with \p rhs.
                 \code
                 #include "TensorUtils.hpp"
 
@@ -669,16 +962,16 @@ namespace TensorUtils
                 {
                     TensorUtils::tensor<long double> foo({2,3,5,7},1.0);
 
-                    foo /= 2;
+                    foo *= 2;
 
                     return 0;
                 }
                 \endcode
             */
-            TensorBase<T>&                      operator/=  (const T& rhs);
+            TensorBase<T>&                      operator*=  (const T& rhs);
 
             /*!
-                Element-wise division.
+                Divide this tensor with \p rhs.
                 \code
                 #include "TensorUtils.hpp"
 
@@ -686,13 +979,13 @@ namespace TensorUtils
                 {
                     TensorUtils::tensor<long double> foo({2,3,5,7},1.0);
 
-                    foo = foo/2;
+                    foo /= 2;
 
                     return 0;
                 }
                 \endcode
             */
-            TensorBase<T>                       operator/   (const T& rhs);
+            TensorBase<T>&                      operator/=  (const T& rhs);
 
             /*!
                 Initialize this tensor from an array in lexicographical order. No error-handling!
@@ -742,25 +1035,12 @@ namespace TensorUtils
             */
             template<class T2>  T2&             operator>>  (T2& rhs);
 
-            /*!
-                Scalar multiplication from the left.
-                \code
-                #include "TensorUtils.hpp"
-
-                int main()
-                {
-                    TensorUtils::tensor<long double> foo({2,3,5,7},1.0);
-
-                    foo = 2*foo;
-
-                    return 0;
-                }
-                \endcode
-            */
-            friend TensorBase<T> operator* (const T& lhs, TensorBase<T> rhs) { rhs*=lhs; return rhs; };
+            //! Copy of the components in lexicographical order, for interfaces that take std::vector<T> with the default allocator.
+            std::vector<T> to_vector() const;
 
             /*!
-                Assign a sub-tensor this tensor with a sub-tensor of \p rhs. Number of components must match, else \ref ErrorHandler::ShapeMismatch is thrown.
+                Assign a sub-tensor this tensor with a sub-tensor of \p rhs. If the number of components differs, the sub-tensor of \p rhs
+                is broadcast to the sub-tensor of this tensor, see \ref TensorView::broadcast, else \ref ErrorHandler::ShapeMismatch is thrown.
                 \param rhs Second operand.
                 \param at_lhs Indices specifying the sub-tensor of the first operand.
                 \param at_rhs Indices specifying the sub-tensor of the second operand.
@@ -785,8 +1065,15 @@ namespace TensorUtils
                 const std::vector<size_t>   &at_lhs={},
                 const std::vector<size_t>   &at_rhs={});
 
+            //! Same as \ref assign for a strided operand \p rhs. Sub-tensors of \p rhs are selected by \ref TensorView::slice.
+            template<class T2>
+            TensorBase<T>& assign(
+                const TensorView<T2>        &rhs,
+                const std::vector<size_t>   &at_lhs={});
+
             /*!
-                Add a sub-tensor of \p rhs to a sub-tensor of this tensor. Number of components must match, else \ref ErrorHandler::ShapeMismatch is thrown.
+                Add a sub-tensor of \p rhs to a sub-tensor of this tensor. If the number of components differs, the sub-tensor of \p rhs
+                is broadcast, see \ref assign.
                 \param rhs Second operand.
                 \param at_lhs Indices specifying the sub-tensor of the first operand.
                 \param at_rhs Indices specifying the sub-tensor of the second operand.
@@ -801,6 +1088,10 @@ namespace TensorUtils
 
                     foo.add(bar, {1,2}, {5});
 
+                    TensorUtils::tensor<float> bias({7},1.0);
+
+                    foo.add(bias, {1});     // adds bias to all rows of foo({1})
+
                     return 0;
                 }
                 \endcode
@@ -811,8 +1102,15 @@ namespace TensorUtils
                 const std::vector<size_t>   &at_lhs={},
                 const std::vector<size_t>   &at_rhs={});
 
+            //! Same as \ref add for a strided operand \p rhs. Sub-tensors of \p rhs are selected by \ref TensorView::slice.
+            template<class T2>
+            TensorBase<T>& add(
+                const TensorView<T2>        &rhs,
+                const std::vector<size_t>   &at_lhs={});
+
             /*!
-                Substract a sub-tensor of \p rhs from a sub-tensor of this tensor. Number of components must match, else \ref ErrorHandler::ShapeMismatch is thrown.
+                Substract a sub-tensor of \p rhs from a sub-tensor of this tensor. If the number of components differs, the sub-tensor of \p rhs
+                is broadcast, see \ref assign.
                 \param rhs Second operand.
                 \param at_lhs Indices specifying the sub-tensor of the first operand.
                 \param at_rhs Indices specifying the sub-tensor of the second operand.
@@ -837,6 +1135,12 @@ namespace TensorUtils
                 const std::vector<size_t>   &at_lhs={},
                 const std::vector<size_t>   &at_rhs={});
 
+            //! Same as \ref substract for a strided operand \p rhs. Sub-tensors of \p rhs are selected by \ref TensorView::slice.
+            template<class T2>
+            TensorBase<T>& substract(
+                const TensorView<T2>        &rhs,
+                const std::vector<size_t>   &at_lhs={});
+
             /*!
                 Multiply a sub-tensor of this tensor with \p rhs.
                 \param rhs Second operand.
@@ -881,6 +1185,66 @@ namespace TensorUtils
                 const T                     &rhs,
                 const std::vector<size_t>   &at_lhs={});
 
+            /*!
+                Batched form of \ref assign: assigns the sub-tensor of \p rhs at \p at_rhs[n] to the sub-tensor of this tensor
+                at \p at_lhs[n] for all n. \p at_rhs holds as many prefixes as \p at_lhs or a single prefix for all of them.
+                The prefixes of each list must have the same length. Shapes are validated once for the whole batch, which
+                runs as a single kernel that is partitioned across threads. Sub-tensors that appear more than once in
+                \p at_lhs are processed in order, as are all sub-tensors if \p rhs is this tensor and an entry reads a sub-tensor
+                that another entry writes. The number of components must match, else \ref ErrorHandler::ShapeMismatch is thrown.
+                Ranges of leading indices are handled without a list by \ref TensorView::range.
+                \param rhs Second operand.
+                \param at_lhs Prefixes specifying the sub-tensors of the first operand.
+                \param at_rhs Prefixes specifying the sub-tensors of the second operand.
+
+                \code
+                #include "TensorUtils.hpp"
+
+                int main()
+                {
+                    TensorUtils::tensor<double> foo({1000,3,3},0.0);
+                    TensorUtils::tensor<float> bar({3,3},1.0);
+
+                    foo.assign_batch(bar, {{1},{5},{42}}, {{}});         // foo({1}), foo({5}) and foo({42}) are set to bar
+                    foo.add_batch(foo, {{0},{1}}, {{998},{999}});       // foo({0}) += foo({998}), foo({1}) += foo({999})
+                    foo.multiply_batch(2.0, {{1,2},{5,0}});             // scale the rows foo({1,2}) and foo({5,0})
+
+                    foo.view().range(0,10,20).add(foo.view().range(0,20,30));   // foo({n}) += foo({n+10}) for n=10,...,19
+
+                    return 0;
+                }
+                \endcode
+            */
+            template<class T2>
+            TensorBase<T>& assign_batch(
+                const TensorBase<T2>                        &rhs,
+                const std::vector<std::vector<size_t>>      &at_lhs,
+                const std::vector<std::vector<size_t>>      &at_rhs);
+
+            //! Batched form of \ref add, see \ref assign_batch.
+            template<class T2>
+            TensorBase<T>& add_batch(
+                const TensorBase<T2>                        &rhs,
+                const std::vector<std::vector<size_t>>      &at_lhs,
+                const std::vector<std::vector<size_t>>      &at_rhs);
+
+            //! Batched form of \ref substract, see \ref assign_batch.
+            template<class T2>
+            TensorBase<T>& substract_batch(
+                const TensorBase<T2>                        &rhs,
+                const std::vector<std::vector<size_t>>      &at_lhs,
+                const std::vector<std::vector<size_t>>      &at_rhs);
+
+            //! Batched form of \ref multiply: multiplies the sub-tensors at all prefixes \p at_lhs with \p rhs, see \ref assign_batch.
+            TensorBase<T>& multiply_batch(
+                const T                                     &rhs,
+                const std::vector<std::vector<size_t>>      &at_lhs);
+
+            //! Batched form of \ref divide: divides the sub-tensors at all prefixes \p at_lhs by \p rhs, see \ref assign_batch.
+            TensorBase<T>& divide_batch(
+                const T                                     &rhs,
+                const std::vector<std::vector<size_t>>      &at_lhs);
+
             /*!
                 Return the sum of a sub-tensor of this tensor with a sub-tensor of \p rhs.
                 Number of components must match, else \ref ErrorHandler::ShapeMismatch is thrown.
@@ -985,6 +1349,8 @@ namespace TensorUtils
 
             /*!
                 Access a component or the first component of a sub-tensor.
+                All overloads are defined inline, so element loops need no call into the library. The rank and the
+                indices are checked against \ref shape if the debug library is linked, see \ref ErrorHandler::index_checks.
                 \code
                 #include "TensorUtils.hpp"
 
@@ -1008,7 +1374,7 @@ namespace TensorUtils
                         }
                     }
 
-                    // Remember that TensorBase<T> inherits from std::vector<T>
+                    // Remember that TensorBase<T> inherits from std::vector<T, Memory::Allocator<T>>
                     elem=0;
                     for(auto it=foo.begin(); it!=foo.end(); it++)
                     {
@@ -1119,6 +1485,8 @@ namespace TensorUtils
             std::vector<size_t> incr;
 
         protected:
+            //! \private Component at the indices \p idx, see \ref operator()(const std::vector<size_t> &).
+            template<size_t R> T& element(const size_t (&idx)[R]);
             //! \private
             void read_txt_helper(std::string path);
             //! \private
@@ -1133,7 +1501,149 @@ namespace TensorUtils
             template<class BUFFER_TYPE> void write_bin(std::string basename, std::string folder);
             //! \private
             template<class BUFFER_TYPE> void write_txt(std::string oname, std::string folder, int precision);
+            //! \private
+            void read_container(std::string path);
+            //! \private
+            void write_container(std::string oname, std::string folder);
     };
+
+    // Element access and init are defined here instead of src/TensorBase.cpp, such that they can be inlined into the
+    // loops of the application, which only sees an opaque call into the shared library otherwise.
+
+    template<class T>
+    inline void TensorBase<T>::init(const T& val)
+    {
+        T* dst = this->data();
+        if(this->size() < Parallel::threshold())
+        {
+            std::fill(dst, dst+this->size(), val);
+            return;
+        }
+        Parallel::for_range(this->size(), [dst,&val](size_t begin, size_t end)
+        {
+            std::fill(dst+begin, dst+end, val);
+        });
+    }
+
+    template<class T>
+    template<size_t R>
+    inline T& TensorBase<T>::element(const size_t (&idx)[R])
+    {
+        if(ErrorHandler::index_checks && R > shape.size())
+        {
+            throw ErrorHandler::ShapeMismatch("TensorUtils::TensorBase<T>::operator():: Too many indices!");
+        }
+        size_t offset = 0;
+        for(size_t dim=0; dim<R; dim++)
+        {
+            if(ErrorHandler::index_checks && idx[dim] >= shape[dim])
+            {
+                throw std::out_of_range("TensorUtils::TensorBase<T>::operator():: Index out of range!");
+            }
+            offset += idx[dim]*incr[dim];
+        }
+        return this->data()[offset];
+    }
+
+    template<class T>
+    inline T& TensorBase<T>::operator()(const std::vector<size_t> &indices)
+    {
+        if(ErrorHandler::index_checks && indices.empty())
+        {
+            return this->at(0);
+        }
+        if(ErrorHandler::index_checks && indices.size() > shape.size())
+        {
+            throw ErrorHandler::ShapeMismatch("TensorUtils::TensorBase<T>::operator():: Too many indices!");
+        }
+        size_t offset = 0;
+        for(size_t dim=0; dim<indices.size(); dim++)
+        {
+            if(ErrorHandler::index_checks && indices[dim] >= shape[dim])
+            {
+                throw std::out_of_range("TensorUtils::TensorBase<T>::operator():: Index out of range!");
+            }
+            offset += indices[dim]*incr[dim];
+        }
+        return this->data()[offset];
+    }
+
+    template<class T>
+    inline T& TensorBase<T>::operator()(const std::vector<size_t*> &indices)
+    {
+        if(ErrorHandler::index_checks && indices.empty())
+        {
+            return this->at(0);
+        }
+        if(ErrorHandler::index_checks && indices.size() > shape.size())
+        {
+            throw ErrorHandler::ShapeMismatch("TensorUtils::TensorBase<T>::operator():: Too many indices!");
+        }
+        size_t offset = 0;
+        for(size_t dim=0; dim<indices.size(); dim++)
+        {
+            if(ErrorHandler::index_checks && *indices[dim] >= shape[dim])
+            {
+                throw std::out_of_range("TensorUtils::TensorBase<T>::operator():: Index out of range!");
+            }
+            offset += (*indices[dim])*incr[dim];
+        }
+        return this->data()[offset];
+    }
+
+    template<class T>
+    inline T& TensorBase<T>::operator()()
+    {
+        return ErrorHandler::index_checks ? this->at(0) : this->data()[0];
+    }
+
+    template<class T>
+    inline T& TensorBase<T>::operator()(size_t n0)
+    {
+        return element({n0});
+    }
+
+    template<class T>
+    inline T& TensorBase<T>::operator()(size_t n0, size_t n1)
+    {
+        return element({n0, n1});
+    }
+
+    template<class T>
+    inline T& TensorBase<T>::operator()(size_t n0, size_t n1, size_t n2)
+    {
+        return element({n0, n1, n2});
+    }
+
+    template<class T>
+    inline T& TensorBase<T>::operator()(size_t n0, size_t n1, size_t n2, size_t n3)
+    {
+        return element({n0, n1, n2, n3});
+    }
+
+    template<class T>
+    inline T& TensorBase<T>::operator()(size_t n0, size_t n1, size_t n2, size_t n3, size_t n4)
+    {
+        return element({n0, n1, n2, n3, n4});
+    }
+
+    template<class T>
+    inline T& TensorBase<T>::operator()(size_t n0, size_t n1, size_t n2, size_t n3, size_t n4, size_t n5)
+    {
+        return element({n0, n1, n2, n3, n4, n5});
+    }
+
+    template<class T>
+    inline T& TensorBase<T>::operator()(size_t n0, size_t n1, size_t n2, size_t n3, size_t n4, size_t n5, size_t n6)
+    {
+        return element({n0, n1, n2, n3, n4, n5, n6});
+    }
+
+    template<class T>
+    inline T& TensorBase<T>::operator()(size_t n0, size_t n1, size_t n2, size_t n3, size_t n4, size_t n5, size_t n6, size_t n7)
+    {
+        return element({n0, n1, n2, n3, n4, n5, n6, n7});
+    }
 }
 
 
@@ -23,6 +23,10 @@
 #define TENSORDERIVED_HPP
 
 #include "TensorBase.hpp"
+#include "TensorView.hpp"
+
+#include <stdexcept>
+#include <type_traits>
 
 namespace TensorUtils
 {
@@ -73,6 +77,13 @@ namespace TensorUtils
             //! Inherits from \ref TensorBase and throws \ref ErrorHandler::RankMismatch if shape.size()!=N.
             TensorDerived(const std::vector<size_t> shape, const T& val);
 
+            //! Evaluates the element-wise expression \p rhs, see \ref TensorUtils::operator+. Throws \ref ErrorHandler::RankMismatch if rhs.shape().size()!=N.
+            template<class E, typename std::enable_if<std::is_base_of<ExpressionBase, E>::value, int>::type = 0>
+            TensorDerived(const E &rhs);
+
+            //! Computes the lazy expression \p rhs, see \ref LazyTensor. Throws \ref ErrorHandler::RankMismatch if rhs.shape().size()!=N.
+            TensorDerived(const LazyTensor<T> &rhs);
+
             //! Inherits from \ref TensorBase and throws \ref ErrorHandler::RankMismatch if shape.size()!=N.
             void alloc(const std::vector<size_t> shape);
 
@@ -85,8 +96,90 @@ namespace TensorUtils
             //! Calls \ref TensorBase<T>::operator= and returns *this by reference. Throws \ref ErrorHandler::RankMismatch if shape.size()!=N.
             template<class T2> TensorDerived<T,N>& operator= (const TensorBase<T2> &rhs);
 
+            //! Calls \ref TensorBase<T>::operator= and returns *this by reference. Throws \ref ErrorHandler::RankMismatch if rhs.shape.size()!=N.
+            template<class T2> TensorDerived<T,N>& operator= (const TensorView<T2> &rhs);
+
             //! Calls \ref TensorBase<T>::operator= and returns *this by reference. Throws \ref ErrorHandler::RankMismatch if shape.size()!=N.
             TensorDerived<T,N>& operator= (const std::vector<T> &rhs);
+
+            //! Calls \ref TensorBase<T>::operator= and returns *this by reference. Throws \ref ErrorHandler::RankMismatch if rhs.shape().size()!=N.
+            template<class E, typename std::enable_if<std::is_base_of<ExpressionBase, E>::value, int>::type = 0>
+            TensorDerived<T,N>& operator= (const E &rhs);
+
+            //! Calls \ref TensorBase<T>::operator= and returns *this by reference. Throws \ref ErrorHandler::RankMismatch if rhs.shape().size()!=N.
+            TensorDerived<T,N>& operator= (const LazyTensor<T> &rhs);
+
+            /*!
+                Access to components with at most N indices, see \ref TensorBase::operator()(const std::vector<size_t> &).
+                Since the rank is known at compile time, the offset is computed inline and unrolled, too many indices
+                do not compile and no rank check is done at runtime. Indices are only checked against \ref shape
+                if the debug library is linked, see \ref ErrorHandler::index_checks.
+                \code
+                #include "TensorUtils.hpp"
+
+                int main()
+                {
+                    TensorUtils::tensor<double,3> foo({3,3,3});
+
+                    foo(0,1,2) = 1.0;
+                    foo(2) = 2.0;           // first component of the sub-tensor foo(2,:,:)
+                    // foo(0,1,2,3);        // does not compile!
+
+                    return 0;
+                }
+                \endcode
+            */
+            template<class... I, typename std::enable_if<(sizeof...(I) <= N) && (std::is_integral<I>::value && ...), int>::type = 0>
+            T& operator()(I... indices)
+            {
+                const size_t idx[] = {size_t(indices)..., 0};
+                size_t offset = 0;
+                for(size_t dim=0; dim<sizeof...(I); dim++)
+                {
+                    if(ErrorHandler::index_checks && idx[dim] >= this->shape[dim])
+                    {
+                        throw std::out_of_range("TensorUtils::TensorDerived<T,N>::operator():: Index out of range!");
+                    }
+                    offset += idx[dim]*this->incr[dim];
+                }
+                return this->data()[offset];
+            }
+
+            //! See \ref TensorBase::operator()(size_t). Resolves braced single indices, e.g. foo({2}) or foo({}), as for \ref TensorBase.
+            T& operator()(size_t n0) { return TensorBase<T>::operator()(n0); }
+
+            //! See \ref TensorBase::operator()(const std::vector<size_t> &).
+            T& operator()(const std::vector<size_t> &indices) { return TensorBase<T>::operator()(indices); }
+
+            //! See \ref TensorBase::operator()(const std::vector<size_t> &).
+            T& operator()(const std::vector<size_t*> &indices) { return TensorBase<T>::operator()(indices); }
+
+            /*!
+                Same as \ref TensorBase::transpose, but the result keeps the rank N.
+                Tensors of up to \ref SMALL_TRANSPOSE components are permuted by a loop nest of depth N,
+                which avoids the analysis of the general permutation kernel.
+                Throws \ref ErrorHandler::ShapeMismatch if \p axes is not a permutation of (0,1,...,N-1).
+                \code
+                #include "TensorUtils.hpp"
+
+                int main()
+                {
+                    TensorUtils::tensor<double,2> A({3,4});
+                    A.arange();
+
+                    TensorUtils::tensor<double,2> B = A.transpose({1,0}); // B has shape {4,3}
+
+                    return 0;
+                }
+                \endcode
+            */
+            TensorDerived<T,N> transpose(const std::vector<unsigned> &axes) &;
+
+            //! Permutes the indices of an expiring tensor in place and returns its storage without a copy, see \ref TensorBase::transpose_inplace.
+            TensorDerived<T,N> transpose(const std::vector<unsigned> &axes) &&;
+
+            //! Tensors with at most this number of components are transposed by the loop nest of depth N.
+            static constexpr size_t SMALL_TRANSPOSE = 1024;
     };
 
     //! This class specialization defines a tensor with mutable rank and inherits from \ref TensorBase.
@@ -103,11 +196,28 @@ namespace TensorUtils
             //! Constructor is inherited from \ref TensorBase.
             TensorDerived(const std::vector<size_t> shape, const T& val) : TensorBase<T>(shape, val) {};
 
+            //! Evaluates the element-wise expression \p rhs, see \ref TensorUtils::operator+.
+            template<class E, typename std::enable_if<std::is_base_of<ExpressionBase, E>::value, int>::type = 0>
+            TensorDerived(const E &rhs) : TensorBase<T>(rhs) {};
+
+            //! Computes the lazy expression \p rhs, see \ref LazyTensor.
+            TensorDerived(const LazyTensor<T> &rhs);
+
             //! Calls \ref TensorBase<T>::operator= and returns *this by reference.
             template<class T2> TensorDerived<T,-1>& operator= (const TensorBase<T2> &rhs);
 
+            //! Calls \ref TensorBase<T>::operator= and returns *this by reference.
+            template<class T2> TensorDerived<T,-1>& operator= (const TensorView<T2> &rhs);
+
             //! Calls \ref TensorBase<T>::operator= and returns *this by reference.
             TensorDerived<T,-1>& operator= (const std::vector<T> &rhs);
+
+            //! Calls \ref TensorBase<T>::operator= and returns *this by reference.
+            template<class E, typename std::enable_if<std::is_base_of<ExpressionBase, E>::value, int>::type = 0>
+            TensorDerived<T,-1>& operator= (const E &rhs) { TensorBase<T>::operator=(rhs); return *this; };
+
+            //! Calls \ref TensorBase<T>::operator= and returns *this by reference.
+            TensorDerived<T,-1>& operator= (const LazyTensor<T> &rhs);
     };
     /*! @} */
 }
@@ -0,0 +1,274 @@
+/**
+\internal
+    TensorUtils Version 0.1
+
+    Copyright 2022 Christoph Widder
+
+    This file is part of TensorUtils.
+
+    TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+    the GNU General Public License as published by the Free Software Foundation, either
+    version 3 of the License, or (at your option) any later version.
+
+    TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+    without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+    PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along with TensorUtils.
+    If not, see <https://www.gnu.org/licenses/>.
+\endinternal
+**/
+
+#ifndef TENSORSTREAM_HPP
+#define TENSORSTREAM_HPP
+
+#include "TensorBase.hpp"
+#include "TensorView.hpp"
+
+#include <deque>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace TensorUtils
+{
+    namespace BinaryFormat
+    {
+        class ContainerReader;
+        class ContainerWriter;
+    }
+
+    /*!
+        \addtogroup TensorUtils
+        @{
+    */
+
+    //! Reads a binary tensor file slab by slab, see \ref TensorBase::read for the file formats.
+    /*!
+        A slab is the sub-tensor obtained by fixing the first \p leading indices, see \ref TensorBase::slice.
+        Only one slab is held in memory at a time, such that tensors larger than the main memory can be processed.
+        The slabs are read in lexicographical order of the fixed indices by \ref next,
+        or in any order by \ref read with the fixed indices given as \p idx_at.
+        The slab tensor passed by the caller is only reallocated if its shape differs, i.e. it can be reused for all slabs.
+
+        The file extension specifies the format as for \ref TensorBase::read, text files are not supported.
+        Components are converted to T while they are read. Checksums of ".tu" containers are verified
+        for all chunks that are read from their beginning to their end. Compressed ".tuz" containers are decoded
+        chunk by chunk, i.e. only the compressed chunks that overlap the requested slab are read and verified.
+        \code
+        #include "TensorUtils.hpp"
+
+        int main()
+        {
+            using namespace TensorUtils;
+
+            {
+                TensorWriter<double> out("foo.tu", {100,300,400});  // 100 slabs of shape {300,400}
+                tensor<double> slab({300,400});
+                for(size_t n=0; n<out.num_slabs(); n++)
+                {
+                    slab.arange(n);
+                    out.write(slab);
+                }
+                out.close();
+            }
+
+            TensorReader<double> in("foo.tu");
+            tensor<double> slab;
+            tensor<double> sum({300,400}, 0.0);
+            while(in.next(slab))                                    // out-of-core reduction over index 0
+            {
+                sum += slab;
+            }
+
+            in.read(slab, {42});                                    // random access to a single slab
+
+            return 0;
+        }
+        \endcode
+    */
+    template<class T>
+    class TensorReader
+    {
+        public:
+            /*!
+                Opens the file \p path.
+                \param path     Path of a binary file.
+                \param leading  Number of leading indices that are fixed in each slab.
+                Throws \ref ErrorHandler::UnableToOpenFile if the file cannot be opened,
+                \ref ErrorHandler::ShapeMismatch if \p leading exceeds the rank or the header does not match the file,
+                and \ref ErrorHandler::CorruptedFile for an invalid container header.
+            */
+            TensorReader(const std::string &path, unsigned leading=1);
+
+            ~TensorReader();
+
+            //! Shape of the complete tensor in the file.
+            const std::vector<size_t>& shape() const;
+
+            //! Shape of a single slab.
+            std::vector<size_t> slab_shape() const;
+
+            //! Number of slabs.
+            size_t num_slabs() const;
+
+            //! Lexicographical index of the slab that is read by the next call of \ref next.
+            size_t tell() const;
+
+            //! Moves to the slab with the lexicographical index \p n.
+            void seek(size_t n);
+
+            /*!
+                Reads the next slab into \p slab. Returns false if all slabs have been read, \p slab is unchanged in that case.
+                Throws \ref ErrorHandler::CorruptedFile if a checksum does not match.
+            */
+            bool next(TensorBase<T> &slab);
+
+            /*!
+                Reads the slab with the fixed leading indices \p idx_at into \p slab.
+                Throws \ref ErrorHandler::ShapeMismatch if \p idx_at does not address a slab.
+            */
+            void read(TensorBase<T> &slab, const std::vector<size_t> &idx_at);
+
+        private:
+            std::unique_ptr<BinaryFormat::ContainerReader> in;
+            unsigned leading;
+            size_t slab_size;
+            size_t slabs;
+            size_t pos;
+    };
+
+    //! Writes a binary tensor file slab by slab, see \ref TensorReader and \ref TensorBase::write.
+    /*!
+        The shape of the complete tensor is specified in advance. The slabs must be written in lexicographical order
+        of the fixed indices, and \ref close must be called after the last slab to complete the file.
+        Files with the extension ".tu" are containers with the component type T and chunk checksums,
+        ".tuz" are compressed containers of the same type.
+        For the extension based formats, the components are converted to the type specified by the extension.
+    */
+    template<class T>
+    class TensorWriter
+    {
+        public:
+            /*!
+                Creates (or truncates) the file \p path.
+                \param path     Path of a binary file.
+                \param shape    Shape of the complete tensor.
+                \param leading  Number of leading indices that are fixed in each slab.
+                Throws \ref ErrorHandler::UnableToOpenFile if the file cannot be created and
+                \ref ErrorHandler::ShapeMismatch if \p leading exceeds the rank.
+            */
+            TensorWriter(const std::string &path, const std::vector<size_t> &shape, unsigned leading=1);
+
+            //! Closes the file if \ref close was not called. Errors are ignored and the file may be incomplete.
+            ~TensorWriter();
+
+            //! Shape of the complete tensor.
+            const std::vector<size_t>& shape() const;
+
+            //! Shape of a single slab.
+            std::vector<size_t> slab_shape() const;
+
+            //! Number of slabs.
+            size_t num_slabs() const;
+
+            //! Lexicographical index of the slab that is written by the next call of \ref write.
+            size_t tell() const;
+
+            /*!
+                Appends the next slab.
+                Throws \ref ErrorHandler::ShapeMismatch if the shape of \p slab differs from \ref slab_shape
+                or if all slabs have already been written.
+            */
+            void write(const TensorBase<T> &slab);
+
+            //! Appends the next slab from a view, which is copied first unless it is contiguous. See \ref write(const TensorBase<T>&).
+            void write(const TensorView<T> &slab);
+
+            //! Completes the file. Throws \ref ErrorHandler::ShapeMismatch if not all slabs were written.
+            void close();
+
+        private:
+            void write_components(const T* src, const std::vector<size_t> &shape);
+
+            std::unique_ptr<BinaryFormat::ContainerWriter> out;
+            std::vector<size_t> full_shape;
+            unsigned leading;
+            size_t slab_size;
+            size_t slabs;
+            size_t pos;
+    };
+
+    //! Reads a list of files in the background ahead of their use, see \ref TensorBase::read_async.
+    /*!
+        The files are read in the given order by \ref next. Up to \p depth files are read ahead on the background
+        I/O threads, see \ref Parallel::num_io_threads, such that reading the next files overlaps with the processing
+        of the current one. Every file can have its own shape and format as for \ref TensorBase::read.
+        \code
+        #include "TensorUtils.hpp"
+
+        int main()
+        {
+            using namespace TensorUtils;
+
+            TensorPrefetcher<float> files({"batch0.tu", "batch1.tu", "batch2.tu", "batch3.tu"}, 2);
+            tensor<float> batch, sum;
+            while(files.next(batch))        // batch1 and batch2 are read while batch0 is processed
+            {
+                sum = batch.sum({0});
+            }
+
+            return 0;
+        }
+        \endcode
+    */
+    template<class T>
+    class TensorPrefetcher
+    {
+        public:
+            /*!
+                Starts reading the first \p depth files of \p paths in the background.
+                \param paths   Files in the order of \ref next.
+                \param depth   Maximum number of files that are held in memory besides the one returned by \ref next, at least 1.
+            */
+            TensorPrefetcher(const std::vector<std::string> &paths, size_t depth=2);
+
+            //! Waits for the reads that are still running. Their errors are ignored.
+            ~TensorPrefetcher();
+
+            TensorPrefetcher(const TensorPrefetcher&) = delete;
+            TensorPrefetcher& operator=(const TensorPrefetcher&) = delete;
+
+            //! Number of files.
+            size_t size() const;
+
+            //! Index of the file that is returned by the next call of \ref next.
+            size_t tell() const;
+
+            /*!
+                Waits until the next file has been read, moves it into \p tensor and starts reading the file \p depth ahead.
+                Returns false if all files have been returned, \p tensor is unchanged in that case.
+                Rethrows the exceptions of \ref TensorBase::read for this file, the following files can still be read.
+            */
+            bool next(TensorBase<T> &tensor);
+
+        private:
+            struct Pending
+            {
+                std::unique_ptr<TensorBase<T>> tensor;
+                std::future<void> done;
+            };
+
+            void start_next();
+
+            std::vector<std::string> paths;
+            std::deque<Pending> pending;
+            size_t depth;
+            size_t started;
+            size_t pos;
+    };
+    /*! @} */
+}
+
+#endif // TENSORSTREAM_HPP
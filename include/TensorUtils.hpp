@@ -24,6 +24,24 @@
 
 #include "ErrorHandler.hpp"
 #include "TensorDerived.hpp"
+#include "Expression.hpp"
+#include "LazyTensor.hpp"
+#include "TensorView.hpp"
+#include "ContractionPlan.hpp"
+#include "ContractionPath.hpp"
+#include "MappedTensor.hpp"
+#include "TensorStream.hpp"
+#include "Parallel.hpp"
+#include "Memory.hpp"
+#include "Profiler.hpp"
+#include "SmallTensor.hpp"
+#include "SparseTensor.hpp"
+#include "SymmetricTensor.hpp"
+#include "BandedMatrix.hpp"
+#include "Device.hpp"
+#include "DeviceTensor.hpp"
+#include "Distributed.hpp"
+#include "DistributedTensor.hpp"
 
 /*!
     \addtogroup TensorUtils
@@ -76,8 +94,12 @@ namespace TensorUtils
 
     \section intro Introduction
 
-	TensorUtils presents a tensor class which is derived from std::vector<T>.
+	TensorUtils presents a tensor class which is derived from std::vector<T>
+	with an aligned, runtime-selectable allocator (see TensorUtils::Memory).
 	It allows the usage of all std::vector routines, but has its own constructors.
+	Because of the allocator, a tensor does not bind to std::vector<T>&: pass
+	TensorUtils::TensorBase<T>::vector_type, iterators or data() instead, or copy
+	the components with TensorUtils::TensorBase<T>::to_vector.
 	The tensor class allows to allocate, initialize, read and write tensors of
 	floating or integral types up to rank 8. It provides text and binary file
 	formats as well as element-wise operations with support for type conversions
@@ -395,6 +417,14 @@ namespace TensorUtils
             H = H.transpose({3,1,2,0});
             H.reshape({7*3,5*2});
 
+            //  VIEWS: SLICE, TRANSPOSE AND RESHAPE WITHOUT COPIES
+
+            TensorView<float> V = H.view().slice({3});    // view of a row of H, no copy
+            V *= 2;                                     // modifies H
+            tensor<float> K;
+            K = H.view().transpose({1,0});              // materialize a view: K has shape {10,21}
+            K.add(H.view().transpose({1,0}));           // strided operands are accepted as well
+
             //  GENERALIZED TENSOR PRODUCT
 
             tensor<double> X({2,3,5,7},1);
@@ -414,6 +444,18 @@ namespace TensorUtils
 
             Z = X.dot(Y,{3,2,-5,-5},{-5,4,2,1});   // generalized tensor product: Z has shape {11,3,2,5}
 
+            ContractionPlan plan(X.shape,{3,2,-5,-5},Y.shape,{-5,4,2,1}); // analyze the indices only once
+            plan.execute(X,Y,Z);                    // same as above, but reusable and without reallocation of Z
+
+            tensor<double> W({11,3},1);
+            Z = contract({{3,2,-5,-5},{-5,4,2,1},{1,-6}}, X, Y, W); // several operands in the cheapest order
+
+            //  REDUCTIONS AND NORMS
+
+            double s = Y.sum();                     // vectorized pairwise summation, no index analysis
+            Z = Y.max({0,2});                       // largest components along the axes 0 and 2: Z has shape {5,11}
+            double r = Y.norm2();                   // also norm1, norm_inf, mean, min, argmax and argmin
+
             //  TENSORS WITH FIXED RANK AND DISTINGUISHABLE TYPES:
             //      In many situations you might want to keep the types of tensors with different rank distinguishable,
             //      i.e. to overload functions that depend on the rank of its arguments.
@@ -435,6 +477,25 @@ namespace TensorUtils
             }
             E = F; // OK!
 
+            tensor<double,2> M({3,3});
+            M(1,2) = 1.0;                       // offset is computed inline for fixed ranks
+            tensor<double,2> Mt = M.transpose({1,0}); // the rank is kept
+
+            //  SMALL TENSORS:
+            //      Tensors with a few components, e.g. 3x3 matrices per particle, can keep their components,
+            //      shape and strides inline. They never allocate memory and work with dot, contract and expressions.
+
+            SmallTensor<double,16> S({3,3}, 1.0);    // at most 16 components and rank 4
+            SmallTensor<double,16> SS = S.dot(S, {1,-1}, {-1,2}) + S*2.0;
+
+            //  SPARSE TENSORS:
+            //      Tensors that are mostly zero store only their non-zero components. Products and contractions take
+            //      the same index labels and cost time proportional to the number of stored components.
+
+            SparseTensor<double> P({100,100,100});
+            P.insert({1,2,3}, 1.0);
+            tensor<double> PM = P.dot(tensor<double>({100,7}, 1.0), {1,2,-1}, {-1,3}); // PM has shape {100,100,7}
+
             //  ERROR HANDLING (see TensorUtils::ErrorHandling for more)
             //      Most error handling is enabled only for the debug-library libtensor_utilsd.so
             //      This will enable you to trace down any occurrence of invalid indices or shape mismatches.
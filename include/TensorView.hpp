@@ -0,0 +1,235 @@
+/**
+\internal
+    TensorUtils Version 0.1
+
+    Copyright 2022 Christoph Widder
+
+    This file is part of TensorUtils.
+
+    TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+    the GNU General Public License as published by the Free Software Foundation, either
+    version 3 of the License, or (at your option) any later version.
+
+    TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+    without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+    PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along with TensorUtils.
+    If not, see <https://www.gnu.org/licenses/>.
+\endinternal
+**/
+
+#ifndef TENSORVIEW_HPP
+#define TENSORVIEW_HPP
+
+#include "TensorBase.hpp"
+
+#include <vector>
+
+namespace TensorUtils
+{
+    /*!
+        \addtogroup TensorUtils
+        @{
+    */
+
+    //! Non-owning strided view into the components of a \ref TensorBase or of any other memory.
+    /*!
+        A view consists of a pointer to its first component, a \ref shape and the strides \ref incr.
+        Slicing, permuting indices, reshaping contiguous views and taking sub-ranges only change
+        this metadata and never copy components. Any operation that writes to a view writes to
+        the memory it points to. The view must not outlive that memory, and it is invalidated
+        if the underlying tensor is reallocated, e.g. by \ref TensorBase::alloc.
+
+        Copying or assigning a view copies the metadata. Use \ref assign to copy components into a view
+        and \ref copy to materialize a view as a contiguous tensor.
+        \code
+        #include "TensorUtils.hpp"
+
+        int main()
+        {
+            using namespace TensorUtils;
+
+            tensor<double> X({2,3,5,7});
+            X.arange();
+
+            TensorView<double> V = X.view();
+
+            TensorView<double> S = V.slice({1,2});              // shape {5,7}, no copy
+            TensorView<double> P = V.transpose({0,2,1,3});      // shape {2,5,3,7}, no copy
+            TensorView<double> R = V.reshape({6,35});           // shape {6,35}, no copy
+            TensorView<double> Q = V.range(3, 2, 5);            // shape {2,3,5,3}, no copy
+
+            S *= 2;                                             // scales X({1,2}) in place
+
+            tensor<double> Y({7,5},1);
+            tensor<double> Z;
+            Z = S.dot(Y.view(), {1,-1}, {-1,2});                // matrix product of a sub-matrix of X with Y
+            Z = X.dot(P, {-1,-2,-3,-4}, {-1,-3,-2,-4});         // strided operands are accepted by TensorBase as well
+
+            X.view().slice({0,0}).assign(Y.view().transpose({1,0}));    // copy components into a part of X
+
+            tensor<double> W;
+            W = P;                                              // materialize: W has shape {2,5,3,7}
+
+            return 0;
+        }
+        \endcode
+    */
+    template<class T>
+    class TensorView
+    {
+        public:
+            //! Empty view of a scalar that points to nothing.
+            TensorView();
+
+            //! View of all components of \p tensor.
+            TensorView(TensorBase<T> &tensor);
+
+            //! View of arbitrary memory with the given shape and strides.
+            TensorView(T* data, const std::vector<size_t> &shape, const std::vector<size_t> &incr);
+
+            //! Pointer to the first component.
+            T* data() const;
+
+            //! Number of components.
+            size_t size() const;
+
+            //! True if the components are stored contiguously in lexicographical order.
+            bool contiguous() const;
+
+            /*!
+                View of the sub-tensor addressed by \p idx_at. See \ref TensorBase::slice.
+                Throws \ref ErrorHandler::ShapeMismatch if there are more indices than the rank.
+            */
+            TensorView<T> slice(const std::vector<size_t> &idx_at) const;
+
+            /*!
+                View with permuted indices. See \ref TensorBase::transpose.
+                Throws \ref ErrorHandler::ShapeMismatch if \p axes is not a permutation of (0,1,...,N-1).
+            */
+            TensorView<T> transpose(const std::vector<unsigned> &axes) const;
+
+            /*!
+                View with a different shape of the same components in lexicographical order. See \ref TensorBase::reshape.
+                Throws \ref ErrorHandler::ShapeMismatch if the view is not \ref contiguous or the number of components differs.
+            */
+            TensorView<T> reshape(const std::vector<size_t> &shape) const;
+
+            /*!
+                View of the components with indices begin,...,end-1 along \p axis.
+                Throws \ref ErrorHandler::ShapeMismatch if \p axis or the range is invalid.
+            */
+            TensorView<T> range(unsigned axis, size_t begin, size_t end) const;
+
+            /*!
+                View of the components repeated to \p shape without a copy, following the broadcasting rules of NumPy:
+                the indices are aligned at the last index, and missing leading indices and indices of extent 1 are
+                repeated with stride 0. Throws \ref ErrorHandler::ShapeMismatch if the shape is not \ref broadcastable.
+                Components of a broadcast view must not be written, since every component appears more than once.
+                \code
+                #include "TensorUtils.hpp"
+
+                int main()
+                {
+                    using namespace TensorUtils;
+
+                    tensor<double> X({4,3}, 1.0);
+                    tensor<double> bias({3});
+                    bias.arange();
+
+                    TensorView<double> B = bias.view().broadcast({4,3}); // shape {4,3} with strides {0,1}
+
+                    X += bias;                                          // adds bias to every row, same as X += B
+                    X.view().substract(tensor<double>({4,1}, 0.5).view()); // substracts 0.5 from every column
+
+                    return 0;
+                }
+                \endcode
+            */
+            TensorView<T> broadcast(const std::vector<size_t> &shape) const;
+
+            //! True if this view can be broadcast to \p shape, see \ref broadcast.
+            bool broadcastable(const std::vector<size_t> &shape) const;
+
+            //! Returns a contiguous copy of the components.
+            TensorBase<T> copy() const;
+
+            /*!
+                Generalized tensor product of two views. See \ref TensorBase::dot.
+                The operands are accessed in place with their strides.
+            */
+            template<class T2>
+            TensorBase<T> dot(
+                const TensorView<T2>        &rhs,
+                const std::vector<int>      &idx_lhs,
+                const std::vector<int>      &idx_rhs,
+                const std::vector<size_t>   &idx_at={}) const;
+
+            //! Contraction of this view. See \ref TensorBase::contract.
+            TensorBase<T> contract(const std::vector<int> &idx_lhs, const std::vector<size_t> &idx_at={}) const;
+
+            /*!
+                Copies the components of \p rhs into this view.
+                If the shapes differ, but the number of components is the same, the components are matched in
+                lexicographical order, which requires that at least one of the operands is \ref contiguous.
+                If the number of components differs, \p rhs is broadcast to the shape of this view, see \ref broadcast.
+                Otherwise \ref ErrorHandler::ShapeMismatch is thrown.
+                If \p rhs overlaps this view, e.g. X.view().assign(X.view().transpose({1,0})), it is copied first.
+            */
+            template<class T2> TensorView<T>& assign(const TensorView<T2> &rhs);
+
+            //! Adds the components of \p rhs to this view. See \ref assign.
+            template<class T2> TensorView<T>& add(const TensorView<T2> &rhs);
+
+            //! Substracts the components of \p rhs from this view. See \ref assign.
+            template<class T2> TensorView<T>& substract(const TensorView<T2> &rhs);
+
+            //! Same as \ref add.
+            template<class T2> TensorView<T>& operator+= (const TensorView<T2> &rhs);
+
+            //! Same as \ref substract.
+            template<class T2> TensorView<T>& operator-= (const TensorView<T2> &rhs);
+
+            //! Multiplies all components of this view with \p rhs.
+            TensorView<T>& operator*= (const T &rhs);
+
+            //! Divides all components of this view by \p rhs.
+            TensorView<T>& operator/= (const T &rhs);
+
+            //! Access a component. See \ref TensorBase::operator()(const std::vector<size_t>&).
+            T& operator()(const std::vector<size_t> &indices) const;
+
+            //! Range of all indices, see \ref TensorBase::shape.
+            std::vector<size_t> shape;
+
+            //! Strides of all indices, i.e. the distance in memory between neighbouring components, see \ref TensorBase::incr.
+            std::vector<size_t> incr;
+
+        private:
+            T* ptr;
+    };
+
+    // defined inline like TensorBase::operator(), see TensorBase.hpp
+    template<class T>
+    inline T& TensorView<T>::operator()(const std::vector<size_t> &indices) const
+    {
+        if(ErrorHandler::index_checks && indices.size() > shape.size())
+        {
+            throw ErrorHandler::ShapeMismatch("TensorUtils::TensorView<T>::operator():: Too many indices!");
+        }
+        size_t offset = 0;
+        for(size_t dim=0; dim<indices.size(); dim++)
+        {
+            if(ErrorHandler::index_checks && indices[dim] >= shape[dim])
+            {
+                throw std::out_of_range("TensorUtils::TensorView<T>::operator():: Index out of range!");
+            }
+            offset += indices[dim]*incr[dim];
+        }
+        return ptr[offset];
+    }
+    /*! @} */
+}
+
+#endif // TENSORVIEW_HPP
@@ -0,0 +1,334 @@
+/*
+TensorUtils Version 0.1
+
+Copyright 2022 Christoph Widder
+
+This file is part of TensorUtils.
+
+TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+the GNU General Public License as published by the Free Software Foundation, either
+version 3 of the License, or (at your option) any later version.
+
+TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with TensorUtils.
+If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef THROW_EXCEPTIONS
+#define THROW_EXCEPTIONS 0
+#endif // THROW_EXCEPTIONS
+
+#ifndef THROW_BASIC_EXCEPTIONS
+#define THROW_BASIC_EXCEPTIONS 1
+#endif // THROW_BASIC_EXCEPTIONS
+
+#include "BandedMatrix.hpp"
+#include "ContractionPlan.hpp"
+#include "ErrorHandler.hpp"
+#include "StridedLoop.hpp"
+#include "ThreadPool.hpp"
+#include "Profile.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+using namespace TensorUtils;
+using namespace ErrorHandler;
+
+/**
+    CONSTRUCTOR AND ALLOCATION
+**/
+
+template<class T>
+BandedMatrix<T>::BandedMatrix()
+{
+    alloc(vector<size_t>{0,0}, 0, 0);
+}
+
+template<class T>
+BandedMatrix<T>::BandedMatrix(const vector<size_t> &shape, size_t lower, size_t upper)
+{
+    alloc(shape, lower, upper);
+}
+
+template<class T>
+BandedMatrix<T>::BandedMatrix(initializer_list<size_t> shape, size_t lower, size_t upper)
+{
+    alloc(vector<size_t>(shape), lower, upper);
+}
+
+template<class T>
+BandedMatrix<T>::BandedMatrix(const TensorBase<T> &dense, size_t lower, size_t upper)
+{
+    alloc(dense.shape, lower, upper);
+    const size_t width = lo+up+1;
+    for(size_t i=0; i<shape[0]; i++)
+    {
+        for(size_t j=(i > lo ? i-lo : 0); j<min(shape[1], i+up+1); j++)
+        {
+            vals[i*width + j+lo-i] = dense[i*dense.incr[0] + j];
+        }
+    }
+}
+
+template<class T>
+BandedMatrix<T> BandedMatrix<T>::diagonal(const TensorBase<T> &diag)
+{
+    if(THROW_BASIC_EXCEPTIONS && diag.shape.size() != 1)
+    {
+        throw ShapeMismatch("TensorUtils::BandedMatrix<T>::diagonal:: The diagonal must have one index!");
+    }
+    BandedMatrix<T> result({diag.size(), diag.size()}, 0, 0);
+    copy(diag.begin(), diag.end(), result.vals.begin());
+    return result;
+}
+
+template<class T>
+void BandedMatrix<T>::alloc(const vector<size_t> &shape, size_t lower, size_t upper)
+{
+    if(THROW_BASIC_EXCEPTIONS && shape.size() != 2)
+    {
+        throw ShapeMismatch("TensorUtils::BandedMatrix<T>::alloc:: A matrix must have two indices!");
+    }
+    this->shape = shape;
+    lo = lower;
+    up = upper;
+    vals.assign(shape[0]*(lo+up+1), T(0));
+}
+
+/**
+    ACCESS
+**/
+
+template<class T>
+size_t BandedMatrix<T>::lower() const
+{
+    return lo;
+}
+
+template<class T>
+size_t BandedMatrix<T>::upper() const
+{
+    return up;
+}
+
+template<class T>
+size_t BandedMatrix<T>::stored() const
+{
+    return vals.size();
+}
+
+template<class T>
+T BandedMatrix<T>::operator()(size_t row, size_t col) const
+{
+    if(THROW_EXCEPTIONS && (row >= shape[0] || col >= shape[1]))
+    {
+        throw out_of_range("TensorUtils::BandedMatrix<T>::operator():: Index out of range!");
+    }
+    if(row > col+lo || col > row+up)
+    {
+        return T(0);
+    }
+    return vals[row*(lo+up+1) + col+lo-row];
+}
+
+template<class T>
+void BandedMatrix<T>::set(size_t row, size_t col, const T &val)
+{
+    if(THROW_BASIC_EXCEPTIONS && (row >= shape[0] || col >= shape[1] || row > col+lo || col > row+up))
+    {
+        throw out_of_range("TensorUtils::BandedMatrix<T>::set:: Component outside of the band!");
+    }
+    vals[row*(lo+up+1) + col+lo-row] = val;
+}
+
+template<class T>
+vector<T>& BandedMatrix<T>::values()
+{
+    return vals;
+}
+
+template<class T>
+const vector<T>& BandedMatrix<T>::values() const
+{
+    return vals;
+}
+
+template<class T>
+TensorBase<T> BandedMatrix<T>::dense() const
+{
+    TensorBase<T> result(shape, T(0));
+    const size_t width = lo+up+1;
+    for(size_t i=0; i<shape[0]; i++)
+    {
+        for(size_t j=(i > lo ? i-lo : 0); j<min(shape[1], i+up+1); j++)
+        {
+            result[i*shape[1] + j] = vals[i*width + j+lo-i];
+        }
+    }
+    return result;
+}
+
+/**
+    PRODUCTS
+**/
+
+template<class T>
+void BandedMatrix<T>::multiply(const TensorBase<T>* rhs, const vector<int> &idx_lhs, const vector<int> &idx_rhs, TensorBase<T> &result) const
+{
+    // strides of every label in the result and in rhs, the result has the non-negative labels in increasing order
+    vector<int> labels;
+    for(int label : idx_lhs)    if(label >= 0) labels.push_back(label);
+    for(int label : idx_rhs)    if(label >= 0) labels.push_back(label);
+    sort(labels.begin(), labels.end());
+    labels.erase(unique(labels.begin(), labels.end()), labels.end());
+    auto result_stride = [&](int label)
+    {
+        return label < 0 ? size_t(0) : result.incr[lower_bound(labels.begin(), labels.end(), label) - labels.begin()];
+    };
+    auto rhs_stride = [&](int label)
+    {
+        size_t stride = 0;
+        for(size_t d=0; d<idx_rhs.size(); d++)
+        {
+            stride += (idx_rhs[d] == label) ? rhs->incr[d] : 0;
+        }
+        return stride;
+    };
+
+    // the labels of the matrix are fixed by every stored component, the other labels of rhs are looped over
+    const bool diag = (idx_lhs[0] == idx_lhs[1]);
+    const size_t res_row = result_stride(idx_lhs[0]), res_col = diag ? 0 : result_stride(idx_lhs[1]);
+    size_t rhs_row = 0, rhs_col = 0;
+    Kernels::StridedLoop<2> loop;
+    if(rhs)
+    {
+        rhs_row = rhs_stride(idx_lhs[0]);
+        rhs_col = diag ? 0 : rhs_stride(idx_lhs[1]);
+        vector<int> looped;
+        for(size_t d=0; d<idx_rhs.size(); d++)
+        {
+            const int label = idx_rhs[d];
+            if(label != idx_lhs[0] && label != idx_lhs[1] && find(looped.begin(), looped.end(), label) == looped.end())
+            {
+                looped.push_back(label);
+                loop.push_back(rhs->shape[d], {result_stride(label), rhs_stride(label)});
+            }
+        }
+        loop.merge();
+        if(loop.size() == 0)
+        {
+            return;
+        }
+    }
+
+    T* C = result.data();
+    const T* B = rhs ? rhs->data() : nullptr;
+    const size_t width = lo+up+1;
+    auto rows = [&](size_t begin, size_t end)
+    {
+        T v = T(0);
+        auto kernel = [&](const Kernels::StridedLoop<2>::Offsets &off, size_t n, const Kernels::StridedLoop<2>::Offsets &stride)
+        {
+            T* c = C+off[0];
+            const T* b = B+off[1];
+            const T s = v; // local copy, c may alias v
+            if(stride[0] == 1 && stride[1] == 1)
+            {
+                for(size_t k=0; k<n; k++)
+                {
+                    c[k] += s*b[k];
+                }
+            }
+            else
+            {
+                for(size_t k=0; k<n; k++)
+                {
+                    c[k*stride[0]] += s*b[k*stride[1]];
+                }
+            }
+        };
+        for(size_t i=begin; i<end; i++)
+        {
+            for(size_t j=(i > lo ? i-lo : 0); j<min(shape[1], i+up+1); j++)
+            {
+                v = vals[i*width + j+lo-i];
+                if(v == T(0) || (diag && i != j))
+                {
+                    continue;
+                }
+                if(rhs)
+                {
+                    loop.run({i*res_row + j*res_col, i*rhs_row + j*rhs_col}, kernel);
+                }
+                else
+                {
+                    C[i*res_row + j*res_col] += v;
+                }
+            }
+        }
+    };
+
+    // rows write to different parts of the result unless the row index is summed over
+    if(res_row != 0)
+    {
+        Parallel::parallel_for(shape[0], rows, width*loop.size());
+    }
+    else
+    {
+        rows(0, shape[0]);
+    }
+}
+
+template<class T>
+TensorBase<T> BandedMatrix<T>::dot(const TensorBase<T> &rhs, const vector<int> &idx_lhs, const vector<int> &idx_rhs) const
+{
+    PROFILE_SCOPE("BandedMatrix::dot");
+    const ContractionPlan plan(shape, idx_lhs, rhs.shape, idx_rhs);
+    TensorBase<T> result(plan.shape(), T(0));
+    multiply(&rhs, idx_lhs, idx_rhs, result);
+    return result;
+}
+
+template<class T>
+TensorBase<T> BandedMatrix<T>::contract(const vector<int> &idx_lhs) const
+{
+    PROFILE_SCOPE("BandedMatrix::contract");
+    const ContractionPlan plan(shape, idx_lhs);
+    TensorBase<T> result(plan.shape(), T(0));
+    multiply(nullptr, idx_lhs, {}, result);
+    return result;
+}
+
+/**
+    EXPLICIT TEMPLATE INSTANTIATION
+**/
+
+namespace TensorUtils
+{
+    #ifndef ENABLE_INTEGRAL_TYPES
+    #define ENABLE_INTEGRAL_TYPES 1
+    #endif // ENABLE_INTEGRAL_TYPES
+
+    template class BandedMatrix<double>;
+    template class BandedMatrix<float>;
+    template class BandedMatrix<long double>;
+
+    #if ENABLE_INTEGRAL_TYPES == 1
+        template class BandedMatrix<unsigned char>;
+        template class BandedMatrix<signed char>;
+        template class BandedMatrix<unsigned short>;
+        template class BandedMatrix<short>;
+        template class BandedMatrix<unsigned>;
+        template class BandedMatrix<int>;
+        template class BandedMatrix<unsigned long>;
+        template class BandedMatrix<long>;
+        template class BandedMatrix<unsigned long long>;
+        template class BandedMatrix<long long>;
+    #endif
+}
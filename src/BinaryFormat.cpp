@@ -0,0 +1,983 @@
+/*
+TensorUtils Version 0.1
+
+Copyright 2022 Christoph Widder
+
+This file is part of TensorUtils.
+
+TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+the GNU General Public License as published by the Free Software Foundation, either
+version 3 of the License, or (at your option) any later version.
+
+TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with TensorUtils.
+If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include "BinaryFormat.hpp"
+#include "ErrorHandler.hpp"
+#include "Compression.hpp"
+#include "Simd.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+
+using namespace std;
+using namespace TensorUtils;
+using namespace TensorUtils::BinaryFormat;
+using namespace ErrorHandler;
+
+/**
+    COMPONENT TYPES
+**/
+
+size_t BinaryFormat::dtype_size(DType d)
+{
+    switch(d)
+    {
+        case DType::FLOAT32:    return sizeof(float);
+        case DType::FLOAT64:    return sizeof(double);
+        case DType::FLOAT80:    return sizeof(long double);
+        case DType::UINT8:      return 1;
+        case DType::INT8:       return 1;
+        case DType::UINT16:     return 2;
+        case DType::INT16:      return 2;
+        case DType::UINT32:     return 4;
+        case DType::INT32:      return 4;
+        case DType::UINT64:     return 8;
+        case DType::INT64:      return 8;
+        case DType::NONE:       return 0;
+    }
+    return 0;
+}
+
+DType BinaryFormat::extension_dtype(const string &extension)
+{
+    if(extension == ".f32")     {return dtype<float>();}
+    if(extension == ".f64")     {return dtype<double>();}
+    if(extension == ".f80")     {return dtype<long double>();}
+    if(extension == ".uc")      {return dtype<unsigned char>();}
+    if(extension == ".sc")      {return dtype<signed char>();}
+    if(extension == ".us")      {return dtype<unsigned short>();}
+    if(extension == ".s")       {return dtype<short>();}
+    if(extension == ".u")       {return dtype<unsigned>();}
+    if(extension == ".int")     {return dtype<int>();}
+    if(extension == ".ul")      {return dtype<unsigned long>();}
+    if(extension == ".l")       {return dtype<long>();}
+    if(extension == ".ull")     {return dtype<unsigned long long>();}
+    if(extension == ".ll")      {return dtype<long long>();}
+    return DType::NONE;
+}
+
+// calls f with a null pointer of the C++ type that corresponds to d
+template<class F>
+static void dispatch(DType d, F f)
+{
+    switch(d)
+    {
+        case DType::FLOAT32:    f((float*)nullptr); break;
+        case DType::FLOAT64:    f((double*)nullptr); break;
+        case DType::FLOAT80:    f((long double*)nullptr); break;
+        case DType::UINT8:      f((uint8_t*)nullptr); break;
+        case DType::INT8:       f((int8_t*)nullptr); break;
+        case DType::UINT16:     f((uint16_t*)nullptr); break;
+        case DType::INT16:      f((int16_t*)nullptr); break;
+        case DType::UINT32:     f((uint32_t*)nullptr); break;
+        case DType::INT32:      f((int32_t*)nullptr); break;
+        case DType::UINT64:     f((uint64_t*)nullptr); break;
+        case DType::INT64:      f((int64_t*)nullptr); break;
+        case DType::NONE:       break;
+    }
+}
+
+static void swap_bytes(char* data, size_t n, size_t elem_size)
+{
+    for(size_t i=0; i<n; i++)
+    {
+        reverse(data+i*elem_size, data+(i+1)*elem_size);
+    }
+}
+
+/**
+    CRC-32C
+**/
+
+// slicing-by-8 lookup tables of the reflected Castagnoli polynomial
+static const uint32_t (&crc_tables())[8][256]
+{
+    static uint32_t table[8][256];
+    static bool initialized = [](){
+        for(uint32_t n=0; n<256; n++)
+        {
+            uint32_t c = n;
+            for(int k=0; k<8; k++)
+            {
+                c = (c & 1) ? (c >> 1) ^ 0x82F63B78u : (c >> 1);
+            }
+            table[0][n] = c;
+        }
+        for(uint32_t n=0; n<256; n++)
+        {
+            for(int k=1; k<8; k++)
+            {
+                table[k][n] = (table[k-1][n] >> 8) ^ table[0][table[k-1][n] & 0xFF];
+            }
+        }
+        return true;
+    }();
+    (void)initialized;
+    return table;
+}
+
+uint32_t BinaryFormat::crc32c(const void* data, size_t n, uint32_t crc)
+{
+    const uint32_t (&T)[8][256] = crc_tables();
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    crc = ~crc;
+    for(; n>=8; n-=8, p+=8)
+    {
+        const uint32_t lo = (uint32_t(p[0]) | uint32_t(p[1])<<8 | uint32_t(p[2])<<16 | uint32_t(p[3])<<24) ^ crc;
+        crc =   T[7][lo & 0xFF] ^ T[6][(lo >> 8) & 0xFF] ^ T[5][(lo >> 16) & 0xFF] ^ T[4][lo >> 24] ^
+                T[3][p[4]] ^ T[2][p[5]] ^ T[1][p[6]] ^ T[0][p[7]];
+    }
+    for(; n>0; n--, p++)
+    {
+        crc = (crc >> 8) ^ T[0][(crc ^ *p) & 0xFF];
+    }
+    return ~crc;
+}
+
+/**
+    HEADER
+**/
+
+template<class U>
+static void put(char* block, size_t offset, U value)
+{
+    memcpy(block+offset, &value, sizeof(U));
+}
+
+template<class U>
+static U get(const char* block, size_t offset, bool swap)
+{
+    U value;
+    memcpy(&value, block+offset, sizeof(U));
+    if(swap)
+    {
+        swap_bytes(reinterpret_cast<char*>(&value), 1, sizeof(U));
+    }
+    return value;
+}
+
+bool BinaryFormat::is_container(const string &path)
+{
+    ifstream in(path, ios::in | ios::binary);
+    char magic[sizeof(MAGIC)];
+    in.read(magic, sizeof(MAGIC));
+    return in.gcount() == sizeof(MAGIC) && memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+ContainerHeader BinaryFormat::make_header(DType d, const vector<size_t> &shape, size_t chunk_size)
+{
+    if(shape.size() > MAX_RANK)
+    {
+        throw ShapeMismatch("TensorUtils::BinaryFormat::make_header:: Rank exceeds the maximum rank of the container format!");
+    }
+    ContainerHeader H;
+    H.little_endian = little_endian();
+    H.dtype = d;
+    H.elem_size = dtype_size(d);
+    H.shape = shape;
+    H.count = count(shape);
+    H.payload_offset = HEADER_SIZE;
+    if(chunk_size)
+    {
+        H.flags |= FLAG_CHUNK_CRC;
+        H.chunk_size = chunk_size;
+        H.crc_offset = H.payload_offset + H.payload_size();
+    }
+    return H;
+}
+
+ContainerHeader BinaryFormat::make_sparse_header(DType d, const vector<size_t> &shape, size_t nnz, size_t chunk_size)
+{
+    ContainerHeader H = make_header(d, shape, 0);
+    H.flags |= FLAG_SPARSE;
+    H.count = nnz;
+    if(chunk_size)
+    {
+        H.flags |= FLAG_CHUNK_CRC;
+        H.chunk_size = chunk_size;
+        H.crc_offset = H.index_offset() + H.index_size();
+    }
+    return H;
+}
+
+ContainerHeader BinaryFormat::make_compressed_header(DType d, const vector<size_t> &shape, size_t chunk_size, Codec codec)
+{
+    ContainerHeader H = make_header(d, shape, max<size_t>(chunk_size, 1));
+    H.version = VERSION_COMPRESSED;
+    H.flags |= FLAG_COMPRESSED;
+    H.codec = codec;
+    H.filter = H.elem_size > 1 ? Filter::SHUFFLE : Filter::NONE;
+    H.crc_offset = 0; // known after all chunks were written
+    return H;
+}
+
+ContainerHeader BinaryFormat::make_legacy_header(DType d, const vector<size_t> &shape)
+{
+    ContainerHeader H;
+    H.legacy = true;
+    H.little_endian = little_endian();
+    H.dtype = d;
+    H.elem_size = dtype_size(d);
+    H.shape = shape;
+    H.count = count(shape);
+    H.payload_offset = payload_offset(shape.size());
+    return H;
+}
+
+void BinaryFormat::encode_header(const ContainerHeader &H, char* block)
+{
+    memset(block, 0, HEADER_SIZE);
+    memcpy(block, MAGIC, sizeof(MAGIC));
+    block[8] = H.little_endian ? 1 : 2;
+    block[9] = static_cast<char>(H.codec);
+    block[10] = static_cast<char>(H.filter);
+    put<uint32_t>(block, 12, H.version);
+    put<uint32_t>(block, 16, static_cast<uint32_t>(H.dtype));
+    put<uint32_t>(block, 20, H.elem_size);
+    put<uint32_t>(block, 24, H.flags);
+    put<uint32_t>(block, 28, H.shape.size());
+    put<uint64_t>(block, 32, H.count);
+    put<uint64_t>(block, 40, H.payload_offset);
+    put<uint64_t>(block, 48, H.chunk_size);
+    put<uint64_t>(block, 56, H.crc_offset);
+    for(unsigned n=0; n<H.shape.size(); n++)
+    {
+        put<uint64_t>(block, SHAPE_OFFSET+n*sizeof(uint64_t), H.shape[n]);
+    }
+    put<uint32_t>(block, HEADER_SIZE-sizeof(uint32_t), crc32c(block, HEADER_SIZE-sizeof(uint32_t)));
+}
+
+ContainerHeader BinaryFormat::decode_header(const char* block, const string &path)
+{
+    const string err_file = " in file \"" + path + "\".";
+    if(memcmp(block, MAGIC, sizeof(MAGIC)) != 0 || (block[8] != 1 && block[8] != 2))
+    {
+        throw CorruptedFile("TensorUtils::BinaryFormat::decode_header:: Invalid magic number" + err_file);
+    }
+    ContainerHeader H;
+    H.little_endian = (block[8] == 1);
+    const bool swap = (H.little_endian != little_endian());
+
+    if(get<uint32_t>(block, HEADER_SIZE-sizeof(uint32_t), swap) != crc32c(block, HEADER_SIZE-sizeof(uint32_t)))
+    {
+        throw CorruptedFile("TensorUtils::BinaryFormat::decode_header:: Header checksum mismatch" + err_file);
+    }
+    H.version = get<uint32_t>(block, 12, swap);
+    if(H.version > VERSION_COMPRESSED)
+    {
+        throw CorruptedFile("TensorUtils::BinaryFormat::decode_header:: Unsupported version" + err_file);
+    }
+    H.dtype = static_cast<DType>(get<uint32_t>(block, 16, swap));
+    H.elem_size = get<uint32_t>(block, 20, swap);
+    if(dtype_size(H.dtype) == 0 || dtype_size(H.dtype) != H.elem_size)
+    {
+        throw CorruptedFile("TensorUtils::BinaryFormat::decode_header:: Unsupported component type" + err_file);
+    }
+    H.flags = get<uint32_t>(block, 24, swap);
+    H.codec = static_cast<Codec>(block[9]);
+    H.filter = static_cast<Filter>(block[10]);
+    if(H.compressed() && (H.sparse() || !(H.flags & FLAG_CHUNK_CRC) || H.codec != Codec::LZ4 ||
+                          (H.filter != Filter::NONE && H.filter != Filter::SHUFFLE)))
+    {
+        throw CorruptedFile("TensorUtils::BinaryFormat::decode_header:: Unsupported compression" + err_file);
+    }
+    const uint32_t rank = get<uint32_t>(block, 28, swap);
+    if(rank > MAX_RANK)
+    {
+        throw CorruptedFile("TensorUtils::BinaryFormat::decode_header:: Invalid rank" + err_file);
+    }
+    H.count = get<uint64_t>(block, 32, swap);
+    H.payload_offset = get<uint64_t>(block, 40, swap);
+    H.chunk_size = get<uint64_t>(block, 48, swap);
+    H.crc_offset = get<uint64_t>(block, 56, swap);
+    H.shape.resize(rank);
+    for(unsigned n=0; n<rank; n++)
+    {
+        H.shape[n] = get<uint64_t>(block, SHAPE_OFFSET+n*sizeof(uint64_t), swap);
+    }
+    if(H.sparse() ? H.count > count(H.shape) : H.count != count(H.shape))
+    {
+        throw ShapeMismatch("TensorUtils::BinaryFormat::decode_header:: Shape in header does not match the number of components" + err_file);
+    }
+    // the chunk table of a compressed container follows the compressed payload, which may be smaller
+    const uint64_t table_offset = H.compressed() ? H.payload_offset : H.index_offset()+H.index_size();
+    if(H.payload_offset < HEADER_SIZE || H.payload_offset % ALIGNMENT != 0 ||
+       ((H.flags & FLAG_CHUNK_CRC) && (H.chunk_size == 0 || H.crc_offset < table_offset)))
+    {
+        throw CorruptedFile("TensorUtils::BinaryFormat::decode_header:: Invalid layout" + err_file);
+    }
+    if(!(H.flags & FLAG_CHUNK_CRC))
+    {
+        H.chunk_size = 0;
+    }
+    return H;
+}
+
+/**
+    READER
+**/
+
+ContainerReader::ContainerReader(const string &path) : in(path, ios::in | ios::binary), path(path)
+{
+    if(in.fail())
+    {
+        string err_str = "TensorUtils::BinaryFormat::ContainerReader:: Unable to open file \"";
+        err_str.append(path);
+        err_str.append("\".");
+        throw UnableToOpenFile(err_str);
+    }
+
+    const DType legacy_dtype = extension_dtype(filesystem::path(path).extension());
+    if(legacy_dtype != DType::NONE)
+    {
+        read_legacy_header(legacy_dtype);
+        seek(0);
+        return;
+    }
+
+    vector<char> block(HEADER_SIZE);
+    in.read(block.data(), HEADER_SIZE);
+    if(in.gcount() != (streamsize)HEADER_SIZE)
+    {
+        throw CorruptedFile("TensorUtils::BinaryFormat::ContainerReader:: File \"" + path + "\" is too small for the header.");
+    }
+    H = decode_header(block.data(), path);
+
+    if(H.compressed())
+    {
+        read_chunk_table();
+    }
+    else if(H.chunk_size)
+    {
+        crc_table.resize(H.num_chunks());
+        in.seekg(H.crc_offset);
+        in.read((char*)crc_table.data(), crc_table.size()*sizeof(uint32_t));
+        if(in.gcount() != (streamsize)(crc_table.size()*sizeof(uint32_t)))
+        {
+            throw CorruptedFile("TensorUtils::BinaryFormat::ContainerReader:: Checksum table is truncated in file \"" + path + "\".");
+        }
+        if(H.little_endian != little_endian())
+        {
+            swap_bytes((char*)crc_table.data(), crc_table.size(), sizeof(uint32_t));
+        }
+    }
+    seek(0);
+}
+
+void ContainerReader::read_legacy_header(DType d)
+{
+    size_t rank = 0;
+    in.read((char*)&rank, sizeof(size_t));
+    if(in.gcount() != (streamsize)sizeof(size_t) || rank > MAX_RANK)
+    {
+        throw ShapeMismatch("TensorUtils::BinaryFormat::ContainerReader:: Invalid header in file \"" + path + "\".");
+    }
+    vector<size_t> shape(rank);
+    size_t data_size = 0;
+    in.read((char*)shape.data(), rank*sizeof(size_t));
+    in.read((char*)&data_size, sizeof(size_t));
+    H = make_legacy_header(d, shape);
+    if(in.fail() || data_size != H.count)
+    {
+        throw ShapeMismatch("TensorUtils::BinaryFormat::ContainerReader:: Shape in header does not match the number of components in file \"" + path + "\".");
+    }
+
+    in.seekg(0, ios::end);
+    const uint64_t file_size = in.tellg();
+    if(file_size < H.payload_offset + H.payload_size())
+    {
+        throw ShapeMismatch("TensorUtils::BinaryFormat::ContainerReader:: Less data than expected from shape in file \"" + path + "\".");
+    }
+    if(file_size > H.payload_offset + H.payload_size())
+    {
+        throw ShapeMismatch("TensorUtils::BinaryFormat::ContainerReader:: More data than expected from shape in file \"" + path + "\".");
+    }
+}
+
+void ContainerReader::read_index(uint64_t* dst)
+{
+    if(!H.sparse())
+    {
+        throw ShapeMismatch("TensorUtils::BinaryFormat::ContainerReader::read_index:: File \"" + path + "\" does not hold a sparse tensor.");
+    }
+    uint32_t stored_crc = 0;
+    in.clear();
+    in.seekg(H.index_offset());
+    in.read((char*)dst, H.count*sizeof(uint64_t));
+    in.read((char*)&stored_crc, sizeof(uint32_t));
+    if(in.gcount() != (streamsize)sizeof(uint32_t))
+    {
+        throw CorruptedFile("TensorUtils::BinaryFormat::ContainerReader::read_index:: Index table is truncated in file \"" + path + "\".");
+    }
+    if(H.little_endian != little_endian())
+    {
+        swap_bytes((char*)&stored_crc, 1, sizeof(uint32_t));
+    }
+    if(stored_crc != crc32c(dst, H.count*sizeof(uint64_t)))
+    {
+        throw CorruptedFile("TensorUtils::BinaryFormat::ContainerReader::read_index:: Checksum mismatch of the index table in file \"" + path + "\".");
+    }
+    if(H.little_endian != little_endian())
+    {
+        swap_bytes((char*)dst, H.count, sizeof(uint64_t));
+    }
+    const uint64_t total = count(H.shape);
+    for(uint64_t n=0; n<H.count; n++)
+    {
+        if(dst[n] >= total || (n > 0 && dst[n] <= dst[n-1]))
+        {
+            throw CorruptedFile("TensorUtils::BinaryFormat::ContainerReader::read_index:: Invalid index table in file \"" + path + "\".");
+        }
+    }
+    seek(0);
+}
+
+void ContainerReader::seek(size_t component)
+{
+    pos = component*H.elem_size;
+    if(H.compressed())
+    {
+        return; // the chunks are located when they are read
+    }
+    in.clear();
+    in.seekg(H.payload_offset + pos);
+    crc = 0;
+    verify = H.chunk_size && (pos % H.chunk_size == 0);
+}
+
+void ContainerReader::read_bytes(char* dst, size_t n)
+{
+    if(pos + n > H.payload_size())
+    {
+        throw ShapeMismatch("TensorUtils::BinaryFormat::ContainerReader::read:: Read beyond the last component of file \"" + path + "\".");
+    }
+    if(H.compressed())
+    {
+        read_compressed(dst, n);
+        return;
+    }
+    while(n > 0)
+    {
+        size_t m = n;
+        if(H.chunk_size)
+        {
+            m = min<uint64_t>(m, H.chunk_size - pos % H.chunk_size);
+        }
+        in.read(dst, m);
+        if(in.gcount() != (streamsize)m)
+        {
+            throw CorruptedFile("TensorUtils::BinaryFormat::ContainerReader::read:: Unexpected end of file \"" + path + "\".");
+        }
+        if(H.chunk_size)
+        {
+            if(verify)
+            {
+                crc = crc32c(dst, m, crc);
+            }
+            const uint64_t chunk = pos / H.chunk_size;
+            pos += m;
+            if(pos % H.chunk_size == 0 || pos == H.payload_size())
+            {
+                if(verify && crc != crc_table[chunk])
+                {
+                    throw CorruptedFile("TensorUtils::BinaryFormat::ContainerReader::read:: Checksum mismatch in chunk " + to_string(chunk) + " of file \"" + path + "\".");
+                }
+                crc = 0;
+                verify = true;
+            }
+        }
+        else
+        {
+            pos += m;
+        }
+        dst += m;
+        n -= m;
+    }
+}
+
+template<class T>
+void ContainerReader::read(T* dst, size_t n)
+{
+    const bool swap = (H.little_endian != little_endian());
+    if(H.dtype == dtype<T>() && H.elem_size == sizeof(T) && !swap)
+    {
+        read_bytes(reinterpret_cast<char*>(dst), n*sizeof(T));
+        return;
+    }
+    // convert block by block, large reads overlap the transfer of the next block with the conversion
+    const size_t blocks = (n + IO_BLOCK-1)/IO_BLOCK;
+    auto transfer = [&](size_t k, unsigned b)
+    {
+        const size_t m = min(n-k*IO_BLOCK, IO_BLOCK);
+        buffer[b].resize(m*H.elem_size);
+        read_bytes(buffer[b].data(), m*H.elem_size);
+        if(swap)
+        {
+            swap_bytes(buffer[b].data(), m, H.elem_size);
+        }
+    };
+    auto convert = [&](size_t k, unsigned b)
+    {
+        const size_t m = min(n-k*IO_BLOCK, IO_BLOCK);
+        dispatch(H.dtype, [&](auto* tag)
+        {
+            typedef typename remove_pointer<decltype(tag)>::type S;
+            Simd::assign(dst+k*IO_BLOCK, reinterpret_cast<const S*>(buffer[b].data()), m);
+        });
+    };
+    if(blocks >= PIPELINE_BLOCKS)
+    {
+        Parallel::pipeline(blocks, transfer, convert);
+        return;
+    }
+    for(size_t k=0; k<blocks; k++)
+    {
+        transfer(k, 0);
+        convert(k, 0);
+    }
+}
+
+template<class T>
+void BinaryFormat::convert(char* raw, const ContainerHeader &H, T* dst, size_t n)
+{
+    if(H.little_endian != little_endian())
+    {
+        swap_bytes(raw, n, H.elem_size);
+    }
+    dispatch(H.dtype, [&](auto* tag)
+    {
+        typedef typename remove_pointer<decltype(tag)>::type S;
+        Simd::assign(dst, reinterpret_cast<const S*>(raw), n);
+    });
+}
+
+/**
+    COMPRESSED READER
+**/
+
+// number of chunks that are compressed or decompressed at once, which bounds the memory of the buffers
+static size_t chunk_batch()
+{
+    return min<size_t>(max(Parallel::num_threads(), 1u), 32);
+}
+
+void ContainerReader::read_chunk_table()
+{
+    const size_t n_chunks = H.num_chunks();
+    vector<char> table(n_chunks*CHUNK_ENTRY_SIZE + sizeof(uint32_t));
+    in.seekg(H.crc_offset);
+    in.read(table.data(), table.size());
+    if(in.gcount() != (streamsize)table.size())
+    {
+        throw CorruptedFile("TensorUtils::BinaryFormat::ContainerReader:: Chunk table is truncated in file \"" + path + "\".");
+    }
+    const bool swap = (H.little_endian != little_endian());
+    if(get<uint32_t>(table.data(), n_chunks*CHUNK_ENTRY_SIZE, swap) != crc32c(table.data(), n_chunks*CHUNK_ENTRY_SIZE))
+    {
+        throw CorruptedFile("TensorUtils::BinaryFormat::ContainerReader:: Checksum mismatch of the chunk table in file \"" + path + "\".");
+    }
+    chunks.resize(n_chunks);
+    uint64_t end = H.payload_offset;
+    for(size_t k=0; k<n_chunks; k++)
+    {
+        ChunkEntry &c = chunks[k];
+        c.offset = get<uint64_t>(table.data(), k*CHUNK_ENTRY_SIZE, swap);
+        c.size = get<uint32_t>(table.data(), k*CHUNK_ENTRY_SIZE+8, swap);
+        c.crc = get<uint32_t>(table.data(), k*CHUNK_ENTRY_SIZE+12, swap);
+        // the chunks follow each other, such that consecutive chunks are read at once
+        if(c.offset != end || c.size > Compression::lz4_bound(raw_size(k)))
+        {
+            throw CorruptedFile("TensorUtils::BinaryFormat::ContainerReader:: Invalid chunk table in file \"" + path + "\".");
+        }
+        end += c.size;
+    }
+    if(end > H.crc_offset)
+    {
+        throw CorruptedFile("TensorUtils::BinaryFormat::ContainerReader:: Invalid chunk table in file \"" + path + "\".");
+    }
+}
+
+size_t ContainerReader::raw_size(size_t k) const
+{
+    return min<uint64_t>(H.chunk_size, H.payload_size() - k*H.chunk_size);
+}
+
+// reads the compressed chunks [first,last) into packed
+void ContainerReader::read_packed(size_t first, size_t last)
+{
+    const uint64_t begin = chunks[first].offset;
+    const uint64_t end = chunks[last-1].offset + chunks[last-1].size;
+    packed.resize(end-begin);
+    in.clear();
+    in.seekg(begin);
+    in.read(packed.data(), packed.size());
+    if(in.gcount() != (streamsize)packed.size())
+    {
+        throw CorruptedFile("TensorUtils::BinaryFormat::ContainerReader::read:: Unexpected end of file \"" + path + "\".");
+    }
+}
+
+// decodes chunk k from src into raw_size(k) bytes of dst and verifies its checksum
+void ContainerReader::decode_chunk(size_t k, const char* src, char* dst) const
+{
+    const size_t n = raw_size(k);
+    const ChunkEntry &c = chunks[k];
+    if(c.size == n)
+    {
+        memcpy(dst, src, n);
+    }
+    else if(H.filter == Filter::SHUFFLE)
+    {
+        thread_local vector<char> shuffled;
+        shuffled.resize(n);
+        if(!Compression::lz4_decompress(src, c.size, shuffled.data(), n))
+        {
+            throw CorruptedFile("TensorUtils::BinaryFormat::ContainerReader::read:: Invalid compressed data in chunk " + to_string(k) + " of file \"" + path + "\".");
+        }
+        Compression::unshuffle(shuffled.data(), dst, n, H.elem_size);
+    }
+    else if(!Compression::lz4_decompress(src, c.size, dst, n))
+    {
+        throw CorruptedFile("TensorUtils::BinaryFormat::ContainerReader::read:: Invalid compressed data in chunk " + to_string(k) + " of file \"" + path + "\".");
+    }
+    if(crc32c(dst, n) != c.crc)
+    {
+        throw CorruptedFile("TensorUtils::BinaryFormat::ContainerReader::read:: Checksum mismatch in chunk " + to_string(k) + " of file \"" + path + "\".");
+    }
+}
+
+// whole chunks are decoded in parallel directly into dst, partially read chunks are decoded once and kept
+void ContainerReader::read_compressed(char* dst, size_t n)
+{
+    while(n > 0)
+    {
+        const size_t k = pos / H.chunk_size;
+        const size_t within = pos % H.chunk_size;
+        if(within == 0 && n >= raw_size(k))
+        {
+            size_t last = k;
+            size_t bytes = 0;
+            while(last < chunks.size() && last-k < chunk_batch() && bytes + raw_size(last) <= n)
+            {
+                bytes += raw_size(last);
+                last++;
+            }
+            read_packed(k, last);
+            Parallel::parallel_for(last-k, [&](size_t begin, size_t end)
+            {
+                for(size_t j=begin; j<end; j++)
+                {
+                    decode_chunk(k+j, packed.data() + (chunks[k+j].offset-chunks[k].offset), dst + j*H.chunk_size);
+                }
+            }, H.chunk_size);
+            dst += bytes;
+            pos += bytes;
+            n -= bytes;
+            continue;
+        }
+        if(decoded_chunk != k)
+        {
+            read_packed(k, k+1);
+            decoded.resize(raw_size(k));
+            decode_chunk(k, packed.data(), decoded.data());
+            decoded_chunk = k;
+        }
+        const size_t m = min(n, raw_size(k)-within);
+        memcpy(dst, decoded.data()+within, m);
+        dst += m;
+        pos += m;
+        n -= m;
+    }
+}
+
+/**
+    WRITER
+**/
+
+ContainerWriter::ContainerWriter(const string &path, DType d, const vector<size_t> &shape, size_t chunk_size) :
+    ContainerWriter(path, make_header(d, shape, chunk_size))
+{
+    //
+}
+
+ContainerWriter::ContainerWriter(const string &path, const ContainerHeader &H) :
+    out(path, ios::out | ios::binary | ios::trunc),
+    path(path),
+    H(H)
+{
+    if(out.fail())
+    {
+        string err_str = "TensorUtils::BinaryFormat::ContainerWriter:: Unable to open file \"";
+        err_str.append(path);
+        err_str.append("\".");
+        throw UnableToOpenFile(err_str);
+    }
+    if(H.legacy)
+    {
+        const size_t rank = H.shape.size();
+        const size_t data_size = H.count;
+        out.write((const char*)&rank, sizeof(size_t));
+        out.write((const char*)H.shape.data(), rank*sizeof(size_t));
+        out.write((const char*)&data_size, sizeof(size_t));
+        return;
+    }
+    vector<char> block(HEADER_SIZE);
+    encode_header(H, block.data());
+    out.write(block.data(), HEADER_SIZE);
+    if(H.compressed())
+    {
+        if(H.sparse())
+        {
+            throw ShapeMismatch("TensorUtils::BinaryFormat::ContainerWriter:: Sparse tensors cannot be compressed, file \"" + path + "\".");
+        }
+        end_offset = H.payload_offset;
+        chunks.reserve(H.num_chunks());
+        return;
+    }
+    crc_table.reserve(H.num_chunks());
+}
+
+void ContainerWriter::write_bytes(const char* src, size_t n)
+{
+    if(pos + n > H.payload_size())
+    {
+        throw ShapeMismatch("TensorUtils::BinaryFormat::ContainerWriter::write:: More data than expected from shape for file \"" + path + "\".");
+    }
+    if(H.compressed())
+    {
+        write_compressed(src, n);
+        return;
+    }
+    if(!H.chunk_size)
+    {
+        out.write(src, n);
+        pos += n;
+        return;
+    }
+    while(n > 0)
+    {
+        const size_t m = min<uint64_t>(n, H.chunk_size - pos % H.chunk_size);
+        out.write(src, m);
+        crc = crc32c(src, m, crc);
+        pos += m;
+        if(pos % H.chunk_size == 0 || pos == H.payload_size())
+        {
+            crc_table.push_back(crc);
+            crc = 0;
+        }
+        src += m;
+        n -= m;
+    }
+}
+
+// whole batches of chunks are compressed directly from src, the remainder is collected in staging
+void ContainerWriter::write_compressed(const char* src, size_t n)
+{
+    const size_t batch = chunk_batch()*H.chunk_size;
+    while(n > 0)
+    {
+        size_t m;
+        if(staging.empty() && n >= batch)
+        {
+            m = batch;
+            compress_chunks(src, m);
+        }
+        else
+        {
+            m = min(n, batch-staging.size());
+            staging.insert(staging.end(), src, src+m);
+            if(staging.size() == batch)
+            {
+                compress_chunks(staging.data(), staging.size());
+                staging.clear();
+            }
+        }
+        pos += m;
+        src += m;
+        n -= m;
+    }
+}
+
+// compresses n bytes in chunks of chunk_size in parallel and appends them to the file
+void ContainerWriter::compress_chunks(const char* src, size_t n)
+{
+    const size_t n_chunks = (n + H.chunk_size-1)/H.chunk_size;
+    if(packed.size() < n_chunks)
+    {
+        packed.resize(n_chunks);
+    }
+    const size_t first = chunks.size();
+    chunks.resize(first + n_chunks);
+    Parallel::parallel_for(n_chunks, [&](size_t begin, size_t end)
+    {
+        thread_local vector<char> shuffled;
+        for(size_t j=begin; j<end; j++)
+        {
+            const char* raw = src + j*H.chunk_size;
+            const size_t m = min<size_t>(H.chunk_size, n - j*H.chunk_size);
+            const char* input = raw;
+            if(H.filter == Filter::SHUFFLE)
+            {
+                shuffled.resize(m);
+                Compression::shuffle(raw, shuffled.data(), m, H.elem_size);
+                input = shuffled.data();
+            }
+            // chunks that do not become smaller are stored as they are
+            packed[j].resize(m);
+            size_t size = m ? Compression::lz4_compress(input, m, packed[j].data(), m-1) : 0;
+            if(size == 0)
+            {
+                memcpy(packed[j].data(), raw, m);
+                size = m;
+            }
+            packed[j].resize(size);
+            chunks[first+j].size = uint32_t(size);
+            chunks[first+j].crc = crc32c(raw, m);
+        }
+    }, H.chunk_size);
+    for(size_t j=0; j<n_chunks; j++)
+    {
+        chunks[first+j].offset = end_offset;
+        out.write(packed[j].data(), packed[j].size());
+        end_offset += packed[j].size();
+    }
+}
+
+template<class T>
+void ContainerWriter::write(const T* src, size_t n)
+{
+    if(H.dtype == dtype<T>() && H.elem_size == sizeof(T))
+    {
+        write_bytes(reinterpret_cast<const char*>(src), n*sizeof(T));
+        return;
+    }
+    // convert block by block, large writes overlap the conversion of the next block with the transfer
+    const size_t blocks = (n + IO_BLOCK-1)/IO_BLOCK;
+    auto convert = [&](size_t k, unsigned b)
+    {
+        const size_t m = min(n-k*IO_BLOCK, IO_BLOCK);
+        buffer[b].resize(m*H.elem_size);
+        dispatch(H.dtype, [&](auto* tag)
+        {
+            typedef typename remove_pointer<decltype(tag)>::type S;
+            Simd::assign(reinterpret_cast<S*>(buffer[b].data()), src+k*IO_BLOCK, m);
+        });
+    };
+    auto transfer = [&](size_t, unsigned b)
+    {
+        write_bytes(buffer[b].data(), buffer[b].size());
+    };
+    if(blocks >= PIPELINE_BLOCKS)
+    {
+        Parallel::pipeline(blocks, convert, transfer);
+        return;
+    }
+    for(size_t k=0; k<blocks; k++)
+    {
+        convert(k, 0);
+        transfer(k, 0);
+    }
+}
+
+void ContainerWriter::write_index(const uint64_t* src)
+{
+    if(!H.sparse() || pos != H.payload_size() || index_written)
+    {
+        throw ShapeMismatch("TensorUtils::BinaryFormat::ContainerWriter::write_index:: The index table of file \"" + path + "\" must follow all components of a sparse tensor.");
+    }
+    const uint32_t crc_index = crc32c(src, H.count*sizeof(uint64_t));
+    out.write((const char*)src, H.count*sizeof(uint64_t));
+    out.write((const char*)&crc_index, sizeof(uint32_t));
+    index_written = true;
+}
+
+void ContainerWriter::close()
+{
+    if(pos != H.payload_size() || (H.sparse() && !index_written))
+    {
+        throw ShapeMismatch("TensorUtils::BinaryFormat::ContainerWriter::close:: Less data than expected from shape for file \"" + path + "\".");
+    }
+    if(H.compressed())
+    {
+        if(!staging.empty())
+        {
+            compress_chunks(staging.data(), staging.size());
+            staging.clear();
+        }
+        vector<char> table(chunks.size()*CHUNK_ENTRY_SIZE + sizeof(uint32_t));
+        for(size_t k=0; k<chunks.size(); k++)
+        {
+            put<uint64_t>(table.data(), k*CHUNK_ENTRY_SIZE, chunks[k].offset);
+            put<uint32_t>(table.data(), k*CHUNK_ENTRY_SIZE+8, chunks[k].size);
+            put<uint32_t>(table.data(), k*CHUNK_ENTRY_SIZE+12, chunks[k].crc);
+        }
+        put<uint32_t>(table.data(), chunks.size()*CHUNK_ENTRY_SIZE, crc32c(table.data(), chunks.size()*CHUNK_ENTRY_SIZE));
+        out.write(table.data(), table.size());
+
+        // the header is complete once the position of the chunk table is known
+        H.crc_offset = end_offset;
+        vector<char> block(HEADER_SIZE);
+        encode_header(H, block.data());
+        out.seekp(0);
+        out.write(block.data(), HEADER_SIZE);
+    }
+    else if(H.chunk_size)
+    {
+        out.write((const char*)crc_table.data(), crc_table.size()*sizeof(uint32_t));
+    }
+    out.close();
+    if(out.fail())
+    {
+        throw UnableToOpenFile("TensorUtils::BinaryFormat::ContainerWriter::close:: Unable to write file \"" + path + "\".");
+    }
+}
+
+/**
+    EXPLICIT TEMPLATE INSTANTIATION
+**/
+
+namespace TensorUtils
+{
+    namespace BinaryFormat
+    {
+        #define INSTANTIATE(X) \
+        template void ContainerReader::read<X>(X*, size_t); \
+        template void ContainerWriter::write<X>(const X*, size_t); \
+        template void convert<X>(char*, const ContainerHeader&, X*, size_t);
+
+        INSTANTIATE(double)
+        INSTANTIATE(float)
+        INSTANTIATE(long double)
+        INSTANTIATE(unsigned char)
+        INSTANTIATE(signed char)
+        INSTANTIATE(unsigned short)
+        INSTANTIATE(short)
+        INSTANTIATE(unsigned)
+        INSTANTIATE(int)
+        INSTANTIATE(unsigned long)
+        INSTANTIATE(long)
+        INSTANTIATE(unsigned long long)
+        INSTANTIATE(long long)
+
+        #undef INSTANTIATE
+    }
+}
@@ -0,0 +1,359 @@
+/*
+TensorUtils Version 0.1
+
+Copyright 2022 Christoph Widder
+
+This file is part of TensorUtils.
+
+TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+the GNU General Public License as published by the Free Software Foundation, either
+version 3 of the License, or (at your option) any later version.
+
+TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with TensorUtils.
+If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef BINARYFORMAT_HPP
+#define BINARYFORMAT_HPP
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace TensorUtils
+{
+    namespace BinaryFormat
+    {
+        /*
+            Layout of the extension based binary files, see TensorBase<T>::read:
+
+                size_t      rank
+                size_t      shape[rank]
+                size_t      count
+                T           data[count]
+        */
+
+        // number of components converted at once when the component type differs from the file type
+        constexpr size_t IO_BLOCK = size_t(1)<<16;
+
+        // conversions of at least this many blocks overlap with the file transfer on a second thread, see Parallel::pipeline
+        constexpr size_t PIPELINE_BLOCKS = 4;
+
+        // byte offset of the payload
+        inline size_t payload_offset(size_t rank)
+        {
+            return (rank+2)*sizeof(size_t);
+        }
+
+        // file extension of the binary format with components of type T, "" if there is none
+        template<class T>
+        inline std::string extension()
+        {
+            if(std::is_same<T,float>::value)                   { return ".f32"; }
+            if(std::is_same<T,double>::value)                  { return ".f64"; }
+            if(std::is_same<T,long double>::value)             { return ".f80"; }
+            if(std::is_same<T,unsigned char>::value)           { return ".uc"; }
+            if(std::is_same<T,signed char>::value)             { return ".sc"; }
+            if(std::is_same<T,unsigned short>::value)          { return ".us"; }
+            if(std::is_same<T,short>::value)                   { return ".s"; }
+            if(std::is_same<T,unsigned>::value)                { return ".u"; }
+            if(std::is_same<T,int>::value)                     { return ".int"; }
+            if(std::is_same<T,unsigned long>::value)           { return ".ul"; }
+            if(std::is_same<T,long>::value)                    { return ".l"; }
+            if(std::is_same<T,unsigned long long>::value)      { return ".ull"; }
+            if(std::is_same<T,long long>::value)               { return ".ll"; }
+            return "";
+        }
+
+        // number of components of a shape
+        inline size_t count(const std::vector<size_t> &shape)
+        {
+            size_t n = 1;
+            for(auto it=shape.begin(); it!=shape.end(); it++)
+            {
+                n *= *it;
+            }
+            return n;
+        }
+
+        /*
+            Self-describing container format, file extension ".tu". All sizes are given in bytes.
+
+                offset  type        field
+                0       char[8]     magic "TUTENSOR"
+                8       uint8       byte order of all following fields and of the payload, 1: little endian, 2: big endian
+                9       uint8[3]    reserved, zero
+                12      uint32      version
+                16      uint32      component type, see DType
+                20      uint32      size of a component
+                24      uint32      flags, see FLAG_CHUNK_CRC
+                28      uint32      rank
+                32      uint64      number of components
+                40      uint64      offset of the payload, multiple of ALIGNMENT
+                48      uint64      size of a checksum chunk
+                56      uint64      offset of the checksum table, 0 if there is none
+                64      uint64[]    shape
+                4092    uint32      CRC-32C of the bytes [0,4092)
+                4096    ...         payload in lexicographical order
+                ...     uint32[]    CRC-32C of every chunk of the payload, the last chunk may be shorter
+
+            The header occupies exactly one block of ALIGNMENT bytes, such that the payload is aligned for
+            memory mapping and direct I/O.
+
+            Containers with FLAG_SPARSE hold a sparse tensor of the given shape: the number of components is the
+            number of stored components, the payload holds their values in increasing order of their lexicographical
+            indices and is followed by the index table, before the checksum table:
+
+                ...     uint64[]    lexicographical index of every stored component, increasing
+                ...     uint32      CRC-32C of the index table
+
+            Compressed containers, file extension ".tuz", have version 2 and FLAG_COMPRESSED. The payload is split
+            into chunks of the checksum chunk size that are compressed independently, such that they can be
+            compressed and decompressed in parallel and every chunk can be decoded on its own. Byte 9 holds the
+            Codec and byte 10 the Filter that was applied before compression. The compressed chunks follow each
+            other from the payload offset. The checksum table is replaced by the chunk table:
+
+                ...     struct { uint64 offset; uint32 stored size; uint32 CRC-32C; }[]  for every chunk
+                ...     uint32      CRC-32C of the chunk table
+
+            The checksum is the one of the uncompressed chunk. A chunk whose stored size equals its uncompressed
+            size is stored as is, without filter. Sparse tensors cannot be compressed.
+        */
+        constexpr char MAGIC[8] = {'T','U','T','E','N','S','O','R'};
+        constexpr uint32_t VERSION = 1;                // uncompressed containers, readable by all releases
+        constexpr uint32_t VERSION_COMPRESSED = 2;     // newest version that can be read
+        constexpr size_t ALIGNMENT = 4096;
+        constexpr size_t HEADER_SIZE = ALIGNMENT;
+        constexpr size_t SHAPE_OFFSET = 64;
+        constexpr size_t MAX_RANK = (HEADER_SIZE-SHAPE_OFFSET-sizeof(uint32_t))/sizeof(uint64_t);
+        constexpr uint32_t FLAG_CHUNK_CRC = 1;
+        constexpr uint32_t FLAG_SPARSE = 2;
+        constexpr uint32_t FLAG_COMPRESSED = 4;
+        constexpr size_t DEFAULT_CHUNK_SIZE = size_t(1)<<20;
+        constexpr const char* CONTAINER_EXTENSION = ".tu";
+        constexpr const char* COMPRESSED_EXTENSION = ".tuz";
+
+        // compression of the chunks of a compressed container
+        enum class Codec : uint8_t
+        {
+            NONE    = 0,
+            LZ4     = 1  // LZ4 block format, see Compression.hpp
+        };
+
+        // reversible transformation of a chunk before compression
+        enum class Filter : uint8_t
+        {
+            NONE    = 0,
+            SHUFFLE = 1  // byte shuffle of the components, see Compression.hpp
+        };
+
+        enum class DType : uint32_t
+        {
+            NONE    = 0, // no binary component type, e.g. text files
+            FLOAT32 = 1,
+            FLOAT64 = 2,
+            FLOAT80 = 3, // extended precision long double, padded to its size in memory
+            UINT8   = 4,
+            INT8    = 5,
+            UINT16  = 6,
+            INT16   = 7,
+            UINT32  = 8,
+            INT32   = 9,
+            UINT64  = 10,
+            INT64   = 11
+        };
+
+        // component type of T independent of the name of the C++ type, e.g. unsigned long and unsigned long long
+        template<class T>
+        inline DType dtype()
+        {
+            if(std::is_floating_point<T>::value)
+            {
+                return sizeof(T) == 4 ? DType::FLOAT32 : sizeof(T) == 8 ? DType::FLOAT64 : DType::FLOAT80;
+            }
+            switch(sizeof(T))
+            {
+                case 1: return std::is_signed<T>::value ? DType::INT8  : DType::UINT8;
+                case 2: return std::is_signed<T>::value ? DType::INT16 : DType::UINT16;
+                case 4: return std::is_signed<T>::value ? DType::INT32 : DType::UINT32;
+                default: return std::is_signed<T>::value ? DType::INT64 : DType::UINT64;
+            }
+        }
+
+        // size of a component of type d as stored on this host, 0 if d is unknown
+        size_t dtype_size(DType d);
+
+        // component type of the extension based binary format, DType::NONE if the extension is not one of them
+        DType extension_dtype(const std::string &extension);
+
+        inline bool little_endian()
+        {
+            const uint16_t one = 1;
+            return *reinterpret_cast<const unsigned char*>(&one) == 1;
+        }
+
+        // CRC-32C (Castagnoli) of n bytes, crc is the checksum of all preceding bytes
+        uint32_t crc32c(const void* data, size_t n, uint32_t crc=0);
+
+        struct ContainerHeader
+        {
+            bool little_endian = true;
+            uint32_t version = VERSION;
+            DType dtype = DType::FLOAT64;
+            uint32_t elem_size = 8;
+            uint32_t flags = 0;
+            uint64_t count = 1;
+            uint64_t payload_offset = HEADER_SIZE;
+            uint64_t chunk_size = 0;
+            uint64_t crc_offset = 0;
+            std::vector<size_t> shape;
+            bool legacy = false;        // extension based format, see payload_offset
+            Codec codec = Codec::NONE;
+            Filter filter = Filter::NONE;
+
+            uint64_t payload_size() const { return count*elem_size; }
+            uint64_t num_chunks() const { return chunk_size ? (payload_size()+chunk_size-1)/chunk_size : 0; }
+            bool sparse() const { return flags & FLAG_SPARSE; }
+            bool compressed() const { return flags & FLAG_COMPRESSED; }
+            uint64_t index_offset() const { return payload_offset + payload_size(); }
+            uint64_t index_size() const { return sparse() ? count*sizeof(uint64_t) + sizeof(uint32_t) : 0; }
+        };
+
+        // true if the file starts with MAGIC
+        bool is_container(const std::string &path);
+
+        // header for a new container with components of type d, chunk_size==0 disables checksums
+        ContainerHeader make_header(DType d, const std::vector<size_t> &shape, size_t chunk_size);
+
+        // header for a new sparse container with nnz stored components of type d, see FLAG_SPARSE
+        ContainerHeader make_sparse_header(DType d, const std::vector<size_t> &shape, size_t nnz, size_t chunk_size);
+
+        // header for a new compressed container, the byte shuffle is applied to components of more than one byte
+        ContainerHeader make_compressed_header(DType d, const std::vector<size_t> &shape, size_t chunk_size=DEFAULT_CHUNK_SIZE, Codec codec=Codec::LZ4);
+
+        // header of the extension based format with components of type d, without checksums
+        ContainerHeader make_legacy_header(DType d, const std::vector<size_t> &shape);
+
+        // fills the header block of HEADER_SIZE bytes
+        void encode_header(const ContainerHeader &H, char* block);
+
+        // parses and validates a header block of HEADER_SIZE bytes, throws ErrorHandler::CorruptedFile
+        ContainerHeader decode_header(const char* block, const std::string &path);
+
+        // converts n components of the payload of H as stored in the file to T, swaps the bytes of raw in place
+        template<class T>
+        void convert(char* raw, const ContainerHeader &H, T* dst, size_t n);
+
+        // entry of the chunk table of a compressed container
+        struct ChunkEntry
+        {
+            uint64_t offset;
+            uint32_t size;
+            uint32_t crc;
+        };
+        constexpr size_t CHUNK_ENTRY_SIZE = 16;
+
+        /*
+            Sequential reader of the payload of a container or of a file in the extension based format,
+            which is selected by the extension of the path. Components are converted to T and
+            swapped to the byte order of this host. Chunk checksums are verified for all chunks
+            that are read from their beginning to their end.
+        */
+        class ContainerReader
+        {
+            public:
+                ContainerReader(const std::string &path);
+
+                const ContainerHeader& header() const { return H; }
+
+                // reads the next n components
+                template<class T> void read(T* dst, size_t n);
+
+                // moves to the component with the given lexicographical index
+                void seek(size_t component);
+
+                // index of the next component
+                size_t tell() const { return pos/H.elem_size; }
+
+                // reads and verifies the index table of a sparse container, the payload is read from its beginning afterwards
+                void read_index(uint64_t* dst);
+
+            private:
+                void read_legacy_header(DType d);
+                void read_chunk_table();
+                void read_bytes(char* dst, size_t n);
+                void read_compressed(char* dst, size_t n);
+                void read_packed(size_t first, size_t last);
+                void decode_chunk(size_t k, const char* src, char* dst) const;
+                size_t raw_size(size_t k) const;
+
+                std::ifstream in;
+                std::string path;
+                ContainerHeader H;
+                std::vector<uint32_t> crc_table;
+                uint64_t pos = 0;           // position in the payload
+                uint32_t crc = 0;           // checksum of the current chunk up to pos
+                bool verify = false;        // current chunk was read from its beginning
+                std::vector<char> buffer[2];
+                std::vector<ChunkEntry> chunks;  // chunk table of a compressed container
+                std::vector<char> packed;   // compressed chunks as read from the file
+                std::vector<char> decoded;  // last chunk that was read in part
+                uint64_t decoded_chunk = UINT64_MAX;
+        };
+
+        /*
+            Sequential writer of a new container, or of a file in the extension based format if the header is a legacy header.
+            Components of type T are converted to the type of the file.
+            close() appends the checksum table and throws if not all components were written.
+            The index table of a sparse container is written by write_index after all components.
+        */
+        class ContainerWriter
+        {
+            public:
+                ContainerWriter(const std::string &path, DType d, const std::vector<size_t> &shape, size_t chunk_size);
+                ContainerWriter(const std::string &path, const ContainerHeader &H);
+
+                const ContainerHeader& header() const { return H; }
+
+                // writes the next n components
+                template<class T> void write(const T* src, size_t n);
+
+                // index of the next component
+                size_t tell() const { return pos/H.elem_size; }
+
+                // writes the index table of a sparse container, see FLAG_SPARSE
+                void write_index(const uint64_t* src);
+
+                void close();
+
+            private:
+                void write_bytes(const char* src, size_t n);
+                void write_compressed(const char* src, size_t n);
+                void compress_chunks(const char* src, size_t n);
+
+                bool index_written = false;
+
+                std::ofstream out;
+                std::string path;
+                ContainerHeader H;
+                std::vector<uint32_t> crc_table;
+                uint64_t pos = 0;
+                uint32_t crc = 0;
+                std::vector<char> buffer[2];
+                std::vector<ChunkEntry> chunks;                  // chunk table of a compressed container
+                std::vector<char> staging;                  // payload that was not compressed yet
+                std::vector<std::vector<char>> packed;      // compressed chunks of one batch
+                uint64_t end_offset = 0;                    // end of the compressed chunks in the file
+        };
+    }
+}
+
+#endif // BINARYFORMAT_HPP
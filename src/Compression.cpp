@@ -0,0 +1,278 @@
+/*
+TensorUtils Version 0.1
+
+Copyright 2022 Christoph Widder
+
+This file is part of TensorUtils.
+
+TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+the GNU General Public License as published by the Free Software Foundation, either
+version 3 of the License, or (at your option) any later version.
+
+TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with TensorUtils.
+If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include "Compression.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+using namespace TensorUtils;
+
+/**
+    LZ4
+**/
+
+namespace
+{
+    constexpr size_t MIN_MATCH = 4;
+    constexpr size_t LAST_LITERALS = 5;     // the last 5 bytes of a block are literals
+    constexpr size_t MF_LIMIT = 12;         // the last match starts at least 12 bytes before the end
+    constexpr size_t MAX_OFFSET = 65535;
+    constexpr unsigned HASH_LOG = 14;
+
+    inline uint32_t read32(const char* p)
+    {
+        uint32_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    inline uint64_t read64(const char* p)
+    {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    inline uint32_t hash_sequence(uint32_t sequence)
+    {
+        return (sequence * 2654435761u) >> (32-HASH_LOG);
+    }
+
+    // length in the 4-bit field of the token followed by bytes of 255 and the remainder
+    inline char* put_length(char* op, size_t length)
+    {
+        while(length >= 255)
+        {
+            *op++ = char(255);
+            length -= 255;
+        }
+        *op++ = char(length);
+        return op;
+    }
+
+    inline bool get_length(const unsigned char* src, size_t n, size_t &ip, size_t &length)
+    {
+        unsigned char b;
+        do
+        {
+            if(ip >= n)
+            {
+                return false;
+            }
+            b = src[ip++];
+            length += b;
+        }
+        while(b == 255);
+        return true;
+    }
+
+    // appends the literals [anchor,ip) and, if length>0, a match of length bytes at offset, 0 if dst is full
+    inline char* put_sequence(char* op, char* end, const char* literals, size_t n_lit, size_t offset, size_t length)
+    {
+        if(size_t(end-op) < 1 + n_lit/255 + 1 + n_lit + 2 + length/255 + 1)
+        {
+            return nullptr;
+        }
+        const size_t match_code = length ? length-MIN_MATCH : 0;
+        char* token = op++;
+        *token = char((min<size_t>(n_lit, 15) << 4) | min<size_t>(match_code, 15));
+        if(n_lit >= 15)
+        {
+            op = put_length(op, n_lit-15);
+        }
+        if(n_lit)
+        {
+            memcpy(op, literals, n_lit);
+            op += n_lit;
+        }
+        if(length)
+        {
+            *op++ = char(offset & 0xFF);
+            *op++ = char(offset >> 8);
+            if(match_code >= 15)
+            {
+                op = put_length(op, match_code-15);
+            }
+        }
+        return op;
+    }
+}
+
+size_t Compression::lz4_compress(const char* src, size_t n, char* dst, size_t capacity)
+{
+    char* op = dst;
+    char* const end = dst + capacity;
+    size_t anchor = 0;
+    if(n > MF_LIMIT)
+    {
+        // positions+1 of the last occurrence of every hashed 4-byte sequence, 0 if none
+        vector<uint32_t> table(size_t(1)<<HASH_LOG, 0);
+        const size_t match_limit = n - LAST_LITERALS;
+        size_t ip = 0;
+        size_t misses = 0;
+        while(ip + MF_LIMIT <= n)
+        {
+            const uint32_t sequence = read32(src+ip);
+            uint32_t &entry = table[hash_sequence(sequence)];
+            const size_t candidate = entry;
+            entry = uint32_t(ip+1);
+            if(candidate == 0 || ip-(candidate-1) > MAX_OFFSET || read32(src+candidate-1) != sequence)
+            {
+                // step faster through incompressible data
+                misses++;
+                ip += 1 + (misses >> 6);
+                continue;
+            }
+            size_t m = candidate-1;
+            while(ip > anchor && m > 0 && src[ip-1] == src[m-1])
+            {
+                ip--;
+                m--;
+            }
+            size_t length = MIN_MATCH;
+            while(ip+length+8 <= match_limit && read64(src+ip+length) == read64(src+m+length))
+            {
+                length += 8;
+            }
+            while(ip+length < match_limit && src[ip+length] == src[m+length])
+            {
+                length++;
+            }
+            op = put_sequence(op, end, src+anchor, ip-anchor, ip-m, length);
+            if(!op)
+            {
+                return 0;
+            }
+            ip += length;
+            anchor = ip;
+            misses = 0;
+            if(ip + MF_LIMIT <= n)
+            {
+                table[hash_sequence(read32(src+ip-2))] = uint32_t(ip-2+1);
+            }
+        }
+    }
+    op = put_sequence(op, end, src+anchor, n-anchor, 0, 0);
+    return op ? size_t(op-dst) : 0;
+}
+
+bool Compression::lz4_decompress(const char* source, size_t n, char* dst, size_t size)
+{
+    const unsigned char* src = reinterpret_cast<const unsigned char*>(source);
+    size_t ip = 0;
+    size_t op = 0;
+    while(true)
+    {
+        if(ip >= n)
+        {
+            return false;
+        }
+        const unsigned token = src[ip++];
+        size_t n_lit = token >> 4;
+        if(n_lit == 15 && !get_length(src, n, ip, n_lit))
+        {
+            return false;
+        }
+        if(n_lit > n-ip || n_lit > size-op)
+        {
+            return false;
+        }
+        if(n_lit)
+        {
+            memcpy(dst+op, src+ip, n_lit);
+        }
+        ip += n_lit;
+        op += n_lit;
+        if(ip == n)
+        {
+            return op == size;  // the last sequence has no match
+        }
+        if(ip+2 > n)
+        {
+            return false;
+        }
+        const size_t offset = src[ip] | (size_t(src[ip+1]) << 8);
+        ip += 2;
+        size_t length = token & 15;
+        if(length == 15 && !get_length(src, n, ip, length))
+        {
+            return false;
+        }
+        length += MIN_MATCH;
+        if(offset == 0 || offset > op || length > size-op)
+        {
+            return false;
+        }
+        // the match may overlap the bytes it produces, e.g. offset 1 repeats a single byte: the bytes repeat with
+        // the period offset, such that they can be copied in words from the first multiple of offset of at least 8
+        char* d = dst+op;
+        const size_t period = offset * ((8+offset-1)/offset);
+        size_t i = 0;
+        for(; i<length && i<period-offset; i++)
+        {
+            d[i] = d[i-offset];
+        }
+        for(; i+8<=length; i+=8)
+        {
+            memcpy(d+i, d+i-period, 8);
+        }
+        for(; i<length; i++)
+        {
+            d[i] = d[i-offset];
+        }
+        op += length;
+    }
+}
+
+/**
+    BYTE SHUFFLE
+**/
+
+void Compression::shuffle(const char* src, char* dst, size_t n, size_t elem_size)
+{
+    const size_t count = n/elem_size;
+    for(size_t k=0; k<elem_size; k++)
+    {
+        char* out = dst + k*count;
+        for(size_t i=0; i<count; i++)
+        {
+            out[i] = src[i*elem_size+k];
+        }
+    }
+    memcpy(dst+count*elem_size, src+count*elem_size, n-count*elem_size);
+}
+
+void Compression::unshuffle(const char* src, char* dst, size_t n, size_t elem_size)
+{
+    const size_t count = n/elem_size;
+    for(size_t k=0; k<elem_size; k++)
+    {
+        const char* in = src + k*count;
+        for(size_t i=0; i<count; i++)
+        {
+            dst[i*elem_size+k] = in[i];
+        }
+    }
+    memcpy(dst+count*elem_size, src+count*elem_size, n-count*elem_size);
+}
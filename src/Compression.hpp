@@ -0,0 +1,59 @@
+/*
+TensorUtils Version 0.1
+
+Copyright 2022 Christoph Widder
+
+This file is part of TensorUtils.
+
+TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+the GNU General Public License as published by the Free Software Foundation, either
+version 3 of the License, or (at your option) any later version.
+
+TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with TensorUtils.
+If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef COMPRESSION_HPP
+#define COMPRESSION_HPP
+
+#include <cstddef>
+
+namespace TensorUtils
+{
+    /*
+        Codecs of the compressed container format, see BinaryFormat.hpp. The codecs are self-contained,
+        such that the library does not depend on compression libraries:
+
+        - LZ4 block format (https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md): blocks written here
+          can be decoded by any LZ4 implementation and vice versa.
+        - Byte shuffle: the k-th bytes of all components are stored next to each other. The exponent and
+          high mantissa bytes of similar floating point numbers then form long runs that LZ4 can match.
+    */
+    namespace Compression
+    {
+        // upper bound of the compressed size of n bytes
+        inline size_t lz4_bound(size_t n)
+        {
+            return n + n/255 + 16;
+        }
+
+        // compresses n bytes of src into dst and returns the compressed size, 0 if it would exceed capacity
+        size_t lz4_compress(const char* src, size_t n, char* dst, size_t capacity);
+
+        // decompresses n bytes of src into exactly size bytes of dst, false if src is not a valid block of that size
+        bool lz4_decompress(const char* src, size_t n, char* dst, size_t size);
+
+        // dst[k*count+i] = src[i*elem_size+k] for count = n/elem_size components, a remainder of n is copied
+        void shuffle(const char* src, char* dst, size_t n, size_t elem_size);
+
+        // inverse of shuffle
+        void unshuffle(const char* src, char* dst, size_t n, size_t elem_size);
+    }
+}
+
+#endif // COMPRESSION_HPP
@@ -0,0 +1,523 @@
+/*
+TensorUtils Version 0.1
+
+Copyright 2022 Christoph Widder
+
+This file is part of TensorUtils.
+
+TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+the GNU General Public License as published by the Free Software Foundation, either
+version 3 of the License, or (at your option) any later version.
+
+TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with TensorUtils.
+If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef THROW_EXCEPTIONS
+#define THROW_EXCEPTIONS 0
+#endif // THROW_EXCEPTIONS
+
+#ifndef THROW_BASIC_EXCEPTIONS
+#define THROW_BASIC_EXCEPTIONS 1
+#endif // THROW_BASIC_EXCEPTIONS
+
+#include "ContractionPath.hpp"
+#include "ErrorHandler.hpp"
+#include "Profile.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+
+using namespace std;
+using namespace TensorUtils;
+using namespace ErrorHandler;
+
+/**
+    NETWORK
+**/
+
+namespace
+{
+    // bit l is set if the label with index l occurs
+    typedef uint64_t LabelSet;
+
+    // distinct labels of all operands and the label sets of the operands
+    struct Network
+    {
+        vector<int> labels;
+        vector<size_t> extent;
+        vector<LabelSet> operand;
+        LabelSet output = 0;        // non-negative labels
+
+        // number of index combinations of the labels in s
+        double volume(LabelSet s) const
+        {
+            double v = 1.0;
+            for(size_t l=0; s; l++, s>>=1)
+            {
+                if(s & 1)
+                {
+                    v *= double(extent[l]);
+                }
+            }
+            return v;
+        }
+    };
+}
+
+static Network analyze(const vector<vector<size_t>> &shapes, const vector<vector<int>> &labels)
+{
+    if(THROW_BASIC_EXCEPTIONS && (shapes.size() != labels.size() || shapes.empty()))
+    {
+        throw ShapeMismatch("TensorUtils::ContractionPath::ContractionPath:: There must be one list of labels per operand and at least one operand!");
+    }
+    Network N;
+    for(size_t op=0; op<shapes.size(); op++)
+    {
+        if(THROW_BASIC_EXCEPTIONS && shapes[op].size() != labels[op].size())
+        {
+            throw ShapeMismatch("TensorUtils::ContractionPath::ContractionPath:: Number of labels does not match the rank of operand " + to_string(op) + "!");
+        }
+        LabelSet s = 0;
+        for(size_t dim=0; dim<labels[op].size(); dim++)
+        {
+            const size_t l = find(N.labels.begin(), N.labels.end(), labels[op][dim]) - N.labels.begin();
+            if(l == N.labels.size())
+            {
+                if(THROW_BASIC_EXCEPTIONS && l == 64)
+                {
+                    throw ShapeMismatch("TensorUtils::ContractionPath::ContractionPath:: More than 64 distinct labels!");
+                }
+                N.labels.push_back(labels[op][dim]);
+                N.extent.push_back(shapes[op][dim]);
+            }
+            else if(THROW_BASIC_EXCEPTIONS && N.extent[l] != shapes[op][dim])
+            {
+                throw ShapeMismatch("TensorUtils::ContractionPath::ContractionPath:: Ranges of equal labels do not match!");
+            }
+            s |= LabelSet(1) << l;
+            if(labels[op][dim] >= 0)
+            {
+                N.output |= LabelSet(1) << l;
+            }
+        }
+        N.operand.push_back(s);
+    }
+    return N;
+}
+
+/*
+    Multiply-adds of a path, where every product keeps the labels that are non-negative or occur in one of the
+    remaining operands. All other labels are summed over.
+*/
+static double path_flops_of(const Network &N, const vector<pair<size_t,size_t>> &steps)
+{
+    vector<LabelSet> ops = N.operand;
+    if(ops.size() == 1)
+    {
+        return N.volume(ops[0]);
+    }
+    double flops = 0.0;
+    for(auto it=steps.begin(); it!=steps.end(); it++)
+    {
+        LabelSet others = 0;
+        for(size_t k=0; k<ops.size(); k++)
+        {
+            if(k != it->first && k != it->second)
+            {
+                others |= ops[k];
+            }
+        }
+        const LabelSet both = ops[it->first] | ops[it->second];
+        flops += N.volume(both);
+        ops.erase(ops.begin()+it->second);
+        ops.erase(ops.begin()+it->first);
+        ops.push_back(both & (N.output | others));
+    }
+    return flops;
+}
+
+/**
+    SEARCH
+**/
+
+// Contracts the pair with a common label that reduces the total size the most, ties are broken by the cost.
+// Pairs without common labels, i.e. outer products, are only taken if there is no other pair.
+static vector<pair<size_t,size_t>> greedy_path(const Network &N)
+{
+    vector<LabelSet> ops = N.operand;
+    vector<pair<size_t,size_t>> steps;
+    while(ops.size() > 1)
+    {
+        // labels that occur in at least two and at least three operands, such that the labels that remain after
+        // the product of a pair are found without a pass over all other operands
+        LabelSet ge2 = 0, ge3 = 0, seen = 0;
+        for(auto it=ops.begin(); it!=ops.end(); it++)
+        {
+            ge3 |= ge2 & *it;
+            ge2 |= seen & *it;
+            seen |= *it;
+        }
+        size_t best_i = 0, best_j = 1;
+        bool best_shared = false;
+        double best_score = 0.0, best_cost = 0.0;
+        bool first = true;
+        for(size_t i=0; i<ops.size(); i++)
+        {
+            for(size_t j=i+1; j<ops.size(); j++)
+            {
+                const LabelSet a = ops[i], b = ops[j];
+                const LabelSet kept = ((a|b) & N.output) | (a & b & ge3) | ((a^b) & ge2);
+                const bool shared = (a & b) != 0;
+                const double score = N.volume(kept) - N.volume(a) - N.volume(b);
+                const double cost = N.volume(a|b);
+                if(first || (shared && !best_shared) ||
+                   (shared == best_shared && (score < best_score || (score == best_score && cost < best_cost))))
+                {
+                    best_i = i;
+                    best_j = j;
+                    best_shared = shared;
+                    best_score = score;
+                    best_cost = cost;
+                    first = false;
+                }
+            }
+        }
+        const LabelSet a = ops[best_i], b = ops[best_j];
+        const LabelSet kept = ((a|b) & N.output) | (a & b & ge3) | ((a^b) & ge2);
+        steps.push_back({best_i, best_j});
+        ops.erase(ops.begin()+best_j);
+        ops.erase(ops.begin()+best_i);
+        ops.push_back(kept);
+    }
+    return steps;
+}
+
+// cheapest path by dynamic programming over all subsets of operands, O(3^n)
+static vector<pair<size_t,size_t>> optimal_path(const Network &N)
+{
+    const size_t n = N.operand.size();
+    const size_t full = (size_t(1) << n) - 1;
+    vector<LabelSet> labels(full+1, 0);
+    for(size_t S=1; S<=full; S++)
+    {
+        labels[S] = labels[S & (S-1)] | N.operand[__builtin_ctzll(S)];
+    }
+    // labels of the product of the operands in S that are still needed, single operands enter a product as they are
+    auto kept = [&](size_t S)
+    {
+        return (S & (S-1)) ? labels[S] & (N.output | labels[full ^ S]) : labels[S];
+    };
+
+    vector<double> cost(full+1, numeric_limits<double>::infinity());
+    vector<size_t> split(full+1, 0);
+    for(size_t S=1; S<=full; S++)
+    {
+        const size_t low = S & (~S+1);
+        const size_t rest = S ^ low;
+        if(rest == 0)
+        {
+            cost[S] = 0.0;
+            continue;
+        }
+        // A contains the lowest operand of S, such that every split is visited once
+        for(size_t sub=(rest-1)&rest; ; sub=(sub-1)&rest)
+        {
+            const size_t A = low | sub;
+            const size_t B = S ^ A;
+            const double c = cost[A] + cost[B] + N.volume(kept(A) | kept(B));
+            if(c < cost[S])
+            {
+                cost[S] = c;
+                split[S] = A;
+            }
+            if(sub == 0)
+            {
+                break;
+            }
+        }
+    }
+
+    // products in post-order, in positions of the current list of operands
+    vector<pair<size_t,size_t>> steps;
+    vector<size_t> current(n);
+    for(size_t op=0; op<n; op++)
+    {
+        current[op] = op;
+    }
+    size_t next_id = n;
+    function<size_t(size_t)> build = [&](size_t S) -> size_t
+    {
+        if((S & (S-1)) == 0)
+        {
+            return __builtin_ctzll(S);
+        }
+        const size_t a = build(split[S]);
+        const size_t b = build(S ^ split[S]);
+        size_t i = find(current.begin(), current.end(), a) - current.begin();
+        size_t j = find(current.begin(), current.end(), b) - current.begin();
+        if(i > j)
+        {
+            swap(i, j);
+        }
+        steps.push_back({i, j});
+        current.erase(current.begin()+j);
+        current.erase(current.begin()+i);
+        current.push_back(next_id);
+        return next_id++;
+    };
+    build(full);
+    return steps;
+}
+
+/**
+    CONSTRUCTOR
+**/
+
+ContractionPath::ContractionPath() : n_operands(0), path_flops(0.0), order_flops(0.0), max_intermediate(0)
+{
+    //
+}
+
+ContractionPath::ContractionPath(
+    const vector<vector<size_t>>    &shapes,
+    const vector<vector<int>>       &labels,
+    Strategy                        strategy) :
+    n_operands(shapes.size()),
+    max_intermediate(0)
+{
+    const Network N = analyze(shapes, labels);
+    if(strategy == Strategy::AUTO)
+    {
+        strategy = (n_operands <= OPTIMAL_LIMIT) ? Strategy::OPTIMAL : Strategy::GREEDY;
+    }
+    if(n_operands > 1)
+    {
+        path = (strategy == Strategy::OPTIMAL) ? optimal_path(N) : greedy_path(N);
+    }
+    vector<pair<size_t,size_t>> in_order;
+    for(size_t op=1; op<n_operands; op++)
+    {
+        in_order.push_back({0, 1});
+    }
+    path_flops = path_flops_of(N, path);
+    order_flops = path_flops_of(N, in_order);
+
+    if(n_operands == 1)
+    {
+        plans.push_back(ContractionPlan(shapes[0], labels[0]));
+        result_shape = plans.back().shape();
+        return;
+    }
+
+    // plan every product: labels that are kept get the non-negative plan labels 0,1,... in the order of the intermediate
+    vector<vector<size_t>> op_shapes = shapes;
+    vector<vector<int>> op_labels = labels;
+    for(auto it=path.begin(); it!=path.end(); it++)
+    {
+        const size_t i = it->first, j = it->second;
+        vector<int> others;
+        for(size_t k=0; k<op_labels.size(); k++)
+        {
+            if(k != i && k != j)
+            {
+                others.insert(others.end(), op_labels[k].begin(), op_labels[k].end());
+            }
+        }
+        vector<int> distinct(op_labels[i]);
+        distinct.insert(distinct.end(), op_labels[j].begin(), op_labels[j].end());
+        vector<int> kept;
+        vector<int> summed;
+        for(auto l=distinct.begin(); l!=distinct.end(); l++)
+        {
+            if(find(kept.begin(), kept.end(), *l) != kept.end() || find(summed.begin(), summed.end(), *l) != summed.end())
+            {
+                continue;
+            }
+            if(*l >= 0 || find(others.begin(), others.end(), *l) != others.end())
+            {
+                kept.push_back(*l);
+            }
+            else
+            {
+                summed.push_back(*l);
+            }
+        }
+        if(op_labels.size() == 2)
+        {
+            sort(kept.begin(), kept.end()); // final result in increasing order of the labels
+        }
+        auto plan_labels = [&](const vector<int> &op)
+        {
+            vector<int> result(op.size());
+            for(size_t dim=0; dim<op.size(); dim++)
+            {
+                const size_t k = find(kept.begin(), kept.end(), op[dim]) - kept.begin();
+                if(k < kept.size())
+                {
+                    result[dim] = int(k);
+                }
+                else
+                {
+                    result[dim] = -1 - int(find(summed.begin(), summed.end(), op[dim]) - summed.begin());
+                }
+            }
+            return result;
+        };
+        plans.push_back(ContractionPlan(op_shapes[i], plan_labels(op_labels[i]), op_shapes[j], plan_labels(op_labels[j])));
+        if(op_labels.size() > 2)
+        {
+            max_intermediate = max(max_intermediate, plans.back().size());
+        }
+
+        op_shapes.erase(op_shapes.begin()+j);
+        op_shapes.erase(op_shapes.begin()+i);
+        op_shapes.push_back(plans.back().shape());
+        op_labels.erase(op_labels.begin()+j);
+        op_labels.erase(op_labels.begin()+i);
+        op_labels.push_back(kept);
+    }
+    result_shape = plans.back().shape();
+}
+
+/**
+    ACCESS
+**/
+
+size_t ContractionPath::operands() const
+{
+    return n_operands;
+}
+
+const vector<pair<size_t,size_t>>& ContractionPath::steps() const
+{
+    return path;
+}
+
+const vector<size_t>& ContractionPath::shape() const
+{
+    return result_shape;
+}
+
+double ContractionPath::flops() const
+{
+    return path_flops;
+}
+
+double ContractionPath::naive_flops() const
+{
+    return order_flops;
+}
+
+size_t ContractionPath::largest_intermediate() const
+{
+    return max_intermediate;
+}
+
+/**
+    EXECUTE
+**/
+
+template<class T>
+void ContractionPath::execute(const vector<const TensorBase<T>*> &operands, TensorBase<T> &result) const
+{
+    PROFILE_SCOPE("ContractionPath::execute");
+    if(THROW_BASIC_EXCEPTIONS && (operands.size() != n_operands || n_operands == 0))
+    {
+        throw ShapeMismatch("TensorUtils::ContractionPath::execute:: Number of operands does not match the path!");
+    }
+    if(n_operands == 1)
+    {
+        plans[0].execute(*operands[0], result);
+        return;
+    }
+
+    // intermediates live in buffers that are handed to the next product as soon as they have been consumed
+    vector<const TensorBase<T>*> current(operands);
+    vector<size_t> owner(current.size(), size_t(-1));
+    vector<TensorBase<T>> buffers;
+    buffers.reserve(path.size());
+    vector<size_t> free_buffers;
+    for(size_t step=0; step<path.size(); step++)
+    {
+        const size_t i = path[step].first, j = path[step].second;
+        const ContractionPlan &plan = plans[step];
+        TensorBase<T>* out = &result;
+        size_t out_owner = size_t(-1);
+        if(step+1 < path.size())
+        {
+            if(free_buffers.empty())
+            {
+                buffers.emplace_back();
+                free_buffers.push_back(buffers.size()-1);
+            }
+            // smallest buffer that fits, else the largest one
+            auto pick = free_buffers.begin();
+            for(auto it=free_buffers.begin(); it!=free_buffers.end(); it++)
+            {
+                const size_t cap = buffers[*it].capacity(), best = buffers[*pick].capacity();
+                if((cap >= plan.size() && (best < plan.size() || cap < best)) || (best < plan.size() && cap > best))
+                {
+                    pick = it;
+                }
+            }
+            out_owner = *pick;
+            out = &buffers[out_owner];
+            free_buffers.erase(pick);
+        }
+        plan.execute(*current[i], *current[j], *out);
+
+        for(size_t k : {i, j})
+        {
+            if(owner[k] != size_t(-1))
+            {
+                free_buffers.push_back(owner[k]);
+            }
+        }
+        current.erase(current.begin()+j);
+        current.erase(current.begin()+i);
+        current.push_back(out);
+        owner.erase(owner.begin()+j);
+        owner.erase(owner.begin()+i);
+        owner.push_back(out_owner);
+    }
+}
+
+/**
+    EXPLICIT TEMPLATE INSTANTIATION
+**/
+
+namespace TensorUtils
+{
+    #define INSTANTIATE_ALL(X) \
+    template void ContractionPath::execute(const vector<const TensorBase<X>*>&, TensorBase<X>&) const;
+
+    #ifndef ENABLE_INTEGRAL_TYPES
+    #define ENABLE_INTEGRAL_TYPES 1
+    #endif // ENABLE_INTEGRAL_TYPES
+
+    INSTANTIATE_ALL(double)
+    INSTANTIATE_ALL(float)
+    INSTANTIATE_ALL(long double)
+    #if ENABLE_INTEGRAL_TYPES == 1
+        INSTANTIATE_ALL(unsigned char)
+        INSTANTIATE_ALL(signed char)
+        INSTANTIATE_ALL(unsigned short)
+        INSTANTIATE_ALL(short)
+        INSTANTIATE_ALL(unsigned)
+        INSTANTIATE_ALL(int)
+        INSTANTIATE_ALL(unsigned long)
+        INSTANTIATE_ALL(long)
+        INSTANTIATE_ALL(unsigned long long)
+        INSTANTIATE_ALL(long long)
+    #endif
+
+    #undef INSTANTIATE_ALL
+}
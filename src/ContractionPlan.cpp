@@ -0,0 +1,796 @@
+/*
+TensorUtils Version 0.1
+
+Copyright 2022 Christoph Widder
+
+This file is part of TensorUtils.
+
+TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+the GNU General Public License as published by the Free Software Foundation, either
+version 3 of the License, or (at your option) any later version.
+
+TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with TensorUtils.
+If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef THROW_EXCEPTIONS
+#define THROW_EXCEPTIONS 0
+#endif // THROW_EXCEPTIONS
+
+#ifndef THROW_BASIC_EXCEPTIONS
+#define THROW_BASIC_EXCEPTIONS 1
+#endif // THROW_BASIC_EXCEPTIONS
+
+#include "ContractionPlan.hpp"
+#include "ErrorHandler.hpp"
+#include "Gemm.hpp"
+#include "Profile.hpp"
+#include "StridedLoop.hpp"
+#include "ThreadPool.hpp"
+
+#include <array>
+#include <map>
+
+using namespace std;
+using namespace TensorUtils;
+using namespace ErrorHandler;
+
+/**
+    SCHEDULE
+**/
+
+struct ContractionPlan::Schedule
+{
+    bool binary = false;
+
+    vector<size_t> shape_lhs;
+    vector<size_t> shape_rhs;
+    vector<size_t> incr_lhs;
+    vector<size_t> incr_rhs;
+    vector<size_t> shape_final;
+    size_t size_final = 1;
+    size_t size_contr = 1;
+
+    // offsets of the sub-tensor addressed by idx_at, and extents and strides of the indices fixed by idx_at
+    size_t a0 = 0;
+    size_t b0 = 0;
+    vector<size_t> at_extent;
+    vector<size_t> at_strideA;
+    vector<size_t> at_strideB;
+
+    // loops over the free indices of the result (operands A, B, C) and over the summation indices (operands A, B)
+    Kernels::StridedLoop<3> final_loop;
+    Kernels::StridedLoop<2> contr_loop;
+
+    // (batched) matrix products are dispatched to the blocked GEMM kernel
+    bool use_gemm = false;
+    Kernels::GemmLayout layout;
+};
+
+// occurrence of an index label in both operands
+struct LabelInfo
+{
+    size_t extent = 0;
+    unsigned countA = 0;
+    unsigned countB = 0;
+    size_t strideA = 0; // sum of the strides of all occurrences: repeated indices address diagonals
+    size_t strideB = 0;
+};
+
+static vector<size_t> contiguous_strides(const vector<size_t> &shape)
+{
+    vector<size_t> incr(shape.size());
+    size_t stride = 1;
+    for(unsigned dim=shape.size(); dim>0; dim--)
+    {
+        incr[dim-1] = stride;
+        stride *= shape[dim-1];
+    }
+    return incr;
+}
+
+static void insert_labels(
+    map<int,LabelInfo>      &labels,
+    const vector<size_t>    &shape,
+    const vector<size_t>    &incr,
+    const vector<int>       &idx,
+    bool                    lhs)
+{
+    for(unsigned n=0; n<idx.size(); n++)
+    {
+        LabelInfo &info = labels[idx[n]];
+        if(info.countA+info.countB == 0)
+        {
+            info.extent = shape[n];
+        }
+        else if(THROW_BASIC_EXCEPTIONS && info.extent != shape[n])
+        {
+            throw ShapeMismatch("TensorUtils::ContractionPlan::ContractionPlan:: Shape mismatch!");
+        }
+        if(lhs)
+        {
+            info.countA++;
+            info.strideA += incr[n];
+        }
+        else
+        {
+            info.countB++;
+            info.strideB += incr[n];
+        }
+    }
+}
+
+// Tries to write the product as a batched matrix product C[b,m,n] = sum_k A[b,m,k]*B[b,k,n].
+// Returns false if an index occurs more than once in one operand, if a summation index occurs in one operand only
+// or if the problem is too small to benefit from the blocked kernel.
+static bool gemm_layout(
+    const vector<LabelInfo>     &final_labels,
+    const vector<size_t>        &final_strideC,
+    const vector<LabelInfo>     &contr_labels,
+    Kernels::GemmLayout         &L)
+{
+    if(contr_labels.empty())
+    {
+        return false;
+    }
+
+    vector<size_t> ext_b, ext_m, ext_n, ext_k;
+    vector<size_t> a_b, b_b, c_b, a_m, c_m, b_n, c_n, a_k, b_k;
+
+    for(unsigned n=0; n<final_labels.size(); n++)
+    {
+        const LabelInfo &info = final_labels[n];
+        if(info.countA>1 || info.countB>1)
+        {
+            return false;
+        }
+        if(info.countA && info.countB) // Hadamard index
+        {
+            ext_b.push_back(info.extent);
+            a_b.push_back(info.strideA);
+            b_b.push_back(info.strideB);
+            c_b.push_back(final_strideC[n]);
+        }
+        else if(info.countA)
+        {
+            ext_m.push_back(info.extent);
+            a_m.push_back(info.strideA);
+            c_m.push_back(final_strideC[n]);
+        }
+        else
+        {
+            ext_n.push_back(info.extent);
+            b_n.push_back(info.strideB);
+            c_n.push_back(final_strideC[n]);
+        }
+    }
+    for(auto it=contr_labels.begin(); it!=contr_labels.end(); it++)
+    {
+        if(it->countA!=1 || it->countB!=1)
+        {
+            return false;
+        }
+        ext_k.push_back(it->extent);
+        a_k.push_back(it->strideA);
+        b_k.push_back(it->strideB);
+    }
+
+    size_t work = 1;
+    for(auto it=ext_m.begin(); it!=ext_m.end(); it++) { work *= *it; }
+    for(auto it=ext_n.begin(); it!=ext_n.end(); it++) { work *= *it; }
+    for(auto it=ext_k.begin(); it!=ext_k.end(); it++) { work *= *it; }
+    if(work < Kernels::GEMM_MIN_WORK)
+    {
+        return false;
+    }
+
+    L.a_b = Kernels::group_offsets(ext_b, a_b);
+    L.b_b = Kernels::group_offsets(ext_b, b_b);
+    L.c_b = Kernels::group_offsets(ext_b, c_b);
+    L.a_m = Kernels::group_offsets(ext_m, a_m);
+    L.c_m = Kernels::group_offsets(ext_m, c_m);
+    L.b_n = Kernels::group_offsets(ext_n, b_n);
+    L.c_n = Kernels::group_offsets(ext_n, c_n);
+    L.a_k = Kernels::group_offsets(ext_k, a_k);
+    L.b_k = Kernels::group_offsets(ext_k, b_k);
+    L.batch = L.c_b.size();
+    L.M = L.c_m.size();
+    L.N = L.c_n.size();
+    L.K = L.a_k.size();
+    return true;
+}
+
+static shared_ptr<const ContractionPlan::Schedule> build_schedule(
+    bool                    binary,
+    const vector<size_t>    &shape_lhs,
+    const vector<size_t>    &incr_lhs,
+    const vector<int>       &idx_lhs,
+    const vector<size_t>    &shape_rhs,
+    const vector<size_t>    &incr_rhs,
+    const vector<int>       &idx_rhs,
+    const vector<size_t>    &idx_at)
+{
+    if(THROW_BASIC_EXCEPTIONS && (shape_lhs.size()!=idx_lhs.size() || shape_rhs.size()!=idx_rhs.size()
+                                  || incr_lhs.size()!=idx_lhs.size() || incr_rhs.size()!=idx_rhs.size()))
+    {
+        throw ShapeMismatch("TensorUtils::ContractionPlan::ContractionPlan:: Shape mismatch!");
+    }
+
+    auto S = make_shared<ContractionPlan::Schedule>();
+    S->binary = binary;
+    S->shape_lhs = shape_lhs;
+    S->shape_rhs = shape_rhs;
+    S->incr_lhs = incr_lhs;
+    S->incr_rhs = incr_rhs;
+
+    // labels in increasing order: summation indices first, then the indices of the result
+    map<int,LabelInfo> labels;
+    insert_labels(labels, shape_lhs, incr_lhs, idx_lhs, true);
+    insert_labels(labels, shape_rhs, incr_rhs, idx_rhs, false);
+
+    vector<LabelInfo> final_labels;
+    vector<LabelInfo> contr_labels;
+    for(auto it=labels.begin(); it!=labels.end(); it++)
+    {
+        if(it->first<0)
+        {
+            contr_labels.push_back(it->second);
+        }
+        else
+        {
+            final_labels.push_back(it->second);
+        }
+    }
+
+    if(THROW_BASIC_EXCEPTIONS && idx_at.size()>final_labels.size())
+    {
+        throw ShapeMismatch("TensorUtils::ContractionPlan::ContractionPlan:: Shape mismatch!");
+    }
+
+    // indices fixed by idx_at only shift the operands
+    for(unsigned n=0; n<idx_at.size(); n++)
+    {
+        const LabelInfo &info = final_labels[n];
+        if(THROW_EXCEPTIONS && idx_at[n]>=info.extent)
+        {
+            throw out_of_range("TensorUtils::ContractionPlan::ContractionPlan:: Index out of range!");
+        }
+        S->a0 += idx_at[n]*info.strideA;
+        S->b0 += idx_at[n]*info.strideB;
+        S->at_extent.push_back(info.extent);
+        S->at_strideA.push_back(info.strideA);
+        S->at_strideB.push_back(info.strideB);
+    }
+    final_labels.erase(final_labels.begin(), final_labels.begin()+idx_at.size());
+
+    for(auto it=final_labels.begin(); it!=final_labels.end(); it++)
+    {
+        S->shape_final.push_back(it->extent);
+        S->size_final *= it->extent;
+    }
+    vector<size_t> final_strideC = contiguous_strides(S->shape_final);
+    for(unsigned n=0; n<final_labels.size(); n++)
+    {
+        S->final_loop.push_back(final_labels[n].extent, {final_labels[n].strideA, final_labels[n].strideB, final_strideC[n]});
+    }
+    for(auto it=contr_labels.begin(); it!=contr_labels.end(); it++)
+    {
+        S->contr_loop.push_back(it->extent, {it->strideA, it->strideB});
+        S->size_contr *= it->extent;
+    }
+    S->final_loop.merge();
+    S->contr_loop.merge();
+
+    if(binary)
+    {
+        S->use_gemm = gemm_layout(final_labels, final_strideC, contr_labels, S->layout);
+    }
+    return S;
+}
+
+// Small contractions are dominated by the analysis of the labels, in particular if dot and contract are
+// called in a loop. Every thread keeps its last schedules and reuses them for identical arguments.
+static constexpr size_t SCHEDULE_CACHE_SIZE = 8;
+
+struct CachedSchedule
+{
+    vector<int> idx_lhs;
+    vector<int> idx_rhs;
+    vector<size_t> idx_at;
+    shared_ptr<const ContractionPlan::Schedule> schedule;
+};
+
+static thread_local array<CachedSchedule,SCHEDULE_CACHE_SIZE> schedule_cache;
+static thread_local size_t schedule_cache_next = 0;
+
+static shared_ptr<const ContractionPlan::Schedule> make_schedule(
+    bool                    binary,
+    const vector<size_t>    &shape_lhs,
+    const vector<size_t>    &incr_lhs,
+    const vector<int>       &idx_lhs,
+    const vector<size_t>    &shape_rhs,
+    const vector<size_t>    &incr_rhs,
+    const vector<int>       &idx_rhs,
+    const vector<size_t>    &idx_at)
+{
+    for(auto it=schedule_cache.begin(); it!=schedule_cache.end(); it++)
+    {
+        const ContractionPlan::Schedule* S = it->schedule.get();
+        if(S && S->binary==binary && S->shape_lhs==shape_lhs && S->incr_lhs==incr_lhs
+             && S->shape_rhs==shape_rhs && S->incr_rhs==incr_rhs
+             && it->idx_lhs==idx_lhs && it->idx_rhs==idx_rhs && it->idx_at==idx_at)
+        {
+            return it->schedule;
+        }
+    }
+
+    shared_ptr<const ContractionPlan::Schedule> S = build_schedule(binary, shape_lhs, incr_lhs, idx_lhs, shape_rhs, incr_rhs, idx_rhs, idx_at);
+    CachedSchedule &entry = schedule_cache[schedule_cache_next];
+    schedule_cache_next = (schedule_cache_next+1)%SCHEDULE_CACHE_SIZE;
+    entry.idx_lhs = idx_lhs;
+    entry.idx_rhs = idx_rhs;
+    entry.idx_at = idx_at;
+    entry.schedule = S;
+    return S;
+}
+
+/**
+    CONSTRUCTORS
+**/
+
+ContractionPlan::ContractionPlan()
+{
+    //
+}
+
+ContractionPlan::ContractionPlan(
+    const vector<size_t>    &shape_lhs,
+    const vector<int>       &idx_lhs,
+    const vector<size_t>    &shape_rhs,
+    const vector<int>       &idx_rhs,
+    const vector<size_t>    &idx_at)
+{
+    PROFILE_SCOPE("ContractionPlan::analyze");
+    schedule = make_schedule(true, shape_lhs, contiguous_strides(shape_lhs), idx_lhs,
+                             shape_rhs, contiguous_strides(shape_rhs), idx_rhs, idx_at);
+}
+
+ContractionPlan::ContractionPlan(
+    const vector<size_t>    &shape_lhs,
+    const vector<size_t>    &incr_lhs,
+    const vector<int>       &idx_lhs,
+    const vector<size_t>    &shape_rhs,
+    const vector<size_t>    &incr_rhs,
+    const vector<int>       &idx_rhs,
+    const vector<size_t>    &idx_at)
+{
+    PROFILE_SCOPE("ContractionPlan::analyze");
+    schedule = make_schedule(true, shape_lhs, incr_lhs, idx_lhs, shape_rhs, incr_rhs, idx_rhs, idx_at);
+}
+
+ContractionPlan::ContractionPlan(
+    const vector<size_t>    &shape_lhs,
+    const vector<int>       &idx_lhs,
+    const vector<size_t>    &idx_at)
+{
+    PROFILE_SCOPE("ContractionPlan::analyze");
+    schedule = make_schedule(false, shape_lhs, contiguous_strides(shape_lhs), idx_lhs, {}, {}, {}, idx_at);
+}
+
+ContractionPlan::ContractionPlan(
+    const vector<size_t>    &shape_lhs,
+    const vector<size_t>    &incr_lhs,
+    const vector<int>       &idx_lhs,
+    const vector<size_t>    &idx_at)
+{
+    PROFILE_SCOPE("ContractionPlan::analyze");
+    schedule = make_schedule(false, shape_lhs, incr_lhs, idx_lhs, {}, {}, {}, idx_at);
+}
+
+const vector<size_t>& ContractionPlan::shape() const
+{
+    return schedule->shape_final;
+}
+
+size_t ContractionPlan::size() const
+{
+    return schedule->size_final;
+}
+
+bool ContractionPlan::binary() const
+{
+    return schedule->binary;
+}
+
+/**
+    EXECUTE
+**/
+
+// sum over a row of summation indices
+template<bool BINARY, class T, class TA, class TB>
+inline void accumulate_row(T &buff, const TA* A, size_t sa, const TB* B, size_t sb, size_t n)
+{
+    if(BINARY)
+    {
+        if(sa == 1 && sb == 1) // unit stride: independent partial sums
+        {
+            T s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+            size_t j=0;
+            for(; j+4<=n; j+=4)
+            {
+                s0 += A[j]*B[j];
+                s1 += A[j+1]*B[j+1];
+                s2 += A[j+2]*B[j+2];
+                s3 += A[j+3]*B[j+3];
+            }
+            for(; j<n; j++)
+            {
+                s0 += A[j]*B[j];
+            }
+            buff += (s0+s1)+(s2+s3);
+        }
+        else
+        {
+            for(size_t j=0; j<n; j++)
+            {
+                buff += A[j*sa]*B[j*sb];
+            }
+        }
+    }
+    else
+    {
+        if(sa == 1)
+        {
+            T s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+            size_t j=0;
+            for(; j+4<=n; j+=4)
+            {
+                s0 += A[j];
+                s1 += A[j+1];
+                s2 += A[j+2];
+                s3 += A[j+3];
+            }
+            for(; j<n; j++)
+            {
+                s0 += A[j];
+            }
+            buff += (s0+s1)+(s2+s3);
+        }
+        else
+        {
+            for(size_t j=0; j<n; j++)
+            {
+                buff += A[j*sa];
+            }
+        }
+    }
+}
+
+// epilogue of all kernels: c = alpha*val + beta*c, c is not read if beta is zero
+template<class T>
+inline void store(T &c, const T &val, const T &alpha, const T &beta)
+{
+    c = (beta == T(0)) ? alpha*val : alpha*val + beta*c;
+}
+
+// Loops over all free indices of the result and sums over all summation indices.
+// The components of the result are partitioned across threads.
+template<bool BINARY, class T, class TA, class TB>
+static void execute_loops(const ContractionPlan::Schedule &S, const TA* A, const TB* B, T* C, size_t a0, size_t b0, const T &alpha, const T &beta)
+{
+    typedef Kernels::StridedLoop<3>::Offsets Offsets3;
+    typedef Kernels::StridedLoop<2>::Offsets Offsets2;
+
+    if(S.contr_loop.rank() == 0) // nothing to sum over: element-wise product or copy
+    {
+        Parallel::parallel_run(S.final_loop, {a0, b0, 0}, [&](const Offsets3 &off, size_t n, const Offsets3 &st)
+        {
+            const TA* a = A+off[0];
+            const TB* b = B+off[1];
+            T* c = C+off[2];
+            for(size_t i=0; i<n; i++)
+            {
+                T buff = 0;
+                if(BINARY)
+                {
+                    buff += a[i*st[0]]*b[i*st[1]];
+                }
+                else
+                {
+                    buff += a[i*st[0]];
+                }
+                store(c[i*st[2]], buff, alpha, beta);
+            }
+        });
+        return;
+    }
+
+    Parallel::parallel_run(S.final_loop, {a0, b0, 0}, [&](const Offsets3 &off, size_t n, const Offsets3 &st)
+    {
+        for(size_t i=0; i<n; i++)
+        {
+            T buff = 0;
+            S.contr_loop.run({off[0]+i*st[0], off[1]+i*st[1]}, [&](const Offsets2 &c, size_t m, const Offsets2 &cs)
+            {
+                accumulate_row<BINARY>(buff, A+c[0], cs[0], B+c[1], cs[1], m);
+            });
+            store(C[off[2]+i*st[2]], buff, alpha, beta);
+        }
+    }, S.size_contr);
+}
+
+// Partitions the (batched) matrix product into column panels of at least 8 register blocks.
+template<class T, class TA, class TB>
+static void execute_gemm(const Kernels::GemmLayout &L, const TA* A, const TB* B, T* C, const T &alpha, const T &beta)
+{
+    const size_t threads = Parallel::num_threads();
+    if(threads <= 1 || L.M == 0 || L.N == 0 || L.K == 0)
+    {
+        Kernels::gemm(L, A, B, C, alpha, beta);
+        return;
+    }
+    constexpr size_t NR = Kernels::GemmBlocking<T>::NR;
+    const size_t panels_per_batch = (threads+L.batch-1)/L.batch;
+    size_t width = (L.N+panels_per_batch-1)/panels_per_batch;
+    width = max((width+NR-1)/NR*NR, 8*NR);
+    const size_t n_panels = (L.N+width-1)/width;
+
+    Parallel::parallel_for(L.batch*n_panels, [&](size_t first, size_t last)
+    {
+        for(size_t p=first; p<last; p++)
+        {
+            const size_t b = p/n_panels;
+            const size_t n_begin = (p%n_panels)*width;
+            Kernels::gemm_panel(L, A, B, C, b, n_begin, min(n_begin+width, L.N), alpha, beta);
+        }
+    }, L.M*L.K*width);
+}
+
+// computes alpha times the sub-tensor at the offsets a0 and b0 of the operands plus beta*C
+template<class T, class TA, class TB>
+static void execute_at(const ContractionPlan::Schedule &S, const TA* A, const TB* B, T* C, size_t a0, size_t b0,
+                       const T &alpha = T(1), const T &beta = T(0))
+{
+    if(!S.binary)
+    {
+        execute_loops<false>(S, A, B, C, a0, b0, alpha, beta);
+    }
+    else if(S.use_gemm)
+    {
+        execute_gemm(S.layout, A+a0, B+b0, C, alpha, beta);
+    }
+    else
+    {
+        execute_loops<true>(S, A, B, C, a0, b0, alpha, beta);
+    }
+}
+
+// Computes the sub-tensors at all prefixes one after each other. Large batches are partitioned across threads,
+// otherwise every sub-tensor is partitioned on its own.
+template<class T, class TA, class TB>
+static void execute_batch(const ContractionPlan::Schedule &S, const TA* A, const TB* B, T* C, const vector<vector<size_t>> &idx_at)
+{
+    vector<size_t> a0(idx_at.size(), 0);
+    vector<size_t> b0(idx_at.size(), 0);
+    for(size_t n=0; n<idx_at.size(); n++)
+    {
+        if(THROW_BASIC_EXCEPTIONS && idx_at[n].size()!=S.at_extent.size())
+        {
+            throw ShapeMismatch("TensorUtils::ContractionPlan::execute:: All prefixes must have the length of the planned idx_at!");
+        }
+        for(size_t dim=0; dim<idx_at[n].size(); dim++)
+        {
+            if(THROW_EXCEPTIONS && idx_at[n][dim]>=S.at_extent[dim])
+            {
+                throw out_of_range("TensorUtils::ContractionPlan::execute:: Index out of range!");
+            }
+            a0[n] += idx_at[n][dim]*S.at_strideA[dim];
+            b0[n] += idx_at[n][dim]*S.at_strideB[dim];
+        }
+    }
+
+    if(idx_at.size() >= Parallel::num_threads())
+    {
+        Parallel::parallel_for(idx_at.size(), [&](size_t first, size_t last)
+        {
+            for(size_t n=first; n<last; n++)
+            {
+                execute_at(S, A, B, C+n*S.size_final, a0[n], b0[n]);
+            }
+        }, S.size_final*S.size_contr);
+    }
+    else
+    {
+        for(size_t n=0; n<idx_at.size(); n++)
+        {
+            execute_at(S, A, B, C+n*S.size_final, a0[n], b0[n]);
+        }
+    }
+}
+
+template<class T, class T2>
+void ContractionPlan::execute(const T* lhs, const T2* rhs, T* result) const
+{
+    PROFILE_SCOPE("ContractionPlan::execute");
+    execute_at(*schedule, lhs, rhs, result, schedule->a0, schedule->b0);
+}
+
+template<class T>
+void ContractionPlan::execute(const T* lhs, T* result) const
+{
+    PROFILE_SCOPE("ContractionPlan::execute");
+    execute_at(*schedule, lhs, (const T*)nullptr, result, schedule->a0, schedule->b0);
+}
+
+template<class T, class T2>
+void ContractionPlan::execute(const T* lhs, const T2* rhs, T* result, const T &alpha, const T &beta) const
+{
+    PROFILE_SCOPE("ContractionPlan::execute");
+    execute_at(*schedule, lhs, rhs, result, schedule->a0, schedule->b0, alpha, beta);
+}
+
+template<class T>
+void ContractionPlan::execute(const T* lhs, T* result, const T &alpha, const T &beta) const
+{
+    PROFILE_SCOPE("ContractionPlan::execute");
+    execute_at(*schedule, lhs, (const T*)nullptr, result, schedule->a0, schedule->b0, alpha, beta);
+}
+
+template<class T, class T2>
+void ContractionPlan::execute(const T* lhs, const T2* rhs, T* result, const vector<vector<size_t>> &idx_at) const
+{
+    if(THROW_BASIC_EXCEPTIONS && (!schedule || !schedule->binary))
+    {
+        throw ShapeMismatch("TensorUtils::ContractionPlan::execute:: Shape mismatch!");
+    }
+    PROFILE_SCOPE("ContractionPlan::execute_batch");
+    execute_batch(*schedule, lhs, rhs, result, idx_at);
+}
+
+template<class T>
+void ContractionPlan::execute(const T* lhs, T* result, const vector<vector<size_t>> &idx_at) const
+{
+    if(THROW_BASIC_EXCEPTIONS && (!schedule || schedule->binary))
+    {
+        throw ShapeMismatch("TensorUtils::ContractionPlan::execute:: Shape mismatch!");
+    }
+    PROFILE_SCOPE("ContractionPlan::execute_batch");
+    execute_batch(*schedule, lhs, (const T*)nullptr, result, idx_at);
+}
+
+template<class T, class T2>
+void ContractionPlan::execute(const TensorBase<T> &lhs, const TensorBase<T2> &rhs, TensorBase<T> &result) const
+{
+    if(THROW_BASIC_EXCEPTIONS && (!schedule || !schedule->binary
+                                  || lhs.shape!=schedule->shape_lhs || lhs.incr!=schedule->incr_lhs
+                                  || rhs.shape!=schedule->shape_rhs || rhs.incr!=schedule->incr_rhs))
+    {
+        throw ShapeMismatch("TensorUtils::ContractionPlan::execute:: Shape mismatch!");
+    }
+    if(result.shape!=schedule->shape_final || result.size()!=schedule->size_final)
+    {
+        result.alloc(schedule->shape_final);
+    }
+    execute(lhs.data(), rhs.data(), result.data());
+}
+
+template<class T, class T2>
+void ContractionPlan::execute(const TensorView<T> &lhs, const TensorView<T2> &rhs, TensorBase<T> &result) const
+{
+    if(THROW_BASIC_EXCEPTIONS && (!schedule || !schedule->binary
+                                  || lhs.shape!=schedule->shape_lhs || lhs.incr!=schedule->incr_lhs
+                                  || rhs.shape!=schedule->shape_rhs || rhs.incr!=schedule->incr_rhs))
+    {
+        throw ShapeMismatch("TensorUtils::ContractionPlan::execute:: Shape mismatch!");
+    }
+    if(result.shape!=schedule->shape_final || result.size()!=schedule->size_final)
+    {
+        result.alloc(schedule->shape_final);
+    }
+    execute((const T*)lhs.data(), (const T2*)rhs.data(), result.data());
+}
+
+template<class T>
+void ContractionPlan::execute(const TensorBase<T> &lhs, TensorBase<T> &result) const
+{
+    if(THROW_BASIC_EXCEPTIONS && (!schedule || schedule->binary || lhs.shape!=schedule->shape_lhs || lhs.incr!=schedule->incr_lhs))
+    {
+        throw ShapeMismatch("TensorUtils::ContractionPlan::execute:: Shape mismatch!");
+    }
+    if(result.shape!=schedule->shape_final || result.size()!=schedule->size_final)
+    {
+        result.alloc(schedule->shape_final);
+    }
+    execute(lhs.data(), result.data());
+}
+
+template<class T>
+void ContractionPlan::execute(const TensorView<T> &lhs, TensorBase<T> &result) const
+{
+    if(THROW_BASIC_EXCEPTIONS && (!schedule || schedule->binary || lhs.shape!=schedule->shape_lhs || lhs.incr!=schedule->incr_lhs))
+    {
+        throw ShapeMismatch("TensorUtils::ContractionPlan::execute:: Shape mismatch!");
+    }
+    if(result.shape!=schedule->shape_final || result.size()!=schedule->size_final)
+    {
+        result.alloc(schedule->shape_final);
+    }
+    execute((const T*)lhs.data(), result.data());
+}
+
+/**
+    EXPLICIT TEMPLATE INSTANTIATION
+**/
+
+namespace TensorUtils
+{
+    #define INSTANTIATE_FUNCTION_TEMPLATES(X,Y) \
+    template void ContractionPlan::execute<X,Y>(const X*, const Y*, X*) const; \
+    template void ContractionPlan::execute<X,Y>(const X*, const Y*, X*, const X&, const X&) const; \
+    template void ContractionPlan::execute<X,Y>(const X*, const Y*, X*, const vector<vector<size_t>>&) const; \
+    template void ContractionPlan::execute<X,Y>(const TensorBase<X>&, const TensorBase<Y>&, TensorBase<X>&) const; \
+    template void ContractionPlan::execute<X,Y>(const TensorView<X>&, const TensorView<Y>&, TensorBase<X>&) const; \
+
+    #define INSTANTIATE_ALL(X) \
+    template void ContractionPlan::execute<X>(const X*, X*) const; \
+    template void ContractionPlan::execute<X>(const X*, X*, const X&, const X&) const; \
+    template void ContractionPlan::execute<X>(const X*, X*, const vector<vector<size_t>>&) const; \
+    template void ContractionPlan::execute<X>(const TensorBase<X>&, TensorBase<X>&) const; \
+    template void ContractionPlan::execute<X>(const TensorView<X>&, TensorBase<X>&) const; \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,double) \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,float) \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,long double) \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,unsigned char) \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,signed char) \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,unsigned short) \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,short) \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,unsigned) \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,int) \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,unsigned long) \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,long) \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,unsigned long long) \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,long long) \
+
+    #define INSTANTIATE_FLOATING_POINT_TYPES(X) \
+    template void ContractionPlan::execute<X>(const X*, X*) const; \
+    template void ContractionPlan::execute<X>(const X*, X*, const X&, const X&) const; \
+    template void ContractionPlan::execute<X>(const X*, X*, const vector<vector<size_t>>&) const; \
+    template void ContractionPlan::execute<X>(const TensorBase<X>&, TensorBase<X>&) const; \
+    template void ContractionPlan::execute<X>(const TensorView<X>&, TensorBase<X>&) const; \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,double) \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,float) \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,long double)
+
+    #ifndef ENABLE_INTEGRAL_TYPES
+    #define ENABLE_INTEGRAL_TYPES 1
+    #endif // ENABLE_INTEGRAL_TYPES
+
+    #if ENABLE_INTEGRAL_TYPES == 1
+        INSTANTIATE_ALL(double)
+        INSTANTIATE_ALL(float)
+        INSTANTIATE_ALL(long double)
+        INSTANTIATE_ALL(unsigned char)
+        INSTANTIATE_ALL(signed char)
+        INSTANTIATE_ALL(unsigned short)
+        INSTANTIATE_ALL(short)
+        INSTANTIATE_ALL(unsigned)
+        INSTANTIATE_ALL(int)
+        INSTANTIATE_ALL(unsigned long)
+        INSTANTIATE_ALL(long)
+        INSTANTIATE_ALL(unsigned long long)
+        INSTANTIATE_ALL(long long)
+    #else
+        INSTANTIATE_FLOATING_POINT_TYPES(double)
+        INSTANTIATE_FLOATING_POINT_TYPES(float)
+        INSTANTIATE_FLOATING_POINT_TYPES(long double)
+    #endif
+
+    #undef INSTANTIATE_ALL
+    #undef INSTANTIATE_FLOATING_POINT_TYPES
+    #undef INSTANTIATE_FUNCTION_TEMPLATES
+}
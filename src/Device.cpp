@@ -0,0 +1,379 @@
+/*
+TensorUtils Version 0.1
+
+Copyright 2022 Christoph Widder
+
+This file is part of TensorUtils.
+
+TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+the GNU General Public License as published by the Free Software Foundation, either
+version 3 of the License, or (at your option) any later version.
+
+TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with TensorUtils.
+If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include "DeviceBackend.hpp"
+
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+using namespace TensorUtils;
+
+/**
+    RUNTIME
+**/
+
+bool Device::enabled()
+{
+    return ENABLE_CUDA == 1;
+}
+
+#if ENABLE_CUDA == 1
+
+int Device::count()
+{
+    int n = 0;
+    if(cudaGetDeviceCount(&n) != cudaSuccess)
+    {
+        cudaGetLastError();
+        return 0;
+    }
+    return n;
+}
+
+void Device::select(int device)
+{
+    Detail::check(cudaSetDevice(device), "cudaSetDevice");
+}
+
+int Device::current_device()
+{
+    int device = 0;
+    Detail::check(cudaGetDevice(&device), "cudaGetDevice");
+    return device;
+}
+
+void Device::synchronize()
+{
+    Detail::check(cudaDeviceSynchronize(), "cudaDeviceSynchronize");
+}
+
+#else
+
+int Device::count()
+{
+    return 0;
+}
+
+void Device::select(int device)
+{
+    if(device != 0)
+    {
+        throw runtime_error("TensorUtils::Device::select:: Invalid device "+to_string(device)+", the library was built without a GPU backend!");
+    }
+}
+
+int Device::current_device()
+{
+    return 0;
+}
+
+void Device::synchronize()
+{
+    //
+}
+
+#endif // ENABLE_CUDA
+
+/**
+    PINNED MEMORY
+**/
+
+#if ENABLE_CUDA == 1
+namespace
+{
+    class PinnedResource : public Memory::Resource
+    {
+        public:
+            // cudaHostAlloc returns page-aligned blocks
+            void* allocate(size_t bytes) override
+            {
+                void* ptr = nullptr;
+                if(cudaHostAlloc(&ptr, bytes, cudaHostAllocPortable) != cudaSuccess)
+                {
+                    cudaGetLastError();
+                    throw bad_alloc();
+                }
+                return ptr;
+            }
+
+            void deallocate(void* ptr, size_t) override
+            {
+                cudaFreeHost(ptr);
+            }
+    };
+}
+#endif // ENABLE_CUDA
+
+// never destroyed, such that pinned tensors with static storage duration can be destroyed at any time
+Memory::Resource* Device::pinned()
+{
+    #if ENABLE_CUDA == 1
+    static Memory::Resource* resource = new PinnedResource;
+    return resource;
+    #else
+    return Memory::aligned();
+    #endif // ENABLE_CUDA
+}
+
+/**
+    STREAMS
+**/
+
+static thread_local Device::Stream* scoped_stream = nullptr;
+
+Device::Stream::Stream() : handle(nullptr), owned(true)
+{
+    #if ENABLE_CUDA == 1
+    cudaStream_t stream;
+    Detail::check(cudaStreamCreateWithFlags(&stream, cudaStreamNonBlocking), "cudaStreamCreateWithFlags");
+    handle = stream;
+    #endif // ENABLE_CUDA
+}
+
+Device::Stream::Stream(void* handle) : handle(handle), owned(false)
+{
+    //
+}
+
+Device::Stream::~Stream()
+{
+    #if ENABLE_CUDA == 1
+    if(owned)
+    {
+        cudaStreamSynchronize(static_cast<cudaStream_t>(handle));
+        cudaStreamDestroy(static_cast<cudaStream_t>(handle));
+    }
+    #endif // ENABLE_CUDA
+}
+
+void Device::Stream::synchronize()
+{
+    #if ENABLE_CUDA == 1
+    Detail::check(cudaStreamSynchronize(static_cast<cudaStream_t>(handle)), "cudaStreamSynchronize");
+    #endif // ENABLE_CUDA
+}
+
+bool Device::Stream::ready() const
+{
+    #if ENABLE_CUDA == 1
+    const cudaError_t status = cudaStreamQuery(static_cast<cudaStream_t>(handle));
+    if(status == cudaErrorNotReady)
+    {
+        return false;
+    }
+    Detail::check(status, "cudaStreamQuery");
+    #endif // ENABLE_CUDA
+    return true;
+}
+
+void Device::Stream::wait(const Stream &other)
+{
+    #if ENABLE_CUDA == 1
+    // the event is released by the runtime once it has completed
+    cudaEvent_t event;
+    Detail::check(cudaEventCreateWithFlags(&event, cudaEventDisableTiming), "cudaEventCreateWithFlags");
+    Detail::check(cudaEventRecord(event, static_cast<cudaStream_t>(other.handle)), "cudaEventRecord");
+    Detail::check(cudaStreamWaitEvent(static_cast<cudaStream_t>(handle), event, 0), "cudaStreamWaitEvent");
+    cudaEventDestroy(event);
+    #else
+    (void)other;
+    #endif // ENABLE_CUDA
+}
+
+void* Device::Stream::native() const
+{
+    return handle;
+}
+
+Device::Stream& Device::Stream::per_thread()
+{
+    #if ENABLE_CUDA == 1
+    static thread_local Stream stream(cudaStreamPerThread);
+    #else
+    static thread_local Stream stream(nullptr);
+    #endif // ENABLE_CUDA
+    return stream;
+}
+
+Device::Stream& Device::current()
+{
+    return scoped_stream ? *scoped_stream : Stream::per_thread();
+}
+
+Device::Scope::Scope(Stream &stream) : previous(scoped_stream)
+{
+    scoped_stream = &stream;
+}
+
+Device::Scope::~Scope()
+{
+    scoped_stream = previous;
+}
+
+/**
+    PRIMITIVES
+**/
+
+#if ENABLE_CUDA == 1
+
+void Device::Detail::check(cudaError_t status, const char* call)
+{
+    if(status != cudaSuccess)
+    {
+        throw runtime_error(string("TensorUtils::Device:: ")+call+" failed: "+cudaGetErrorString(status));
+    }
+}
+
+void Device::Detail::check(cublasStatus_t status, const char* call)
+{
+    if(status != CUBLAS_STATUS_SUCCESS)
+    {
+        throw runtime_error(string("TensorUtils::Device:: ")+call+" failed: "+cublasGetStatusString(status));
+    }
+}
+
+void Device::Detail::check(cutensorStatus_t status, const char* call)
+{
+    if(status != CUTENSOR_STATUS_SUCCESS)
+    {
+        throw runtime_error(string("TensorUtils::Device:: ")+call+" failed: "+cutensorGetErrorString(status));
+    }
+}
+
+cudaStream_t Device::Detail::native(const Stream &stream)
+{
+    return static_cast<cudaStream_t>(stream.native());
+}
+
+namespace
+{
+    struct CublasHandle
+    {
+        CublasHandle()
+        {
+            Device::Detail::check(cublasCreate(&handle), "cublasCreate");
+        }
+
+        ~CublasHandle()
+        {
+            cublasDestroy(handle);
+        }
+
+        cublasHandle_t handle;
+    };
+
+    struct CutensorHandle
+    {
+        CutensorHandle()
+        {
+            Device::Detail::check(cutensorCreate(&handle), "cutensorCreate");
+        }
+
+        ~CutensorHandle()
+        {
+            cutensorDestroy(handle);
+        }
+
+        cutensorHandle_t handle;
+    };
+}
+
+cublasHandle_t Device::Detail::cublas(Stream &stream)
+{
+    static thread_local CublasHandle cublas_handle;
+    check(cublasSetStream(cublas_handle.handle, native(stream)), "cublasSetStream");
+    return cublas_handle.handle;
+}
+
+cutensorHandle_t Device::Detail::cutensor()
+{
+    static thread_local CutensorHandle cutensor_handle;
+    return cutensor_handle.handle;
+}
+
+void* Device::Detail::allocate(size_t bytes, Stream &stream)
+{
+    void* ptr = nullptr;
+    if(bytes)
+    {
+        check(cudaMallocAsync(&ptr, bytes, native(stream)), "cudaMallocAsync");
+    }
+    return ptr;
+}
+
+void Device::Detail::deallocate(void* ptr, size_t, Stream &stream)
+{
+    if(ptr)
+    {
+        cudaFreeAsync(ptr, native(stream));
+    }
+}
+
+void Device::Detail::copy(void* dst, const void* src, size_t bytes, Stream &stream)
+{
+    if(bytes && dst != src)
+    {
+        check(cudaMemcpyAsync(dst, src, bytes, cudaMemcpyDefault, native(stream)), "cudaMemcpyAsync");
+    }
+}
+
+void Device::Detail::zero(void* dst, size_t bytes, Stream &stream)
+{
+    if(bytes)
+    {
+        check(cudaMemsetAsync(dst, 0, bytes, native(stream)), "cudaMemsetAsync");
+    }
+}
+
+#else
+
+void* Device::Detail::allocate(size_t bytes, Stream&)
+{
+    return bytes ? Memory::aligned()->allocate(bytes) : nullptr;
+}
+
+void Device::Detail::deallocate(void* ptr, size_t bytes, Stream&)
+{
+    if(ptr)
+    {
+        Memory::aligned()->deallocate(ptr, bytes);
+    }
+}
+
+void Device::Detail::copy(void* dst, const void* src, size_t bytes, Stream&)
+{
+    if(bytes && dst != src)
+    {
+        memcpy(dst, src, bytes);
+    }
+}
+
+void Device::Detail::zero(void* dst, size_t bytes, Stream&)
+{
+    if(bytes)
+    {
+        memset(dst, 0, bytes);
+    }
+}
+
+#endif // ENABLE_CUDA
@@ -0,0 +1,73 @@
+/*
+TensorUtils Version 0.1
+
+Copyright 2022 Christoph Widder
+
+This file is part of TensorUtils.
+
+TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+the GNU General Public License as published by the Free Software Foundation, either
+version 3 of the License, or (at your option) any later version.
+
+TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with TensorUtils.
+If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef DEVICEBACKEND_HPP
+#define DEVICEBACKEND_HPP
+
+#include "Device.hpp"
+
+#include <cstddef>
+
+/*
+    Backend of Device.hpp and DeviceTensor.hpp. ENABLE_CUDA=1 selects the CUDA runtime, cuBLAS and cuTENSOR,
+    which requires their headers and libraries, see the makefile. Otherwise device memory is host memory and
+    all primitives run synchronously on the host.
+*/
+#ifndef ENABLE_CUDA
+#define ENABLE_CUDA 0
+#endif // ENABLE_CUDA
+
+#if ENABLE_CUDA == 1
+#include <cublas_v2.h>
+#include <cuda_runtime.h>
+#include <cutensor.h>
+#endif // ENABLE_CUDA
+
+namespace TensorUtils
+{
+    namespace Device
+    {
+        namespace Detail
+        {
+            // device memory in the order of the stream, a block must be freed with the size it was allocated with
+            void* allocate(size_t bytes, Stream &stream);
+            void deallocate(void* ptr, size_t bytes, Stream &stream);
+
+            // copies between any two of host and device memory, asynchronous unless the host memory is pageable
+            void copy(void* dst, const void* src, size_t bytes, Stream &stream);
+            void zero(void* dst, size_t bytes, Stream &stream);
+
+            #if ENABLE_CUDA == 1
+            // throws std::runtime_error with the name of the failed call
+            void check(cudaError_t status, const char* call);
+            void check(cublasStatus_t status, const char* call);
+            void check(cutensorStatus_t status, const char* call);
+
+            cudaStream_t native(const Stream &stream);
+
+            // handles of the calling thread, the cuBLAS handle is bound to the stream
+            cublasHandle_t cublas(Stream &stream);
+            cutensorHandle_t cutensor();
+            #endif // ENABLE_CUDA
+        }
+    }
+}
+
+#endif // DEVICEBACKEND_HPP
@@ -0,0 +1,745 @@
+/*
+TensorUtils Version 0.1
+
+Copyright 2022 Christoph Widder
+
+This file is part of TensorUtils.
+
+TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+the GNU General Public License as published by the Free Software Foundation, either
+version 3 of the License, or (at your option) any later version.
+
+TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with TensorUtils.
+If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef THROW_BASIC_EXCEPTIONS
+#define THROW_BASIC_EXCEPTIONS 1
+#endif // THROW_BASIC_EXCEPTIONS
+
+#include "DeviceTensor.hpp"
+#include "ContractionPlan.hpp"
+#include "DeviceBackend.hpp"
+#include "Profile.hpp"
+#include "Simd.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+
+using namespace std;
+using namespace TensorUtils;
+using namespace ErrorHandler;
+
+/**
+    HELPERS
+**/
+
+// strides of a row-major layout, see TensorBase<T>::alloc
+static size_t layout(const vector<size_t> &shape, vector<size_t> &incr)
+{
+    incr.assign(shape.size(), 1);
+    size_t num_elems = 1;
+    for(size_t dim=shape.size(); dim-- > 0;)
+    {
+        incr[dim] = num_elems;
+        num_elems *= shape[dim];
+    }
+    return num_elems;
+}
+
+static void check_shapes(const vector<size_t> &lhs, const vector<size_t> &rhs, const char* op)
+{
+    if(THROW_BASIC_EXCEPTIONS && lhs != rhs)
+    {
+        throw ShapeMismatch(string("TensorUtils::DeviceTensor<T>::") + op + ":: Shape mismatch: Arguments do not have the same shape!");
+    }
+}
+
+#if ENABLE_CUDA == 1
+
+/**
+    CUDA KERNELS
+**/
+
+// true if no label occurs twice in the same operand, i.e. the operation has no diagonals or traces
+static bool distinct_labels(const vector<int> &idx)
+{
+    vector<int> sorted(idx);
+    sort(sorted.begin(), sorted.end());
+    return adjacent_find(sorted.begin(), sorted.end()) == sorted.end();
+}
+
+// labels of the result in the order of its indices, see TensorBase<T>::dot
+static vector<int> result_labels(const vector<int> &idx_lhs, const vector<int> &idx_rhs)
+{
+    vector<int> labels;
+    for(const vector<int>* idx : {&idx_lhs, &idx_rhs})
+    {
+        for(auto it=idx->begin(); it!=idx->end(); it++)
+        {
+            if(*it >= 0)
+            {
+                labels.push_back(*it);
+            }
+        }
+    }
+    sort(labels.begin(), labels.end());
+    labels.erase(unique(labels.begin(), labels.end()), labels.end());
+    return labels;
+}
+
+// cuBLAS takes int sizes, larger tensors are processed in chunks
+static constexpr size_t CUBLAS_CHUNK = size_t(1)<<30;
+
+template<class F>
+static void chunked(size_t n, F f)
+{
+    for(size_t begin=0; begin<n; begin+=CUBLAS_CHUNK)
+    {
+        f(begin, int(min(CUBLAS_CHUNK, n-begin)));
+    }
+}
+
+static cublasStatus_t geam(cublasHandle_t h, int n, const float* alpha, const float* a, const float* beta, const float* b, float* c)
+{
+    return cublasSgeam(h, CUBLAS_OP_N, CUBLAS_OP_N, n, 1, alpha, a, n, beta, b, n, c, n);
+}
+
+static cublasStatus_t geam(cublasHandle_t h, int n, const double* alpha, const double* a, const double* beta, const double* b, double* c)
+{
+    return cublasDgeam(h, CUBLAS_OP_N, CUBLAS_OP_N, n, 1, alpha, a, n, beta, b, n, c, n);
+}
+
+static cublasStatus_t axpy(cublasHandle_t h, int n, const float* alpha, const float* x, float* y)
+{
+    return cublasSaxpy(h, n, alpha, x, 1, y, 1);
+}
+
+static cublasStatus_t axpy(cublasHandle_t h, int n, const double* alpha, const double* x, double* y)
+{
+    return cublasDaxpy(h, n, alpha, x, 1, y, 1);
+}
+
+static cublasStatus_t scal(cublasHandle_t h, int n, const float* alpha, float* x)
+{
+    return cublasSscal(h, n, alpha, x, 1);
+}
+
+static cublasStatus_t scal(cublasHandle_t h, int n, const double* alpha, double* x)
+{
+    return cublasDscal(h, n, alpha, x, 1);
+}
+
+template<class T> struct CutensorType;
+template<> struct CutensorType<float>
+{
+    static cutensorDataType_t data() { return CUTENSOR_R_32F; }
+    static cutensorComputeDescriptor_t compute() { return CUTENSOR_COMPUTE_DESC_32F; }
+};
+template<> struct CutensorType<double>
+{
+    static cutensorDataType_t data() { return CUTENSOR_R_64F; }
+    static cutensorComputeDescriptor_t compute() { return CUTENSOR_COMPUTE_DESC_64F; }
+};
+
+// cudaMallocAsync returns blocks aligned to at least 256 bytes
+static constexpr uint32_t DEVICE_ALIGNMENT = 256;
+
+// contracted labels are moved behind all labels of the result, cuTENSOR matches modes by value
+static vector<int32_t> modes(const vector<int> &idx)
+{
+    vector<int32_t> result(idx.size());
+    for(size_t n=0; n<idx.size(); n++)
+    {
+        result[n] = idx[n] >= 0 ? idx[n] : (1<<24) - idx[n];
+    }
+    return result;
+}
+
+namespace
+{
+    struct TensorDescriptor
+    {
+        TensorDescriptor(const vector<size_t> &shape, const vector<size_t> &incr, cutensorDataType_t type)
+        {
+            const vector<int64_t> extent(shape.begin(), shape.end());
+            const vector<int64_t> stride(incr.begin(), incr.end());
+            Device::Detail::check(cutensorCreateTensorDescriptor(Device::Detail::cutensor(), &desc, uint32_t(shape.size()),
+                extent.data(), stride.data(), type, DEVICE_ALIGNMENT), "cutensorCreateTensorDescriptor");
+        }
+
+        ~TensorDescriptor()
+        {
+            cutensorDestroyTensorDescriptor(desc);
+        }
+
+        TensorDescriptor(const TensorDescriptor&) = delete;
+        TensorDescriptor& operator=(const TensorDescriptor&) = delete;
+
+        cutensorTensorDescriptor_t desc;
+    };
+
+    // plan and workspace of one cuTENSOR operation, all resources are released in stream order
+    class Operation
+    {
+        public:
+            explicit Operation(cutensorOperationDescriptor_t op) : op(op), pref(nullptr), plan(nullptr), work(nullptr), work_size(0)
+            {
+                cutensorHandle_t handle = Device::Detail::cutensor();
+                Device::Detail::check(cutensorCreatePlanPreference(handle, &pref, CUTENSOR_ALGO_DEFAULT, CUTENSOR_JIT_MODE_NONE), "cutensorCreatePlanPreference");
+                uint64_t estimate = 0;
+                Device::Detail::check(cutensorEstimateWorkspaceSize(handle, op, pref, CUTENSOR_WORKSPACE_DEFAULT, &estimate), "cutensorEstimateWorkspaceSize");
+                Device::Detail::check(cutensorCreatePlan(handle, &plan, op, pref, estimate), "cutensorCreatePlan");
+                Device::Detail::check(cutensorPlanGetAttribute(handle, plan, CUTENSOR_PLAN_REQUIRED_WORKSPACE, &work_size, sizeof(work_size)), "cutensorPlanGetAttribute");
+                work = Device::Detail::allocate(work_size, Device::current());
+            }
+
+            ~Operation()
+            {
+                Device::Detail::deallocate(work, work_size, Device::current());
+                if(plan)
+                {
+                    cutensorDestroyPlan(plan);
+                }
+                if(pref)
+                {
+                    cutensorDestroyPlanPreference(pref);
+                }
+                cutensorDestroyOperationDescriptor(op);
+            }
+
+            Operation(const Operation&) = delete;
+            Operation& operator=(const Operation&) = delete;
+
+            cutensorOperationDescriptor_t op;
+            cutensorPlanPreference_t pref;
+            cutensorPlan_t plan;
+            void* work;
+            uint64_t work_size;
+    };
+}
+
+template<class T>
+static void cutensor_contract(const DeviceTensor<T> &A, const vector<int> &idx_A, const DeviceTensor<T> &B, const vector<int> &idx_B,
+    DeviceTensor<T> &C, const vector<int> &idx_C)
+{
+    cutensorHandle_t handle = Device::Detail::cutensor();
+    const TensorDescriptor dA(A.shape, A.incr, CutensorType<T>::data());
+    const TensorDescriptor dB(B.shape, B.incr, CutensorType<T>::data());
+    const TensorDescriptor dC(C.shape, C.incr, CutensorType<T>::data());
+    const vector<int32_t> mA = modes(idx_A), mB = modes(idx_B), mC = modes(idx_C);
+
+    cutensorOperationDescriptor_t op;
+    Device::Detail::check(cutensorCreateContraction(handle, &op,
+        dA.desc, mA.data(), CUTENSOR_OP_IDENTITY,
+        dB.desc, mB.data(), CUTENSOR_OP_IDENTITY,
+        dC.desc, mC.data(), CUTENSOR_OP_IDENTITY,
+        dC.desc, mC.data(), CutensorType<T>::compute()), "cutensorCreateContraction");
+    const Operation operation(op);
+
+    const T alpha = 1, beta = 0;
+    Device::Detail::check(cutensorContract(handle, operation.plan, &alpha, A.data(), B.data(), &beta, C.data(), C.data(),
+        operation.work, operation.work_size, Device::Detail::native(Device::current())), "cutensorContract");
+}
+
+template<class T>
+static void cutensor_reduce(const DeviceTensor<T> &A, const vector<int> &idx_A, DeviceTensor<T> &C, const vector<int> &idx_C)
+{
+    cutensorHandle_t handle = Device::Detail::cutensor();
+    const TensorDescriptor dA(A.shape, A.incr, CutensorType<T>::data());
+    const TensorDescriptor dC(C.shape, C.incr, CutensorType<T>::data());
+    const vector<int32_t> mA = modes(idx_A), mC = modes(idx_C);
+
+    cutensorOperationDescriptor_t op;
+    Device::Detail::check(cutensorCreateReduction(handle, &op,
+        dA.desc, mA.data(), CUTENSOR_OP_IDENTITY,
+        dC.desc, mC.data(), CUTENSOR_OP_IDENTITY,
+        dC.desc, mC.data(), CUTENSOR_OP_ADD, CutensorType<T>::compute()), "cutensorCreateReduction");
+    const Operation operation(op);
+
+    const T alpha = 1, beta = 0;
+    Device::Detail::check(cutensorReduce(handle, operation.plan, &alpha, A.data(), &beta, C.data(), C.data(),
+        operation.work, operation.work_size, Device::Detail::native(Device::current())), "cutensorReduce");
+}
+
+template<class T>
+static void cutensor_permute(const DeviceTensor<T> &A, const vector<int> &idx_A, DeviceTensor<T> &C, const vector<int> &idx_C)
+{
+    cutensorHandle_t handle = Device::Detail::cutensor();
+    const TensorDescriptor dA(A.shape, A.incr, CutensorType<T>::data());
+    const TensorDescriptor dC(C.shape, C.incr, CutensorType<T>::data());
+    const vector<int32_t> mA = modes(idx_A), mC = modes(idx_C);
+
+    cutensorOperationDescriptor_t op;
+    Device::Detail::check(cutensorCreatePermutation(handle, &op,
+        dA.desc, mA.data(), CUTENSOR_OP_IDENTITY,
+        dC.desc, mC.data(), CutensorType<T>::compute()), "cutensorCreatePermutation");
+    const Operation operation(op);
+
+    const T alpha = 1;
+    Device::Detail::check(cutensorPermute(handle, operation.plan, &alpha, A.data(), C.data(),
+        Device::Detail::native(Device::current())), "cutensorPermute");
+}
+
+// cuTENSOR contracts every label that occurs in both operands but not in the result
+static bool cutensor_supports(const vector<int> &idx_lhs, const vector<int> &idx_rhs)
+{
+    if(!distinct_labels(idx_lhs) || !distinct_labels(idx_rhs))
+    {
+        return false;
+    }
+    for(auto it=idx_lhs.begin(); it!=idx_lhs.end(); it++)
+    {
+        if(*it < 0 && find(idx_rhs.begin(), idx_rhs.end(), *it) == idx_rhs.end())
+        {
+            return false;
+        }
+    }
+    for(auto it=idx_rhs.begin(); it!=idx_rhs.end(); it++)
+    {
+        if(*it < 0 && find(idx_lhs.begin(), idx_lhs.end(), *it) == idx_lhs.end())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+#endif // ENABLE_CUDA
+
+/**
+    CONSTRUCTORS AND ASSIGNMENT
+**/
+
+template<class T>
+DeviceTensor<T>::DeviceTensor() : ptr(nullptr), count(0)
+{
+    //
+}
+
+template<class T>
+DeviceTensor<T>::DeviceTensor(const vector<size_t> &shape) : ptr(nullptr), count(0)
+{
+    alloc(shape);
+    zero();
+}
+
+template<class T>
+DeviceTensor<T>::DeviceTensor(initializer_list<size_t> shape) : DeviceTensor(vector<size_t>(shape))
+{
+    //
+}
+
+template<class T>
+DeviceTensor<T>::DeviceTensor(const TensorBase<T> &host) : ptr(nullptr), count(0)
+{
+    upload(host);
+}
+
+template<class T>
+DeviceTensor<T>::DeviceTensor(const DeviceTensor<T> &other) : ptr(nullptr), count(0)
+{
+    *this = other;
+}
+
+template<class T>
+DeviceTensor<T>::DeviceTensor(DeviceTensor<T> &&other) noexcept :
+    shape(move(other.shape)), incr(move(other.incr)), ptr(other.ptr), count(other.count)
+{
+    other.shape.clear();
+    other.incr.clear();
+    other.ptr = nullptr;
+    other.count = 0;
+}
+
+template<class T>
+DeviceTensor<T>& DeviceTensor<T>::operator=(const DeviceTensor<T> &other)
+{
+    if(this != &other)
+    {
+        alloc(other.shape);
+        Device::Detail::copy(ptr, other.ptr, count*sizeof(T), Device::current());
+    }
+    return *this;
+}
+
+template<class T>
+DeviceTensor<T>& DeviceTensor<T>::operator=(DeviceTensor<T> &&other) noexcept
+{
+    if(this != &other)
+    {
+        release();
+        shape.swap(other.shape);
+        incr.swap(other.incr);
+        ptr = other.ptr;
+        count = other.count;
+        other.shape.clear();
+        other.incr.clear();
+        other.ptr = nullptr;
+        other.count = 0;
+    }
+    return *this;
+}
+
+template<class T>
+DeviceTensor<T>::~DeviceTensor()
+{
+    release();
+}
+
+template<class T>
+void DeviceTensor<T>::release()
+{
+    Device::Detail::deallocate(ptr, count*sizeof(T), Device::current());
+    ptr = nullptr;
+    count = 0;
+}
+
+/**
+    ALLOCATE AND INITIALIZE
+**/
+
+template<class T>
+void DeviceTensor<T>::alloc(const vector<size_t> &shape)
+{
+    vector<size_t> incr;
+    const size_t num_elems = layout(shape, incr);
+    if(num_elems != count)
+    {
+        release();
+        ptr = static_cast<T*>(Device::Detail::allocate(num_elems*sizeof(T), Device::current()));
+        count = num_elems;
+    }
+    this->shape = shape;
+    this->incr.swap(incr);
+}
+
+template<class T>
+void DeviceTensor<T>::clear()
+{
+    release();
+    shape.clear();
+    incr.clear();
+}
+
+template<class T>
+void DeviceTensor<T>::zero()
+{
+    Device::Detail::zero(ptr, count*sizeof(T), Device::current());
+}
+
+template<class T>
+T* DeviceTensor<T>::data()
+{
+    return ptr;
+}
+
+template<class T>
+const T* DeviceTensor<T>::data() const
+{
+    return ptr;
+}
+
+template<class T>
+size_t DeviceTensor<T>::size() const
+{
+    return count;
+}
+
+template<class T>
+size_t DeviceTensor<T>::rank() const
+{
+    return shape.size();
+}
+
+/**
+    TRANSFERS
+**/
+
+template<class T>
+void DeviceTensor<T>::upload(const TensorBase<T> &host)
+{
+    PROFILE_SCOPE("DeviceTensor::upload");
+    PROFILE_ARGS(Profiler::Detail::shape_string(host.shape));
+    alloc(host.shape);
+    Device::Detail::copy(ptr, host.data(), count*sizeof(T), Device::current());
+}
+
+template<class T>
+void DeviceTensor<T>::download(TensorBase<T> &host) const
+{
+    PROFILE_SCOPE("DeviceTensor::download");
+    PROFILE_ARGS(Profiler::Detail::shape_string(shape));
+    if(host.shape != shape || host.size() != count)
+    {
+        host.alloc(shape);
+    }
+    Device::Detail::copy(host.data(), ptr, count*sizeof(T), Device::current());
+}
+
+template<class T>
+TensorBase<T> DeviceTensor<T>::host() const
+{
+    TensorBase<T> result;
+    download(result);
+    Device::current().synchronize();
+    return result;
+}
+
+/**
+    PRODUCTS AND CONTRACTIONS
+**/
+
+// evaluates a plan on host copies of the operands, used for the labels that the device kernels do not support
+template<class T>
+static void host_execute(const ContractionPlan &plan, const DeviceTensor<T> &lhs, const DeviceTensor<T>* rhs, DeviceTensor<T> &result)
+{
+    #if ENABLE_CUDA == 1
+    Memory::Scope scope(Device::pinned());
+    TensorBase<T> A, B, C(plan.shape());
+    lhs.download(A);
+    if(rhs)
+    {
+        rhs->download(B);
+    }
+    Device::current().synchronize();
+    if(rhs)
+    {
+        plan.execute(A.data(), B.data(), C.data());
+    }
+    else
+    {
+        plan.execute(A.data(), C.data());
+    }
+    result.upload(C);
+    Device::current().synchronize();
+    #else
+    if(rhs)
+    {
+        plan.execute(lhs.data(), rhs->data(), result.data());
+    }
+    else
+    {
+        plan.execute(lhs.data(), result.data());
+    }
+    #endif // ENABLE_CUDA
+}
+
+template<class T>
+DeviceTensor<T> DeviceTensor<T>::dot(const DeviceTensor<T> &rhs, const vector<int> &idx_lhs, const vector<int> &idx_rhs) const
+{
+    PROFILE_SCOPE("DeviceTensor::dot");
+    PROFILE_ARGS(Profiler::Detail::shape_string(shape) + " " + Profiler::Detail::shape_string(rhs.shape));
+    const ContractionPlan plan(shape, idx_lhs, rhs.shape, idx_rhs);
+    DeviceTensor<T> result;
+    result.alloc(plan.shape());
+    if(count == 0 || rhs.count == 0)
+    {
+        result.zero();
+        return result;
+    }
+    #if ENABLE_CUDA == 1
+    if(cutensor_supports(idx_lhs, idx_rhs))
+    {
+        cutensor_contract(*this, idx_lhs, rhs, idx_rhs, result, result_labels(idx_lhs, idx_rhs));
+        return result;
+    }
+    #endif // ENABLE_CUDA
+    host_execute(plan, *this, &rhs, result);
+    return result;
+}
+
+template<class T>
+DeviceTensor<T> DeviceTensor<T>::contract(const vector<int> &idx) const
+{
+    PROFILE_SCOPE("DeviceTensor::contract");
+    PROFILE_ARGS(Profiler::Detail::shape_string(shape));
+    const ContractionPlan plan(shape, idx);
+    DeviceTensor<T> result;
+    result.alloc(plan.shape());
+    if(count == 0)
+    {
+        result.zero();
+        return result;
+    }
+    #if ENABLE_CUDA == 1
+    if(distinct_labels(idx))
+    {
+        if(find_if(idx.begin(), idx.end(), [](int label) { return label < 0; }) == idx.end())
+        {
+            cutensor_permute(*this, idx, result, result_labels(idx, {}));
+        }
+        else
+        {
+            cutensor_reduce(*this, idx, result, result_labels(idx, {}));
+        }
+        return result;
+    }
+    #endif // ENABLE_CUDA
+    host_execute<T>(plan, *this, nullptr, result);
+    return result;
+}
+
+/**
+    ELEMENT-WISE OPERATIONS
+**/
+
+template<class T>
+void DeviceTensor<T>::combine(const T &alpha, const DeviceTensor<T> &a, const T &beta, const DeviceTensor<T> &b, DeviceTensor<T> &result)
+{
+    #if ENABLE_CUDA == 1
+    cublasHandle_t handle = Device::Detail::cublas(Device::current());
+    chunked(result.count, [&](size_t begin, int n)
+    {
+        Device::Detail::check(geam(handle, n, &alpha, a.ptr+begin, &beta, b.ptr+begin, result.ptr+begin), "cublasXgeam");
+    });
+    #else
+    const T* pa = a.ptr;
+    const T* pb = b.ptr;
+    T* dst = result.ptr;
+    Parallel::parallel_for(result.count, [&](size_t begin, size_t end)
+    {
+        for(size_t i=begin; i<end; i++)
+        {
+            dst[i] = alpha*pa[i] + beta*pb[i];
+        }
+    });
+    #endif // ENABLE_CUDA
+}
+
+template<class T>
+DeviceTensor<T>& DeviceTensor<T>::axpby(const T &alpha, const DeviceTensor<T> &x, const T &beta)
+{
+    check_shapes(shape, x.shape, "axpby");
+    combine(alpha, x, beta, *this, *this);
+    return *this;
+}
+
+template<class T>
+DeviceTensor<T>& DeviceTensor<T>::operator+=(const DeviceTensor<T> &rhs)
+{
+    check_shapes(shape, rhs.shape, "operator+=");
+    #if ENABLE_CUDA == 1
+    const T one = 1;
+    cublasHandle_t handle = Device::Detail::cublas(Device::current());
+    chunked(count, [&](size_t begin, int n)
+    {
+        Device::Detail::check(axpy(handle, n, &one, rhs.ptr+begin, ptr+begin), "cublasXaxpy");
+    });
+    #else
+    T* dst = ptr;
+    const T* src = rhs.ptr;
+    Parallel::parallel_for(count, [&](size_t begin, size_t end)
+    {
+        Simd::add(dst+begin, src+begin, end-begin);
+    });
+    #endif // ENABLE_CUDA
+    return *this;
+}
+
+template<class T>
+DeviceTensor<T>& DeviceTensor<T>::operator-=(const DeviceTensor<T> &rhs)
+{
+    check_shapes(shape, rhs.shape, "operator-=");
+    #if ENABLE_CUDA == 1
+    const T minus_one = -1;
+    cublasHandle_t handle = Device::Detail::cublas(Device::current());
+    chunked(count, [&](size_t begin, int n)
+    {
+        Device::Detail::check(axpy(handle, n, &minus_one, rhs.ptr+begin, ptr+begin), "cublasXaxpy");
+    });
+    #else
+    T* dst = ptr;
+    const T* src = rhs.ptr;
+    Parallel::parallel_for(count, [&](size_t begin, size_t end)
+    {
+        Simd::substract(dst+begin, src+begin, end-begin);
+    });
+    #endif // ENABLE_CUDA
+    return *this;
+}
+
+template<class T>
+DeviceTensor<T>& DeviceTensor<T>::operator*=(const T &val)
+{
+    #if ENABLE_CUDA == 1
+    cublasHandle_t handle = Device::Detail::cublas(Device::current());
+    chunked(count, [&](size_t begin, int n)
+    {
+        Device::Detail::check(scal(handle, n, &val, ptr+begin), "cublasXscal");
+    });
+    #else
+    T* dst = ptr;
+    Parallel::parallel_for(count, [&](size_t begin, size_t end)
+    {
+        Simd::multiply(dst+begin, val, end-begin);
+    });
+    #endif // ENABLE_CUDA
+    return *this;
+}
+
+template<class T>
+DeviceTensor<T>& DeviceTensor<T>::operator/=(const T &val)
+{
+    return *this *= T(1)/val;
+}
+
+template<class T>
+DeviceTensor<T> TensorUtils::operator+(const DeviceTensor<T> &lhs, const DeviceTensor<T> &rhs)
+{
+    check_shapes(lhs.shape, rhs.shape, "operator+");
+    DeviceTensor<T> result;
+    result.alloc(lhs.shape);
+    DeviceTensor<T>::combine(1, lhs, 1, rhs, result);
+    return result;
+}
+
+template<class T>
+DeviceTensor<T> TensorUtils::operator-(const DeviceTensor<T> &lhs, const DeviceTensor<T> &rhs)
+{
+    check_shapes(lhs.shape, rhs.shape, "operator-");
+    DeviceTensor<T> result;
+    result.alloc(lhs.shape);
+    DeviceTensor<T>::combine(1, lhs, -1, rhs, result);
+    return result;
+}
+
+template<class T>
+DeviceTensor<T> TensorUtils::operator*(const DeviceTensor<T> &lhs, const T &val)
+{
+    DeviceTensor<T> result(lhs);
+    result *= val;
+    return result;
+}
+
+template<class T>
+DeviceTensor<T> TensorUtils::operator*(const T &val, const DeviceTensor<T> &rhs)
+{
+    return rhs*val;
+}
+
+/**
+    EXPLICIT TEMPLATE INSTANTIATION
+**/
+
+namespace TensorUtils
+{
+    #define INSTANTIATE_DEVICE_TYPE(X) \
+    template class DeviceTensor<X>; \
+    template DeviceTensor<X> operator+<X>(const DeviceTensor<X>&, const DeviceTensor<X>&); \
+    template DeviceTensor<X> operator-<X>(const DeviceTensor<X>&, const DeviceTensor<X>&); \
+    template DeviceTensor<X> operator*<X>(const DeviceTensor<X>&, const X&); \
+    template DeviceTensor<X> operator*<X>(const X&, const DeviceTensor<X>&);
+
+    INSTANTIATE_DEVICE_TYPE(double)
+    INSTANTIATE_DEVICE_TYPE(float)
+
+    #undef INSTANTIATE_DEVICE_TYPE
+}
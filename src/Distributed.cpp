@@ -0,0 +1,435 @@
+/*
+TensorUtils Version 0.1
+
+Copyright 2022 Christoph Widder
+
+This file is part of TensorUtils.
+
+TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+the GNU General Public License as published by the Free Software Foundation, either
+version 3 of the License, or (at your option) any later version.
+
+TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with TensorUtils.
+If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef THROW_EXCEPTIONS
+#define THROW_EXCEPTIONS 0
+#endif // THROW_EXCEPTIONS
+
+#ifndef THROW_BASIC_EXCEPTIONS
+#define THROW_BASIC_EXCEPTIONS 1
+#endif // THROW_BASIC_EXCEPTIONS
+
+#include "DistributedBackend.hpp"
+#include "ErrorHandler.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+using namespace TensorUtils;
+using namespace ErrorHandler;
+
+/**
+    RUNTIME
+**/
+
+bool Distributed::enabled()
+{
+    return ENABLE_MPI == 1;
+}
+
+#if ENABLE_MPI == 1
+
+void Distributed::Detail::check(int status, const char* call)
+{
+    if(status != MPI_SUCCESS)
+    {
+        char msg[MPI_MAX_ERROR_STRING];
+        int length = 0;
+        MPI_Error_string(status, msg, &length);
+        throw runtime_error(string("TensorUtils::Distributed:: ")+call+" failed: "+string(msg, length));
+    }
+}
+
+static void finalize_at_exit()
+{
+    int finalized = 0;
+    MPI_Finalized(&finalized);
+    if(!finalized)
+    {
+        MPI_Finalize();
+    }
+}
+
+static bool initialized()
+{
+    int flag = 0;
+    MPI_Initialized(&flag);
+    return flag;
+}
+
+// the local kernels run on the thread pool, only the calling thread calls MPI
+static void initialize(int* argc, char*** argv)
+{
+    int provided = 0;
+    Distributed::Detail::check(MPI_Init_thread(argc, argv, MPI_THREAD_FUNNELED, &provided), "MPI_Init_thread");
+}
+
+Distributed::Detail::Comm Distributed::Detail::world()
+{
+    if(!initialized())
+    {
+        initialize(nullptr, nullptr);
+        atexit(finalize_at_exit);
+    }
+    return MPI_COMM_WORLD;
+}
+
+int Distributed::rank()
+{
+    int r = 0;
+    Detail::check(MPI_Comm_rank(Detail::world(), &r), "MPI_Comm_rank");
+    return r;
+}
+
+int Distributed::size()
+{
+    int n = 1;
+    Detail::check(MPI_Comm_size(Detail::world(), &n), "MPI_Comm_size");
+    return n;
+}
+
+void Distributed::barrier()
+{
+    Detail::check(MPI_Barrier(Detail::world()), "MPI_Barrier");
+}
+
+Distributed::Environment::Environment(int &argc, char** &argv) : owned(!initialized())
+{
+    if(owned)
+    {
+        initialize(&argc, &argv);
+    }
+}
+
+Distributed::Environment::Environment() : owned(!initialized())
+{
+    if(owned)
+    {
+        initialize(nullptr, nullptr);
+    }
+}
+
+Distributed::Environment::~Environment()
+{
+    if(owned)
+    {
+        finalize_at_exit();
+    }
+}
+
+#else
+
+Distributed::Detail::Comm Distributed::Detail::world()
+{
+    return 0;
+}
+
+int Distributed::rank()
+{
+    return 0;
+}
+
+int Distributed::size()
+{
+    return 1;
+}
+
+void Distributed::barrier()
+{
+    //
+}
+
+Distributed::Environment::Environment(int&, char**&) : owned(false)
+{
+    //
+}
+
+Distributed::Environment::Environment() : owned(false)
+{
+    //
+}
+
+Distributed::Environment::~Environment()
+{
+    //
+}
+
+#endif // ENABLE_MPI
+
+/**
+    GRIDS
+**/
+
+pair<size_t,size_t> Distributed::block(size_t n, size_t parts, size_t part)
+{
+    return {part*n/parts, (part+1)*n/parts};
+}
+
+vector<size_t> Distributed::grid(const vector<size_t> &shape, const vector<size_t> &axes, int ranks)
+{
+    vector<size_t> candidates = axes;
+    if(candidates.empty())
+    {
+        for(size_t k=0; k<shape.size(); k++)
+        {
+            candidates.push_back(k);
+        }
+    }
+    if(THROW_BASIC_EXCEPTIONS && any_of(candidates.begin(), candidates.end(), [&shape](size_t k){ return k >= shape.size(); }))
+    {
+        throw ShapeMismatch("TensorUtils::Distributed::grid:: Axis out of range!");
+    }
+
+    // prime factors in decreasing order
+    vector<size_t> factors;
+    size_t n = max(ranks, 1);
+    for(size_t p=2; p*p<=n; p++)
+    {
+        while(n % p == 0)
+        {
+            factors.push_back(p);
+            n /= p;
+        }
+    }
+    if(n > 1)
+    {
+        factors.push_back(n);
+    }
+    sort(factors.rbegin(), factors.rend());
+
+    vector<size_t> result(shape.size(), 1);
+    if(candidates.empty())
+    {
+        return result;
+    }
+    for(size_t p : factors)
+    {
+        size_t best = candidates[0];
+        for(size_t k : candidates)
+        {
+            if((shape[k]+result[k]-1)/result[k] > (shape[best]+result[best]-1)/result[best])
+            {
+                best = k;
+            }
+        }
+        result[best] *= p;
+    }
+    return result;
+}
+
+/**
+    COLLECTIVES
+**/
+
+#if ENABLE_MPI == 1
+
+template<class T> static MPI_Datatype datatype();
+template<> MPI_Datatype datatype<double>()             { return MPI_DOUBLE; }
+template<> MPI_Datatype datatype<float>()              { return MPI_FLOAT; }
+template<> MPI_Datatype datatype<long double>()        { return MPI_LONG_DOUBLE; }
+template<> MPI_Datatype datatype<unsigned char>()      { return MPI_UNSIGNED_CHAR; }
+template<> MPI_Datatype datatype<signed char>()        { return MPI_SIGNED_CHAR; }
+template<> MPI_Datatype datatype<unsigned short>()     { return MPI_UNSIGNED_SHORT; }
+template<> MPI_Datatype datatype<short>()              { return MPI_SHORT; }
+template<> MPI_Datatype datatype<unsigned>()           { return MPI_UNSIGNED; }
+template<> MPI_Datatype datatype<int>()                { return MPI_INT; }
+template<> MPI_Datatype datatype<unsigned long>()      { return MPI_UNSIGNED_LONG; }
+template<> MPI_Datatype datatype<long>()               { return MPI_LONG; }
+template<> MPI_Datatype datatype<unsigned long long>() { return MPI_UNSIGNED_LONG_LONG; }
+template<> MPI_Datatype datatype<long long>()          { return MPI_LONG_LONG; }
+
+Distributed::Detail::Comm Distributed::Detail::split(Comm comm, int color, int key)
+{
+    Comm result;
+    check(MPI_Comm_split(comm, color, key, &result), "MPI_Comm_split");
+    return result;
+}
+
+void Distributed::Detail::release(Comm &comm)
+{
+    MPI_Comm_free(&comm);
+}
+
+void Distributed::Detail::broadcast(void* data, size_t bytes, int root, Comm comm)
+{
+    char* ptr = static_cast<char*>(data);
+    for(size_t n=0; n<bytes; n+=MAX_MESSAGE)
+    {
+        check(MPI_Bcast(ptr+n, int(min(bytes-n, MAX_MESSAGE)), MPI_BYTE, root, comm), "MPI_Bcast");
+    }
+}
+
+Distributed::Detail::Broadcast::~Broadcast()
+{
+    if(!requests.empty())
+    {
+        MPI_Waitall(int(requests.size()), requests.data(), MPI_STATUSES_IGNORE);
+    }
+}
+
+void Distributed::Detail::Broadcast::start(void* data, size_t bytes, int root, Comm comm)
+{
+    char* ptr = static_cast<char*>(data);
+    for(size_t n=0; n<bytes; n+=MAX_MESSAGE)
+    {
+        requests.emplace_back();
+        check(MPI_Ibcast(ptr+n, int(min(bytes-n, MAX_MESSAGE)), MPI_BYTE, root, comm, &requests.back()), "MPI_Ibcast");
+    }
+}
+
+void Distributed::Detail::Broadcast::wait()
+{
+    if(!requests.empty())
+    {
+        check(MPI_Waitall(int(requests.size()), requests.data(), MPI_STATUSES_IGNORE), "MPI_Waitall");
+        requests.clear();
+    }
+}
+
+// point-to-point messages instead of MPI_Alltoallv, whose int counts and displacements limit the blocks to 2 GiB
+void Distributed::Detail::exchange(const char* send, const vector<size_t> &send_bytes, char* recv, const vector<size_t> &recv_bytes)
+{
+    const Comm comm = world();
+    vector<MPI_Request> requests;
+    size_t offset = 0;
+    for(size_t q=0; q<recv_bytes.size(); q++)
+    {
+        for(size_t n=0; n<recv_bytes[q]; n+=MAX_MESSAGE)
+        {
+            requests.emplace_back();
+            check(MPI_Irecv(recv+offset+n, int(min(recv_bytes[q]-n, MAX_MESSAGE)), MPI_BYTE, int(q), 0, comm, &requests.back()), "MPI_Irecv");
+        }
+        offset += recv_bytes[q];
+    }
+    offset = 0;
+    for(size_t q=0; q<send_bytes.size(); q++)
+    {
+        for(size_t n=0; n<send_bytes[q]; n+=MAX_MESSAGE)
+        {
+            requests.emplace_back();
+            check(MPI_Isend(send+offset+n, int(min(send_bytes[q]-n, MAX_MESSAGE)), MPI_BYTE, int(q), 0, comm, &requests.back()), "MPI_Isend");
+        }
+        offset += send_bytes[q];
+    }
+    check(MPI_Waitall(int(requests.size()), requests.data(), MPI_STATUSES_IGNORE), "MPI_Waitall");
+}
+
+template<class T>
+void Distributed::Detail::all_sum(T* data, size_t n)
+{
+    const size_t max_count = MAX_MESSAGE/sizeof(T);
+    for(size_t k=0; k<n; k+=max_count)
+    {
+        check(MPI_Allreduce(MPI_IN_PLACE, data+k, int(min(n-k, max_count)), datatype<T>(), MPI_SUM, world()), "MPI_Allreduce");
+    }
+}
+
+size_t Distributed::Detail::all_max(size_t value)
+{
+    unsigned long long result = value;
+    check(MPI_Allreduce(MPI_IN_PLACE, &result, 1, MPI_UNSIGNED_LONG_LONG, MPI_MAX, world()), "MPI_Allreduce");
+    return size_t(result);
+}
+
+#else
+
+Distributed::Detail::Comm Distributed::Detail::split(Comm comm, int, int)
+{
+    return comm;
+}
+
+void Distributed::Detail::release(Comm&)
+{
+    //
+}
+
+void Distributed::Detail::broadcast(void*, size_t, int, Comm)
+{
+    //
+}
+
+Distributed::Detail::Broadcast::~Broadcast()
+{
+    //
+}
+
+void Distributed::Detail::Broadcast::start(void*, size_t, int, Comm)
+{
+    //
+}
+
+void Distributed::Detail::Broadcast::wait()
+{
+    //
+}
+
+// a single rank only sends to itself
+void Distributed::Detail::exchange(const char* send, const vector<size_t> &send_bytes, char* recv, const vector<size_t>&)
+{
+    if(!send_bytes.empty() && send_bytes[0])
+    {
+        memcpy(recv, send, send_bytes[0]);
+    }
+}
+
+template<class T>
+void Distributed::Detail::all_sum(T*, size_t)
+{
+    //
+}
+
+size_t Distributed::Detail::all_max(size_t value)
+{
+    return value;
+}
+
+#endif // ENABLE_MPI
+
+/**
+    EXPLICIT TEMPLATE INSTANTIATION
+**/
+
+namespace TensorUtils
+{
+    namespace Distributed
+    {
+        namespace Detail
+        {
+            template void all_sum<double>(double*, size_t);
+            template void all_sum<float>(float*, size_t);
+            template void all_sum<long double>(long double*, size_t);
+            template void all_sum<unsigned char>(unsigned char*, size_t);
+            template void all_sum<signed char>(signed char*, size_t);
+            template void all_sum<unsigned short>(unsigned short*, size_t);
+            template void all_sum<short>(short*, size_t);
+            template void all_sum<unsigned>(unsigned*, size_t);
+            template void all_sum<int>(int*, size_t);
+            template void all_sum<unsigned long>(unsigned long*, size_t);
+            template void all_sum<long>(long*, size_t);
+            template void all_sum<unsigned long long>(unsigned long long*, size_t);
+            template void all_sum<long long>(long long*, size_t);
+        }
+    }
+}
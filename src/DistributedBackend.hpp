@@ -0,0 +1,104 @@
+/*
+TensorUtils Version 0.1
+
+Copyright 2022 Christoph Widder
+
+This file is part of TensorUtils.
+
+TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+the GNU General Public License as published by the Free Software Foundation, either
+version 3 of the License, or (at your option) any later version.
+
+TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with TensorUtils.
+If not, see <https://www.gnu.org/licenses/>.
+
+*/
+#ifndef DISTRIBUTEDBACKEND_HPP
+#define DISTRIBUTEDBACKEND_HPP
+
+#include "Distributed.hpp"
+
+#include <cstddef>
+#include <vector>
+
+/*
+    Backend of Distributed.hpp and DistributedTensor.hpp. ENABLE_MPI=1 selects MPI, which requires the library
+    and the application to be compiled with the MPI compiler wrapper, see the makefile. Otherwise there is a
+    single rank and all collectives are copies or no-ops.
+*/
+#ifndef ENABLE_MPI
+#define ENABLE_MPI 0
+#endif // ENABLE_MPI
+
+#if ENABLE_MPI == 1
+#include <mpi.h>
+#endif // ENABLE_MPI
+
+namespace TensorUtils
+{
+    namespace Distributed
+    {
+        namespace Detail
+        {
+            #if ENABLE_MPI == 1
+            typedef MPI_Comm Comm;
+            #else
+            typedef int Comm;
+            #endif // ENABLE_MPI
+
+            // MPI_COMM_WORLD, initializes MPI on first use
+            Comm world();
+
+            // sub-communicator of the ranks of comm with the same color, ordered by key
+            Comm split(Comm comm, int color, int key);
+            void release(Comm &comm);
+
+            // broadcast of any number of bytes
+            void broadcast(void* data, size_t bytes, int root, Comm comm);
+
+            // nonblocking broadcast of any number of bytes, completed by wait
+            class Broadcast
+            {
+                public:
+                    Broadcast() = default;
+                    ~Broadcast();
+
+                    Broadcast(const Broadcast&) = delete;
+                    Broadcast& operator=(const Broadcast&) = delete;
+
+                    void start(void* data, size_t bytes, int root, Comm comm);
+                    void wait();
+
+                private:
+                    #if ENABLE_MPI == 1
+                    std::vector<MPI_Request> requests;
+                    #endif // ENABLE_MPI
+            };
+
+            // sends send_bytes[q] bytes of send to every rank q and receives recv_bytes[q] bytes from it,
+            // the blocks of all ranks follow each other in send and recv
+            void exchange(const char* send, const std::vector<size_t> &send_bytes, char* recv, const std::vector<size_t> &recv_bytes);
+
+            // sum of data on all ranks, in place
+            template<class T>
+            void all_sum(T* data, size_t n);
+
+            // maximum of value on all ranks
+            size_t all_max(size_t value);
+
+            #if ENABLE_MPI == 1
+            // throws std::runtime_error with the name of the failed call
+            void check(int status, const char* call);
+
+            // largest message of a single call, larger ones are split
+            constexpr size_t MAX_MESSAGE = size_t(1)<<30;
+            #endif // ENABLE_MPI
+        }
+    }
+}
+
+#endif // DISTRIBUTEDBACKEND_HPP
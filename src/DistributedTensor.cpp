@@ -0,0 +1,1041 @@
+/*
+TensorUtils Version 0.1
+
+Copyright 2022 Christoph Widder
+
+This file is part of TensorUtils.
+
+TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+the GNU General Public License as published by the Free Software Foundation, either
+version 3 of the License, or (at your option) any later version.
+
+TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with TensorUtils.
+If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef THROW_EXCEPTIONS
+#define THROW_EXCEPTIONS 0
+#endif // THROW_EXCEPTIONS
+
+#ifndef THROW_BASIC_EXCEPTIONS
+#define THROW_BASIC_EXCEPTIONS 1
+#endif // THROW_BASIC_EXCEPTIONS
+
+#include "DistributedTensor.hpp"
+#include "DistributedBackend.hpp"
+#include "BinaryFormat.hpp"
+#include "ContractionPlan.hpp"
+#include "ErrorHandler.hpp"
+#include "Profile.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+
+using namespace std;
+using namespace TensorUtils;
+using namespace ErrorHandler;
+
+/**
+    BLOCKS
+**/
+
+namespace
+{
+    // global index ranges [first,last) of a block, nothing if empty
+    struct Box
+    {
+        vector<size_t> first;
+        vector<size_t> last;
+        bool empty = false;
+    };
+
+    typedef function<Box(int)> Layout;
+}
+
+static size_t volume(const Box &box)
+{
+    if(box.empty)
+    {
+        return 0;
+    }
+    size_t n = 1;
+    for(size_t k=0; k<box.first.size(); k++)
+    {
+        n *= box.last[k]-box.first[k];
+    }
+    return n;
+}
+
+static vector<size_t> box_shape(const Box &box)
+{
+    vector<size_t> result(box.first.size());
+    for(size_t k=0; k<result.size(); k++)
+    {
+        result[k] = box.last[k]-box.first[k];
+    }
+    return result;
+}
+
+static Box intersect(const Box &a, const Box &b)
+{
+    Box result = a;
+    result.empty = a.empty || b.empty;
+    for(size_t k=0; k<a.first.size() && !result.empty; k++)
+    {
+        result.first[k] = max(a.first[k], b.first[k]);
+        result.last[k] = max(result.first[k], min(a.last[k], b.last[k]));
+    }
+    return result;
+}
+
+static Box full(const vector<size_t> &shape)
+{
+    return {vector<size_t>(shape.size(), 0), shape};
+}
+
+static Box nothing(size_t rank)
+{
+    return {vector<size_t>(rank, 0), vector<size_t>(rank, 0), true};
+}
+
+// number of blocks of a grid
+static size_t blocks(const vector<size_t> &grid)
+{
+    size_t n = 1;
+    for(size_t g : grid)
+    {
+        n *= g;
+    }
+    return n;
+}
+
+// coordinates of the block of rank r, ranks beyond the number of blocks hold copies
+static vector<size_t> coordinates(int r, const vector<size_t> &grid)
+{
+    size_t b = size_t(r) % blocks(grid);
+    vector<size_t> result(grid.size());
+    for(size_t k=grid.size(); k-- > 0;)
+    {
+        result[k] = b % grid[k];
+        b /= grid[k];
+    }
+    return result;
+}
+
+// block of rank r
+static Box block_box(const vector<size_t> &shape, const vector<size_t> &grid, int r)
+{
+    const vector<size_t> c = coordinates(r, grid);
+    Box box = full(shape);
+    for(size_t k=0; k<shape.size(); k++)
+    {
+        tie(box.first[k], box.last[k]) = Distributed::block(shape[k], grid[k], c[k]);
+    }
+    return box;
+}
+
+// block that rank r sends in an exchange, copies are not sent
+template<class T>
+static Box source_box(const DistributedTensor<T> &tensor, int r)
+{
+    return size_t(r) < blocks(tensor.grid) ? block_box(tensor.shape, tensor.grid, r) : nothing(tensor.rank());
+}
+
+// part of the block of an index of size n that contains the index i
+static size_t part_of(size_t n, size_t parts, size_t i)
+{
+    return ((i+1)*parts-1)/n;
+}
+
+// copies the components in box from the block src with the global ranges from to the block dst with the ranges to
+template<class T>
+static void copy_box(const T* src, const Box &from, T* dst, const Box &to, const Box &box)
+{
+    const size_t N = box.first.size();
+    if(volume(box) == 0)
+    {
+        return;
+    }
+    if(N == 0)
+    {
+        *dst = *src;
+        return;
+    }
+    vector<size_t> incr_src(N, 1), incr_dst(N, 1);
+    for(size_t k=N-1; k>0; k--)
+    {
+        incr_src[k-1] = incr_src[k]*(from.last[k]-from.first[k]);
+        incr_dst[k-1] = incr_dst[k]*(to.last[k]-to.first[k]);
+    }
+    size_t s = 0, d = 0;
+    for(size_t k=0; k<N; k++)
+    {
+        s += (box.first[k]-from.first[k])*incr_src[k];
+        d += (box.first[k]-to.first[k])*incr_dst[k];
+    }
+
+    // rows of the last index are contiguous in both blocks
+    const vector<size_t> ext = box_shape(box);
+    vector<size_t> idx(N, 0);
+    while(true)
+    {
+        copy(src+s, src+s+ext[N-1], dst+d);
+        size_t k = N-1;
+        while(k-- > 0)
+        {
+            idx[k]++;
+            s += incr_src[k];
+            d += incr_dst[k];
+            if(idx[k] < ext[k])
+            {
+                break;
+            }
+            s -= ext[k]*incr_src[k];
+            d -= ext[k]*incr_dst[k];
+            idx[k] = 0;
+        }
+        if(k == size_t(-1))
+        {
+            return;
+        }
+    }
+}
+
+/*
+    Moves the components of the blocks from(q) of all ranks q to the blocks to(q). The blocks from(q) must be
+    disjoint and held by src on the calling rank, result is allocated with the shape of to(rank()).
+*/
+template<class T>
+static void exchange(const T* src, const Layout &from, TensorBase<T> &result, const Layout &to)
+{
+    PROFILE_SCOPE("DistributedTensor::exchange");
+    const int P = Distributed::size();
+    const int me = Distributed::rank();
+    const Box mine = from(me);
+    const Box wanted = to(me);
+    result.alloc(box_shape(wanted));
+
+    vector<Box> sends(P), recvs(P);
+    vector<size_t> send_bytes(P, 0), recv_bytes(P, 0);
+    size_t send_total = 0, recv_total = 0;
+    for(int q=0; q<P; q++)
+    {
+        sends[q] = intersect(mine, to(q));
+        recvs[q] = intersect(from(q), wanted);
+        if(q == me)
+        {
+            copy_box(src, mine, result.data(), wanted, sends[q]);
+            continue;
+        }
+        send_total += (send_bytes[q] = volume(sends[q])*sizeof(T));
+        recv_total += (recv_bytes[q] = volume(recvs[q])*sizeof(T));
+    }
+
+    vector<T> send(send_total/sizeof(T)), recv(recv_total/sizeof(T));
+    size_t offset = 0;
+    for(int q=0; q<P; q++)
+    {
+        if(send_bytes[q])
+        {
+            copy_box(src, mine, send.data()+offset, sends[q], sends[q]);
+            offset += volume(sends[q]);
+        }
+    }
+    Distributed::Detail::exchange(reinterpret_cast<const char*>(send.data()), send_bytes, reinterpret_cast<char*>(recv.data()), recv_bytes);
+    offset = 0;
+    for(int q=0; q<P; q++)
+    {
+        if(recv_bytes[q])
+        {
+            copy_box(recv.data()+offset, recvs[q], result.data(), wanted, recvs[q]);
+            offset += volume(recvs[q]);
+        }
+    }
+}
+
+// runs f on rank 0 and throws its exception on all ranks
+template<class F>
+static void on_root(F f)
+{
+    int status = 0;
+    string msg;
+    if(Distributed::rank() == 0)
+    {
+        try
+        {
+            f();
+        }
+        catch(UnableToOpenFile &ex)     { status = 1; msg = ex.what(); }
+        catch(CorruptedFile &ex)        { status = 2; msg = ex.what(); }
+        catch(ShapeMismatch &ex)        { status = 3; msg = ex.what(); }
+        catch(exception &ex)            { status = 4; msg = ex.what(); }
+    }
+    const Distributed::Detail::Comm world = Distributed::Detail::world();
+    Distributed::Detail::broadcast(&status, sizeof(status), 0, world);
+    if(status == 0)
+    {
+        return;
+    }
+    uint64_t length = msg.size();
+    Distributed::Detail::broadcast(&length, sizeof(length), 0, world);
+    msg.resize(length);
+    Distributed::Detail::broadcast(&msg[0], length, 0, world);
+    switch(status)
+    {
+        case 1: throw UnableToOpenFile(msg);
+        case 2: throw CorruptedFile(msg);
+        case 3: throw ShapeMismatch(msg);
+        default: throw runtime_error(msg);
+    }
+}
+
+/**
+    CONSTRUCTORS
+**/
+
+template<class T>
+DistributedTensor<T>::DistributedTensor()
+{
+    init({}, {});
+}
+
+template<class T>
+DistributedTensor<T>::DistributedTensor(const vector<size_t> &shape, const vector<size_t> &grid)
+{
+    init(shape, grid);
+}
+
+template<class T>
+DistributedTensor<T>::DistributedTensor(const vector<size_t> &shape, const vector<size_t> &grid, const T &val)
+{
+    init(shape, grid);
+    fill(block.begin(), block.end(), val);
+}
+
+template<class T>
+void DistributedTensor<T>::init(const vector<size_t> &shape, const vector<size_t> &grid)
+{
+    if(THROW_BASIC_EXCEPTIONS && grid.size() != shape.size())
+    {
+        throw RankMismatch("TensorUtils::DistributedTensor<T>::DistributedTensor:: Grid and shape have different ranks!");
+    }
+    if(THROW_BASIC_EXCEPTIONS && (count(grid.begin(), grid.end(), size_t(0)) || blocks(grid) > size_t(Distributed::size())))
+    {
+        throw invalid_argument("TensorUtils::DistributedTensor<T>::DistributedTensor:: Grid has no blocks or more blocks than there are ranks!");
+    }
+    this->shape = shape;
+    this->grid = grid;
+    const Box box = block_box(shape, grid, Distributed::rank());
+    offset = box.first;
+    block.alloc(box_shape(box), T(0));
+}
+
+template<class T>
+DistributedTensor<T> DistributedTensor<T>::scatter(const TensorBase<T> &global, const vector<size_t> &grid, int root)
+{
+    PROFILE_SCOPE("DistributedTensor::scatter");
+    const Distributed::Detail::Comm world = Distributed::Detail::world();
+    uint64_t rank = global.shape.size();
+    Distributed::Detail::broadcast(&rank, sizeof(rank), root, world);
+    vector<uint64_t> shape(global.shape.begin(), global.shape.end());
+    shape.resize(rank);
+    Distributed::Detail::broadcast(shape.data(), rank*sizeof(uint64_t), root, world);
+
+    DistributedTensor<T> result(vector<size_t>(shape.begin(), shape.end()), grid);
+    exchange(global.data(),
+             [&](int q){ return q == root ? full(result.shape) : nothing(result.rank()); },
+             result.block,
+             [&](int q){ return block_box(result.shape, result.grid, q); });
+    return result;
+}
+
+template<class T>
+TensorBase<T> DistributedTensor<T>::gather(int root) const
+{
+    PROFILE_SCOPE("DistributedTensor::gather");
+    TensorBase<T> result;
+    exchange(block.data(),
+             [this](int q){ return source_box(*this, q); },
+             result,
+             [&](int q){ return q == root ? full(shape) : nothing(rank()); });
+    if(Distributed::rank() != root)
+    {
+        result.clear();
+    }
+    return result;
+}
+
+template<class T>
+DistributedTensor<T> DistributedTensor<T>::redistribute(const vector<size_t> &grid) const
+{
+    PROFILE_SCOPE("DistributedTensor::redistribute");
+    DistributedTensor<T> result(shape, grid);
+    exchange(block.data(),
+             [this](int q){ return source_box(*this, q); },
+             result.block,
+             [&result](int q){ return block_box(result.shape, result.grid, q); });
+    return result;
+}
+
+/**
+    ACCESS
+**/
+
+template<class T>
+size_t DistributedTensor<T>::size() const
+{
+    return BinaryFormat::count(shape);
+}
+
+template<class T>
+size_t DistributedTensor<T>::rank() const
+{
+    return shape.size();
+}
+
+template<class T>
+TensorBase<T>& DistributedTensor<T>::local()
+{
+    return block;
+}
+
+template<class T>
+const TensorBase<T>& DistributedTensor<T>::local() const
+{
+    return block;
+}
+
+template<class T>
+int DistributedTensor<T>::owner(const vector<size_t> &idx) const
+{
+    if(THROW_BASIC_EXCEPTIONS && idx.size() != shape.size())
+    {
+        throw RankMismatch("TensorUtils::DistributedTensor<T>::owner:: Rank mismatch!");
+    }
+    if(THROW_EXCEPTIONS)
+    {
+        for(size_t k=0; k<idx.size(); k++)
+        {
+            if(idx[k] >= shape[k])
+            {
+                throw out_of_range("TensorUtils::DistributedTensor<T>::owner:: Index out of range!");
+            }
+        }
+    }
+    size_t b = 0;
+    for(size_t k=0; k<idx.size(); k++)
+    {
+        b = b*grid[k] + part_of(shape[k], grid[k], idx[k]);
+    }
+    return int(b);
+}
+
+/**
+    PRODUCTS
+**/
+
+namespace
+{
+    // operand of a distributed product
+    template<class T>
+    struct Operand
+    {
+        const DistributedTensor<T>* tensor;
+        const vector<int>* idx;
+
+        size_t occurrences(int label) const
+        {
+            return count(idx->begin(), idx->end(), label);
+        }
+
+        // extent of the index with the given label, 0 if the operand has none
+        size_t extent(int label) const
+        {
+            for(size_t k=0; k<idx->size(); k++)
+            {
+                if((*idx)[k] == label)
+                {
+                    return tensor->shape[k];
+                }
+            }
+            return 0;
+        }
+
+        // full box with the indices of the given label restricted to [first,last)
+        Box restrict(Box box, int label, size_t first, size_t last) const
+        {
+            for(size_t k=0; k<idx->size(); k++)
+            {
+                if((*idx)[k] == label)
+                {
+                    box.first[k] = first;
+                    box.last[k] = last;
+                }
+            }
+            return box;
+        }
+    };
+}
+
+// labels of the result in the order of its indices, see TensorBase::dot
+static vector<int> result_labels(const vector<const vector<int>*> &idx)
+{
+    vector<int> result;
+    for(auto labels : idx)
+    {
+        copy_if(labels->begin(), labels->end(), back_inserter(result), [](int l){ return l >= 0; });
+    }
+    sort(result.begin(), result.end());
+    result.erase(unique(result.begin(), result.end()), result.end());
+    return result;
+}
+
+// position of the label in the labels of the result
+static size_t position(const vector<int> &labels, int label)
+{
+    return lower_bound(labels.begin(), labels.end(), label) - labels.begin();
+}
+
+/*
+    SUMMA on a rows x columns grid of ranks: a is an index of the result of lhs only, split across the rows,
+    b one of rhs only, split across the columns, and k a summation index of both operands. Rank (i,j) holds the
+    block (i,j) of the result, lhs is redistributed such that it holds the rows i of a and the block j of k,
+    rhs such that it holds the block i of k and the columns j of b. Every step broadcasts the components of a
+    panel of k along the rows of the grid and the columns of the grid while the previous panel is multiplied.
+*/
+template<class T>
+static DistributedTensor<T> summa(const Operand<T> &lhs, const Operand<T> &rhs, const vector<size_t> &shape, int a, int b, int k)
+{
+    PROFILE_SCOPE("DistributedTensor::summa");
+    const size_t P = Distributed::size();
+    const vector<int> labels = result_labels({lhs.idx, rhs.idx});
+    const size_t n_a = lhs.extent(a), n_b = rhs.extent(b), n_k = lhs.extent(k);
+
+    // every rank receives about |lhs|/rows + |rhs|/columns components, idle rows or columns are avoided if possible
+    size_t rows = 1;
+    double best = numeric_limits<double>::max();
+    for(size_t r=1; r<=P; r++)
+    {
+        const size_t c = P/r;
+        if(r*c != P || (a < 0 && r > 1) || (b < 0 && c > 1))
+        {
+            continue;
+        }
+        double cost = double(lhs.tensor->size())/r + double(rhs.tensor->size())/c;
+        if((a >= 0 && r > n_a) || (b >= 0 && c > n_b))
+        {
+            cost = cost*2 + double(lhs.tensor->size() + rhs.tensor->size());
+        }
+        if(cost < best)
+        {
+            best = cost;
+            rows = r;
+        }
+    }
+    const size_t cols = P/rows;
+
+    vector<size_t> grid(shape.size(), 1);
+    if(a >= 0)
+    {
+        grid[position(labels, a)] = rows;
+    }
+    if(b >= 0)
+    {
+        grid[position(labels, b)] = cols;
+    }
+    DistributedTensor<T> result(shape, grid);
+
+    auto row_of = [&](int q){ return a >= 0 ? coordinates(q, grid)[position(labels, a)] : 0; };
+    auto col_of = [&](int q){ return b >= 0 ? coordinates(q, grid)[position(labels, b)] : 0; };
+    auto lhs_box = [&](int q)
+    {
+        Box box = full(lhs.tensor->shape);
+        if(a >= 0)
+        {
+            const auto range = Distributed::block(n_a, rows, row_of(q));
+            box = lhs.restrict(box, a, range.first, range.second);
+        }
+        const auto range = Distributed::block(n_k, cols, col_of(q));
+        return lhs.restrict(box, k, range.first, range.second);
+    };
+    auto rhs_box = [&](int q)
+    {
+        Box box = full(rhs.tensor->shape);
+        if(b >= 0)
+        {
+            const auto range = Distributed::block(n_b, cols, col_of(q));
+            box = rhs.restrict(box, b, range.first, range.second);
+        }
+        const auto range = Distributed::block(n_k, rows, row_of(q));
+        return rhs.restrict(box, k, range.first, range.second);
+    };
+
+    const int me = Distributed::rank();
+    const size_t i = row_of(me), j = col_of(me);
+    TensorBase<T> A, B;
+    exchange(lhs.tensor->local().data(), [&](int q){ return source_box(*lhs.tensor, q); }, A, lhs_box);
+    exchange(rhs.tensor->local().data(), [&](int q){ return source_box(*rhs.tensor, q); }, B, rhs_box);
+
+    // panels of k that are contained in a single block of both operands
+    vector<size_t> bounds = {n_k};
+    for(size_t p=0; p<cols; p++)
+    {
+        bounds.push_back(Distributed::block(n_k, cols, p).first);
+    }
+    for(size_t p=0; p<rows; p++)
+    {
+        bounds.push_back(Distributed::block(n_k, rows, p).first);
+    }
+    sort(bounds.begin(), bounds.end());
+    bounds.erase(unique(bounds.begin(), bounds.end()), bounds.end());
+
+    Distributed::Detail::Comm world = Distributed::Detail::world();
+    Distributed::Detail::Comm row = Distributed::Detail::split(world, int(i), int(j));
+    Distributed::Detail::Comm col = Distributed::Detail::split(world, int(j), int(i));
+
+    const Box box_A = lhs_box(me), box_B = rhs_box(me);
+    struct Panel
+    {
+        Box A, B;
+        vector<T> data_A, data_B;
+        Distributed::Detail::Broadcast bcast_A, bcast_B;
+    };
+    Panel panels[2];
+    auto start = [&](size_t t, Panel &panel)
+    {
+        const size_t first = bounds[t], last = bounds[t+1];
+        panel.A = lhs.restrict(box_A, k, first, last);
+        panel.B = rhs.restrict(box_B, k, first, last);
+        panel.data_A.resize(volume(panel.A));
+        panel.data_B.resize(volume(panel.B));
+        const size_t owner_A = part_of(n_k, cols, first), owner_B = part_of(n_k, rows, first);
+        if(owner_A == j)
+        {
+            copy_box(A.data(), box_A, panel.data_A.data(), panel.A, panel.A);
+        }
+        if(owner_B == i)
+        {
+            copy_box(B.data(), box_B, panel.data_B.data(), panel.B, panel.B);
+        }
+        panel.bcast_A.start(panel.data_A.data(), panel.data_A.size()*sizeof(T), int(owner_A), row);
+        panel.bcast_B.start(panel.data_B.data(), panel.data_B.size()*sizeof(T), int(owner_B), col);
+    };
+
+    const size_t steps = bounds.size()-1;
+    if(steps)
+    {
+        start(0, panels[0]);
+    }
+    for(size_t t=0; t<steps; t++)
+    {
+        Panel &panel = panels[t%2];
+        panel.bcast_A.wait();
+        panel.bcast_B.wait();
+        if(t+1 < steps)
+        {
+            start(t+1, panels[(t+1)%2]);
+        }
+        if(!panel.data_A.empty() && !panel.data_B.empty() && result.local().size())
+        {
+            const ContractionPlan plan(box_shape(panel.A), *lhs.idx, box_shape(panel.B), *rhs.idx);
+            plan.execute(panel.data_A.data(), panel.data_B.data(), result.local().data(), T(1), T(1));
+        }
+    }
+
+    Distributed::Detail::release(row);
+    Distributed::Detail::release(col);
+    return result;
+}
+
+/*
+    Splits the range of a single label across all ranks. Every rank receives the components of its range of all
+    indices with that label and computes the product of its blocks. Partial results of a summation index are
+    reduced across the ranks. The label is chosen to minimize the components that are received and reduced.
+*/
+template<class T>
+static DistributedTensor<T> partitioned(const vector<Operand<T>> &operands, const vector<size_t> &shape)
+{
+    PROFILE_SCOPE("DistributedTensor::partitioned");
+    const size_t P = Distributed::size();
+    vector<const vector<int>*> idx;
+    for(const auto &op : operands)
+    {
+        idx.push_back(op.idx);
+    }
+    const vector<int> labels = result_labels(idx);
+    const size_t result_size = BinaryFormat::count(shape);
+
+    bool found = false;
+    int label = 0;
+    size_t n = 0;
+    double best = numeric_limits<double>::max();
+    for(const auto &op : operands)
+    {
+        for(int l : *op.idx)
+        {
+            const size_t m = op.extent(l);
+            double cost = l < 0 ? double(result_size) : double(result_size)/min(P, max<size_t>(m,1));
+            for(const auto &other : operands)
+            {
+                const double s = double(other.tensor->size());
+                cost += other.occurrences(l) ? s/min(P, max<size_t>(m,1)) : s;
+            }
+            if(cost < best)
+            {
+                best = cost;
+                found = true;
+                label = l;
+                n = m;
+            }
+        }
+    }
+
+    vector<TensorBase<T>> local_blocks(operands.size());
+    for(size_t o=0; o<operands.size(); o++)
+    {
+        const Operand<T> &op = operands[o];
+        exchange(op.tensor->local().data(), [&](int q){ return source_box(*op.tensor, q); }, local_blocks[o], [&](int q)
+        {
+            const Box box = full(op.tensor->shape);
+            if(!found)
+            {
+                return box;
+            }
+            const auto range = Distributed::block(n, P, q);
+            return op.restrict(box, label, range.first, range.second);
+        });
+    }
+
+    // the ranges of a label of the result are the blocks of the result
+    vector<size_t> grid(shape.size(), 1);
+    if(found && label >= 0)
+    {
+        grid[position(labels, label)] = P;
+    }
+    TensorBase<T> partial;
+    partial.alloc(found && label >= 0 ? box_shape(block_box(shape, grid, Distributed::rank())) : shape, T(0));
+    if(all_of(local_blocks.begin(), local_blocks.end(), [](const TensorBase<T> &t){ return t.size(); }) && partial.size())
+    {
+        if(operands.size() == 2)
+        {
+            const ContractionPlan plan(local_blocks[0].shape, *operands[0].idx, local_blocks[1].shape, *operands[1].idx);
+            plan.execute(local_blocks[0].data(), local_blocks[1].data(), partial.data());
+        }
+        else
+        {
+            const ContractionPlan plan(local_blocks[0].shape, *operands[0].idx);
+            plan.execute(local_blocks[0].data(), partial.data());
+        }
+    }
+
+    if(found && label >= 0)
+    {
+        DistributedTensor<T> result(shape, grid);
+        result.local() = move(partial);
+        return result;
+    }
+    if(found)
+    {
+        Distributed::Detail::all_sum(partial.data(), partial.size());
+    }
+    DistributedTensor<T> result(shape, Distributed::grid(shape));
+    const Box box = block_box(shape, result.grid, Distributed::rank());
+    copy_box(partial.data(), full(shape), result.local().data(), box, box);
+    return result;
+}
+
+template<class T>
+DistributedTensor<T> DistributedTensor<T>::dot(const DistributedTensor<T> &rhs, const vector<int> &idx_lhs, const vector<int> &idx_rhs) const
+{
+    PROFILE_SCOPE("DistributedTensor::dot");
+    const ContractionPlan plan(shape, idx_lhs, rhs.shape, idx_rhs);
+    if(Distributed::size() == 1)
+    {
+        DistributedTensor<T> result(plan.shape(), vector<size_t>(plan.shape().size(), 1));
+        plan.execute(block, rhs.block, result.block);
+        return result;
+    }
+
+    // SUMMA needs a summation index of both operands and an index of the result of a single operand
+    const Operand<T> lhs_op = {this, &idx_lhs}, rhs_op = {&rhs, &idx_rhs};
+    int a = -1, b = -1, k = 0;
+    for(int l : idx_lhs)
+    {
+        if(l >= 0 && lhs_op.occurrences(l) == 1 && !rhs_op.occurrences(l) && (a < 0 || lhs_op.extent(l) > lhs_op.extent(a)))
+        {
+            a = l;
+        }
+        if(l < 0 && lhs_op.occurrences(l) == 1 && rhs_op.occurrences(l) == 1 && (!k || lhs_op.extent(l) > lhs_op.extent(k)))
+        {
+            k = l;
+        }
+    }
+    for(int l : idx_rhs)
+    {
+        if(l >= 0 && rhs_op.occurrences(l) == 1 && !lhs_op.occurrences(l) && (b < 0 || rhs_op.extent(l) > rhs_op.extent(b)))
+        {
+            b = l;
+        }
+    }
+    if(k && (a >= 0 || b >= 0))
+    {
+        return summa(lhs_op, rhs_op, plan.shape(), a, b, k);
+    }
+    return partitioned<T>({lhs_op, rhs_op}, plan.shape());
+}
+
+template<class T>
+DistributedTensor<T> DistributedTensor<T>::contract(const vector<int> &idx) const
+{
+    PROFILE_SCOPE("DistributedTensor::contract");
+    const ContractionPlan plan(shape, idx);
+    if(Distributed::size() == 1)
+    {
+        DistributedTensor<T> result(plan.shape(), vector<size_t>(plan.shape().size(), 1));
+        plan.execute(block, result.block);
+        return result;
+    }
+    return partitioned<T>({Operand<T>{this, &idx}}, plan.shape());
+}
+
+/**
+    FILE I/O
+**/
+
+#if ENABLE_MPI == 1
+/*
+    Reads or writes the components of box of a tensor of the given shape, whose payload starts at the given offset
+    of the file. Collective: the view of every rank selects its block, such that MPI-IO can merge the accesses.
+*/
+static void transfer_block(MPI_File file, uint64_t payload, const vector<size_t> &shape, const Box &box, size_t elem_size, void* data, bool write)
+{
+    using Distributed::Detail::check;
+    MPI_Datatype etype, ftype;
+    check(MPI_Type_contiguous(int(elem_size), MPI_BYTE, &etype), "MPI_Type_contiguous");
+    check(MPI_Type_commit(&etype), "MPI_Type_commit");
+    ftype = etype;
+    const size_t n = volume(box);
+    if(shape.size() && n)
+    {
+        vector<int> sizes(shape.size()), subsizes(shape.size()), starts(shape.size());
+        for(size_t k=0; k<shape.size(); k++)
+        {
+            if(shape[k] > size_t(numeric_limits<int>::max()))
+            {
+                throw overflow_error("TensorUtils::DistributedTensor<T>:: Index too large for MPI-IO!");
+            }
+            sizes[k] = int(shape[k]);
+            subsizes[k] = int(box.last[k]-box.first[k]);
+            starts[k] = int(box.first[k]);
+        }
+        check(MPI_Type_create_subarray(int(shape.size()), sizes.data(), subsizes.data(), starts.data(), MPI_ORDER_C, etype, &ftype), "MPI_Type_create_subarray");
+        check(MPI_Type_commit(&ftype), "MPI_Type_commit");
+    }
+    check(MPI_File_set_view(file, MPI_Offset(payload), etype, ftype, "native", MPI_INFO_NULL), "MPI_File_set_view");
+
+    // blocks beyond MAX_MESSAGE bytes take several collective calls
+    const size_t max_count = Distributed::Detail::MAX_MESSAGE/elem_size;
+    const size_t calls = Distributed::Detail::all_max((n+max_count-1)/max_count);
+    char* ptr = static_cast<char*>(data);
+    for(size_t c=0; c<calls; c++)
+    {
+        const size_t first = min(n, c*max_count), m = min(n-first, max_count);
+        if(write)
+        {
+            check(MPI_File_write_all(file, ptr+first*elem_size, int(m), etype, MPI_STATUS_IGNORE), "MPI_File_write_all");
+        }
+        else
+        {
+            check(MPI_File_read_all(file, ptr+first*elem_size, int(m), etype, MPI_STATUS_IGNORE), "MPI_File_read_all");
+        }
+    }
+    if(ftype != etype)
+    {
+        MPI_Type_free(&ftype);
+    }
+    MPI_Type_free(&etype);
+}
+
+// true for the binary formats of BinaryFormat with a payload in lexicographical order
+static bool raw_format(const string &extension)
+{
+    return extension == BinaryFormat::CONTAINER_EXTENSION || BinaryFormat::extension_dtype(extension) != BinaryFormat::DType::NONE;
+}
+#endif // ENABLE_MPI
+
+template<class T>
+void DistributedTensor<T>::read(const string &path, const vector<size_t> &axes)
+{
+    PROFILE_SCOPE("DistributedTensor::read");
+    #if ENABLE_MPI == 1
+    // rank 0 reads the header, or the whole tensor if its payload cannot be read in blocks
+    BinaryFormat::ContainerHeader H;
+    TensorBase<T> global;
+    vector<uint64_t> meta;
+    on_root([&]()
+    {
+        bool direct = false;
+        if(raw_format(filesystem::path(path).extension()))
+        {
+            H = BinaryFormat::ContainerReader(path).header();
+            direct = !H.compressed() && !H.sparse();
+        }
+        if(!direct)
+        {
+            global.read(path);
+            H.shape = global.shape;
+        }
+        meta = {direct, H.little_endian, uint64_t(H.dtype), H.elem_size, H.payload_offset, H.shape.size()};
+        meta.insert(meta.end(), H.shape.begin(), H.shape.end());
+    });
+    const Distributed::Detail::Comm world = Distributed::Detail::world();
+    uint64_t length = meta.size();
+    Distributed::Detail::broadcast(&length, sizeof(length), 0, world);
+    meta.resize(length);
+    Distributed::Detail::broadcast(meta.data(), length*sizeof(uint64_t), 0, world);
+    H.little_endian = meta[1];
+    H.dtype = BinaryFormat::DType(meta[2]);
+    H.elem_size = uint32_t(meta[3]);
+    H.payload_offset = meta[4];
+    H.shape.assign(meta.begin()+6, meta.begin()+6+meta[5]);
+
+    const vector<size_t> grid = Distributed::grid(H.shape, axes);
+    if(!meta[0])
+    {
+        *this = scatter(global, grid);
+        return;
+    }
+    init(H.shape, grid);
+
+    MPI_File file;
+    if(MPI_File_open(world, path.c_str(), MPI_MODE_RDONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS)
+    {
+        throw UnableToOpenFile("TensorUtils::DistributedTensor<T>::read:: Unable to open file \""+path+"\".");
+    }
+    const Box box = block_box(shape, grid, Distributed::rank());
+    const bool same = H.dtype == BinaryFormat::dtype<T>() && H.elem_size == sizeof(T) && H.little_endian == BinaryFormat::little_endian();
+    vector<char> raw(same ? 0 : volume(box)*H.elem_size);
+    try
+    {
+        transfer_block(file, H.payload_offset, shape, box, H.elem_size, same ? (void*)block.data() : (void*)raw.data(), false);
+    }
+    catch(...)
+    {
+        MPI_File_close(&file);
+        throw;
+    }
+    MPI_File_close(&file);
+    if(!same)
+    {
+        BinaryFormat::convert(raw.data(), H, block.data(), block.size());
+    }
+    #else
+    block.read(path);
+    grid = Distributed::grid(block.shape, axes);
+    shape = block.shape;
+    offset.assign(shape.size(), 0);
+    #endif // ENABLE_MPI
+    PROFILE_IO(block.size()*sizeof(T));
+}
+
+template<class T>
+void DistributedTensor<T>::write(const string &oname, const string &folder)
+{
+    PROFILE_SCOPE("DistributedTensor::write");
+    #if ENABLE_MPI == 1
+    const string extension = filesystem::path(oname).extension();
+    if(extension != BinaryFormat::CONTAINER_EXTENSION && extension != BinaryFormat::extension<T>())
+    {
+        // conversions, compression and text are applied by rank 0
+        TensorBase<T> global = gather(0);
+        on_root([&](){ global.write(oname, folder); });
+        return;
+    }
+    string path = folder;
+    if(path.back() != '/' ){
+        path.append("/");
+    }
+    path.append(oname);
+    on_root([&](){ filesystem::create_directories(folder); });
+
+    // without checksums, which would need the components of other blocks
+    const BinaryFormat::ContainerHeader H = (extension == BinaryFormat::CONTAINER_EXTENSION)
+        ? BinaryFormat::make_header(BinaryFormat::dtype<T>(), shape, 0)
+        : BinaryFormat::make_legacy_header(BinaryFormat::dtype<T>(), shape);
+    vector<char> header(H.payload_offset);
+    if(H.legacy)
+    {
+        vector<size_t> sizes = {shape.size()};
+        sizes.insert(sizes.end(), shape.begin(), shape.end());
+        sizes.push_back(size());
+        copy_n(reinterpret_cast<const char*>(sizes.data()), header.size(), header.data());
+    }
+    else
+    {
+        BinaryFormat::encode_header(H, header.data());
+    }
+
+    using Distributed::Detail::check;
+    MPI_File file;
+    const Distributed::Detail::Comm world = Distributed::Detail::world();
+    if(MPI_File_open(world, path.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS)
+    {
+        throw UnableToOpenFile("TensorUtils::DistributedTensor<T>::write:: Unable to create file \""+path+"\".");
+    }
+    try
+    {
+        check(MPI_File_set_size(file, MPI_Offset(H.payload_offset + H.payload_size())), "MPI_File_set_size");
+        if(Distributed::rank() == 0)
+        {
+            check(MPI_File_write_at(file, 0, header.data(), int(header.size()), MPI_BYTE, MPI_STATUS_IGNORE), "MPI_File_write_at");
+        }
+        transfer_block(file, H.payload_offset, shape, source_box(*this, Distributed::rank()), sizeof(T), block.data(), true);
+    }
+    catch(...)
+    {
+        MPI_File_close(&file);
+        throw;
+    }
+    check(MPI_File_close(&file), "MPI_File_close");
+    #else
+    block.write(oname, folder);
+    #endif // ENABLE_MPI
+}
+
+/**
+    EXPLICIT TEMPLATE INSTANTIATION
+**/
+
+namespace TensorUtils
+{
+    #ifndef ENABLE_INTEGRAL_TYPES
+    #define ENABLE_INTEGRAL_TYPES 1
+    #endif // ENABLE_INTEGRAL_TYPES
+
+    template class DistributedTensor<double>;
+    template class DistributedTensor<float>;
+    template class DistributedTensor<long double>;
+
+    #if ENABLE_INTEGRAL_TYPES == 1
+        template class DistributedTensor<unsigned char>;
+        template class DistributedTensor<signed char>;
+        template class DistributedTensor<unsigned short>;
+        template class DistributedTensor<short>;
+        template class DistributedTensor<unsigned>;
+        template class DistributedTensor<int>;
+        template class DistributedTensor<unsigned long>;
+        template class DistributedTensor<long>;
+        template class DistributedTensor<unsigned long long>;
+        template class DistributedTensor<long long>;
+    #endif
+}
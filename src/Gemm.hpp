@@ -0,0 +1,314 @@
+/*
+TensorUtils Version 0.1
+
+Copyright 2022 Christoph Widder
+
+This file is part of TensorUtils.
+
+TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+the GNU General Public License as published by the Free Software Foundation, either
+version 3 of the License, or (at your option) any later version.
+
+TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with TensorUtils.
+If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef GEMM_HPP
+#define GEMM_HPP
+
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+
+namespace TensorUtils
+{
+    namespace Kernels
+    {
+        /*
+            Memory layout of a batched matrix product C[b,m,n] = sum_k A[b,m,k]*B[b,k,n].
+            Each of the logical indices b,m,n,k may be a group of several tensor indices.
+            Groups are flattened in lexicographical order and every flattened index is
+            translated into a memory offset by the tables below, i.e.
+
+                A[b,m,k] = A_data[a0 + a_b[b] + a_m[m] + a_k[k]]
+
+            and analogously for B and C. This allows arbitrary strides and orderings of
+            the tensor indices without copying the operands.
+        */
+        struct GemmLayout
+        {
+            size_t M = 1;
+            size_t N = 1;
+            size_t K = 1;
+            size_t batch = 1;
+
+            size_t a0 = 0;
+            size_t b0 = 0;
+            size_t c0 = 0;
+
+            std::vector<size_t> a_b, a_m, a_k;
+            std::vector<size_t> b_b, b_k, b_n;
+            std::vector<size_t> c_b, c_m, c_n;
+        };
+
+        // offsets of all multi-indices of a group of axes in lexicographical order
+        inline std::vector<size_t> group_offsets(const std::vector<size_t> &extent, const std::vector<size_t> &stride)
+        {
+            std::vector<size_t> offsets(1,0);
+            for(size_t dim=0; dim<extent.size(); dim++)
+            {
+                std::vector<size_t> next;
+                next.reserve(offsets.size()*extent[dim]);
+                for(auto it=offsets.begin(); it!=offsets.end(); it++)
+                {
+                    for(size_t n=0; n<extent[dim]; n++)
+                    {
+                        next.push_back(*it + n*stride[dim]);
+                    }
+                }
+                offsets.swap(next);
+            }
+            return offsets;
+        }
+
+        // register and cache blocking, chosen such that the packed panels of A fit into L2
+        // and the packed panels of B into L3 for all supported floating point types
+        template<class T>
+        struct GemmBlocking
+        {
+            static constexpr size_t MR = 4;
+            static constexpr size_t NR = (sizeof(T) == 4) ? 8 : 4;
+            static constexpr size_t KC = 256;
+            static constexpr size_t MC = 128;
+            static constexpr size_t NC = 2048;
+        };
+
+        // minimum number of multiply-adds M*N*K for which packing pays off
+        constexpr size_t GEMM_MIN_WORK = 1024;
+
+        // pack a mc x kc block of A into row panels of height MR, padded with zeros
+        template<class T, size_t MR, class TA>
+        inline void pack_A(
+            T*              dst,
+            const TA*       A,
+            const size_t*   off_m,
+            const size_t*   off_k,
+            size_t          mc,
+            size_t          kc)
+        {
+            for(size_t ir=0; ir<mc; ir+=MR)
+            {
+                const size_t mr = std::min(MR, mc-ir);
+                for(size_t p=0; p<kc; p++)
+                {
+                    const TA* col = A + off_k[p];
+                    size_t i=0;
+                    for(; i<mr; i++)
+                    {
+                        dst[i] = col[off_m[ir+i]];
+                    }
+                    for(; i<MR; i++)
+                    {
+                        dst[i] = 0;
+                    }
+                    dst += MR;
+                }
+            }
+        }
+
+        // pack a kc x nc block of B into column panels of width NR, padded with zeros
+        template<class T, size_t NR, class TB>
+        inline void pack_B(
+            T*              dst,
+            const TB*       B,
+            const size_t*   off_k,
+            const size_t*   off_n,
+            size_t          kc,
+            size_t          nc)
+        {
+            for(size_t jr=0; jr<nc; jr+=NR)
+            {
+                const size_t nr = std::min(NR, nc-jr);
+                for(size_t p=0; p<kc; p++)
+                {
+                    const TB* row = B + off_k[p];
+                    size_t j=0;
+                    for(; j<nr; j++)
+                    {
+                        dst[j] = row[off_n[jr+j]];
+                    }
+                    for(; j<NR; j++)
+                    {
+                        dst[j] = 0;
+                    }
+                    dst += NR;
+                }
+            }
+        }
+
+        // MR x NR outer product update on packed panels, accumulators are kept in registers
+        template<class T, size_t MR, size_t NR>
+        inline void micro_kernel(size_t kc, const T* a, const T* b, T (&acc)[MR][NR])
+        {
+            T c[MR][NR];
+            for(size_t i=0; i<MR; i++)
+            {
+                for(size_t j=0; j<NR; j++)
+                {
+                    c[i][j] = 0;
+                }
+            }
+            for(size_t p=0; p<kc; p++)
+            {
+                for(size_t i=0; i<MR; i++)
+                {
+                    const T a_i = a[i];
+                    for(size_t j=0; j<NR; j++)
+                    {
+                        c[i][j] += a_i*b[j];
+                    }
+                }
+                a += MR;
+                b += NR;
+            }
+            for(size_t i=0; i<MR; i++)
+            {
+                for(size_t j=0; j<NR; j++)
+                {
+                    acc[i][j] = c[i][j];
+                }
+            }
+        }
+
+        // packing buffers are kept per thread and reused by subsequent calls
+        template<class T>
+        inline T* gemm_workspace(size_t n, unsigned slot)
+        {
+            thread_local std::vector<T> buffer[2];
+            if(buffer[slot].size()<n)
+            {
+                buffer[slot].resize(n);
+            }
+            return buffer[slot].data();
+        }
+
+        /*
+            Columns [n_begin,n_end) of the matrix product of batch b on the layout L, with L.M, L.N, L.K > 0.
+            Panels of different columns or batches are independent and can be computed concurrently.
+            The epilogue stores C = alpha*A*B + beta*C, C is not read if beta is zero.
+        */
+        template<class T, class TA, class TB>
+        void gemm_panel(const GemmLayout &L, const TA* A, const TB* B, T* C, size_t b, size_t n_begin, size_t n_end,
+                        const T &alpha = T(1), const T &beta = T(0))
+        {
+            typedef GemmBlocking<T> BS;
+            constexpr size_t MR = BS::MR;
+            constexpr size_t NR = BS::NR;
+
+            const size_t KC = std::min(BS::KC, L.K);
+            const size_t MC = std::min(BS::MC, (L.M+MR-1)/MR*MR);
+            const size_t NC = std::min(BS::NC, (n_end-n_begin+NR-1)/NR*NR);
+            T* Ap = gemm_workspace<T>(MC*KC, 0);
+            T* Bp = gemm_workspace<T>(KC*NC, 1);
+            T acc[MR][NR];
+
+            const TA* Ab = A + L.a0 + L.a_b[b];
+            const TB* Bb = B + L.b0 + L.b_b[b];
+            T* Cb = C + L.c0 + L.c_b[b];
+
+            for(size_t jc=n_begin; jc<n_end; jc+=NC)
+            {
+                const size_t nc = std::min(NC, n_end-jc);
+                for(size_t pc=0; pc<L.K; pc+=KC)
+                {
+                    const size_t kc = std::min(KC, L.K-pc);
+                    const bool first = (pc == 0);
+                    pack_B<T,NR>(Bp, Bb, &L.b_k[pc], &L.b_n[jc], kc, nc);
+
+                    for(size_t ic=0; ic<L.M; ic+=MC)
+                    {
+                        const size_t mc = std::min(MC, L.M-ic);
+                        pack_A<T,MR>(Ap, Ab, &L.a_m[ic], &L.a_k[pc], mc, kc);
+
+                        for(size_t jr=0; jr<nc; jr+=NR)
+                        {
+                            const size_t nr = std::min(NR, nc-jr);
+                            const size_t* c_n = &L.c_n[jc+jr];
+                            for(size_t ir=0; ir<mc; ir+=MR)
+                            {
+                                const size_t mr = std::min(MR, mc-ir);
+                                const size_t* c_m = &L.c_m[ic+ir];
+                                micro_kernel<T,MR,NR>(kc, &Ap[ir*kc], &Bp[jr*kc], acc);
+                                for(size_t i=0; i<mr; i++)
+                                {
+                                    T* row = Cb + c_m[i];
+                                    if(first && beta == T(0))
+                                    {
+                                        for(size_t j=0; j<nr; j++)
+                                        {
+                                            row[c_n[j]] = alpha*acc[i][j];
+                                        }
+                                    }
+                                    else if(first)
+                                    {
+                                        for(size_t j=0; j<nr; j++)
+                                        {
+                                            row[c_n[j]] = alpha*acc[i][j] + beta*row[c_n[j]];
+                                        }
+                                    }
+                                    else
+                                    {
+                                        for(size_t j=0; j<nr; j++)
+                                        {
+                                            row[c_n[j]] += alpha*acc[i][j];
+                                        }
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        /*
+            Blocked and packed (batched) matrix product on the layout L.
+            The components of C addressed by L are overwritten with alpha*A*B + beta*C.
+            Operands are converted to T while packing, the accumulation is done in T.
+        */
+        template<class T, class TA, class TB>
+        void gemm(const GemmLayout &L, const TA* A, const TB* B, T* C, const T &alpha = T(1), const T &beta = T(0))
+        {
+            if(L.M == 0 || L.N == 0)
+            {
+                return;
+            }
+            if(L.K == 0)
+            {
+                for(size_t b=0; b<L.batch; b++)
+                {
+                    for(size_t m=0; m<L.M; m++)
+                    {
+                        for(size_t n=0; n<L.N; n++)
+                        {
+                            T &c = C[L.c0 + L.c_b[b] + L.c_m[m] + L.c_n[n]];
+                            c = (beta == T(0)) ? T(0) : beta*c;
+                        }
+                    }
+                }
+                return;
+            }
+            for(size_t b=0; b<L.batch; b++)
+            {
+                gemm_panel(L, A, B, C, b, 0, L.N, alpha, beta);
+            }
+        }
+    }
+}
+
+#endif // GEMM_HPP
@@ -0,0 +1,446 @@
+/*
+TensorUtils Version 0.1
+
+Copyright 2022 Christoph Widder
+
+This file is part of TensorUtils.
+
+TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+the GNU General Public License as published by the Free Software Foundation, either
+version 3 of the License, or (at your option) any later version.
+
+TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with TensorUtils.
+If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef THROW_BASIC_EXCEPTIONS
+#define THROW_BASIC_EXCEPTIONS 1
+#endif // THROW_BASIC_EXCEPTIONS
+
+#include "LazyTensor.hpp"
+#include "ContractionPlan.hpp"
+#include "Profile.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <utility>
+
+using namespace std;
+using namespace TensorUtils;
+using namespace ErrorHandler;
+
+/**
+    GRAPH
+**/
+
+// transposes of leaves are strides, transposes of products and contractions are relabelings: there is no transpose node
+template<class T>
+struct LazyTensor<T>::Node
+{
+    enum Kind { LEAF, DOT, CONTRACT, SCALE, SUM };
+
+    Kind                    kind;
+    vector<size_t>          shape;
+
+    // LEAF: strided components
+    const T*                data = nullptr;
+    vector<size_t>          incr;
+
+    // DOT, CONTRACT: labels of the operands, SCALE: lhs, SUM: lhs + factor*rhs
+    shared_ptr<const Node>  lhs, rhs;
+    vector<int>             idx_lhs, idx_rhs;
+    T                       factor = T(1);
+};
+
+namespace
+{
+    // labels of a product or contraction after its result is transposed by axes
+    void relabel(const vector<unsigned> &axes, vector<int> &idx_lhs, vector<int> &idx_rhs)
+    {
+        // the output positions are the distinct nonnegative labels in ascending order
+        vector<int> labels;
+        for(int label : idx_lhs)    if(label >= 0) labels.push_back(label);
+        for(int label : idx_rhs)    if(label >= 0) labels.push_back(label);
+        sort(labels.begin(), labels.end());
+        labels.erase(unique(labels.begin(), labels.end()), labels.end());
+
+        map<int,int> mapping;
+        for(size_t d=0; d<axes.size(); d++)
+        {
+            mapping[labels[axes[d]]] = int(d);
+        }
+        for(int &label : idx_lhs)   if(label >= 0) label = mapping[label];
+        for(int &label : idx_rhs)   if(label >= 0) label = mapping[label];
+    }
+
+    // lowest and one past the highest address of a strided operand, empty for operands without components
+    template<class T>
+    pair<const T*, const T*> extent(const T* data, const vector<size_t> &shape, const vector<size_t> &incr)
+    {
+        size_t last = 0;
+        for(size_t d=0; d<shape.size(); d++)
+        {
+            if(shape[d] == 0)
+            {
+                return {data, data};
+            }
+            last += (shape[d]-1)*incr[d];
+        }
+        return {data, data+last+1};
+    }
+}
+
+template<class T>
+LazyTensor<T>::LazyTensor(shared_ptr<const Node> node) : node(std::move(node))
+{
+    //
+}
+
+template<class T>
+LazyTensor<T>::LazyTensor(const TensorBase<T> &tensor)
+{
+    auto leaf = make_shared<Node>();
+    leaf->kind = Node::LEAF;
+    leaf->shape = tensor.shape;
+    leaf->incr = tensor.incr;
+    leaf->data = tensor.data();
+    node = std::move(leaf);
+}
+
+template<class T>
+LazyTensor<T>::LazyTensor(const TensorView<T> &view)
+{
+    auto leaf = make_shared<Node>();
+    leaf->kind = Node::LEAF;
+    leaf->shape = view.shape;
+    leaf->incr = view.incr;
+    leaf->data = view.data();
+    node = std::move(leaf);
+}
+
+template<class T>
+const vector<size_t>& LazyTensor<T>::shape() const
+{
+    return node->shape;
+}
+
+template<class T>
+size_t LazyTensor<T>::size() const
+{
+    size_t num_elems = 1;
+    for(size_t n : node->shape)
+    {
+        num_elems *= n;
+    }
+    return num_elems;
+}
+
+template<class T>
+LazyTensor<T> LazyTensor<T>::transpose(const vector<unsigned> &axes) const
+{
+    const vector<size_t> &shape = node->shape;
+    bool identity = (axes.size() == shape.size());
+    if(THROW_BASIC_EXCEPTIONS)
+    {
+        // every axis exactly once
+        vector<bool> seen(shape.size(), false);
+        bool valid = (axes.size() == shape.size());
+        for(auto it=axes.begin(); valid && it!=axes.end(); it++)
+        {
+            valid = (*it < shape.size()) && !seen[*it];
+            if(valid)
+            {
+                seen[*it] = true;
+            }
+        }
+        if(!valid)
+        {
+            throw ShapeMismatch("TensorUtils::LazyTensor<T>::transpose:: Axes do not match!");
+        }
+    }
+    for(size_t d=0; identity && d<axes.size(); d++)
+    {
+        identity = (axes[d] == d);
+    }
+    if(identity)
+    {
+        return *this;
+    }
+
+    auto result = make_shared<Node>(*node);
+    for(size_t d=0; d<axes.size(); d++)
+    {
+        result->shape[d] = shape[axes[d]];
+    }
+    switch(node->kind)
+    {
+        case Node::LEAF:
+            for(size_t d=0; d<axes.size(); d++)
+            {
+                result->incr[d] = node->incr[axes[d]];
+            }
+            break;
+        case Node::DOT:
+        case Node::CONTRACT:
+            relabel(axes, result->idx_lhs, result->idx_rhs);
+            break;
+        case Node::SCALE:
+            result->lhs = LazyTensor<T>(node->lhs).transpose(axes).node;
+            break;
+        case Node::SUM:
+            result->lhs = LazyTensor<T>(node->lhs).transpose(axes).node;
+            result->rhs = LazyTensor<T>(node->rhs).transpose(axes).node;
+            break;
+    }
+    return LazyTensor<T>(std::move(result));
+}
+
+template<class T>
+LazyTensor<T> LazyTensor<T>::dot(const LazyTensor<T> &rhs, const vector<int> &idx_lhs, const vector<int> &idx_rhs) const
+{
+    // validates the labels, the plan is cached for the evaluation
+    const ContractionPlan plan(node->shape, idx_lhs, rhs.node->shape, idx_rhs);
+
+    auto result = make_shared<Node>();
+    result->kind = Node::DOT;
+    result->shape = plan.shape();
+    result->lhs = node;
+    result->rhs = rhs.node;
+    result->idx_lhs = idx_lhs;
+    result->idx_rhs = idx_rhs;
+    return LazyTensor<T>(std::move(result));
+}
+
+template<class T>
+LazyTensor<T> LazyTensor<T>::dot(const TensorBase<T> &rhs, const vector<int> &idx_lhs, const vector<int> &idx_rhs) const
+{
+    return dot(LazyTensor<T>(rhs), idx_lhs, idx_rhs);
+}
+
+template<class T>
+LazyTensor<T> LazyTensor<T>::contract(const vector<int> &idx) const
+{
+    const ContractionPlan plan(node->shape, idx);
+
+    auto result = make_shared<Node>();
+    result->kind = Node::CONTRACT;
+    result->shape = plan.shape();
+    result->lhs = node;
+    result->idx_lhs = idx;
+    return LazyTensor<T>(std::move(result));
+}
+
+template<class T>
+LazyTensor<T> LazyTensor<T>::scale(const T &factor) const
+{
+    if(factor == T(1))
+    {
+        return *this;
+    }
+    if(node->kind == Node::SCALE)
+    {
+        auto result = make_shared<Node>(*node);
+        result->factor *= factor;
+        return LazyTensor<T>(std::move(result));
+    }
+
+    auto result = make_shared<Node>();
+    result->kind = Node::SCALE;
+    result->shape = node->shape;
+    result->lhs = node;
+    result->factor = factor;
+    return LazyTensor<T>(std::move(result));
+}
+
+template<class T>
+LazyTensor<T> LazyTensor<T>::combine(const LazyTensor<T> &rhs, const T &factor) const
+{
+    if(THROW_BASIC_EXCEPTIONS && node->shape != rhs.node->shape)
+    {
+        throw ShapeMismatch(string("TensorUtils::LazyTensor<T>::") + (factor == T(1) ? "operator+" : "operator-") + ":: Shape mismatch: Arguments do not have the same shape!");
+    }
+
+    auto result = make_shared<Node>();
+    result->kind = Node::SUM;
+    result->shape = node->shape;
+    result->lhs = node;
+    result->rhs = rhs.node;
+    result->factor = factor;
+    return LazyTensor<T>(std::move(result));
+}
+
+/**
+    EVALUATION
+**/
+
+namespace
+{
+    template<class T>
+    using NodePtr = shared_ptr<const typename LazyTensor<T>::Node>;
+
+    // strided operand of a product or contraction with its folded scalar factor
+    template<class T>
+    struct Operand
+    {
+        const T*        data;
+        vector<size_t>  shape;
+        vector<size_t>  incr;
+        T               scale;
+        TensorBase<T>   storage;
+    };
+
+    template<class T>
+    void evaluate(const NodePtr<T> &node, T* dst, const T &alpha, const T &beta);
+
+    // leaves and scaled leaves are read in place, everything else is computed into a temporary
+    template<class T>
+    Operand<T> resolve(NodePtr<T> node)
+    {
+        using Node = typename LazyTensor<T>::Node;
+
+        Operand<T> op;
+        op.scale = T(1);
+        while(node->kind == Node::SCALE)
+        {
+            op.scale *= node->factor;
+            node = node->lhs;
+        }
+        if(node->kind == Node::LEAF)
+        {
+            op.data = node->data;
+            op.shape = node->shape;
+            op.incr = node->incr;
+        }
+        else
+        {
+            op.storage.alloc(node->shape);
+            evaluate<T>(node, op.storage.data(), T(1), T(0));
+            op.data = op.storage.data();
+            op.shape = op.storage.shape;
+            op.incr = op.storage.incr;
+        }
+        return op;
+    }
+
+    // dst = alpha*node + beta*dst, dst is contiguous with the shape of node
+    template<class T>
+    void evaluate(const NodePtr<T> &node, T* dst, const T &alpha, const T &beta)
+    {
+        using Node = typename LazyTensor<T>::Node;
+
+        switch(node->kind)
+        {
+            case Node::LEAF:
+            {
+                // copy through the identity contraction, which applies the epilogue while it is written
+                vector<int> idx(node->shape.size());
+                for(size_t d=0; d<idx.size(); d++)
+                {
+                    idx[d] = int(d);
+                }
+                const ContractionPlan plan(node->shape, node->incr, idx, {});
+                plan.execute(node->data, dst, alpha, beta);
+                break;
+            }
+            case Node::DOT:
+            {
+                const Operand<T> lhs = resolve<T>(node->lhs);
+                const Operand<T> rhs = resolve<T>(node->rhs);
+                const ContractionPlan plan(lhs.shape, lhs.incr, node->idx_lhs, rhs.shape, rhs.incr, node->idx_rhs);
+                plan.execute(lhs.data, rhs.data, dst, alpha*lhs.scale*rhs.scale, beta);
+                break;
+            }
+            case Node::CONTRACT:
+            {
+                const Operand<T> lhs = resolve<T>(node->lhs);
+                const ContractionPlan plan(lhs.shape, lhs.incr, node->idx_lhs, {});
+                plan.execute(lhs.data, dst, alpha*lhs.scale, beta);
+                break;
+            }
+            case Node::SCALE:
+                evaluate<T>(node->lhs, dst, alpha*node->factor, beta);
+                break;
+            case Node::SUM:
+                // every term is accumulated directly into dst
+                evaluate<T>(node->lhs, dst, alpha, beta);
+                evaluate<T>(node->rhs, dst, alpha*node->factor, T(1));
+                break;
+        }
+    }
+
+    // true if a leaf of node shares memory with [begin,end)
+    template<class T>
+    bool overlaps(const NodePtr<T> &node, const T* begin, const T* end)
+    {
+        using Node = typename LazyTensor<T>::Node;
+
+        if(!node)
+        {
+            return false;
+        }
+        if(node->kind == Node::LEAF)
+        {
+            const pair<const T*, const T*> range = extent(node->data, node->shape, node->incr);
+            return range.first < end && begin < range.second;
+        }
+        return overlaps<T>(node->lhs, begin, end) || overlaps<T>(node->rhs, begin, end);
+    }
+}
+
+template<class T>
+TensorBase<T> LazyTensor<T>::eval() const
+{
+    TensorBase<T> result;
+    eval(result, T(1), T(0));
+    return result;
+}
+
+template<class T>
+void LazyTensor<T>::eval(TensorBase<T> &result, const T &alpha, const T &beta) const
+{
+    PROFILE_SCOPE("LazyTensor::eval");
+    if(THROW_BASIC_EXCEPTIONS && beta != T(0) && result.shape != node->shape)
+    {
+        throw ShapeMismatch("TensorUtils::LazyTensor<T>::eval:: Shape mismatch: The result does not have the shape of the expression!");
+    }
+
+    // the result is an operand of its own expression: compute into a temporary before result is changed
+    const T* begin = result.data();
+    if(overlaps<T>(node, begin, begin+result.size()))
+    {
+        TensorBase<T> tmp(node->shape);
+        evaluate<T>(node, tmp.data(), alpha, T(0));
+        if(beta == T(0))
+        {
+            result = std::move(tmp);
+        }
+        else
+        {
+            evaluate<T>(LazyTensor<T>(tmp).node, result.data(), T(1), beta);
+        }
+        return;
+    }
+
+    if(result.shape != node->shape)
+    {
+        result.alloc(node->shape);
+    }
+    evaluate<T>(node, result.data(), alpha, beta);
+}
+
+/**
+    EXPLICIT TEMPLATE INSTANTIATION
+**/
+
+namespace TensorUtils
+{
+    template class LazyTensor<double>;
+    template class LazyTensor<float>;
+    template class LazyTensor<long double>;
+}
@@ -0,0 +1,335 @@
+/*
+TensorUtils Version 0.1
+
+Copyright 2022 Christoph Widder
+
+This file is part of TensorUtils.
+
+TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+the GNU General Public License as published by the Free Software Foundation, either
+version 3 of the License, or (at your option) any later version.
+
+TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with TensorUtils.
+If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include "MappedTensor.hpp"
+#include "ErrorHandler.hpp"
+#include "BinaryFormat.hpp"
+
+#include <filesystem>
+#include <cstring>
+#include <cerrno>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace TensorUtils;
+using namespace ErrorHandler;
+
+/**
+    CONSTRUCTOR & DESTRUCTOR
+**/
+
+template<class T>
+MappedTensor<T>::MappedTensor() : addr(nullptr), length(0), ptr(nullptr), count(0), is_writable(false)
+{
+    //
+}
+
+template<class T>
+MappedTensor<T>::MappedTensor(const string &path, bool writable) : MappedTensor()
+{
+    map_file(path, writable, false);
+}
+
+template<class T>
+MappedTensor<T>::MappedTensor(const string &path, const vector<size_t> &shape) : MappedTensor()
+{
+    this->shape = shape;
+    map_file(path, true, true);
+}
+
+template<class T>
+MappedTensor<T>::MappedTensor(MappedTensor<T> &&other) : MappedTensor()
+{
+    *this = move(other);
+}
+
+template<class T>
+MappedTensor<T>& MappedTensor<T>::operator=(MappedTensor<T> &&other)
+{
+    if(this != &other)
+    {
+        release();
+        shape.swap(other.shape);
+        incr.swap(other.incr);
+        swap(addr, other.addr);
+        swap(length, other.length);
+        swap(ptr, other.ptr);
+        swap(count, other.count);
+        swap(is_writable, other.is_writable);
+    }
+    return *this;
+}
+
+template<class T>
+MappedTensor<T>::~MappedTensor()
+{
+    release();
+}
+
+/**
+    MAPPING
+**/
+
+template<class T>
+void MappedTensor<T>::map_file(const string &path, bool writable, bool create)
+{
+    const string extension = filesystem::path(path).extension();
+    const bool container = (extension == BinaryFormat::CONTAINER_EXTENSION);
+    if(!container && extension != BinaryFormat::extension<T>())
+    {
+        throw runtime_error("TensorUtils::MappedTensor<T>::MappedTensor:: Invalid file extension: extension does not match the component type!");
+    }
+
+    int fd = open(path.c_str(), writable ? (create ? O_RDWR|O_CREAT|O_TRUNC : O_RDWR) : O_RDONLY, 0644);
+    if(fd < 0)
+    {
+        string err_str = "TensorUtils::MappedTensor<T>::MappedTensor:: Unable to open file \"";
+        err_str.append(path);
+        err_str.append("\": ");
+        err_str.append(strerror(errno));
+        throw UnableToOpenFile(err_str);
+    }
+
+    size_t offset = 0;
+    if(create)
+    {
+        count = BinaryFormat::count(shape);
+        offset = container ? BinaryFormat::HEADER_SIZE : BinaryFormat::payload_offset(shape.size());
+        length = offset + count*sizeof(T);
+        if(ftruncate(fd, length) != 0)
+        {
+            close(fd);
+            throw UnableToOpenFile("TensorUtils::MappedTensor<T>::MappedTensor:: Unable to resize file \""+path+"\": "+strerror(errno));
+        }
+    }
+    else
+    {
+        struct stat st;
+        if(fstat(fd, &st) != 0)
+        {
+            close(fd);
+            throw UnableToOpenFile("TensorUtils::MappedTensor<T>::MappedTensor:: Unable to stat file \""+path+"\": "+strerror(errno));
+        }
+        length = st.st_size;
+    }
+
+    if(length < (container ? BinaryFormat::HEADER_SIZE : sizeof(size_t)))
+    {
+        close(fd);
+        length = 0;
+        throw ShapeMismatch("TensorUtils::MappedTensor<T>::MappedTensor:: File \""+path+"\" is too small for the header!");
+    }
+
+    // private mappings of read-only files can be changed without affecting the file
+    addr = mmap(nullptr, length, PROT_READ|PROT_WRITE, writable ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(addr == MAP_FAILED)
+    {
+        addr = nullptr;
+        length = 0;
+        throw UnableToOpenFile("TensorUtils::MappedTensor<T>::MappedTensor:: Unable to map file \""+path+"\": "+strerror(errno));
+    }
+    is_writable = writable;
+
+    size_t* header = static_cast<size_t*>(addr);
+    if(container)
+    {
+        BinaryFormat::ContainerHeader H;
+        try
+        {
+            if(create)
+            {
+                // checksums cannot be maintained for writes through the mapping
+                H = BinaryFormat::make_header(BinaryFormat::dtype<T>(), shape, 0);
+                BinaryFormat::encode_header(H, static_cast<char*>(addr));
+            }
+            else
+            {
+                H = BinaryFormat::decode_header(static_cast<const char*>(addr), path);
+            }
+        }
+        catch(...)
+        {
+            release();
+            throw;
+        }
+        if(H.sparse())
+        {
+            release();
+            throw runtime_error("TensorUtils::MappedTensor<T>::MappedTensor:: File \""+path+"\" holds a sparse tensor, use SparseTensor<T>::read instead!");
+        }
+        if(H.compressed())
+        {
+            release();
+            throw runtime_error("TensorUtils::MappedTensor<T>::MappedTensor:: File \""+path+"\" is compressed, use TensorBase<T>::read or TensorReader<T> instead!");
+        }
+        if(H.dtype != BinaryFormat::dtype<T>() || H.elem_size != sizeof(T) || H.little_endian != BinaryFormat::little_endian())
+        {
+            release();
+            throw runtime_error("TensorUtils::MappedTensor<T>::MappedTensor:: Component type or byte order of file \""+path+"\" does not match, use TensorBase<T>::read instead!");
+        }
+        if(length < H.payload_offset || (length-H.payload_offset)/sizeof(T) < H.count)
+        {
+            release();
+            throw ShapeMismatch("TensorUtils::MappedTensor<T>::MappedTensor:: Header does not match the size of file \""+path+"\"!");
+        }
+        if(writable && (H.flags & BinaryFormat::FLAG_CHUNK_CRC))
+        {
+            // the checksums become stale as soon as the mapping is changed
+            H.flags &= ~BinaryFormat::FLAG_CHUNK_CRC;
+            H.chunk_size = 0;
+            H.crc_offset = 0;
+            BinaryFormat::encode_header(H, static_cast<char*>(addr));
+        }
+        shape = H.shape;
+        count = H.count;
+        offset = H.payload_offset;
+    }
+    else if(create)
+    {
+        header[0] = shape.size();
+        for(unsigned n=0; n<shape.size(); n++)
+        {
+            header[n+1] = shape[n];
+        }
+        header[shape.size()+1] = count;
+    }
+    else
+    {
+        // parse the header in place
+        const size_t rank = header[0];
+        if(length/sizeof(size_t) < rank+2)
+        {
+            release();
+            throw ShapeMismatch("TensorUtils::MappedTensor<T>::MappedTensor:: Header does not match the size of file \""+path+"\"!");
+        }
+        shape.assign(header+1, header+1+rank);
+        count = header[rank+1];
+        offset = BinaryFormat::payload_offset(rank);
+        if(count != BinaryFormat::count(shape) || (length-offset)/sizeof(T) < count)
+        {
+            release();
+            throw ShapeMismatch("TensorUtils::MappedTensor<T>::MappedTensor:: Header does not match the size of file \""+path+"\"!");
+        }
+    }
+
+    if(offset % alignof(T) != 0)
+    {
+        release();
+        throw ShapeMismatch("TensorUtils::MappedTensor<T>::MappedTensor:: Components of file \""+path+"\" are not aligned, use TensorBase<T>::read instead!");
+    }
+    ptr = reinterpret_cast<T*>(static_cast<char*>(addr)+offset);
+
+    incr.resize(shape.size());
+    size_t stride = 1;
+    for(unsigned dim=shape.size(); dim>0; dim--)
+    {
+        incr[dim-1] = stride;
+        stride *= shape[dim-1];
+    }
+}
+
+template<class T>
+void MappedTensor<T>::release()
+{
+    if(addr)
+    {
+        munmap(addr, length);
+    }
+    addr = nullptr;
+    length = 0;
+    ptr = nullptr;
+    count = 0;
+    is_writable = false;
+    shape.clear();
+    incr.clear();
+}
+
+template<class T>
+void MappedTensor<T>::sync()
+{
+    if(addr && is_writable && msync(addr, length, MS_SYNC) != 0)
+    {
+        throw runtime_error(string("TensorUtils::MappedTensor<T>::sync:: msync failed: ")+strerror(errno));
+    }
+}
+
+/**
+    ACCESS
+**/
+
+template<class T>
+T* MappedTensor<T>::data() const
+{
+    return ptr;
+}
+
+template<class T>
+size_t MappedTensor<T>::size() const
+{
+    return count;
+}
+
+template<class T>
+bool MappedTensor<T>::writable() const
+{
+    return is_writable;
+}
+
+template<class T>
+TensorView<T> MappedTensor<T>::view() const
+{
+    return TensorView<T>(ptr, shape, incr);
+}
+
+/**
+    EXPLICIT TEMPLATE INSTANTIATION
+**/
+
+namespace TensorUtils
+{
+    #ifndef ENABLE_INTEGRAL_TYPES
+    #define ENABLE_INTEGRAL_TYPES 1
+    #endif // ENABLE_INTEGRAL_TYPES
+
+    #if ENABLE_INTEGRAL_TYPES == 1
+        template class MappedTensor<double>;
+        template class MappedTensor<float>;
+        template class MappedTensor<long double>;
+        template class MappedTensor<unsigned char>;
+        template class MappedTensor<signed char>;
+        template class MappedTensor<unsigned short>;
+        template class MappedTensor<short>;
+        template class MappedTensor<unsigned>;
+        template class MappedTensor<int>;
+        template class MappedTensor<unsigned long>;
+        template class MappedTensor<long>;
+        template class MappedTensor<unsigned long long>;
+        template class MappedTensor<long long>;
+    #else
+        template class MappedTensor<double>;
+        template class MappedTensor<float>;
+        template class MappedTensor<long double>;
+    #endif
+}
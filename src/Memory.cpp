@@ -0,0 +1,314 @@
+/*
+TensorUtils Version 0.1
+
+Copyright 2022 Christoph Widder
+
+This file is part of TensorUtils.
+
+TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+the GNU General Public License as published by the Free Software Foundation, either
+version 3 of the License, or (at your option) any later version.
+
+TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with TensorUtils.
+If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include "Memory.hpp"
+#include "Profile.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif // __linux__
+
+using namespace std;
+using namespace TensorUtils;
+
+Memory::Resource::~Resource()
+{
+    //
+}
+
+/**
+    RESOURCES
+**/
+
+namespace
+{
+    class AlignedResource : public Memory::Resource
+    {
+        public:
+            void* allocate(size_t bytes) override
+            {
+                return ::operator new(bytes, align_val_t(Memory::ALIGNMENT));
+            }
+
+            void deallocate(void* ptr, size_t) override
+            {
+                ::operator delete(ptr, align_val_t(Memory::ALIGNMENT));
+            }
+    };
+
+    class HugePageResource : public Memory::Resource
+    {
+        public:
+            static constexpr size_t HUGE_PAGE = size_t(1)<<21;
+
+            void* allocate(size_t bytes) override
+            {
+                #ifdef __linux__
+                if(bytes >= HUGE_PAGE)
+                {
+                    // over-allocate by one huge page and trim, such that the block starts at a huge page boundary
+                    const size_t size = round_up(bytes);
+                    void* raw = mmap(nullptr, size+HUGE_PAGE, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+                    if(raw == MAP_FAILED)
+                    {
+                        throw bad_alloc();
+                    }
+                    char* begin = static_cast<char*>(raw);
+                    char* aligned = reinterpret_cast<char*>(round_up(reinterpret_cast<size_t>(begin)));
+                    if(aligned != begin)
+                    {
+                        munmap(begin, aligned-begin);
+                    }
+                    const size_t tail = (begin+size+HUGE_PAGE) - (aligned+size);
+                    if(tail)
+                    {
+                        munmap(aligned+size, tail);
+                    }
+                    madvise(aligned, size, MADV_HUGEPAGE);
+                    return aligned;
+                }
+                #endif // __linux__
+                return Memory::aligned()->allocate(bytes);
+            }
+
+            void deallocate(void* ptr, size_t bytes) override
+            {
+                #ifdef __linux__
+                if(bytes >= HUGE_PAGE)
+                {
+                    munmap(ptr, round_up(bytes));
+                    return;
+                }
+                #endif // __linux__
+                Memory::aligned()->deallocate(ptr, bytes);
+            }
+
+        private:
+            static size_t round_up(size_t n)
+            {
+                return (n + HUGE_PAGE-1) & ~(HUGE_PAGE-1);
+            }
+    };
+
+    class PoolResource : public Memory::Resource
+    {
+        public:
+            void* allocate(size_t bytes) override
+            {
+                const size_t size = size_class(bytes);
+                {
+                    lock_guard<mutex> lock(m);
+                    auto it = free_blocks.find(size);
+                    if(it != free_blocks.end() && !it->second.empty())
+                    {
+                        void* ptr = it->second.back();
+                        it->second.pop_back();
+                        return ptr;
+                    }
+                }
+                return Memory::aligned()->allocate(size);
+            }
+
+            void deallocate(void* ptr, size_t bytes) override
+            {
+                lock_guard<mutex> lock(m);
+                free_blocks[size_class(bytes)].push_back(ptr);
+            }
+
+            void release()
+            {
+                lock_guard<mutex> lock(m);
+                for(auto it=free_blocks.begin(); it!=free_blocks.end(); it++)
+                {
+                    for(auto blk=it->second.begin(); blk!=it->second.end(); blk++)
+                    {
+                        Memory::aligned()->deallocate(*blk, it->first);
+                    }
+                }
+                free_blocks.clear();
+            }
+
+        private:
+            // quarter steps between powers of two, at least 256 bytes: at most 25% unused memory per block
+            static size_t size_class(size_t bytes)
+            {
+                size_t base = 256;
+                while(base < bytes/2)
+                {
+                    base *= 2;
+                }
+                const size_t step = max<size_t>(base/4, 1);
+                return ((max(bytes, base) + step-1)/step)*step;
+            }
+
+            mutex m;
+            map<size_t, vector<void*>> free_blocks;
+    };
+
+    atomic<Memory::Resource*> default_resource{nullptr};
+    thread_local Memory::Resource* scoped_resource = nullptr;
+}
+
+// the resources are never destroyed, such that tensors with static storage duration can be destroyed at any time
+Memory::Resource* Memory::aligned()
+{
+    static Resource* resource = new AlignedResource;
+    return resource;
+}
+
+Memory::Resource* Memory::huge_pages()
+{
+    static Resource* resource = new HugePageResource;
+    return resource;
+}
+
+static PoolResource* pool_resource()
+{
+    static PoolResource* resource = new PoolResource;
+    return resource;
+}
+
+Memory::Resource* Memory::pool()
+{
+    return pool_resource();
+}
+
+void Memory::release_pool()
+{
+    pool_resource()->release();
+}
+
+/**
+    SELECTION
+**/
+
+void Memory::set_default(Resource* resource)
+{
+    default_resource = resource;
+}
+
+Memory::Resource* Memory::current()
+{
+    if(scoped_resource)
+    {
+        return scoped_resource;
+    }
+    Resource* resource = default_resource;
+    return resource ? resource : aligned();
+}
+
+Memory::Scope::Scope(Resource* resource) : previous(scoped_resource)
+{
+    scoped_resource = resource;
+}
+
+Memory::Scope::~Scope()
+{
+    scoped_resource = previous;
+}
+
+/**
+    ALLOCATION
+**/
+
+// every block starts with a header of ALIGNMENT bytes that holds the resource it was allocated from
+void* Memory::allocate(size_t bytes)
+{
+    PROFILE_ALLOC(bytes);
+    Resource* resource = current();
+    char* block = static_cast<char*>(resource->allocate(bytes + ALIGNMENT));
+    *reinterpret_cast<Resource**>(block) = resource;
+    return block + ALIGNMENT;
+}
+
+void Memory::deallocate(void* ptr, size_t bytes)
+{
+    char* block = static_cast<char*>(ptr) - ALIGNMENT;
+    Resource* resource = *reinterpret_cast<Resource**>(block);
+    resource->deallocate(block, bytes + ALIGNMENT);
+}
+
+/**
+    ARENA
+**/
+
+Memory::Arena::Arena(size_t chunk_size) : chunk_size(max(chunk_size, ALIGNMENT)), offset(0), in_use(0)
+{
+    //
+}
+
+Memory::Arena::~Arena()
+{
+    for(auto it=chunks.begin(); it!=chunks.end(); it++)
+    {
+        aligned()->deallocate(it->data, it->size);
+    }
+}
+
+void* Memory::Arena::allocate(size_t bytes)
+{
+    const size_t size = (bytes + ALIGNMENT-1) & ~(ALIGNMENT-1);
+    lock_guard<mutex> lock(m);
+    if(chunks.empty() || offset + size > chunks.back().size)
+    {
+        const size_t n = max(chunk_size, size);
+        chunks.push_back({static_cast<char*>(aligned()->allocate(n)), n});
+        offset = 0;
+    }
+    void* ptr = chunks.back().data + offset;
+    offset += size;
+    in_use += size;
+    return ptr;
+}
+
+void Memory::Arena::deallocate(void*, size_t)
+{
+    //
+}
+
+void Memory::Arena::release()
+{
+    lock_guard<mutex> lock(m);
+    if(chunks.size() > 1)
+    {
+        size_t total = 0;
+        for(auto it=chunks.begin(); it!=chunks.end(); it++)
+        {
+            total += it->size;
+            aligned()->deallocate(it->data, it->size);
+        }
+        chunks.assign(1, Chunk{static_cast<char*>(aligned()->allocate(total)), total});
+    }
+    offset = 0;
+    in_use = 0;
+}
+
+size_t Memory::Arena::used() const
+{
+    lock_guard<mutex> lock(m);
+    return in_use;
+}
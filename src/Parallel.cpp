@@ -0,0 +1,415 @@
+/*
+TensorUtils Version 0.1
+
+Copyright 2022 Christoph Widder
+
+This file is part of TensorUtils.
+
+TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+the GNU General Public License as published by the Free Software Foundation, either
+version 3 of the License, or (at your option) any later version.
+
+TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with TensorUtils.
+If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include "Parallel.hpp"
+#include "ThreadPool.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace TensorUtils;
+
+/**
+    THREAD POOL
+**/
+
+// true on the workers of the pool and on a thread that currently runs tasks
+static thread_local bool inside_pool = false;
+
+class ThreadPool
+{
+    public:
+        ThreadPool(unsigned n_workers)
+        {
+            for(unsigned n=0; n<n_workers; n++)
+            {
+                workers.emplace_back([this](){ work(); });
+            }
+        }
+
+        ~ThreadPool()
+        {
+            {
+                lock_guard<mutex> lock(m);
+                stop = true;
+            }
+            cv_work.notify_all();
+            for(auto it=workers.begin(); it!=workers.end(); it++)
+            {
+                it->join();
+            }
+        }
+
+        unsigned size() const
+        {
+            return workers.size();
+        }
+
+        void run(size_t tasks, const function<void(size_t)> &f)
+        {
+            {
+                lock_guard<mutex> lock(m);
+                task = &f;
+                n_tasks = tasks;
+                next = 0;
+                active = workers.size();
+                error = nullptr;
+                generation++;
+            }
+            cv_work.notify_all();
+
+            execute();
+
+            unique_lock<mutex> lock(m);
+            cv_done.wait(lock, [this](){ return active == 0; });
+            task = nullptr;
+            if(error)
+            {
+                rethrow_exception(error);
+            }
+        }
+
+    private:
+        // takes tasks until all are taken
+        void execute()
+        {
+            while(true)
+            {
+                const size_t t = next.fetch_add(1);
+                if(t >= n_tasks)
+                {
+                    return;
+                }
+                try
+                {
+                    (*task)(t);
+                }
+                catch(...)
+                {
+                    lock_guard<mutex> lock(m);
+                    if(!error)
+                    {
+                        error = current_exception();
+                    }
+                }
+            }
+        }
+
+        void work()
+        {
+            inside_pool = true;
+            size_t seen = 0;
+            while(true)
+            {
+                {
+                    unique_lock<mutex> lock(m);
+                    cv_work.wait(lock, [&](){ return stop || generation != seen; });
+                    if(stop)
+                    {
+                        return;
+                    }
+                    seen = generation;
+                }
+                execute();
+                {
+                    lock_guard<mutex> lock(m);
+                    active--;
+                }
+                cv_done.notify_one();
+            }
+        }
+
+        vector<thread> workers;
+        mutex m;
+        condition_variable cv_work;
+        condition_variable cv_done;
+        const function<void(size_t)>* task = nullptr;
+        size_t n_tasks = 0;
+        atomic<size_t> next{0};
+        size_t active = 0;
+        size_t generation = 0;
+        bool stop = false;
+        exception_ptr error;
+};
+
+/**
+    EXECUTION POLICY
+**/
+
+static unsigned default_num_threads()
+{
+    const char* env = getenv("TENSORUTILS_NUM_THREADS");
+    if(env)
+    {
+        const long n = strtol(env, nullptr, 10);
+        if(n > 0)
+        {
+            return n;
+        }
+    }
+    return max(1u, thread::hardware_concurrency());
+}
+
+static atomic<unsigned> global_num_threads{default_num_threads()};
+static atomic<size_t> global_threshold{size_t(1)<<15};
+
+// the pool is created on first use and recreated if the number of threads changed
+static mutex pool_mutex;
+static unique_ptr<ThreadPool> pool;
+
+void Parallel::set_num_threads(unsigned n)
+{
+    global_num_threads = (n == 0) ? max(1u, thread::hardware_concurrency()) : n;
+}
+
+unsigned Parallel::num_threads()
+{
+    return global_num_threads;
+}
+
+void Parallel::set_threshold(size_t n)
+{
+    global_threshold = n;
+}
+
+size_t Parallel::threshold()
+{
+    return global_threshold;
+}
+
+void Parallel::run_tasks(size_t n_tasks, const function<void(size_t)> &task)
+{
+    unique_lock<mutex> lock(pool_mutex, try_to_lock);
+    if(inside_pool || !lock.owns_lock() || num_threads() <= 1)
+    {
+        for(size_t t=0; t<n_tasks; t++)
+        {
+            task(t);
+        }
+        return;
+    }
+    if(!pool || pool->size() != num_threads()-1)
+    {
+        pool.reset();
+        pool.reset(new ThreadPool(num_threads()-1));
+    }
+    inside_pool = true;
+    try
+    {
+        pool->run(n_tasks, task);
+    }
+    catch(...)
+    {
+        inside_pool = false;
+        throw;
+    }
+    inside_pool = false;
+}
+
+void Parallel::for_range(size_t n, const function<void(size_t,size_t)> &f, size_t work_per_item)
+{
+    parallel_for(n, f, work_per_item);
+}
+
+/**
+    BACKGROUND I/O
+**/
+
+// FIFO of I/O tasks, of which at most num_io_threads() run concurrently. Workers are started on demand,
+// the destructor finishes all queued tasks, such that pending writes complete when the program exits.
+class IOQueue
+{
+    public:
+        ~IOQueue()
+        {
+            {
+                lock_guard<mutex> lock(m);
+                stop = true;
+            }
+            cv.notify_all();
+            for(auto it=workers.begin(); it!=workers.end(); it++)
+            {
+                it->join();
+            }
+        }
+
+        future<void> submit(function<void()> &&f, unsigned limit)
+        {
+            packaged_task<void()> task(std::move(f));
+            future<void> result = task.get_future();
+            {
+                lock_guard<mutex> lock(m);
+                tasks.push_back(std::move(task));
+                max_busy = limit;
+                if(workers.size() < limit && workers.size() < busy + tasks.size())
+                {
+                    workers.emplace_back([this](){ work(); });
+                }
+            }
+            cv.notify_all();
+            return result;
+        }
+
+    private:
+        void work()
+        {
+            unique_lock<mutex> lock(m);
+            while(true)
+            {
+                cv.wait(lock, [this](){ return (stop && tasks.empty()) || (!tasks.empty() && busy < max_busy); });
+                if(tasks.empty())
+                {
+                    return;
+                }
+                packaged_task<void()> task = std::move(tasks.front());
+                tasks.pop_front();
+                busy++;
+                lock.unlock();
+                task();     // exceptions are stored in the future
+                lock.lock();
+                busy--;
+                cv.notify_all();
+            }
+        }
+
+        vector<thread> workers;
+        deque<packaged_task<void()>> tasks;
+        mutex m;
+        condition_variable cv;
+        size_t busy = 0;
+        size_t max_busy = 1;
+        bool stop = false;
+};
+
+static atomic<unsigned> global_num_io_threads{2};
+static IOQueue io_queue;
+
+void Parallel::set_num_io_threads(unsigned n)
+{
+    global_num_io_threads = max(1u, n);
+}
+
+unsigned Parallel::num_io_threads()
+{
+    return global_num_io_threads;
+}
+
+future<void> Parallel::submit_io(function<void()> task)
+{
+    return io_queue.submit(std::move(task), num_io_threads());
+}
+
+void Parallel::pipeline(size_t n_blocks, const function<void(size_t,unsigned)> &first, const function<void(size_t,unsigned)> &second)
+{
+    if(n_blocks < 2)
+    {
+        for(size_t k=0; k<n_blocks; k++)
+        {
+            first(k, 0);
+            second(k, 0);
+        }
+        return;
+    }
+
+    mutex m;
+    condition_variable cv;
+    size_t produced = 0;
+    size_t consumed = 0;
+    exception_ptr error;
+
+    auto fail = [&]()
+    {
+        lock_guard<mutex> lock(m);
+        if(!error)
+        {
+            error = current_exception();
+        }
+        cv.notify_all();
+    };
+
+    // block k uses buffer k%2: the helper fills the buffer that the calling thread has released
+    thread helper([&]()
+    {
+        try
+        {
+            for(size_t k=0; k<n_blocks; k++)
+            {
+                {
+                    unique_lock<mutex> lock(m);
+                    cv.wait(lock, [&](){ return error || k < consumed+2; });
+                    if(error)
+                    {
+                        return;
+                    }
+                }
+                first(k, k%2);
+                {
+                    lock_guard<mutex> lock(m);
+                    produced = k+1;
+                }
+                cv.notify_all();
+            }
+        }
+        catch(...)
+        {
+            fail();
+        }
+    });
+
+    try
+    {
+        for(size_t k=0; k<n_blocks; k++)
+        {
+            {
+                unique_lock<mutex> lock(m);
+                cv.wait(lock, [&](){ return error || k < produced; });
+                if(error)
+                {
+                    break;
+                }
+            }
+            second(k, k%2);
+            {
+                lock_guard<mutex> lock(m);
+                consumed = k+1;
+            }
+            cv.notify_all();
+        }
+    }
+    catch(...)
+    {
+        fail();
+    }
+
+    helper.join();
+    if(error)
+    {
+        rethrow_exception(error);
+    }
+}
@@ -0,0 +1,297 @@
+/*
+TensorUtils Version 0.1
+
+Copyright 2022 Christoph Widder
+
+This file is part of TensorUtils.
+
+TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+the GNU General Public License as published by the Free Software Foundation, either
+version 3 of the License, or (at your option) any later version.
+
+TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with TensorUtils.
+If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef PERMUTE_HPP
+#define PERMUTE_HPP
+
+#include "StridedLoop.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace TensorUtils
+{
+    namespace Kernels
+    {
+        // edge length of the leaf tiles, a leaf of source and destination fills about half of L1
+        template<class T>
+        struct PermuteBlocking
+        {
+            static constexpr size_t TILE = (sizeof(T) <= 4) ? 64 : 32;
+        };
+
+        /*
+            Cache-oblivious copy of a 2d block dst[i*dst_stride + j] = src[i + j*src_stride],
+            i.e. both operands are contiguous along different axes. The block is split recursively
+            along its longer edge until a leaf fits into L1, so that every cache line that is loaded
+            on either side is used completely before it is evicted.
+        */
+        template<class T>
+        void permute_tile(
+            const T*    src,
+            size_t      src_stride,
+            T*          dst,
+            size_t      dst_stride,
+            size_t      ni,
+            size_t      nj)
+        {
+            constexpr size_t TILE = PermuteBlocking<T>::TILE;
+            while(ni > TILE || nj > TILE)
+            {
+                if(ni >= nj)
+                {
+                    const size_t half = ni/2;
+                    permute_tile(src, src_stride, dst, dst_stride, half, nj);
+                    src += half;
+                    dst += half*dst_stride;
+                    ni -= half;
+                }
+                else
+                {
+                    const size_t half = nj/2;
+                    permute_tile(src, src_stride, dst, dst_stride, ni, half);
+                    src += half*src_stride;
+                    dst += half;
+                    nj -= half;
+                }
+            }
+            for(size_t i=0; i<ni; i++)
+            {
+                const T* s = src + i;
+                T* d = dst + i*dst_stride;
+                for(size_t j=0; j<nj; j++)
+                {
+                    d[j] = s[j*src_stride];
+                }
+            }
+        }
+
+        /*
+            Copies all elements addressed by loop from src (operand 1) to dst (operand 0).
+            If the innermost dimension is contiguous in both operands, whole runs are copied.
+            Otherwise the innermost dimension of dst and the dimension in which src is densest
+            span a plane, which is copied by the tiled kernel above for all remaining dimensions.
+        */
+        template<class T>
+        void permute(const StridedLoop<2> &loop, const T* src, T* dst)
+        {
+            typedef typename StridedLoop<2>::Offsets Offsets;
+
+            const size_t nd = loop.rank();
+            const size_t inner = nd-1;
+            if(nd < 2 || loop.stride(inner)[0] != 1 || loop.stride(inner)[1] == 1)
+            {
+                loop.run({0,0}, [&](const Offsets &off, size_t n, const Offsets &stride)
+                {
+                    if(stride[0] == 1 && stride[1] == 1)
+                    {
+                        std::copy(src+off[1], src+off[1]+n, dst+off[0]);
+                    }
+                    else
+                    {
+                        for(size_t i=0; i<n; i++)
+                        {
+                            dst[off[0]+i*stride[0]] = src[off[1]+i*stride[1]];
+                        }
+                    }
+                });
+                return;
+            }
+
+            size_t plane = 0;
+            for(size_t d=1; d<inner; d++)
+            {
+                if(loop.stride(d)[1] < loop.stride(plane)[1])
+                {
+                    plane = d;
+                }
+            }
+            const size_t ni = loop.extent(plane);
+            const size_t nj = loop.extent(inner);
+            const Offsets plane_stride = loop.stride(plane);
+            const size_t src_stride = loop.stride(inner)[1];
+
+            StridedLoop<2> outer;
+            for(size_t d=0; d<inner; d++)
+            {
+                if(d != plane)
+                {
+                    outer.push_back(loop.extent(d), loop.stride(d));
+                }
+            }
+            outer.merge();
+
+            outer.run({0,0}, [&](const Offsets &off, size_t n, const Offsets &stride)
+            {
+                for(size_t k=0; k<n; k++)
+                {
+                    const T* s = src + off[1] + k*stride[1];
+                    T* d = dst + off[0] + k*stride[0];
+                    if(plane_stride[1] == 1)
+                    {
+                        permute_tile(s, src_stride, d, plane_stride[0], ni, nj);
+                    }
+                    else
+                    {
+                        // source has no unit stride in the plane (e.g. a strided view), tile anyway
+                        for(size_t i0=0; i0<ni; i0+=PermuteBlocking<T>::TILE)
+                        {
+                            const size_t i1 = std::min(ni, i0+PermuteBlocking<T>::TILE);
+                            for(size_t j0=0; j0<nj; j0+=PermuteBlocking<T>::TILE)
+                            {
+                                const size_t j1 = std::min(nj, j0+PermuteBlocking<T>::TILE);
+                                for(size_t i=i0; i<i1; i++)
+                                {
+                                    for(size_t j=j0; j<j1; j++)
+                                    {
+                                        d[i*plane_stride[0]+j] = s[i*plane_stride[1]+j*src_stride];
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+            });
+        }
+
+        /*
+            Detects a batch of square block transposes in loop (see permute_inplace): two dimensions of equal extent n
+            whose strides are swapped between dst and src, optionally followed by a dimension that is contiguous in
+            both, and outer dimensions with equal strides in both. Returns false for all other permutations.
+        */
+        inline bool square_transpose(const StridedLoop<2> &loop, size_t &n, size_t &run, std::vector<size_t> &batches)
+        {
+            size_t nd = loop.rank();
+            run = 1;
+            if(nd >= 1 && loop.stride(nd-1)[0] == 1 && loop.stride(nd-1)[1] == 1)
+            {
+                run = loop.extent(nd-1);
+                nd--;
+            }
+            if(nd < 2)
+            {
+                return false;
+            }
+            n = loop.extent(nd-2);
+            const typename StridedLoop<2>::Offsets &a = loop.stride(nd-2);
+            const typename StridedLoop<2>::Offsets &b = loop.stride(nd-1);
+            if(loop.extent(nd-1) != n || b[0] != run || a[0] != n*run || a[1] != run || b[1] != n*run)
+            {
+                return false;
+            }
+            // offsets of the batches, the outer dimensions have the same strides in dst and src
+            batches.assign(1, 0);
+            for(size_t d=nd-2; d-->0;)
+            {
+                if(loop.stride(d)[0] != loop.stride(d)[1])
+                {
+                    return false;
+                }
+            }
+            for(size_t d=0; d<nd-2; d++)
+            {
+                std::vector<size_t> next;
+                next.reserve(batches.size()*loop.extent(d));
+                for(auto it=batches.begin(); it!=batches.end(); it++)
+                {
+                    for(size_t i=0; i<loop.extent(d); i++)
+                    {
+                        next.push_back(*it + i*loop.stride(d)[0]);
+                    }
+                }
+                batches.swap(next);
+            }
+            return true;
+        }
+
+        /*
+            Swaps the tile pairs of row ib of the tile grid of an n x n matrix of runs ("components") of length run.
+            Different rows touch disjoint tile pairs, so they can be processed concurrently.
+        */
+        template<class T>
+        void swap_tiles(T* data, size_t n, size_t run, size_t ib)
+        {
+            constexpr size_t TILE = PermuteBlocking<T>::TILE;
+            const size_t i1 = std::min(n, ib+TILE);
+            for(size_t jb=ib; jb<n; jb+=TILE)
+            {
+                const size_t j1 = std::min(n, jb+TILE);
+                for(size_t i=ib; i<i1; i++)
+                {
+                    for(size_t j=std::max(jb, i+1); j<j1; j++)
+                    {
+                        std::swap_ranges(data + (i*n+j)*run, data + (i*n+j+1)*run, data + (j*n+i)*run);
+                    }
+                }
+            }
+        }
+
+        /*
+            Permutes the size components of data in place, such that it holds what permute(loop, src, dst) would
+            have written to dst. Follows the cycles of the index mapping and marks visited components in a bit set,
+            i.e. needs size/8 bytes of extra memory. Square transposes should use swap_tiles instead.
+        */
+        template<class T>
+        void permute_cycles(const StridedLoop<2> &loop, T* data, size_t size)
+        {
+            const size_t nd = loop.rank();
+            // source index of the component that belongs to the destination index p, dst is contiguous in loop order
+            auto source = [&](size_t p)
+            {
+                size_t q = 0;
+                for(size_t d=nd; d-->0;)
+                {
+                    const size_t ext = loop.extent(d);
+                    q += (p % ext)*loop.stride(d)[1];
+                    p /= ext;
+                }
+                return q;
+            };
+            std::vector<unsigned long long> visited((size+63)/64, 0);
+            for(size_t start=0; start<size; start++)
+            {
+                if(visited[start/64] >> (start%64) & 1)
+                {
+                    continue;
+                }
+                size_t p = start;
+                size_t q = source(p);
+                if(q == p)
+                {
+                    continue;
+                }
+                T tmp = std::move(data[start]);
+                while(q != start)
+                {
+                    data[p] = std::move(data[q]);
+                    visited[p/64] |= 1ULL << (p%64);
+                    p = q;
+                    q = source(p);
+                }
+                data[p] = std::move(tmp);
+                visited[p/64] |= 1ULL << (p%64);
+            }
+        }
+    }
+}
+
+#endif // PERMUTE_HPP
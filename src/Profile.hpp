@@ -0,0 +1,113 @@
+/*
+TensorUtils Version 0.1
+
+Copyright 2022 Christoph Widder
+
+This file is part of TensorUtils.
+
+TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+the GNU General Public License as published by the Free Software Foundation, either
+version 3 of the License, or (at your option) any later version.
+
+TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with TensorUtils.
+If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef PROFILE_HPP
+#define PROFILE_HPP
+
+#include "Profiler.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+    Instrumentation of the library, see Profiler.hpp. Compiled out unless ENABLE_PROFILING=1:
+
+        PROFILE_SCOPE("TensorBase::dot");           // counts the call and times the rest of the block
+        PROFILE_ARGS(Detail::shape_string(shape));  // arguments of the trace event, only evaluated while tracing
+        PROFILE_IO(bytes);                          // bytes read or written by the innermost operation
+
+    A block holds at most one PROFILE_SCOPE. Allocations are recorded by Memory::allocate.
+*/
+#ifndef ENABLE_PROFILING
+#define ENABLE_PROFILING 0
+#endif // ENABLE_PROFILING
+
+namespace TensorUtils
+{
+    namespace Profiler
+    {
+        namespace Detail
+        {
+            struct Site
+            {
+                std::string name;
+                std::atomic<uint64_t> calls{0};
+                std::atomic<uint64_t> nanoseconds{0};
+                std::atomic<uint64_t> allocations{0};
+                std::atomic<uint64_t> allocated_bytes{0};
+                std::atomic<uint64_t> io_bytes{0};
+            };
+
+            // counters of the operation with this name, the pointer stays valid
+            Site* site(const char* name);
+
+            extern std::atomic<bool> tracing;
+
+            // times an operation on the calling thread, scopes nest per thread
+            class Scope
+            {
+                public:
+                    explicit Scope(Site* site);
+                    ~Scope();
+
+                    Scope(const Scope&) = delete;
+                    Scope& operator=(const Scope&) = delete;
+
+                    bool trace() const { return traced; }
+                    void args(const std::string &text) { arguments = text; }
+
+                private:
+                    Site* site;
+                    Scope* parent;
+                    uint64_t start;
+                    bool traced;
+                    std::string arguments;
+
+                    friend void record_alloc(size_t bytes);
+                    friend void record_io(size_t bytes);
+            };
+
+            // attribute to the innermost scope of the calling thread
+            void record_alloc(size_t bytes);
+            void record_io(size_t bytes);
+
+            // "{2,3,4}", for the arguments of trace events
+            std::string shape_string(const std::vector<size_t> &shape);
+        }
+    }
+}
+
+#if ENABLE_PROFILING == 1
+#define PROFILE_SCOPE(NAME) \
+    static TensorUtils::Profiler::Detail::Site* const profile_site = TensorUtils::Profiler::Detail::site(NAME); \
+    TensorUtils::Profiler::Detail::Scope profile_scope(profile_site)
+#define PROFILE_ARGS(EXPR) do { if(profile_scope.trace()) { profile_scope.args(EXPR); } } while(0)
+#define PROFILE_IO(BYTES) TensorUtils::Profiler::Detail::record_io(BYTES)
+#define PROFILE_ALLOC(BYTES) TensorUtils::Profiler::Detail::record_alloc(BYTES)
+#else
+#define PROFILE_SCOPE(NAME) do {} while(0)
+#define PROFILE_ARGS(EXPR) do {} while(0)
+#define PROFILE_IO(BYTES) do {} while(0)
+#define PROFILE_ALLOC(BYTES) do {} while(0)
+#endif // ENABLE_PROFILING
+
+#endif // PROFILE_HPP
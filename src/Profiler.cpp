@@ -0,0 +1,260 @@
+/*
+TensorUtils Version 0.1
+
+Copyright 2022 Christoph Widder
+
+This file is part of TensorUtils.
+
+TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+the GNU General Public License as published by the Free Software Foundation, either
+version 3 of the License, or (at your option) any later version.
+
+TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with TensorUtils.
+If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include "Profile.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+using namespace TensorUtils;
+using namespace Profiler::Detail;
+
+/**
+    COUNTERS
+**/
+
+namespace
+{
+    struct Event
+    {
+        const Site* site;
+        uint64_t start;
+        uint64_t duration;
+        unsigned thread;
+        string arguments;
+    };
+
+    // sites are never destroyed, such that operations can run during static destruction
+    struct Registry
+    {
+        mutex m;
+        map<string, unique_ptr<Site>> sites;
+        vector<Event> events;
+    };
+
+    Registry& registry()
+    {
+        static Registry* r = new Registry;
+        return *r;
+    }
+
+    uint64_t now()
+    {
+        return uint64_t(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    // small ids instead of std::thread::id for the trace
+    unsigned thread_index()
+    {
+        static atomic<unsigned> next{0};
+        thread_local unsigned index = next++;
+        return index;
+    }
+
+    thread_local Scope* current = nullptr;
+
+    Site* application()
+    {
+        static Site* s = site("(application)");
+        return s;
+    }
+}
+
+atomic<bool> Profiler::Detail::tracing{false};
+
+Site* Profiler::Detail::site(const char* name)
+{
+    Registry &r = registry();
+    lock_guard<mutex> lock(r.m);
+    unique_ptr<Site> &s = r.sites[name];
+    if(!s)
+    {
+        s.reset(new Site);
+        s->name = name;
+    }
+    return s.get();
+}
+
+Scope::Scope(Site* site) : site(site), parent(current), start(now()), traced(tracing.load(memory_order_relaxed))
+{
+    current = this;
+}
+
+Scope::~Scope()
+{
+    const uint64_t duration = now() - start;
+    site->calls.fetch_add(1, memory_order_relaxed);
+    site->nanoseconds.fetch_add(duration, memory_order_relaxed);
+    current = parent;
+    if(traced)
+    {
+        Registry &r = registry();
+        lock_guard<mutex> lock(r.m);
+        r.events.push_back({site, start, duration, thread_index(), std::move(arguments)});
+    }
+}
+
+void Profiler::Detail::record_alloc(size_t bytes)
+{
+    Site* s = current ? current->site : application();
+    s->allocations.fetch_add(1, memory_order_relaxed);
+    s->allocated_bytes.fetch_add(bytes, memory_order_relaxed);
+}
+
+void Profiler::Detail::record_io(size_t bytes)
+{
+    Site* s = current ? current->site : application();
+    s->io_bytes.fetch_add(bytes, memory_order_relaxed);
+}
+
+string Profiler::Detail::shape_string(const vector<size_t> &shape)
+{
+    string result = "{";
+    for(size_t dim=0; dim<shape.size(); dim++)
+    {
+        result += (dim ? "," : "") + to_string(shape[dim]);
+    }
+    return result + "}";
+}
+
+/**
+    REPORTS
+**/
+
+bool Profiler::enabled()
+{
+    return ENABLE_PROFILING == 1;
+}
+
+vector<Profiler::Entry> Profiler::entries()
+{
+    vector<Entry> result;
+    Registry &r = registry();
+    lock_guard<mutex> lock(r.m);
+    for(auto it=r.sites.begin(); it!=r.sites.end(); it++)
+    {
+        const Site &s = *it->second;
+        const Entry e = {s.name, s.calls.load(), 1e-9*double(s.nanoseconds.load()), s.allocations.load(),
+                         s.allocated_bytes.load(), s.io_bytes.load()};
+        if(e.calls || e.allocations || e.io_bytes)
+        {
+            result.push_back(e);
+        }
+    }
+    return result;
+}
+
+void Profiler::reset()
+{
+    Registry &r = registry();
+    lock_guard<mutex> lock(r.m);
+    for(auto it=r.sites.begin(); it!=r.sites.end(); it++)
+    {
+        Site &s = *it->second;
+        s.calls = 0;
+        s.nanoseconds = 0;
+        s.allocations = 0;
+        s.allocated_bytes = 0;
+        s.io_bytes = 0;
+    }
+    r.events.clear();
+}
+
+void Profiler::dump(ostream &out)
+{
+    vector<Entry> e = entries();
+    sort(e.begin(), e.end(), [](const Entry &a, const Entry &b){ return a.seconds > b.seconds; });
+    char line[256];
+    snprintf(line, sizeof(line), "%-36s %10s %12s %12s %10s %14s %14s\n",
+             "operation", "calls", "total ms", "us/call", "allocs", "alloc bytes", "I/O bytes");
+    out << line;
+    for(auto it=e.begin(); it!=e.end(); it++)
+    {
+        snprintf(line, sizeof(line), "%-36s %10llu %12.3f %12.3f %10llu %14llu %14llu\n",
+                 it->name.c_str(), (unsigned long long)it->calls, 1e3*it->seconds,
+                 it->calls ? 1e6*it->seconds/double(it->calls) : 0.0, (unsigned long long)it->allocations,
+                 (unsigned long long)it->allocated_bytes, (unsigned long long)it->io_bytes);
+        out << line;
+    }
+}
+
+void Profiler::start_trace()
+{
+    tracing = true;
+}
+
+void Profiler::stop_trace()
+{
+    tracing = false;
+}
+
+static string json_escape(const string &s)
+{
+    string result;
+    for(char ch : s)
+    {
+        if(ch == '"' || ch == '\\')
+        {
+            result += '\\';
+        }
+        result += ch;
+    }
+    return result;
+}
+
+void Profiler::write_trace(const string &path)
+{
+    ofstream out(path);
+    if(!out)
+    {
+        throw runtime_error("TensorUtils::Profiler::write_trace:: Unable to open file \"" + path + "\".");
+    }
+    Registry &r = registry();
+    lock_guard<mutex> lock(r.m);
+    const uint64_t origin = r.events.empty() ? 0 : min_element(r.events.begin(), r.events.end(),
+        [](const Event &a, const Event &b){ return a.start < b.start; })->start;
+    out << "{\"traceEvents\":[\n";
+    char buffer[256];
+    for(size_t n=0; n<r.events.size(); n++)
+    {
+        const Event &e = r.events[n];
+        snprintf(buffer, sizeof(buffer), "{\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"name\":\"",
+                 e.thread, 1e-3*double(e.start-origin), 1e-3*double(e.duration));
+        out << buffer << json_escape(e.site->name) << "\"";
+        if(!e.arguments.empty())
+        {
+            out << ",\"args\":{\"shape\":\"" << json_escape(e.arguments) << "\"}";
+        }
+        out << "}" << (n+1 < r.events.size() ? ",\n" : "\n");
+    }
+    out << "],\"displayTimeUnit\":\"ns\"}\n";
+    if(!out)
+    {
+        throw runtime_error("TensorUtils::Profiler::write_trace:: Unable to write file \"" + path + "\".");
+    }
+}
@@ -0,0 +1,227 @@
+/*
+TensorUtils Version 0.1
+
+Copyright 2022 Christoph Widder
+
+This file is part of TensorUtils.
+
+TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+the GNU General Public License as published by the Free Software Foundation, either
+version 3 of the License, or (at your option) any later version.
+
+TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with TensorUtils.
+If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef REDUCE_HPP
+#define REDUCE_HPP
+
+#include "Simd.hpp"
+#include "StridedLoop.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+namespace TensorUtils
+{
+    namespace Kernels
+    {
+        /*
+            Reduction operations. identity() is the initial value of the result, term(x) the contribution of a
+            single component, combine(acc,x) accumulates a contribution or a partial result and row(src,n) reduces
+            a contiguous row with the vectorized kernels of Simd.hpp.
+        */
+        template<class T>
+        struct SumOp
+        {
+            static T identity() { return T(0); }
+            static T term(const T &x) { return x; }
+            static void combine(T &acc, const T &x) { acc += x; }
+            static T row(const T* src, size_t n) { return Simd::sum(src, n); }
+        };
+
+        template<class T>
+        struct SumAbsOp
+        {
+            static T identity() { return T(0); }
+            static T term(const T &x) { return Simd::power<1>(x); }
+            static void combine(T &acc, const T &x) { acc += x; }
+            static T row(const T* src, size_t n) { return Simd::sum_abs(src, n); }
+        };
+
+        template<class T>
+        struct SumSquaresOp
+        {
+            static T identity() { return T(0); }
+            static T term(const T &x) { return x*x; }
+            static void combine(T &acc, const T &x) { acc += x; }
+            static T row(const T* src, size_t n) { return Simd::sum_squares(src, n); }
+        };
+
+        template<class T>
+        struct MaxOp
+        {
+            static T identity() { return std::numeric_limits<T>::lowest(); }
+            static T term(const T &x) { return x; }
+            static void combine(T &acc, const T &x) { acc = (x > acc) ? x : acc; }
+            static T row(const T* src, size_t n) { return Simd::maximum(src, n); }
+        };
+
+        template<class T>
+        struct MinOp
+        {
+            static T identity() { return std::numeric_limits<T>::max(); }
+            static T term(const T &x) { return x; }
+            static void combine(T &acc, const T &x) { acc = (x < acc) ? x : acc; }
+            static T row(const T* src, size_t n) { return Simd::minimum(src, n); }
+        };
+
+        template<class T>
+        struct MaxAbsOp
+        {
+            static T identity() { return T(0); }
+            static T term(const T &x) { return Simd::power<1>(x); }
+            static void combine(T &acc, const T &x) { acc = (x > acc) ? x : acc; }
+            static T row(const T* src, size_t n) { return Simd::max_abs(src, n); }
+        };
+
+        // minimum number of components and maximum number of partial results of a reduction over the outermost axis
+        constexpr size_t REDUCE_CHUNK = 128*Simd::REDUCE_BLOCK;
+        constexpr size_t REDUCE_MAX_PARTIALS = 64;
+
+        /*
+            Reduces the contiguous row-major array src of the given shape over all axes with reduced[d] == true.
+            dst is the contiguous result with the remaining axes in their original order and holds the identity of OP.
+
+            The loop nest follows the memory order of src, such that src is streamed once. Rows that are reduced
+            completely use OP::row, rows that are kept accumulate element-wise into dst. If the outermost (merged)
+            axis is kept, its iterations are partitioned across threads. If it is reduced, e.g. for a reduction over
+            all components, its iterations are split into blocks of at least REDUCE_CHUNK components, every block
+            accumulates into its own copy of dst and the copies are combined pairwise. The blocks only depend on the
+            shape, such that the result is the same for any number of threads.
+        */
+        template<class OP, class T>
+        void reduce(
+            const T*                        src,
+            const std::vector<size_t>       &shape,
+            const std::vector<size_t>       &incr,
+            const std::vector<bool>         &reduced,
+            T*                              dst)
+        {
+            std::vector<size_t> dst_incr(shape.size(), 0);
+            size_t dst_size = 1;
+            for(size_t d=shape.size(); d-->0;)
+            {
+                if(!reduced[d])
+                {
+                    dst_incr[d] = dst_size;
+                    dst_size *= shape[d];
+                }
+            }
+
+            StridedLoop<2> loop;
+            for(size_t d=0; d<shape.size(); d++)
+            {
+                loop.push_back(shape[d], {dst_incr[d], incr[d]});
+            }
+            loop.merge();
+            if(loop.size() == 0)
+            {
+                return;
+            }
+
+            auto rows = [src](T* out)
+            {
+                return [src,out](const StridedLoop<2>::Offsets &off, size_t n, const StridedLoop<2>::Offsets &stride)
+                {
+                    T* d = out+off[0];
+                    const T* x = src+off[1];
+                    if(stride[0] == 0 && stride[1] == 1)
+                    {
+                        OP::combine(*d, OP::row(x, n));
+                    }
+                    else if(stride[0] == 0)
+                    {
+                        T acc = *d;
+                        for(size_t i=0; i<n; i++)
+                        {
+                            OP::combine(acc, OP::term(x[i*stride[1]]));
+                        }
+                        *d = acc;
+                    }
+                    else if(stride[0] == 1 && stride[1] == 1)
+                    {
+                        for(size_t i=0; i<n; i++)
+                        {
+                            OP::combine(d[i], OP::term(x[i]));
+                        }
+                    }
+                    else
+                    {
+                        for(size_t i=0; i<n; i++)
+                        {
+                            OP::combine(d[i*stride[0]], OP::term(x[i*stride[1]]));
+                        }
+                    }
+                };
+            };
+
+            const size_t outer = (loop.rank() > 0) ? loop.extent(0) : 1;
+            const size_t per_outer = loop.size()/outer;
+            if(loop.rank() == 0 || loop.stride(0)[0] != 0)
+            {
+                // distinct outer iterations write to distinct components of dst
+                auto kernel = rows(dst);
+                Parallel::parallel_for(outer, [&](size_t begin, size_t end)
+                {
+                    loop.run_range({0,0}, begin*per_outer, end*per_outer, kernel);
+                }, per_outer);
+                return;
+            }
+
+            // the blocks and the order of their combination depend only on the shape, not on the number of threads
+            const size_t outer_per_block = (REDUCE_CHUNK+per_outer-1)/per_outer;
+            const size_t blocks = std::min((outer+outer_per_block-1)/outer_per_block, REDUCE_MAX_PARTIALS);
+            if(blocks <= 1)
+            {
+                loop.run({0,0}, rows(dst));
+                return;
+            }
+            const size_t block_outer = ((outer+blocks-1)/blocks + outer_per_block-1)/outer_per_block*outer_per_block;
+            const size_t n_partial = (outer+block_outer-1)/block_outer;
+            std::vector<T> partial(n_partial*dst_size, OP::identity());
+            Parallel::parallel_for(n_partial, [&](size_t begin, size_t end)
+            {
+                for(size_t c=begin; c<end; c++)
+                {
+                    const size_t last = std::min(outer, (c+1)*block_outer);
+                    loop.run_range({0,0}, c*block_outer*per_outer, last*per_outer, rows(partial.data()+c*dst_size));
+                }
+            }, block_outer*per_outer);
+            for(size_t step=1; step<n_partial; step*=2)
+            {
+                for(size_t c=0; c+step<n_partial; c+=2*step)
+                {
+                    for(size_t i=0; i<dst_size; i++)
+                    {
+                        OP::combine(partial[c*dst_size+i], partial[(c+step)*dst_size+i]);
+                    }
+                }
+            }
+            for(size_t i=0; i<dst_size; i++)
+            {
+                OP::combine(dst[i], partial[i]);
+            }
+        }
+    }
+}
+
+#endif // REDUCE_HPP
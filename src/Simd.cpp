@@ -0,0 +1,153 @@
+/*
+TensorUtils Version 0.1
+
+Copyright 2022 Christoph Widder
+
+This file is part of TensorUtils.
+
+TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+the GNU General Public License as published by the Free Software Foundation, either
+version 3 of the License, or (at your option) any later version.
+
+TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with TensorUtils.
+If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include "Simd.hpp"
+
+#include <cstdint>
+
+using namespace std;
+using namespace TensorUtils;
+
+/*
+    Every kernel is compiled for AVX-512, AVX2 and the baseline of the target (SSE2 on x86-64) with
+    target_clones. The dynamic loader resolves each kernel once to the best version for the CPU.
+    Other architectures use the baseline, e.g. NEON on AArch64. Define ENABLE_SIMD_DISPATCH=0 to
+    compile the baseline only.
+*/
+#ifndef ENABLE_SIMD_DISPATCH
+#define ENABLE_SIMD_DISPATCH 1
+#endif // ENABLE_SIMD_DISPATCH
+
+#if defined(__has_attribute)
+#if ENABLE_SIMD_DISPATCH == 1 && __has_attribute(target_clones) && defined(__x86_64__) && defined(__ELF__)
+#define SIMD_DISPATCH 1
+#endif
+#endif
+
+#ifdef SIMD_DISPATCH
+#define SIMD_KERNEL __attribute__((target_clones("avx512f","avx2","default")))
+#else
+#define SIMD_KERNEL
+#endif
+
+/**
+    KERNELS
+**/
+
+#define DEFINE_ASSIGN(D,S) \
+SIMD_KERNEL void Simd::assign(D* dst, const S* src, size_t n) \
+{ \
+    for(size_t i=0; i<n; i++) \
+    { \
+        dst[i] = static_cast<D>(src[i]); \
+    } \
+}
+
+#define DEFINE_UPDATE(NAME,OP,D,S) \
+SIMD_KERNEL void Simd::NAME(D* dst, const S* src, size_t n) \
+{ \
+    for(size_t i=0; i<n; i++) \
+    { \
+        dst[i] OP src[i]; \
+    } \
+}
+
+#define DEFINE_SCALE(NAME,OP,T) \
+SIMD_KERNEL void Simd::NAME(T* dst, const T &s, size_t n) \
+{ \
+    const T c = s; \
+    for(size_t i=0; i<n; i++) \
+    { \
+        dst[i] OP c; \
+    } \
+}
+
+DEFINE_ASSIGN(float,double)
+DEFINE_ASSIGN(double,float)
+DEFINE_ASSIGN(float,int32_t)
+DEFINE_ASSIGN(int32_t,float)
+DEFINE_ASSIGN(double,int32_t)
+DEFINE_ASSIGN(int32_t,double)
+DEFINE_ASSIGN(float,int64_t)
+DEFINE_ASSIGN(int64_t,float)
+DEFINE_ASSIGN(double,int64_t)
+DEFINE_ASSIGN(int64_t,double)
+DEFINE_ASSIGN(float,int16_t)
+DEFINE_ASSIGN(float,uint16_t)
+DEFINE_ASSIGN(float,int8_t)
+DEFINE_ASSIGN(float,uint8_t)
+DEFINE_ASSIGN(double,int16_t)
+DEFINE_ASSIGN(double,uint16_t)
+DEFINE_ASSIGN(double,int8_t)
+DEFINE_ASSIGN(double,uint8_t)
+
+DEFINE_UPDATE(add,+=,float,float)
+DEFINE_UPDATE(add,+=,double,double)
+DEFINE_UPDATE(add,+=,float,double)
+DEFINE_UPDATE(add,+=,double,float)
+
+DEFINE_UPDATE(substract,-=,float,float)
+DEFINE_UPDATE(substract,-=,double,double)
+DEFINE_UPDATE(substract,-=,float,double)
+DEFINE_UPDATE(substract,-=,double,float)
+
+DEFINE_SCALE(multiply,*=,float)
+DEFINE_SCALE(multiply,*=,double)
+
+DEFINE_SCALE(divide,/=,float)
+DEFINE_SCALE(divide,/=,double)
+
+#define DEFINE_REDUCE(NAME,T,EXPR) \
+SIMD_KERNEL T Simd::NAME(const T* src, size_t n) \
+{ \
+    return EXPR; \
+}
+
+DEFINE_REDUCE(sum,float,(pairwise_sum<0>(src, n)))
+DEFINE_REDUCE(sum,double,(pairwise_sum<0>(src, n)))
+DEFINE_REDUCE(sum_abs,float,(pairwise_sum<1>(src, n)))
+DEFINE_REDUCE(sum_abs,double,(pairwise_sum<1>(src, n)))
+DEFINE_REDUCE(sum_squares,float,(pairwise_sum<2>(src, n)))
+DEFINE_REDUCE(sum_squares,double,(pairwise_sum<2>(src, n)))
+DEFINE_REDUCE(maximum,float,(extremum<true,0>(src, n)))
+DEFINE_REDUCE(maximum,double,(extremum<true,0>(src, n)))
+DEFINE_REDUCE(minimum,float,(extremum<false,0>(src, n)))
+DEFINE_REDUCE(minimum,double,(extremum<false,0>(src, n)))
+DEFINE_REDUCE(max_abs,float,(extremum<true,1>(src, n)))
+DEFINE_REDUCE(max_abs,double,(extremum<true,1>(src, n)))
+
+/**
+    DIAGNOSTICS
+**/
+
+const char* Simd::instruction_set()
+{
+    #ifdef SIMD_DISPATCH
+    if(__builtin_cpu_supports("avx512f"))
+    {
+        return "avx512f";
+    }
+    if(__builtin_cpu_supports("avx2"))
+    {
+        return "avx2";
+    }
+    #endif // SIMD_DISPATCH
+    return "default";
+}
@@ -0,0 +1,291 @@
+/*
+TensorUtils Version 0.1
+
+Copyright 2022 Christoph Widder
+
+This file is part of TensorUtils.
+
+TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+the GNU General Public License as published by the Free Software Foundation, either
+version 3 of the License, or (at your option) any later version.
+
+TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with TensorUtils.
+If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef SIMD_HPP
+#define SIMD_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+// forces the generic reduction loops into the kernels of Simd.cpp, which are compiled once per instruction set
+#if defined(__GNUC__)
+#define SIMD_INLINE inline __attribute__((always_inline))
+#else
+#define SIMD_INLINE inline
+#endif
+
+namespace TensorUtils
+{
+    namespace Simd
+    {
+        /*
+            Element-wise kernels on contiguous arrays: dst[i] = src[i], dst[i] += src[i], dst[i] -= src[i],
+            dst[i] *= s and dst[i] /= s for i in [0,n).
+
+            The templates are the generic fallback. The non-template overloads below are chosen by overload
+            resolution for the common pairs of component types and are compiled in Simd.cpp once per
+            instruction set (AVX-512, AVX2 and the baseline). The loader selects the best version for the CPU
+            at runtime, so applications get the wide kernels without being compiled for a specific CPU.
+            dst and src may only overlap if they are equal.
+        */
+
+        template<class T, class S>
+        inline void assign(T* dst, const S* src, size_t n)
+        {
+            for(size_t i=0; i<n; i++)
+            {
+                dst[i] = src[i];
+            }
+        }
+
+        template<class T, class S>
+        inline void add(T* dst, const S* src, size_t n)
+        {
+            for(size_t i=0; i<n; i++)
+            {
+                dst[i] += src[i];
+            }
+        }
+
+        template<class T, class S>
+        inline void substract(T* dst, const S* src, size_t n)
+        {
+            for(size_t i=0; i<n; i++)
+            {
+                dst[i] -= src[i];
+            }
+        }
+
+        template<class T>
+        inline void multiply(T* dst, const T &s, size_t n)
+        {
+            for(size_t i=0; i<n; i++)
+            {
+                dst[i] *= s;
+            }
+        }
+
+        template<class T>
+        inline void divide(T* dst, const T &s, size_t n)
+        {
+            for(size_t i=0; i<n; i++)
+            {
+                dst[i] /= s;
+            }
+        }
+
+        /*
+            Reductions of contiguous arrays: sum of src[i], |src[i]| and src[i]^2, and maximum, minimum and
+            maximum of |src[i]|. Each block of REDUCE_BLOCK components is reduced into 8 independent accumulators,
+            which the compiler maps onto vector registers, and the block sums are combined pairwise like a binary
+            counter. The rounding error of the sums grows with O(log n) instead of O(n). The result of an empty
+            array is the identity of the operation, e.g. the lowest value of T for maximum.
+        */
+        constexpr size_t REDUCE_BLOCK = 128;
+
+        // 0: src[i], 1: |src[i]|, 2: src[i]^2
+        template<unsigned P, class T>
+        SIMD_INLINE T power(const T &x)
+        {
+            if constexpr(P == 0)
+            {
+                return x;
+            }
+            else if constexpr(P == 1)
+            {
+                if constexpr(std::is_signed<T>::value)
+                {
+                    return x < T(0) ? -x : x;
+                }
+                else
+                {
+                    return x;
+                }
+            }
+            else
+            {
+                return x*x;
+            }
+        }
+
+        template<unsigned P, class T>
+        SIMD_INLINE T block_sum(const T* src, size_t n)
+        {
+            T acc[8] = {};
+            size_t i = 0;
+            for(; i+8<=n; i+=8)
+            {
+                for(unsigned k=0; k<8; k++)
+                {
+                    acc[k] += power<P>(src[i+k]);
+                }
+            }
+            for(; i<n; i++)
+            {
+                acc[0] += power<P>(src[i]);
+            }
+            return ((acc[0]+acc[1])+(acc[2]+acc[3])) + ((acc[4]+acc[5])+(acc[6]+acc[7]));
+        }
+
+        template<unsigned P, class T>
+        SIMD_INLINE T pairwise_sum(const T* src, size_t n)
+        {
+            // partial[l] is the sum of 2^k blocks with decreasing k, merged whenever two sums have the same k
+            T partial[64];
+            size_t levels = 0;
+            size_t count = 0;
+            for(size_t i=0; i<n; i+=REDUCE_BLOCK)
+            {
+                T s = block_sum<P>(src+i, (n-i < REDUCE_BLOCK) ? n-i : REDUCE_BLOCK);
+                count++;
+                for(size_t c=count; (c&1)==0; c>>=1)
+                {
+                    s = partial[--levels] + s;
+                }
+                partial[levels++] = s;
+            }
+            T total = T(0);
+            while(levels > 0)
+            {
+                total = partial[--levels] + total;
+            }
+            return total;
+        }
+
+        // MAX selects the maximum or the minimum, P the values src[i] or |src[i]|
+        template<bool MAX, unsigned P, class T>
+        SIMD_INLINE T extremum(const T* src, size_t n)
+        {
+            const T init = (P == 1) ? T(0) : (MAX ? std::numeric_limits<T>::lowest() : std::numeric_limits<T>::max());
+            T acc[8] = {init, init, init, init, init, init, init, init};
+            size_t i = 0;
+            for(; i+8<=n; i+=8)
+            {
+                for(unsigned k=0; k<8; k++)
+                {
+                    const T x = power<P>(src[i+k]);
+                    acc[k] = (MAX ? x > acc[k] : x < acc[k]) ? x : acc[k];
+                }
+            }
+            for(; i<n; i++)
+            {
+                const T x = power<P>(src[i]);
+                acc[0] = (MAX ? x > acc[0] : x < acc[0]) ? x : acc[0];
+            }
+            for(unsigned k=1; k<8; k++)
+            {
+                acc[0] = (MAX ? acc[k] > acc[0] : acc[k] < acc[0]) ? acc[k] : acc[0];
+            }
+            return acc[0];
+        }
+
+        template<class T>
+        inline T sum(const T* src, size_t n)
+        {
+            return pairwise_sum<0>(src, n);
+        }
+
+        template<class T>
+        inline T sum_abs(const T* src, size_t n)
+        {
+            return pairwise_sum<1>(src, n);
+        }
+
+        template<class T>
+        inline T sum_squares(const T* src, size_t n)
+        {
+            return pairwise_sum<2>(src, n);
+        }
+
+        template<class T>
+        inline T maximum(const T* src, size_t n)
+        {
+            return extremum<true,0>(src, n);
+        }
+
+        template<class T>
+        inline T minimum(const T* src, size_t n)
+        {
+            return extremum<false,0>(src, n);
+        }
+
+        template<class T>
+        inline T max_abs(const T* src, size_t n)
+        {
+            return extremum<true,1>(src, n);
+        }
+
+        // type conversions, in particular for reading and writing binary files of another type
+        void assign(float* dst, const double* src, size_t n);
+        void assign(double* dst, const float* src, size_t n);
+        void assign(float* dst, const int32_t* src, size_t n);
+        void assign(int32_t* dst, const float* src, size_t n);
+        void assign(double* dst, const int32_t* src, size_t n);
+        void assign(int32_t* dst, const double* src, size_t n);
+        void assign(float* dst, const int64_t* src, size_t n);
+        void assign(int64_t* dst, const float* src, size_t n);
+        void assign(double* dst, const int64_t* src, size_t n);
+        void assign(int64_t* dst, const double* src, size_t n);
+        void assign(float* dst, const int16_t* src, size_t n);
+        void assign(float* dst, const uint16_t* src, size_t n);
+        void assign(float* dst, const int8_t* src, size_t n);
+        void assign(float* dst, const uint8_t* src, size_t n);
+        void assign(double* dst, const int16_t* src, size_t n);
+        void assign(double* dst, const uint16_t* src, size_t n);
+        void assign(double* dst, const int8_t* src, size_t n);
+        void assign(double* dst, const uint8_t* src, size_t n);
+
+        void add(float* dst, const float* src, size_t n);
+        void add(double* dst, const double* src, size_t n);
+        void add(float* dst, const double* src, size_t n);
+        void add(double* dst, const float* src, size_t n);
+
+        void substract(float* dst, const float* src, size_t n);
+        void substract(double* dst, const double* src, size_t n);
+        void substract(float* dst, const double* src, size_t n);
+        void substract(double* dst, const float* src, size_t n);
+
+        void multiply(float* dst, const float &s, size_t n);
+        void multiply(double* dst, const double &s, size_t n);
+
+        void divide(float* dst, const float &s, size_t n);
+        void divide(double* dst, const double &s, size_t n);
+
+        float sum(const float* src, size_t n);
+        double sum(const double* src, size_t n);
+        float sum_abs(const float* src, size_t n);
+        double sum_abs(const double* src, size_t n);
+        float sum_squares(const float* src, size_t n);
+        double sum_squares(const double* src, size_t n);
+        float maximum(const float* src, size_t n);
+        double maximum(const double* src, size_t n);
+        float minimum(const float* src, size_t n);
+        double minimum(const double* src, size_t n);
+        float max_abs(const float* src, size_t n);
+        double max_abs(const double* src, size_t n);
+
+        // name of the instruction set that the kernels use on this CPU, for diagnostics
+        const char* instruction_set();
+    }
+}
+
+#endif // SIMD_HPP
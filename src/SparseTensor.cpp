@@ -0,0 +1,698 @@
+/*
+TensorUtils Version 0.1
+
+Copyright 2022 Christoph Widder
+
+This file is part of TensorUtils.
+
+TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+the GNU General Public License as published by the Free Software Foundation, either
+version 3 of the License, or (at your option) any later version.
+
+TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with TensorUtils.
+If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef THROW_EXCEPTIONS
+#define THROW_EXCEPTIONS 0
+#endif // THROW_EXCEPTIONS
+
+#ifndef THROW_BASIC_EXCEPTIONS
+#define THROW_BASIC_EXCEPTIONS 1
+#endif // THROW_BASIC_EXCEPTIONS
+
+#include "SparseTensor.hpp"
+#include "ErrorHandler.hpp"
+#include "BinaryFormat.hpp"
+#include "StridedLoop.hpp"
+#include "ThreadPool.hpp"
+#include "Simd.hpp"
+#include "Profile.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <numeric>
+#include <stdexcept>
+#include <unordered_map>
+
+using namespace std;
+using namespace TensorUtils;
+using namespace ErrorHandler;
+
+/**
+    INDEX LABELS
+**/
+
+namespace
+{
+    // distinct index labels of one or two operands, see ContractionPlan
+    struct LabelMap
+    {
+        vector<int> labels;
+        vector<size_t> extent;          // range of every label
+        vector<size_t> result_stride;   // stride of every label in the result, 0 if it is summed over
+        vector<size_t> result_shape;
+        vector<size_t> lhs, rhs;        // label of every index of the operands
+        vector<bool> lhs_first, rhs_first; // first index of an operand with its label
+    };
+}
+
+static void add_labels(
+    LabelMap                &M,
+    const vector<size_t>    &shape,
+    const vector<int>       &idx,
+    vector<size_t>          &ids,
+    vector<bool>            &first,
+    const char*             name)
+{
+    if(THROW_BASIC_EXCEPTIONS && idx.size() != shape.size())
+    {
+        throw ShapeMismatch(string("TensorUtils::SparseTensor<T>::")+name+":: Number of labels does not match the rank!");
+    }
+    ids.resize(idx.size());
+    first.assign(idx.size(), false);
+    for(size_t dim=0; dim<idx.size(); dim++)
+    {
+        const size_t L = find(M.labels.begin(), M.labels.end(), idx[dim]) - M.labels.begin();
+        if(L == M.labels.size())
+        {
+            M.labels.push_back(idx[dim]);
+            M.extent.push_back(shape[dim]);
+        }
+        else if(THROW_BASIC_EXCEPTIONS && M.extent[L] != shape[dim])
+        {
+            throw ShapeMismatch(string("TensorUtils::SparseTensor<T>::")+name+":: Ranges of equal labels do not match!");
+        }
+        first[dim] = (find(ids.begin(), ids.begin()+dim, L) == ids.begin()+dim);
+        ids[dim] = L;
+    }
+}
+
+// the result has the non-negative labels in increasing order
+static void finish_labels(LabelMap &M)
+{
+    vector<size_t> order;
+    for(size_t L=0; L<M.labels.size(); L++)
+    {
+        if(M.labels[L] >= 0)
+        {
+            order.push_back(L);
+        }
+    }
+    sort(order.begin(), order.end(), [&](size_t a, size_t b){ return M.labels[a] < M.labels[b]; });
+    M.result_stride.assign(M.labels.size(), 0);
+    M.result_shape.resize(order.size());
+    size_t stride = 1;
+    for(size_t n=order.size(); n-->0;)
+    {
+        M.result_shape[n] = M.extent[order[n]];
+        M.result_stride[order[n]] = stride;
+        stride *= M.extent[order[n]];
+    }
+}
+
+// Values of the labels of the component at offset off. Returns false if equal labels have different indices,
+// i.e. the component does not contribute to a product.
+static bool bind_labels(
+    size_t                  off,
+    const vector<size_t>    &incr,
+    const vector<size_t>    &ids,
+    const vector<bool>      &first,
+    size_t*                 value)
+{
+    for(size_t dim=0; dim<incr.size(); dim++)
+    {
+        const size_t index = off/incr[dim];
+        off %= incr[dim];
+        if(first[dim])
+        {
+            value[ids[dim]] = index;
+        }
+        else if(value[ids[dim]] != index)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// offset in the result of the labels of one operand
+static size_t result_offset(const LabelMap &M, const vector<size_t> &ids, const vector<bool> &first, const size_t* value)
+{
+    size_t off = 0;
+    for(size_t dim=0; dim<ids.size(); dim++)
+    {
+        if(first[dim])
+        {
+            off += value[ids[dim]]*M.result_stride[ids[dim]];
+        }
+    }
+    return off;
+}
+
+/*
+    Calls f(begin,end) on ranges of the sorted offsets, concurrently if every range writes to its own part of the
+    result, i.e. if the first index is not summed over: the ranges are then cut at the rows of the first index.
+*/
+template<class F>
+static void for_rows(const vector<size_t> &offs, const vector<size_t> &incr, bool disjoint, size_t work_per_item, F f)
+{
+    if(!disjoint || incr.empty())
+    {
+        f(size_t(0), offs.size());
+        return;
+    }
+    auto row_begin = [&](size_t n)
+    {
+        if(n == 0 || n >= offs.size())
+        {
+            return n;
+        }
+        return size_t(lower_bound(offs.begin(), offs.end(), (offs[n]/incr[0])*incr[0]) - offs.begin());
+    };
+    Parallel::parallel_for(offs.size(), [&](size_t begin, size_t end)
+    {
+        f(row_begin(begin), row_begin(end));
+    }, work_per_item);
+}
+
+static void row_major_strides(const vector<size_t> &shape, vector<size_t> &incr)
+{
+    incr.resize(shape.size());
+    size_t stride = 1;
+    for(size_t dim=shape.size(); dim-->0;)
+    {
+        incr[dim] = stride;
+        stride *= shape[dim];
+    }
+}
+
+/**
+    CONSTRUCTOR AND ALLOCATION
+**/
+
+template<class T>
+SparseTensor<T>::SparseTensor() : sorted(true)
+{
+    //
+}
+
+template<class T>
+SparseTensor<T>::SparseTensor(const vector<size_t> &shape) : sorted(true)
+{
+    alloc(shape);
+}
+
+template<class T>
+template<class T2>
+SparseTensor<T>::SparseTensor(const TensorBase<T2> &dense, const T &tolerance) : sorted(true)
+{
+    alloc(dense.shape);
+    for(size_t n=0; n<dense.size(); n++)
+    {
+        const T val = static_cast<T>(dense[n]);
+        if(Simd::power<1>(val) > tolerance)
+        {
+            offs.push_back(n);
+            vals.push_back(val);
+        }
+    }
+}
+
+template<class T>
+void SparseTensor<T>::alloc(const vector<size_t> &shape)
+{
+    this->shape = shape;
+    row_major_strides(shape, incr);
+    offs.clear();
+    vals.clear();
+    sorted = true;
+}
+
+template<class T>
+void SparseTensor<T>::reserve(size_t nnz)
+{
+    offs.reserve(nnz);
+    vals.reserve(nnz);
+}
+
+template<class T>
+void SparseTensor<T>::insert(const vector<size_t> &indices, const T &val)
+{
+    if(THROW_BASIC_EXCEPTIONS && indices.size() != shape.size())
+    {
+        throw ShapeMismatch("TensorUtils::SparseTensor<T>::insert:: Number of indices does not match the rank!");
+    }
+    size_t off = 0;
+    for(size_t dim=0; dim<indices.size(); dim++)
+    {
+        if(THROW_EXCEPTIONS && indices[dim] >= shape[dim])
+        {
+            throw out_of_range("TensorUtils::SparseTensor<T>::insert:: Index out of range!");
+        }
+        off += indices[dim]*incr[dim];
+    }
+    // appending in increasing order keeps the tensor sorted
+    sorted = sorted && (offs.empty() || off > offs.back()) && val != T(0);
+    offs.push_back(off);
+    vals.push_back(val);
+}
+
+template<class T>
+void SparseTensor<T>::sort_entries() const
+{
+    if(sorted)
+    {
+        return;
+    }
+    vector<size_t> perm(offs.size());
+    iota(perm.begin(), perm.end(), size_t(0));
+    stable_sort(perm.begin(), perm.end(), [&](size_t a, size_t b){ return offs[a] < offs[b]; });
+    vector<size_t> new_offs;
+    vector<T> new_vals;
+    new_offs.reserve(offs.size());
+    new_vals.reserve(vals.size());
+    for(auto it=perm.begin(); it!=perm.end(); it++)
+    {
+        if(!new_offs.empty() && new_offs.back() == offs[*it])
+        {
+            new_vals.back() += vals[*it];
+        }
+        else
+        {
+            new_offs.push_back(offs[*it]);
+            new_vals.push_back(vals[*it]);
+        }
+    }
+    size_t m = 0;
+    for(size_t n=0; n<new_offs.size(); n++)
+    {
+        if(new_vals[n] != T(0))
+        {
+            new_offs[m] = new_offs[n];
+            new_vals[m] = new_vals[n];
+            m++;
+        }
+    }
+    new_offs.resize(m);
+    new_vals.resize(m);
+    offs.swap(new_offs);
+    vals.swap(new_vals);
+    sorted = true;
+}
+
+template<class T>
+void SparseTensor<T>::compress()
+{
+    sort_entries();
+}
+
+/**
+    ACCESS
+**/
+
+template<class T>
+size_t SparseTensor<T>::nnz() const
+{
+    sort_entries();
+    return offs.size();
+}
+
+template<class T>
+double SparseTensor<T>::density() const
+{
+    const size_t total = BinaryFormat::count(shape);
+    return total ? double(nnz())/double(total) : 0.0;
+}
+
+template<class T>
+T SparseTensor<T>::operator()(const vector<size_t> &indices) const
+{
+    if(THROW_BASIC_EXCEPTIONS && indices.size() != shape.size())
+    {
+        throw ShapeMismatch("TensorUtils::SparseTensor<T>::operator():: Number of indices does not match the rank!");
+    }
+    size_t off = 0;
+    for(size_t dim=0; dim<indices.size(); dim++)
+    {
+        if(THROW_EXCEPTIONS && indices[dim] >= shape[dim])
+        {
+            throw out_of_range("TensorUtils::SparseTensor<T>::operator():: Index out of range!");
+        }
+        off += indices[dim]*incr[dim];
+    }
+    sort_entries();
+    auto it = lower_bound(offs.begin(), offs.end(), off);
+    return (it != offs.end() && *it == off) ? vals[it-offs.begin()] : T(0);
+}
+
+template<class T>
+const vector<size_t>& SparseTensor<T>::offsets() const
+{
+    sort_entries();
+    return offs;
+}
+
+template<class T>
+const vector<T>& SparseTensor<T>::values() const
+{
+    sort_entries();
+    return vals;
+}
+
+template<class T>
+TensorBase<T> SparseTensor<T>::dense() const
+{
+    sort_entries();
+    TensorBase<T> result(shape, T(0));
+    for(size_t n=0; n<offs.size(); n++)
+    {
+        result[offs[n]] = vals[n];
+    }
+    return result;
+}
+
+/**
+    PRODUCTS
+**/
+
+template<class T>
+template<class T2>
+TensorBase<T> SparseTensor<T>::dot(const TensorBase<T2> &B, const vector<int> &idx_lhs, const vector<int> &idx_rhs) const
+{
+    PROFILE_SCOPE("SparseTensor::dot");
+    sort_entries();
+    LabelMap M;
+    add_labels(M, shape, idx_lhs, M.lhs, M.lhs_first, "dot");
+    add_labels(M, B.shape, idx_rhs, M.rhs, M.rhs_first, "dot");
+    finish_labels(M);
+    TensorBase<T> result(M.result_shape, T(0));
+
+    // indices of B with a label of this tensor are fixed by every stored component, the others are looped over
+    vector<bool> in_lhs(M.labels.size(), false);
+    for(auto it=M.lhs.begin(); it!=M.lhs.end(); it++)
+    {
+        in_lhs[*it] = true;
+    }
+    vector<pair<size_t,size_t>> bound; // label and stride in B
+    vector<size_t> free_labels, free_stride(M.labels.size(), 0);
+    for(size_t dim=0; dim<B.shape.size(); dim++)
+    {
+        const size_t L = M.rhs[dim];
+        if(in_lhs[L])
+        {
+            bound.push_back({L, B.incr[dim]});
+            continue;
+        }
+        if(M.rhs_first[dim])
+        {
+            free_labels.push_back(L);
+        }
+        free_stride[L] += B.incr[dim];
+    }
+    Kernels::StridedLoop<2> loop;
+    for(auto it=free_labels.begin(); it!=free_labels.end(); it++)
+    {
+        loop.push_back(M.extent[*it], {M.result_stride[*it], free_stride[*it]});
+    }
+    loop.merge();
+    if(loop.size() == 0 || B.empty())
+    {
+        return result;
+    }
+
+    T* C = result.data();
+    const T2* src = B.data();
+    const bool disjoint = !shape.empty() && M.result_stride[M.lhs[0]] != 0;
+    for_rows(offs, incr, disjoint, loop.size(), [&](size_t begin, size_t end)
+    {
+        vector<size_t> value(M.labels.size());
+        T v = T(0);
+        auto kernel = [&](const Kernels::StridedLoop<2>::Offsets &off, size_t n, const Kernels::StridedLoop<2>::Offsets &stride)
+        {
+            T* c = C+off[0];
+            const T2* b = src+off[1];
+            const T s = v; // local copy, c may alias v
+            if(stride[0] == 1 && stride[1] == 1)
+            {
+                for(size_t i=0; i<n; i++)
+                {
+                    c[i] += s*static_cast<T>(b[i]);
+                }
+            }
+            else
+            {
+                for(size_t i=0; i<n; i++)
+                {
+                    c[i*stride[0]] += s*static_cast<T>(b[i*stride[1]]);
+                }
+            }
+        };
+        for(size_t e=begin; e<end; e++)
+        {
+            if(!bind_labels(offs[e], incr, M.lhs, M.lhs_first, value.data()))
+            {
+                continue;
+            }
+            size_t off_b = 0;
+            for(auto it=bound.begin(); it!=bound.end(); it++)
+            {
+                off_b += value[it->first]*it->second;
+            }
+            v = vals[e];
+            loop.run({result_offset(M, M.lhs, M.lhs_first, value.data()), off_b}, kernel);
+        }
+    });
+    return result;
+}
+
+template<class T>
+template<class T2>
+SparseTensor<T> SparseTensor<T>::dot(const SparseTensor<T2> &B, const vector<int> &idx_lhs, const vector<int> &idx_rhs) const
+{
+    PROFILE_SCOPE("SparseTensor::dot_sparse");
+    sort_entries();
+    const vector<size_t> &B_offs = B.offsets();
+    const vector<T2> &B_vals = B.values();
+    LabelMap M;
+    add_labels(M, shape, idx_lhs, M.lhs, M.lhs_first, "dot");
+    add_labels(M, B.shape, idx_rhs, M.rhs, M.rhs_first, "dot");
+    finish_labels(M);
+
+    // key of the common labels, and offset in the result of the labels that occur only in B
+    vector<bool> in_lhs(M.labels.size(), false);
+    for(auto it=M.lhs.begin(); it!=M.lhs.end(); it++)
+    {
+        in_lhs[*it] = true;
+    }
+    vector<size_t> key_stride(M.labels.size(), 0);
+    vector<bool> rhs_only(M.rhs.size(), false);
+    size_t radix = 1;
+    for(size_t dim=0; dim<M.rhs.size(); dim++)
+    {
+        const size_t L = M.rhs[dim];
+        if(in_lhs[L] && M.rhs_first[dim])
+        {
+            key_stride[L] = radix;
+            radix *= M.extent[L];
+        }
+        rhs_only[dim] = M.rhs_first[dim] && !in_lhs[L];
+    }
+    auto key = [&](const size_t* value)
+    {
+        size_t k = 0;
+        for(size_t L=0; L<M.labels.size(); L++)
+        {
+            k += value[L]*key_stride[L];
+        }
+        return k;
+    };
+
+    // table of the stored components of B, sorted by key
+    struct Entry
+    {
+        size_t key;
+        size_t off;
+        T2 val;
+    };
+    vector<Entry> table;
+    table.reserve(B_offs.size());
+    vector<size_t> value(M.labels.size(), 0);
+    for(size_t e=0; e<B_offs.size(); e++)
+    {
+        if(bind_labels(B_offs[e], B.incr, M.rhs, M.rhs_first, value.data()))
+        {
+            table.push_back({key(value.data()), result_offset(M, M.rhs, rhs_only, value.data()), B_vals[e]});
+        }
+    }
+    std::sort(table.begin(), table.end(), [](const Entry &a, const Entry &b){ return a.key < b.key; });
+
+    unordered_map<size_t,T> acc;
+    for(size_t e=0; e<offs.size(); e++)
+    {
+        if(!bind_labels(offs[e], incr, M.lhs, M.lhs_first, value.data()))
+        {
+            continue;
+        }
+        const size_t k = key(value.data());
+        const size_t off = result_offset(M, M.lhs, M.lhs_first, value.data());
+        auto it = lower_bound(table.begin(), table.end(), k, [](const Entry &a, size_t k){ return a.key < k; });
+        for(; it!=table.end() && it->key==k; it++)
+        {
+            acc[off+it->off] += vals[e]*static_cast<T>(it->val);
+        }
+    }
+
+    SparseTensor<T> result(M.result_shape);
+    result.reserve(acc.size());
+    for(auto it=acc.begin(); it!=acc.end(); it++)
+    {
+        result.offs.push_back(it->first);
+        result.vals.push_back(it->second);
+    }
+    result.sorted = false;
+    result.sort_entries();
+    return result;
+}
+
+template<class T>
+TensorBase<T> SparseTensor<T>::contract(const vector<int> &idx_lhs) const
+{
+    PROFILE_SCOPE("SparseTensor::contract");
+    sort_entries();
+    LabelMap M;
+    add_labels(M, shape, idx_lhs, M.lhs, M.lhs_first, "contract");
+    finish_labels(M);
+    TensorBase<T> result(M.result_shape, T(0));
+    T* C = result.data();
+    const bool disjoint = !shape.empty() && M.result_stride[M.lhs[0]] != 0;
+    for_rows(offs, incr, disjoint, 1, [&](size_t begin, size_t end)
+    {
+        vector<size_t> value(M.labels.size());
+        for(size_t e=begin; e<end; e++)
+        {
+            if(bind_labels(offs[e], incr, M.lhs, M.lhs_first, value.data()))
+            {
+                C[result_offset(M, M.lhs, M.lhs_first, value.data())] += vals[e];
+            }
+        }
+    });
+    return result;
+}
+
+/**
+    READ AND WRITE
+**/
+
+template<class T>
+void SparseTensor<T>::read(string path)
+{
+    if(filesystem::path(path).extension() == BinaryFormat::CONTAINER_EXTENSION && BinaryFormat::is_container(path))
+    {
+        BinaryFormat::ContainerReader in(path);
+        if(in.header().sparse())
+        {
+            vector<uint64_t> index(in.header().count);
+            in.read_index(index.data());
+            alloc(in.header().shape);
+            offs.assign(index.begin(), index.end());
+            vals.resize(index.size());
+            in.read(vals.data(), vals.size());
+            sorted = false; // drops stored zeros
+            sort_entries();
+            return;
+        }
+    }
+    TensorBase<T> dense;
+    dense.read(path);
+    *this = SparseTensor<T>(dense);
+}
+
+template<class T>
+void SparseTensor<T>::write(string oname, string folder) const
+{
+    if(filesystem::path(oname).extension() != BinaryFormat::CONTAINER_EXTENSION)
+    {
+        throw runtime_error("TensorUtils::SparseTensor<T>::write:: Invalid file extension: sparse tensors are stored in containers \".tu\"!");
+    }
+    sort_entries();
+    filesystem::create_directories(folder);
+    string path = folder;
+    if(path.back() != '/' ){
+        path.append("/");
+    }
+    path.append(oname);
+
+    BinaryFormat::ContainerWriter out(path, BinaryFormat::make_sparse_header(BinaryFormat::dtype<T>(), shape, offs.size(), BinaryFormat::DEFAULT_CHUNK_SIZE));
+    out.write(vals.data(), vals.size());
+    const vector<uint64_t> index(offs.begin(), offs.end());
+    out.write_index(index.data());
+    out.close();
+}
+
+/**
+    EXPLICIT TEMPLATE INSTANTIATION
+**/
+
+namespace TensorUtils
+{
+    #define INSTANTIATE_FUNCTION_TEMPLATES(X,Y) \
+    template SparseTensor<X>::SparseTensor(const TensorBase<Y>&, const X&); \
+    template TensorBase<X> SparseTensor<X>::dot(const TensorBase<Y>&, const vector<int>&, const vector<int>&) const; \
+    template SparseTensor<X> SparseTensor<X>::dot(const SparseTensor<Y>&, const vector<int>&, const vector<int>&) const; \
+
+    #define INSTANTIATE_ALL(X) \
+    template class SparseTensor<X>; \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,double) \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,float) \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,long double) \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,unsigned char) \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,signed char) \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,unsigned short) \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,short) \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,unsigned) \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,int) \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,unsigned long) \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,long) \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,unsigned long long) \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,long long) \
+
+    #define INSTANTIATE_FLOATING_POINT_TYPES(X) \
+    template class SparseTensor<X>; \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,double) \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,float) \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,long double)
+
+    #ifndef ENABLE_INTEGRAL_TYPES
+    #define ENABLE_INTEGRAL_TYPES 1
+    #endif // ENABLE_INTEGRAL_TYPES
+
+    #if ENABLE_INTEGRAL_TYPES == 1
+        INSTANTIATE_ALL(double)
+        INSTANTIATE_ALL(float)
+        INSTANTIATE_ALL(long double)
+        INSTANTIATE_ALL(unsigned char)
+        INSTANTIATE_ALL(signed char)
+        INSTANTIATE_ALL(unsigned short)
+        INSTANTIATE_ALL(short)
+        INSTANTIATE_ALL(unsigned)
+        INSTANTIATE_ALL(int)
+        INSTANTIATE_ALL(unsigned long)
+        INSTANTIATE_ALL(long)
+        INSTANTIATE_ALL(unsigned long long)
+        INSTANTIATE_ALL(long long)
+    #else
+        INSTANTIATE_FLOATING_POINT_TYPES(double)
+        INSTANTIATE_FLOATING_POINT_TYPES(float)
+        INSTANTIATE_FLOATING_POINT_TYPES(long double)
+    #endif
+
+    #undef INSTANTIATE_ALL
+    #undef INSTANTIATE_FLOATING_POINT_TYPES
+    #undef INSTANTIATE_FUNCTION_TEMPLATES
+}
@@ -0,0 +1,222 @@
+/*
+TensorUtils Version 0.1
+
+Copyright 2022 Christoph Widder
+
+This file is part of TensorUtils.
+
+TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+the GNU General Public License as published by the Free Software Foundation, either
+version 3 of the License, or (at your option) any later version.
+
+TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with TensorUtils.
+If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef STRIDEDLOOP_HPP
+#define STRIDEDLOOP_HPP
+
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <cstddef>
+
+namespace TensorUtils
+{
+    namespace Kernels
+    {
+        /*
+            Flattened loop nest over an N-dimensional index space that is shared by K operands.
+            Every dimension has an extent and one stride per operand. Dimensions are ordered from
+            the outermost to the innermost. The innermost dimension is handed to a kernel as a
+            whole, so that the kernel can run a tight (and for unit strides vectorizable) loop:
+
+                kernel(const std::array<size_t,K> &offset, size_t n, const std::array<size_t,K> &stride)
+
+            All outer dimensions are iterated like an odometer without recursion or type erasure.
+        */
+        template<unsigned K>
+        class StridedLoop
+        {
+            public:
+                typedef std::array<size_t,K> Offsets;
+
+                // appends a dimension inside of all previous dimensions
+                void push_back(size_t extent, const Offsets &stride)
+                {
+                    extents.push_back(extent);
+                    strides.push_back(stride);
+                }
+
+                // Drops dimensions of extent 1 and merges neighbouring dimensions that are contiguous
+                // in all operands, e.g. a transpose {0,2,1,3} of a row-major tensor becomes a 3d loop
+                // and a copy of a contiguous tensor becomes a single 1d loop.
+                void merge()
+                {
+                    std::vector<size_t> ext;
+                    std::vector<Offsets> str;
+                    for(size_t d=0; d<extents.size(); d++)
+                    {
+                        if(extents[d] == 1)
+                        {
+                            continue;
+                        }
+                        if(extents[d] == 0) // empty index space
+                        {
+                            ext.assign(1,0);
+                            str.assign(1,Offsets{});
+                            break;
+                        }
+                        bool contiguous = !ext.empty();
+                        for(unsigned k=0; contiguous && k<K; k++)
+                        {
+                            contiguous = (str.back()[k] == strides[d][k]*extents[d]);
+                        }
+                        if(contiguous)
+                        {
+                            ext.back() *= extents[d];
+                            str.back() = strides[d];
+                        }
+                        else
+                        {
+                            ext.push_back(extents[d]);
+                            str.push_back(strides[d]);
+                        }
+                    }
+                    extents.swap(ext);
+                    strides.swap(str);
+                }
+
+                size_t rank() const
+                {
+                    return extents.size();
+                }
+
+                // total number of iterations
+                size_t size() const
+                {
+                    size_t n = 1;
+                    for(auto it=extents.begin(); it!=extents.end(); it++)
+                    {
+                        n *= *it;
+                    }
+                    return n;
+                }
+
+                size_t extent(size_t dim) const
+                {
+                    return extents[dim];
+                }
+
+                const Offsets& stride(size_t dim) const
+                {
+                    return strides[dim];
+                }
+
+                // runs kernel on all innermost rows, starting at the offsets base
+                template<class KERNEL>
+                void run(const Offsets &base, KERNEL &&kernel) const
+                {
+                    run_range(base, 0, size(), kernel);
+                }
+
+                // Runs kernel on the iterations [first,last) in lexicographical order. Rows are cut at first and last,
+                // such that disjoint ranges can be processed concurrently.
+                template<class KERNEL>
+                void run_range(const Offsets &base, size_t first, size_t last, KERNEL &&kernel) const
+                {
+                    const size_t nd = extents.size();
+                    if(nd == 0) // scalar
+                    {
+                        if(first == 0 && last > 0)
+                        {
+                            kernel(base, size_t(1), Offsets{});
+                        }
+                        return;
+                    }
+                    const size_t n_inner = extents.back();
+                    const Offsets &s_inner = strides.back();
+                    if(n_inner == 0 || first >= last)
+                    {
+                        return;
+                    }
+
+                    // counters live on the stack for all practical ranks
+                    size_t stack_counter[32];
+                    std::vector<size_t> heap_counter;
+                    size_t* idx = stack_counter;
+                    if(nd > 32)
+                    {
+                        heap_counter.resize(nd);
+                        idx = heap_counter.data();
+                    }
+
+                    // odometer position of the row that contains first
+                    Offsets off = base;
+                    size_t row = first/n_inner;
+                    for(size_t d=nd-1; d-->0;)
+                    {
+                        idx[d] = row % extents[d];
+                        row /= extents[d];
+                        for(unsigned k=0; k<K; k++)
+                        {
+                            off[k] += idx[d]*strides[d][k];
+                        }
+                    }
+
+                    size_t col = first % n_inner;
+                    size_t remaining = last-first;
+                    while(true)
+                    {
+                        const size_t n = std::min(n_inner-col, remaining);
+                        if(col == 0)
+                        {
+                            kernel(static_cast<const Offsets&>(off), n, s_inner);
+                        }
+                        else
+                        {
+                            Offsets shifted = off;
+                            for(unsigned k=0; k<K; k++)
+                            {
+                                shifted[k] += col*s_inner[k];
+                            }
+                            kernel(static_cast<const Offsets&>(shifted), n, s_inner);
+                        }
+                        remaining -= n;
+                        if(remaining == 0)
+                        {
+                            return;
+                        }
+                        col = 0;
+                        for(size_t d=nd-1; d-->0;)
+                        {
+                            for(unsigned k=0; k<K; k++)
+                            {
+                                off[k] += strides[d][k];
+                            }
+                            if(++idx[d] < extents[d])
+                            {
+                                break;
+                            }
+                            idx[d] = 0;
+                            for(unsigned k=0; k<K; k++)
+                            {
+                                off[k] -= strides[d][k]*extents[d];
+                            }
+                        }
+                    }
+                }
+
+            private:
+                std::vector<size_t> extents;
+                std::vector<Offsets> strides;
+        };
+    }
+}
+
+#endif // STRIDEDLOOP_HPP
@@ -0,0 +1,652 @@
+/*
+TensorUtils Version 0.1
+
+Copyright 2022 Christoph Widder
+
+This file is part of TensorUtils.
+
+TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+the GNU General Public License as published by the Free Software Foundation, either
+version 3 of the License, or (at your option) any later version.
+
+TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with TensorUtils.
+If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef THROW_EXCEPTIONS
+#define THROW_EXCEPTIONS 0
+#endif // THROW_EXCEPTIONS
+
+#ifndef THROW_BASIC_EXCEPTIONS
+#define THROW_BASIC_EXCEPTIONS 1
+#endif // THROW_BASIC_EXCEPTIONS
+
+#include "SymmetricTensor.hpp"
+#include "ContractionPlan.hpp"
+#include "ErrorHandler.hpp"
+#include "StridedLoop.hpp"
+#include "ThreadPool.hpp"
+#include "Profile.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+using namespace TensorUtils;
+using namespace ErrorHandler;
+
+/**
+    SORTED INDICES
+**/
+
+// first sorted tuple, strictly increasing if strict. Returns false if there is none.
+static bool first_sorted(vector<size_t> &idx, size_t range, bool strict)
+{
+    for(size_t k=0; k<idx.size(); k++)
+    {
+        idx[k] = strict ? k : 0;
+    }
+    return idx.empty() || (strict ? idx.size() <= range : range > 0);
+}
+
+// next sorted tuple in lexicographical order. Returns false after the last one.
+static bool next_sorted(vector<size_t> &idx, size_t range, bool strict)
+{
+    const size_t N = idx.size();
+    for(size_t k=N; k-- > 0;)
+    {
+        const size_t max_k = strict ? range-(N-k) : range-1;
+        if(idx[k] < max_k)
+        {
+            idx[k]++;
+            for(size_t l=k+1; l<N; l++)
+            {
+                idx[l] = strict ? idx[l-1]+1 : idx[k];
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+// increments the odometer idx with the given ranges, the last index runs fastest
+static void next_index(vector<size_t> &idx, const vector<size_t> &shape)
+{
+    for(size_t k=shape.size(); k-- > 0;)
+    {
+        if(++idx[k] < shape[k])
+        {
+            return;
+        }
+        idx[k] = 0;
+    }
+}
+
+// true if no label is repeated in an operand and the operands have exactly their negative labels in common
+static bool symmetric_labels(const vector<int> &idx_lhs, const vector<int> &idx_rhs)
+{
+    auto distinct = [](vector<int> idx)
+    {
+        sort(idx.begin(), idx.end());
+        return adjacent_find(idx.begin(), idx.end()) == idx.end();
+    };
+    if(!distinct(idx_lhs) || !distinct(idx_rhs))
+    {
+        return false;
+    }
+    for(int label : idx_lhs)
+    {
+        if((label < 0) != (find(idx_rhs.begin(), idx_rhs.end(), label) != idx_rhs.end()))
+        {
+            return false;
+        }
+    }
+    for(int label : idx_rhs)
+    {
+        if(label < 0 && find(idx_lhs.begin(), idx_lhs.end(), label) == idx_lhs.end())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+    CONSTRUCTOR AND ALLOCATION
+**/
+
+template<class T>
+SymmetricTensor<T>::SymmetricTensor()
+{
+    alloc(0, 0);
+}
+
+template<class T>
+SymmetricTensor<T>::SymmetricTensor(size_t range, size_t rank, Symmetry symmetry)
+{
+    alloc(range, rank, symmetry);
+}
+
+template<class T>
+SymmetricTensor<T>::SymmetricTensor(const TensorBase<T> &dense, Symmetry symmetry)
+{
+    const size_t n = dense.shape.empty() ? 0 : dense.shape[0];
+    if(THROW_BASIC_EXCEPTIONS && count_if(dense.shape.begin(), dense.shape.end(), [n](size_t m){ return m != n; }))
+    {
+        throw ShapeMismatch("TensorUtils::SymmetricTensor<T>::SymmetricTensor:: All indices must have the same range!");
+    }
+    alloc(n, dense.shape.size(), symmetry);
+
+    const bool strict = (sym == Symmetry::ANTISYMMETRIC);
+    vector<size_t> idx(rank());
+    for(bool valid=first_sorted(idx, n, strict); valid; valid=next_sorted(idx, n, strict))
+    {
+        size_t off = 0;
+        for(size_t k=0; k<idx.size(); k++)
+        {
+            off += idx[k]*dense.incr[k];
+        }
+        vals[offset(idx.data(), idx.size())] = dense[off];
+    }
+}
+
+template<class T>
+void SymmetricTensor<T>::alloc(size_t range, size_t rank, Symmetry symmetry)
+{
+    sym = symmetry;
+    extent = range;
+    shape.assign(rank, range);
+
+    // Pascal's triangle up to the largest offset of binom(m,k+1), i.e. m < range+rank
+    const size_t rows = range+rank;
+    binom.assign(rank*rows, 0);
+    vector<size_t> row(rank+1, 0);
+    for(size_t m=0; m<rows; m++)
+    {
+        for(size_t k=min(m, rank); k>0; k--)
+        {
+            row[k] += row[k-1];
+        }
+        row[0] = 1;
+        for(size_t k=0; k<rank; k++)
+        {
+            binom[k*rows+m] = row[k+1];
+        }
+    }
+    vals.assign(count(rank), T(0));
+}
+
+/**
+    ACCESS
+**/
+
+template<class T>
+size_t SymmetricTensor<T>::offset(const size_t* sorted, size_t length) const
+{
+    const size_t rows = extent+shape.size();
+    const size_t shift = (sym == Symmetry::SYMMETRIC);
+    size_t off = 0;
+    for(size_t k=0; k<length; k++)
+    {
+        off += binom[k*rows + sorted[k] + shift*k];
+    }
+    return off;
+}
+
+template<class T>
+size_t SymmetricTensor<T>::count(size_t length) const
+{
+    if(length == 0)
+    {
+        return 1;
+    }
+    const size_t rows = extent+shape.size();
+    return binom[(length-1)*rows + (sym == Symmetry::SYMMETRIC ? extent+length-1 : extent)];
+}
+
+template<class T>
+T SymmetricTensor<T>::canonical(vector<size_t> &indices) const
+{
+    // insertion sort, counting the transpositions
+    bool odd = false;
+    for(size_t k=1; k<indices.size(); k++)
+    {
+        for(size_t l=k; l>0 && indices[l-1] > indices[l]; l--)
+        {
+            swap(indices[l-1], indices[l]);
+            odd = !odd;
+        }
+    }
+    if(sym == Symmetry::SYMMETRIC)
+    {
+        return T(1);
+    }
+    if(adjacent_find(indices.begin(), indices.end()) != indices.end())
+    {
+        return T(0);
+    }
+    return odd ? T(-1) : T(1);
+}
+
+template<class T>
+typename SymmetricTensor<T>::Symmetry SymmetricTensor<T>::symmetry() const
+{
+    return sym;
+}
+
+template<class T>
+size_t SymmetricTensor<T>::rank() const
+{
+    return shape.size();
+}
+
+template<class T>
+size_t SymmetricTensor<T>::range() const
+{
+    return extent;
+}
+
+template<class T>
+size_t SymmetricTensor<T>::stored() const
+{
+    return vals.size();
+}
+
+template<class T>
+T SymmetricTensor<T>::operator()(const vector<size_t> &indices) const
+{
+    if(THROW_BASIC_EXCEPTIONS && indices.size() != shape.size())
+    {
+        throw ShapeMismatch("TensorUtils::SymmetricTensor<T>::operator():: Number of indices does not match the rank!");
+    }
+    if(THROW_EXCEPTIONS && any_of(indices.begin(), indices.end(), [this](size_t i){ return i >= extent; }))
+    {
+        throw out_of_range("TensorUtils::SymmetricTensor<T>::operator():: Index out of range!");
+    }
+    vector<size_t> sorted(indices);
+    const T sign = canonical(sorted);
+    return sign == T(0) ? T(0) : sign*vals[offset(sorted.data(), sorted.size())];
+}
+
+template<class T>
+void SymmetricTensor<T>::set(const vector<size_t> &indices, const T &val)
+{
+    if(THROW_BASIC_EXCEPTIONS && indices.size() != shape.size())
+    {
+        throw ShapeMismatch("TensorUtils::SymmetricTensor<T>::set:: Number of indices does not match the rank!");
+    }
+    if(THROW_EXCEPTIONS && any_of(indices.begin(), indices.end(), [this](size_t i){ return i >= extent; }))
+    {
+        throw out_of_range("TensorUtils::SymmetricTensor<T>::set:: Index out of range!");
+    }
+    vector<size_t> sorted(indices);
+    const T sign = canonical(sorted);
+    if(sign == T(0))
+    {
+        if(val != T(0))
+        {
+            throw domain_error("TensorUtils::SymmetricTensor<T>::set:: Components of antisymmetric tensors with repeated indices are zero!");
+        }
+        return;
+    }
+    vals[offset(sorted.data(), sorted.size())] = sign*val;
+}
+
+template<class T>
+vector<T>& SymmetricTensor<T>::values()
+{
+    return vals;
+}
+
+template<class T>
+const vector<T>& SymmetricTensor<T>::values() const
+{
+    return vals;
+}
+
+template<class T>
+TensorBase<T> SymmetricTensor<T>::dense() const
+{
+    PROFILE_SCOPE("SymmetricTensor::dense");
+    TensorBase<T> result(shape);
+    vector<size_t> idx(shape.size(), 0), sorted;
+    for(size_t e=0; e<result.size(); e++, next_index(idx, shape))
+    {
+        sorted = idx;
+        const T sign = canonical(sorted);
+        result[e] = (sign == T(0)) ? T(0) : sign*vals[offset(sorted.data(), sorted.size())];
+    }
+    return result;
+}
+
+/**
+    PRODUCTS
+**/
+
+template<class T>
+TensorBase<T> SymmetricTensor<T>::dot(const TensorBase<T> &rhs, const vector<int> &idx_lhs, const vector<int> &idx_rhs) const
+{
+    PROFILE_SCOPE("SymmetricTensor::dot");
+    const ContractionPlan plan(shape, idx_lhs, rhs.shape, idx_rhs);
+    TensorBase<T> result;
+    if(!symmetric_labels(idx_lhs, idx_rhs))
+    {
+        plan.execute(dense(), rhs, result);
+        return result;
+    }
+    result.alloc(plan.shape(), T(0));
+
+    // free and summed positions of this tensor, the summed ones in the order of their indices in rhs
+    const bool strict = (sym == Symmetry::ANTISYMMETRIC);
+    vector<size_t> free_pos, sum_pos, sum_dims;
+    for(size_t p=0; p<idx_lhs.size(); p++)
+    {
+        if(idx_lhs[p] >= 0)
+        {
+            free_pos.push_back(p);
+        }
+    }
+    for(size_t d=0; d<idx_rhs.size(); d++)
+    {
+        if(idx_rhs[d] < 0)
+        {
+            sum_pos.push_back(find(idx_lhs.begin(), idx_lhs.end(), idx_rhs[d]) - idx_lhs.begin());
+            sum_dims.push_back(d);
+        }
+    }
+    const size_t f = free_pos.size(), c = sum_pos.size(), N = f+c;
+
+    // sign of the permutation that moves the free indices in front of the summed ones
+    vector<size_t> order(free_pos);
+    order.insert(order.end(), sum_pos.begin(), sum_pos.end());
+    const T sign0 = canonical(order);
+
+    // the free indices of rhs are the columns of the accumulated operands and of the sorted result
+    vector<int> labels;
+    for(int label : idx_lhs)    if(label >= 0) labels.push_back(label);
+    for(int label : idx_rhs)    if(label >= 0) labels.push_back(label);
+    sort(labels.begin(), labels.end());
+    auto axis = [&](int label){ return size_t(lower_bound(labels.begin(), labels.end(), label) - labels.begin()); };
+
+    size_t cols = 1;
+    vector<size_t> col_stride(rhs.shape.size(), 0);
+    Kernels::StridedLoop<2> loop;
+    for(size_t d=rhs.shape.size(); d-- > 0;)
+    {
+        if(idx_rhs[d] >= 0)
+        {
+            col_stride[d] = cols;
+            cols *= rhs.shape[d];
+        }
+    }
+    for(size_t d=0; d<rhs.shape.size(); d++)
+    {
+        if(idx_rhs[d] >= 0)
+        {
+            loop.push_back(rhs.shape[d], {result.incr[axis(idx_rhs[d])], col_stride[d]});
+        }
+    }
+    loop.merge();
+    if(result.empty())
+    {
+        return result;
+    }
+
+    // rhs accumulated onto the sorted summed indices, with the signs of the sorting permutations
+    vector<T> R(count(c)*cols, T(0));
+    {
+        vector<size_t> idx(rhs.shape.size(), 0), m(c);
+        for(size_t e=0; e<rhs.size(); e++, next_index(idx, rhs.shape))
+        {
+            size_t col = 0;
+            for(size_t d=0; d<idx.size(); d++)
+            {
+                col += idx[d]*col_stride[d];
+            }
+            for(size_t k=0; k<c; k++)
+            {
+                m[k] = idx[sum_dims[k]];
+            }
+            const T sign = canonical(m);
+            if(sign != T(0))
+            {
+                R[offset(m.data(), c)*cols + col] += sign*rhs[e];
+            }
+        }
+    }
+
+    // sorted index tuples of the free and the summed indices, stored at their offsets
+    auto tuples = [&](size_t length)
+    {
+        vector<size_t> flat(count(length)*length), idx(length);
+        for(bool valid=first_sorted(idx, extent, strict); valid; valid=next_sorted(idx, extent, strict))
+        {
+            copy(idx.begin(), idx.end(), flat.begin() + offset(idx.data(), length)*length);
+        }
+        return flat;
+    };
+    const vector<size_t> free_tuples = tuples(f), sum_tuples = tuples(c);
+    const size_t n_free = count(f), n_sum = count(c), n = extent, rows = extent+N;
+    const size_t shift = strict ? 0 : 1;
+
+    // product for the sorted free indices only: G(i,col) = sum_m S(i,m) R(m,col)
+    vector<T> G(n_free*cols, T(0));
+    if(N == 2 && f == 1 && cols == 1)
+    {
+        // matrix-vector: every stored column j is one axpy into G and one dot product for G(j)
+        for(size_t j=0; j<n; j++)
+        {
+            const T* column = vals.data() + (strict ? j*(j-1)/2 : j*(j+1)/2);
+            const size_t length = strict ? j : j+1;
+            const T r_j = R[j];
+            T acc = T(0);
+            for(size_t i=0; i<length; i++)
+            {
+                G[i] += column[i]*r_j;
+                acc += column[i]*R[i];
+            }
+            if(strict)
+            {
+                G[j] -= acc;
+            }
+            else
+            {
+                G[j] += acc - column[j]*r_j;
+            }
+        }
+    }
+    else if(N == 2 && f == 1)
+    {
+        // matrices: every stored component (i,j) contributes to the rows i and j, the columns are split across threads
+        Parallel::parallel_for(cols, [&](size_t begin, size_t end)
+        {
+            for(size_t j=0; j<n; j++)
+            {
+                const T* column = vals.data() + (strict ? j*(j-1)/2 : j*(j+1)/2);
+                const T* r_j = R.data() + j*cols;
+                T* g_j = G.data() + j*cols;
+                for(size_t i=0; i<(strict ? j : j+1); i++)
+                {
+                    const T s = column[i];
+                    const T s_ji = strict ? -s : s;
+                    const T* r_i = R.data() + i*cols;
+                    T* g_i = G.data() + i*cols;
+                    for(size_t col=begin; col<end; col++)
+                    {
+                        g_i[col] += s*r_j[col];
+                    }
+                    if(i != j)
+                    {
+                        for(size_t col=begin; col<end; col++)
+                        {
+                            g_j[col] += s_ji*r_i[col];
+                        }
+                    }
+                }
+            }
+        }, n*n);
+    }
+    else
+    {
+        /*
+            The offset of the merged tuple of i and m is a sum of one term per index, which depends on its value and on its
+            position in the merged tuple: a+(number of m[b] < i[a]) for i[a] and b+(number of i[a] <= m[b]) for m[b].
+            The terms of the free indices are tabulated once per m, those of the summed indices once per i, such that
+            every pair costs N lookups.
+        */
+        vector<size_t> P(n_sum*f*n);
+        for(size_t u=0; u<n_sum; u++)
+        {
+            const size_t* m = sum_tuples.data() + u*c;
+            for(size_t v=0, lt=0; v<n; v++)
+            {
+                for(size_t a=0; a<f; a++)
+                {
+                    const size_t pos = a+lt;
+                    P[(u*f+a)*n + v] = binom[pos*rows + v + shift*pos];
+                }
+                lt += count_if(m, m+c, [v](size_t x){ return x == v; });
+            }
+        }
+
+        Parallel::parallel_for(n_free, [&](size_t begin, size_t end)
+        {
+            vector<size_t> Q(c*n);
+            vector<T> Q_sign(c*n, T(1));
+            for(size_t t=begin; t<end; t++)
+            {
+                const size_t* i = free_tuples.data() + t*f;
+                for(size_t v=0; v<n; v++)
+                {
+                    const size_t le = count_if(i, i+f, [v](size_t x){ return x <= v; });
+                    for(size_t b=0; b<c; b++)
+                    {
+                        const size_t pos = b+le;
+                        Q[b*n + v] = binom[pos*rows + v + shift*pos];
+                        if(strict)
+                        {
+                            // zero for repeated indices, otherwise the sign of the f-le inversions
+                            const bool repeated = (find(i, i+f, v) != i+f);
+                            Q_sign[b*n + v] = repeated ? T(0) : ((f-le)%2 ? T(-1) : T(1));
+                        }
+                    }
+                }
+
+                T* g = G.data() + t*cols;
+                for(size_t u=0; u<n_sum; u++)
+                {
+                    const size_t* m = sum_tuples.data() + u*c;
+                    const size_t* p = P.data() + u*f*n;
+                    size_t off = 0;
+                    T sign = T(1);
+                    for(size_t a=0; a<f; a++)
+                    {
+                        off += p[a*n + i[a]];
+                    }
+                    for(size_t b=0; b<c; b++)
+                    {
+                        off += Q[b*n + m[b]];
+                        sign *= Q_sign[b*n + m[b]];
+                    }
+                    if(sign == T(0))
+                    {
+                        continue;
+                    }
+                    const T s = sign*vals[off];
+                    const T* r = R.data() + u*cols;
+                    for(size_t col=0; col<cols; col++)
+                    {
+                        g[col] += s*r[col];
+                    }
+                }
+            }
+        }, n_sum*(N+cols));
+    }
+
+    // expanded to all permutations of the free indices
+    vector<size_t> free_stride(f), free_shape(f, extent);
+    for(size_t k=0; k<f; k++)
+    {
+        free_stride[k] = result.incr[axis(idx_lhs[free_pos[k]])];
+    }
+    size_t n_dense = 1;
+    for(size_t k=0; k<f; k++)
+    {
+        n_dense *= extent;
+    }
+    T* C = result.data();
+    Parallel::parallel_for(n_dense, [&](size_t begin, size_t end)
+    {
+        vector<size_t> idx(f), sorted;
+        for(size_t k=f, rest=begin; k-- > 0; rest/=extent)
+        {
+            idx[k] = rest%extent;
+        }
+        for(size_t e=begin; e<end; e++, next_index(idx, free_shape))
+        {
+            sorted = idx;
+            const T s = sign0*canonical(sorted);
+            if(s == T(0))
+            {
+                continue;
+            }
+            size_t base = 0;
+            for(size_t k=0; k<f; k++)
+            {
+                base += idx[k]*free_stride[k];
+            }
+            const T* g = G.data() + offset(sorted.data(), f)*cols;
+            loop.run({base, 0}, [&](const Kernels::StridedLoop<2>::Offsets &off, size_t n, const Kernels::StridedLoop<2>::Offsets &stride)
+            {
+                for(size_t j=0; j<n; j++)
+                {
+                    C[off[0]+j*stride[0]] = s*g[off[1]+j*stride[1]];
+                }
+            });
+        }
+    }, cols);
+    return result;
+}
+
+template<class T>
+TensorBase<T> SymmetricTensor<T>::contract(const vector<int> &idx_lhs) const
+{
+    PROFILE_SCOPE("SymmetricTensor::contract");
+    const ContractionPlan plan(shape, idx_lhs);
+    TensorBase<T> result;
+    plan.execute(dense(), result);
+    return result;
+}
+
+/**
+    EXPLICIT TEMPLATE INSTANTIATION
+**/
+
+namespace TensorUtils
+{
+    #ifndef ENABLE_INTEGRAL_TYPES
+    #define ENABLE_INTEGRAL_TYPES 1
+    #endif // ENABLE_INTEGRAL_TYPES
+
+    template class SymmetricTensor<double>;
+    template class SymmetricTensor<float>;
+    template class SymmetricTensor<long double>;
+
+    #if ENABLE_INTEGRAL_TYPES == 1
+        template class SymmetricTensor<unsigned char>;
+        template class SymmetricTensor<signed char>;
+        template class SymmetricTensor<unsigned short>;
+        template class SymmetricTensor<short>;
+        template class SymmetricTensor<unsigned>;
+        template class SymmetricTensor<int>;
+        template class SymmetricTensor<unsigned long>;
+        template class SymmetricTensor<long>;
+        template class SymmetricTensor<unsigned long long>;
+        template class SymmetricTensor<long long>;
+    #endif
+}
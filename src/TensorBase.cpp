@@ -27,38 +27,54 @@ If not, see <https://www.gnu.org/licenses/>.
 #endif // THROW_BASIC_EXCEPTIONS
 
 #include "TensorBase.hpp"
+#include "Expression.hpp"
 #include "ErrorHandler.hpp"
+#include "ContractionPlan.hpp"
+#include "TensorView.hpp"
+#include "Permute.hpp"
+#include "BinaryFormat.hpp"
+#include "TextFormat.hpp"
+#include "ThreadPool.hpp"
+#include "Simd.hpp"
+#include "Reduce.hpp"
+#include "Profile.hpp"
 
 #include <iostream>
 #include <filesystem>
 #include <fstream>
-#include <set>
-#include <functional>
 #include <cstring>
-#include <iomanip>
+#include <algorithm>
+#include <cmath>
 
 using namespace std;
 using namespace TensorUtils;
 using namespace ErrorHandler;
 
+/**
+    ERROR HANDLING
+**/
+
+// read by the inline element access of the headers, such that the linked library selects the checks
+const bool ErrorHandler::index_checks = (THROW_EXCEPTIONS == 1);
+
 /**
     CONSTRUCTOR & DESTRUCTOR
 **/
 
 template<class T>
-TensorBase<T>::TensorBase() : vector<T>()
+TensorBase<T>::TensorBase() : vector_type()
 {
     //
 }
 
 template<class T>
-TensorBase<T>::TensorBase(const vector<size_t> &shape) : vector<T>()
+TensorBase<T>::TensorBase(const vector<size_t> &shape) : vector_type()
 {
     alloc(shape);
 }
 
 template<class T>
-TensorBase<T>::TensorBase(const vector<size_t> &shape, const T& val) : vector<T>()
+TensorBase<T>::TensorBase(const vector<size_t> &shape, const T& val) : vector_type()
 {
     alloc(shape, val);
 }
@@ -78,7 +94,7 @@ void TensorBase<T>::alloc(const vector<size_t> &shape)
 {
     if(shape.empty())
     {
-        vector<T>::resize(1); // scalar
+        vector_type::resize(1); // scalar
         this->shape.clear();
         incr.clear();
         return;
@@ -96,7 +112,7 @@ void TensorBase<T>::alloc(const vector<size_t> &shape)
         num_elems *= shape[dim+1];
     }
     num_elems *= shape.front();
-    vector<T>::resize(num_elems);
+    vector_type::resize(num_elems);
 }
 
 template<class T>
@@ -106,26 +122,24 @@ void TensorBase<T>::alloc(const vector<size_t> &shape, const T& val)
     init(val);
 }
 
-template<class T>
-void TensorBase<T>::init(const T& val)
-{
-    vector<T>::assign(vector<T>::size(), val);
-}
-
 template<class T>
 void TensorBase<T>::arange(T val)
 {
-    for(auto it=vector<T>::begin();it!=vector<T>::end();it++)
+    // closed form, such that every range can be filled independently
+    T* dst = vector_type::data();
+    Parallel::parallel_for(vector_type::size(), [&](size_t begin, size_t end)
     {
-        *it=val;
-        val++;
-    }
+        for(size_t n=begin; n<end; n++)
+        {
+            dst[n] = val + static_cast<T>(n);
+        }
+    });
 }
 
 template<class T>
 void TensorBase<T>::clear()
 {
-    vector<T>::clear();
+    vector_type::clear();
     shape.clear();
     incr.clear();
 }
@@ -143,7 +157,7 @@ void TensorBase<T>::print_helper()
         cout << *it << '\t';
     }
     cout << '\n' << '\n';
-    for(size_t n=0;n<vector<T>::size();n++)
+    for(size_t n=0;n<vector_type::size();n++)
     {
         cout << (BUFFER_TYPE)(*this)[n] << '\t';
         if(incr.empty())
@@ -184,6 +198,7 @@ void TensorBase<signed char>::print()
 template<class T>
 void TensorBase<T>::read(string path)
 {
+    PROFILE_SCOPE("TensorBase::read");
     string extension = filesystem::path(path).extension();
     if(extension == ".f32")    {read_bin<float>(path);}
     else if(extension == ".f64")    {read_bin<double>(path);}
@@ -198,10 +213,13 @@ void TensorBase<T>::read(string path)
     else if(extension == ".l")      {read_bin<long>(path);}
     else if(extension == ".ull")    {read_bin<unsigned long long>(path);}
     else if(extension == ".ll")     {read_bin<long long>(path);}
+    else if(extension == BinaryFormat::CONTAINER_EXTENSION) {read_container(path);}
+    else if(extension == BinaryFormat::COMPRESSED_EXTENSION) {read_container(path);}
     else
     {
         read_txt_helper(path);
     }
+    PROFILE_IO(filesystem::file_size(path));
 }
 
 // READ TEXT TO A BUFFER AND STORE DATA USING IMPLICIT TYPE CONVERSIONS
@@ -218,49 +236,41 @@ void TensorBase<T>::read_txt(string path)
         throw UnableToOpenFile(err_str);
     }
     string line;
-    stringstream ss;
-
     getline(in,line);
-    ss = stringstream(line);
     shape.clear();
-    size_t dummy;
-    while(ss >> dummy)
+    const char* p = line.data();
+    const char* end = p + line.size();
+    while(true)
     {
+        while(p != end && TextFormat::is_space(*p))
+        {
+            p++;
+        }
+        size_t dummy;
+        const char* next = TextFormat::parse(p, end, dummy);
+        if(next == p)
+        {
+            break;
+        }
         shape.push_back(dummy);
+        p = next;
     }
     alloc(shape);
 
     size_t idx = 0;
-    BUFFER_TYPE tmp;
     bool idx_out_of_range = false;
-    while(getline(in, line))
+    T* dst = vector_type::data();
+    const size_t n = vector_type::size();
+    TextFormat::scan<BUFFER_TYPE>(in, [&](const BUFFER_TYPE &tmp)
     {
-        ss = stringstream(line);
-        if(line == "")
-        {
-            continue;
-        }
-        else
-        {
-            while (ss >> tmp)
-            {
-                if(idx < vector<T>::size())
-                {
-                    (*this)[idx] = tmp;
-                    idx++;
-                }
-                else
-                {
-                    idx_out_of_range = true;
-                    break;
-                }
-            }
-        }
-        if(idx_out_of_range)
+        if(idx < n)
         {
-            break;
+            dst[idx++] = tmp;
+            return true;
         }
-    }
+        idx_out_of_range = true;
+        return false;
+    });
     if(idx_out_of_range)
     {
         string err_str = "TensorUtils::TensorBase<T>::read_txt:: More data than expected from shape in file \"";
@@ -268,7 +278,7 @@ void TensorBase<T>::read_txt(string path)
         err_str.append("\".");
         throw ShapeMismatch(err_str);
     }
-    if(idx<vector<T>::size())
+    if(idx<vector_type::size())
     {
         string err_str = "TensorUtils::TensorBase<T>::read_txt:: Less data than expected from shape in file \"";
         err_str.append(path);
@@ -322,32 +332,56 @@ void TensorBase<T>::read_bin(string path)
     // read data
     bool data_too_large = false;
     bool data_too_small = false;
-    if(vector<T>::size() < data_size)
+    if(vector_type::size() < data_size)
     {
         data_too_large = true;
     }
-    else if(vector<T>::size() > data_size)
+    else if(vector_type::size() > data_size)
     {
         data_too_small = true;
     }
-    size_t num_expected = vector<T>::size();
+    size_t num_expected = vector_type::size();
 
-    vector<T>::resize(data_size);
+    vector_type::resize(data_size);
 
-    vector<BUFFER_TYPE> buffer(data_size);
-    in.read((char*)&buffer[0], data_size*sizeof(BUFFER_TYPE));
-    auto it2 = vector<T>::begin();
-    for(auto it=buffer.begin(); it!= buffer.end(); it++)
+    if(is_same<T,BUFFER_TYPE>::value)
+    {
+        // single pass directly into the storage
+        in.read((char*)vector_type::data(), data_size*sizeof(T));
+    }
+    else
     {
-        *it2 = *it;
-        it2++;
+        // convert block by block to keep the additional memory bounded, large files overlap reading and conversion
+        const size_t blocks = (data_size + BinaryFormat::IO_BLOCK-1)/BinaryFormat::IO_BLOCK;
+        vector<BUFFER_TYPE> buffer[2];
+        auto transfer = [&](size_t k, unsigned b)
+        {
+            buffer[b].resize(std::min(BinaryFormat::IO_BLOCK, data_size-k*BinaryFormat::IO_BLOCK));
+            in.read((char*)buffer[b].data(), buffer[b].size()*sizeof(BUFFER_TYPE));
+        };
+        auto convert = [&](size_t k, unsigned b)
+        {
+            Simd::assign(vector_type::data()+k*BinaryFormat::IO_BLOCK, buffer[b].data(), buffer[b].size());
+        };
+        if(blocks >= BinaryFormat::PIPELINE_BLOCKS)
+        {
+            Parallel::pipeline(blocks, transfer, convert);
+        }
+        else
+        {
+            for(size_t k=0; k<blocks; k++)
+            {
+                transfer(k, 0);
+                convert(k, 0);
+            }
+        }
     }
 
     in.close();
 
     if(data_too_large)
     {
-        vector<T>::resize(num_expected);
+        vector_type::resize(num_expected);
         string err_str = "TensorUtils::TensorBase<T>::read_binary:: More data than expected from shape in file \"";
         err_str.append(path);
         err_str.append("\".");
@@ -355,7 +389,7 @@ void TensorBase<T>::read_bin(string path)
     }
     if(data_too_small)
     {
-        while(vector<T>::size()<num_expected)
+        while(vector_type::size()<num_expected)
         {
             this->push_back(0);
         }
@@ -366,6 +400,29 @@ void TensorBase<T>::read_bin(string path)
     }
 }
 
+// READ A SELF-DESCRIBING CONTAINER, COMPONENTS ARE CONVERTED FROM THE STORED TYPE
+template<class T>
+void TensorBase<T>::read_container(string path)
+{
+    BinaryFormat::ContainerReader in(path);
+    if(in.header().sparse())
+    {
+        // scatter the stored components of a sparse tensor, see SparseTensor
+        vector<uint64_t> index(in.header().count);
+        vector<T> values(in.header().count);
+        in.read_index(index.data());
+        in.read(values.data(), values.size());
+        alloc(in.header().shape, T(0));
+        for(size_t n=0; n<index.size(); n++)
+        {
+            (*this)[index[n]] = values[n];
+        }
+        return;
+    }
+    alloc(in.header().shape);
+    in.read(vector_type::data(), vector_type::size());
+}
+
 /**
     WRITE
 **/
@@ -374,6 +431,7 @@ void TensorBase<T>::read_bin(string path)
 template<class T>
 void TensorBase<T>::write(string oname, string folder)
 {
+    PROFILE_SCOPE("TensorBase::write");
     string extension = filesystem::path(oname).extension();
     if(extension == ".f32")    {write_bin<float>(oname, folder);}
     else if(extension == ".f64")    {write_bin<double>(oname, folder);}
@@ -388,10 +446,13 @@ void TensorBase<T>::write(string oname, string folder)
     else if(extension == ".l")      {write_bin<long>(oname, folder);}
     else if(extension == ".ull")    {write_bin<unsigned long long>(oname, folder);}
     else if(extension == ".ll")     {write_bin<long long>(oname, folder);}
+    else if(extension == BinaryFormat::CONTAINER_EXTENSION) {write_container(oname, folder);}
+    else if(extension == BinaryFormat::COMPRESSED_EXTENSION) {write_container(oname, folder);}
     else
     {
         write_txt(oname, folder);
     }
+    PROFILE_IO(filesystem::file_size(filesystem::path(folder)/oname));
 }
 
 template<class T>
@@ -402,17 +463,17 @@ void TensorBase<T>::write_txt(string oname, string folder)
 template<>
 void TensorBase<float>::write_txt(string oname, string folder)
 {
-    TensorBase<float>::write_txt<float>(oname, folder, numeric_limits<float>::max_digits10);
+    TensorBase<float>::write_txt<float>(oname, folder, TextFormat::SHORTEST);
 }
 template<>
 void TensorBase<double>::write_txt(string oname, string folder)
 {
-    TensorBase<double>::write_txt<double>(oname, folder, numeric_limits<double>::max_digits10);
+    TensorBase<double>::write_txt<double>(oname, folder, TextFormat::SHORTEST);
 }
 template<>
 void TensorBase<long double>::write_txt(string oname, string folder)
 {
-    TensorBase<long double>::write_txt<long double>(oname, folder, numeric_limits<long double>::max_digits10);
+    TensorBase<long double>::write_txt<long double>(oname, folder, TextFormat::SHORTEST);
 }
 template<>
 void TensorBase<unsigned char>::write_txt(string oname, string folder)
@@ -472,7 +533,9 @@ void TensorBase<T>::write_txt(
        extension==".ul"||
        extension==".l"||
        extension==".ull"||
-       extension==".ll")
+       extension==".ll"||
+       extension==BinaryFormat::CONTAINER_EXTENSION||
+       extension==BinaryFormat::COMPRESSED_EXTENSION)
     {
         throw std::runtime_error("Invalid file extension: extension for binary file format, but text file requested!");
     }
@@ -483,31 +546,54 @@ void TensorBase<T>::write_txt(
         path.append("/");
     }
     path.append(oname);
-    ofstream out;
-    out << scientific;
-    out << setprecision(precision);
-    out.open(path);
+    ofstream out(path, ios::out | ios::binary);
 
+    TextFormat::Writer writer(out);
     for(auto it=shape.begin();it!=shape.end();it++)
     {
-        out << *it << '\t';
+        writer.value(*it, 0);
+        writer.put('\t');
     }
-    out << '\n' << '\n';
-    for(size_t n=0;n<vector<T>::size();n++)
+    writer.put('\n', 2);
+
+    const T* src = vector_type::data();
+    const size_t rank = shape.size();
+    if(rank <= 1)
     {
-        out << (BUFFER_TYPE)(*this)[n] << '\t';
-        if(incr.empty())
+        // scalars and vectors are written in a single line
+        for(size_t n=0; n<vector_type::size(); n++)
         {
-            break;
+            writer.value((BUFFER_TYPE)src[n], precision);
+            writer.put('\t');
         }
-        for(auto it=incr.begin(); it!= --incr.end(); it++)
+    }
+    else
+    {
+        // each row is followed by one newline per completed sub-tensor of rank 1,...,rank-1
+        const size_t row = shape.back();
+        const size_t rows = (row == 0) ? 0 : vector_type::size()/row;
+        vector<size_t> idx(rank-1, 0);
+        for(size_t r=0; r<rows; r++, src+=row)
         {
-            if((n+1)%(*it) == 0)
+            for(size_t j=0; j<row; j++)
+            {
+                writer.value((BUFFER_TYPE)src[j], precision);
+                writer.put('\t');
+            }
+            size_t newlines = 1;
+            for(size_t dim=rank-1; dim>1; dim--)
             {
-                out << '\n';
+                if(++idx[dim-1] < shape[dim-1])
+                {
+                    break;
+                }
+                idx[dim-1] = 0;
+                newlines++;
             }
+            writer.put('\n', newlines);
         }
     }
+    writer.flush();
     out.close();
 }
 
@@ -526,7 +612,7 @@ void TensorBase<T>::write_bin(string oname, string folder)
     ofstream out(path, ios::out | ios::binary);
 
     size_t header_size = shape.size();
-    size_t data_size = vector<T>::size();
+    size_t data_size = vector_type::size();
 
     // write header
     out.write((char*)&header_size, sizeof(size_t));
@@ -534,76 +620,182 @@ void TensorBase<T>::write_bin(string oname, string folder)
     out.write((char*)&data_size, sizeof(size_t));
 
     // write data
-    vector<BUFFER_TYPE> buffer(vector<T>::size());
-    auto it2 = vector<T>::begin();
-    for(auto it=buffer.begin();it!=buffer.end();it++)
+    if(is_same<T,BUFFER_TYPE>::value)
     {
-        *it = *it2;
-        it2++;
+        // single write directly from the storage
+        out.write((const char*)vector_type::data(), data_size*sizeof(T));
+    }
+    else
+    {
+        // convert block by block to keep the additional memory bounded, large files overlap conversion and writing
+        const size_t blocks = (data_size + BinaryFormat::IO_BLOCK-1)/BinaryFormat::IO_BLOCK;
+        vector<BUFFER_TYPE> buffer[2];
+        auto convert = [&](size_t k, unsigned b)
+        {
+            buffer[b].resize(std::min(BinaryFormat::IO_BLOCK, data_size-k*BinaryFormat::IO_BLOCK));
+            Simd::assign(buffer[b].data(), vector_type::data()+k*BinaryFormat::IO_BLOCK, buffer[b].size());
+        };
+        auto transfer = [&](size_t, unsigned b)
+        {
+            out.write((const char*)buffer[b].data(), buffer[b].size()*sizeof(BUFFER_TYPE));
+        };
+        if(blocks >= BinaryFormat::PIPELINE_BLOCKS)
+        {
+            Parallel::pipeline(blocks, convert, transfer);
+        }
+        else
+        {
+            for(size_t k=0; k<blocks; k++)
+            {
+                convert(k, 0);
+                transfer(k, 0);
+            }
+        }
+    }
+
+    out.close();
+}
+
+// WRITE A SELF-DESCRIBING CONTAINER WITH THE COMPONENT TYPE OF THIS TENSOR AND CHUNK CHECKSUMS, COMPRESSED FOR ".tuz"
+template<class T>
+void TensorBase<T>::write_container(string oname, string folder)
+{
+    filesystem::create_directories(folder);
+    string path = folder;
+    if(path.back() != '/' ){
+        path.append("/");
     }
-    out.write((char*)&buffer[0], data_size*sizeof(BUFFER_TYPE));
+    path.append(oname);
 
+    const bool compressed = (filesystem::path(oname).extension() == BinaryFormat::COMPRESSED_EXTENSION);
+    BinaryFormat::ContainerWriter out(path, compressed ? BinaryFormat::make_compressed_header(BinaryFormat::dtype<T>(), shape)
+                                                       : BinaryFormat::make_header(BinaryFormat::dtype<T>(), shape, BinaryFormat::DEFAULT_CHUNK_SIZE));
+    out.write(vector_type::data(), vector_type::size());
     out.close();
 }
 
+/**
+    ASYNCHRONOUS I/O
+**/
+
+template<class T>
+future<void> TensorBase<T>::read_async(string path)
+{
+    return Parallel::submit_io([this, path](){ read(path); });
+}
+
 template<class T>
-TensorBase<T> TensorBase<T>::transpose(const vector<unsigned> &axes)
+future<void> TensorBase<T>::write_async(string oname, string folder)
+{
+    return Parallel::submit_io([this, oname, folder](){ write(oname, folder); });
+}
+
+/**
+    TRANSPOSE, SLICE & PRODUCTS
+**/
+
+// Checks the permutation axes and returns the loop over the transposed shape2 with the strides {transposed, this}.
+static Kernels::StridedLoop<2> transpose_loop(
+    const vector<size_t>    &shape,
+    const vector<size_t>    &incr,
+    const vector<unsigned>  &axes,
+    vector<size_t>          &shape2)
 {
     if(THROW_BASIC_EXCEPTIONS)
     {
-        set<unsigned> set1;
-        for(unsigned n=0; n<shape.size(); n++)
-        {
-            set1.insert(n);
-        }
-        set<unsigned> set2;
-        for(auto it=axes.begin(); it!=axes.end(); it++)
+        // every axis exactly once
+        vector<bool> seen(shape.size(), false);
+        bool valid = (axes.size() == shape.size());
+        for(auto it=axes.begin(); valid && it!=axes.end(); it++)
         {
-            set2.insert(*it);
+            valid = (*it < shape.size()) && !seen[*it];
+            if(valid)
+            {
+                seen[*it] = true;
+            }
         }
-        if( set1 != set2 )
+        if(!valid)
         {
             throw ShapeMismatch("TensorUtils::TensorBase<T>::transpose:: Axes do not match!");
         }
     }
 
-    vector<size_t> shape2;
+    shape2.clear();
     for(auto it=axes.begin(); it!=axes.end(); it++)
     {
         shape2.push_back(shape[*it]);
     }
+    vector<size_t> incr2(shape2.size());
+    size_t stride = 1;
+    for(size_t dim=shape2.size(); dim-->0;)
+    {
+        incr2[dim] = stride;
+        stride *= shape2[dim];
+    }
+
+    // iterate in the order of the result, neighbouring axes that are not swapped are merged
+    Kernels::StridedLoop<2> loop;
+    for(unsigned dim=0; dim<axes.size(); dim++)
+    {
+        loop.push_back(shape2[dim], {incr2[dim], incr[axes[dim]]});
+    }
+    loop.merge();
+    return loop;
+}
 
+template<class T>
+TensorBase<T> TensorBase<T>::transpose(const vector<unsigned> &axes) &
+{
+    PROFILE_SCOPE("TensorBase::transpose");
+    vector<size_t> shape2;
+    const Kernels::StridedLoop<2> loop = transpose_loop(shape, incr, axes, shape2);
     TensorBase<T> result(shape2);
+    Kernels::permute(loop, vector_type::data(), result.data());
+    return result;
+}
+
+template<class T>
+TensorBase<T> TensorBase<T>::transpose(const vector<unsigned> &axes) &&
+{
+    transpose_inplace(axes);
+    return std::move(*this);
+}
+
+template<class T>
+TensorBase<T>& TensorBase<T>::transpose_inplace(const vector<unsigned> &axes)
+{
+    PROFILE_SCOPE("TensorBase::transpose_inplace");
+    vector<size_t> shape2;
+    const Kernels::StridedLoop<2> loop = transpose_loop(shape, incr, axes, shape2);
+    T* data = vector_type::data();
 
-    vector<size_t> index(shape.size());
-    vector<size_t> index2(shape2.size());
-    
-    function<void(unsigned)> iterate = [&](unsigned dim2)
+    size_t n, run;
+    vector<size_t> batches;
+    if(Kernels::square_transpose(loop, n, run, batches))
     {
-        index[axes[dim2]]=0;
-        index2[dim2]=0;
-        while(index2[dim2]<shape2[dim2])
+        const size_t tiles = (n + Kernels::PermuteBlocking<T>::TILE-1)/Kernels::PermuteBlocking<T>::TILE;
+        Parallel::parallel_for(batches.size()*tiles, [&](size_t begin, size_t end)
         {
-            if( dim2 == shape2.size()-1 )
-            {
-                result(index2) = (*this)(index);
-            }
-            else
+            for(size_t t=begin; t<end; t++)
             {
-                iterate(dim2+1);
+                Kernels::swap_tiles(data + batches[t/tiles], n, run, (t%tiles)*Kernels::PermuteBlocking<T>::TILE);
             }
-            index[axes[dim2]]++;
-            index2[dim2]++;
-        }
-    };
-    iterate(0);
+        }, n*run*Kernels::PermuteBlocking<T>::TILE);
+    }
+    else if(loop.rank() > 1)
+    {
+        Kernels::permute_cycles(loop, data, vector_type::size());
+    }
+    // else: the permutation does not move any component
 
-    return result;
+    alloc(shape2);
+    return *this;
 }
 
 template<class T>
 TensorBase<T> TensorBase<T>::slice(const std::vector<size_t> &idx_at)
 {
+    PROFILE_SCOPE("TensorBase::slice");
     if(THROW_BASIC_EXCEPTIONS && idx_at.size()>= shape.size())
     {
         throw ShapeMismatch("TensorBase<T>::slice(const std::vector<unsigned>&):: Too many indices!");
@@ -620,7 +812,7 @@ TensorBase<T>& TensorBase<T>::reshape(const std::vector<size_t> &shape)
 {
     if(shape.empty())
     {
-        if(THROW_BASIC_EXCEPTIONS && 1 != vector<T>::size())
+        if(THROW_BASIC_EXCEPTIONS && 1 != vector_type::size())
         {
             throw ShapeMismatch("TensorBase<T>::reshape(const std::vector<size_t> &shape):: Shape does not match the number of components!");
         }
@@ -642,7 +834,7 @@ TensorBase<T>& TensorBase<T>::reshape(const std::vector<size_t> &shape)
             num_elems *= shape[dim+1];
         }
         num_elems *= shape.front();
-        if(THROW_BASIC_EXCEPTIONS && num_elems != vector<T>::size())
+        if(THROW_BASIC_EXCEPTIONS && num_elems != vector_type::size())
         {
             throw ShapeMismatch("TensorBase<T>::reshape(const std::vector<size_t> &shape):: Shape does not match the number of components!");
         }
@@ -650,971 +842,631 @@ TensorBase<T>& TensorBase<T>::reshape(const std::vector<size_t> &shape)
     return *this;
 }
 
+template<class T>
+TensorView<T> TensorBase<T>::view()
+{
+    return TensorView<T>(*this);
+}
+
 template<class T>
 template<class T2>
 TensorBase<T> TensorBase<T>::dot(TensorBase<T2>& B, const vector<int> &idx_lhs, const vector<int> &idx_rhs, const vector<size_t> &idx_at)
 {
-    if(THROW_BASIC_EXCEPTIONS && (shape.size()!=idx_lhs.size() || B.shape.size()!= idx_rhs.size()))
-    {
-        throw ShapeMismatch("TensorUtils::TensorBase<T>::dot:: Shape mismatch!");
-    }
+    PROFILE_SCOPE("TensorBase::dot");
+    PROFILE_ARGS(Profiler::Detail::shape_string(shape) + " x " + Profiler::Detail::shape_string(B.shape));
+    ContractionPlan plan(shape, idx_lhs, B.shape, idx_rhs, idx_at);
+    TensorBase<T> result(plan.shape());
+    plan.execute(vector_type::data(), B.data(), result.data());
+    return result;
+}
 
-    // concat axes
-    vector<int> ax_all = idx_lhs;
-    for(auto it=idx_rhs.begin(); it!=idx_rhs.end(); it++)
-    {
-        ax_all.push_back(*it);
-    }
+template<class T>
+TensorBase<T> TensorBase<T>::contract(const vector<int> &idx_lhs, const vector<size_t> &idx_at)
+{
+    PROFILE_SCOPE("TensorBase::contract");
+    PROFILE_ARGS(Profiler::Detail::shape_string(shape));
+    ContractionPlan plan(shape, idx_lhs, idx_at);
+    TensorBase<T> result(plan.shape());
+    plan.execute(vector_type::data(), result.data());
+    return result;
+}
 
-    // get final and contraction indices
-    set<int> idx_contr;
-    set<int> idx_final;
-    for(auto it=ax_all.begin(); it!=ax_all.end(); it++)
-    {
-        if(*it<0)
-        {
-            idx_contr.insert(*it);
-        }
-        else
-        {
-            idx_final.insert(*it);
-        }
-    }
+// shape of a batch of results
+static vector<size_t> batch_shape(size_t batch, const vector<size_t> &shape)
+{
+    vector<size_t> result(1, batch);
+    result.insert(result.end(), shape.begin(), shape.end());
+    return result;
+}
+
+template<class T>
+template<class T2>
+TensorBase<T> TensorBase<T>::dot_batch(
+    const TensorBase<T2>            &B,
+    const vector<int>               &idx_lhs,
+    const vector<int>               &idx_rhs,
+    const vector<vector<size_t>>    &idx_at)
+{
+    PROFILE_SCOPE("TensorBase::dot_batch");
+    PROFILE_ARGS(Profiler::Detail::shape_string(shape) + " x " + Profiler::Detail::shape_string(B.shape));
+    const size_t length = idx_at.empty() ? 0 : idx_at[0].size();
+    ContractionPlan plan(shape, idx_lhs, B.shape, idx_rhs, vector<size_t>(length, 0));
+    TensorBase<T> result(batch_shape(idx_at.size(), plan.shape()));
+    plan.execute(vector_type::data(), B.data(), result.data(), idx_at);
+    return result;
+}
+
+template<class T>
+TensorBase<T> TensorBase<T>::contract_batch(const vector<int> &idx_lhs, const vector<vector<size_t>> &idx_at)
+{
+    PROFILE_SCOPE("TensorBase::contract_batch");
+    PROFILE_ARGS(Profiler::Detail::shape_string(shape));
+    const size_t length = idx_at.empty() ? 0 : idx_at[0].size();
+    ContractionPlan plan(shape, idx_lhs, vector<size_t>(length, 0));
+    TensorBase<T> result(batch_shape(idx_at.size(), plan.shape()));
+    plan.execute(vector_type::data(), result.data(), idx_at);
+    return result;
+}
+
+template<class T>
+template<class T2>
+TensorBase<T> TensorBase<T>::dot(const TensorView<T2>& B, const vector<int> &idx_lhs, const vector<int> &idx_rhs, const vector<size_t> &idx_at)
+{
+    return TensorView<T>(*this).dot(B, idx_lhs, idx_rhs, idx_at);
+}
+
+/**
+    OPERATORS
+**/
 
-    // get idx_contr positions
-    vector<vector<unsigned>> contr_pos(idx_contr.size());
-    vector<vector<unsigned>> contr_posA(idx_contr.size());
-    vector<vector<unsigned>> contr_posB(idx_contr.size());
-    auto iter = contr_pos.begin();
-    auto iterA = contr_posA.begin();
-    auto iterB = contr_posB.begin();
-    for(auto it=idx_contr.begin();it!=idx_contr.end(); it++)
+template<class T>
+TensorBase<T>& TensorBase<T>::operator= (const std::vector<T>& rhs)
+{
+    if(vector_type::size() != rhs.size())
     {
-        for(unsigned n=0; n<ax_all.size(); n++)
-        {
-            if(*it == ax_all[n] )
-            {
-                (*iter).push_back(n);
-            }
-        }
-        for(unsigned n=0; n<idx_lhs.size(); n++)
-        {
-            if(*it == idx_lhs[n] )
-            {
-                (*iterA).push_back(n);
-            }
-        }
-        for(unsigned n=0; n<idx_rhs.size(); n++)
-        {
-            if(*it == idx_rhs[n] )
-            {
-                (*iterB).push_back(n);
-            }
-        }
-        iter++;
-        iterA++;
-        iterB++;
+        throw ShapeMismatch("TensorBase<T>::operator=(const std::vector<T>&):: Assigment with invalid number of elements!");
     }
+    vector_type::assign(rhs.begin(), rhs.end());
+    return *this;
+}
 
-    // get idx_final positions
-    vector<vector<unsigned>> final_pos(idx_final.size());
-    vector<vector<unsigned>> final_posA(idx_final.size());
-    vector<vector<unsigned>> final_posB(idx_final.size());
-    iter = final_pos.begin();
-    iterA = final_posA.begin();
-    iterB = final_posB.begin();
-    for(auto it=idx_final.begin();it!=idx_final.end(); it++)
+template<class T>    // class template
+template<class T2>   // function template
+TensorBase<T>& TensorBase<T>::operator=(const TensorBase<T2>& rhs)
+{
+    vector_type::resize(rhs.size());
+    T* dst = vector_type::data();
+    const T2* src = rhs.data();
+    Parallel::parallel_for(vector_type::size(), [&](size_t begin, size_t end)
     {
-        for(unsigned n=0; n<ax_all.size(); n++)
-        {
-            if(*it == ax_all[n] )
-            {
-                (*iter).push_back(n);
-            }
-        }
-        for(unsigned n=0; n<idx_lhs.size(); n++)
-        {
-            if(*it == idx_lhs[n] )
-            {
-                (*iterA).push_back(n);
-            }
-        }
-        for(unsigned n=0; n<idx_rhs.size(); n++)
-        {
-            if(*it == idx_rhs[n] )
-            {
-                (*iterB).push_back(n);
-            }
-        }
-        iter++;
-        iterA++;
-        iterB++;
-    }
+        Simd::assign(dst+begin, src+begin, end-begin);
+    });
+    shape = rhs.shape;
+    incr = rhs.incr;
+    return *this;
+}
 
-    // concat shapes
-    vector<size_t> shape_all = shape;
-    for(auto it=B.shape.begin();it!=B.shape.end(); it++)
+template<class T>    // class template
+template<class T2>   // function template
+TensorBase<T>& TensorBase<T>::operator=(const TensorView<T2>& rhs)
+{
+    // the view may point into this tensor
+    const char* begin = reinterpret_cast<const char*>(vector_type::data());
+    const char* end = begin + vector_type::size()*sizeof(T);
+    const char* ptr = reinterpret_cast<const char*>(rhs.data());
+    if(!less<const char*>()(ptr, begin) && less<const char*>()(ptr, end))
     {
-        shape_all.push_back(*it);
+        return operator=(rhs.copy());
     }
-    // get final shape
-    vector<size_t> shape_final;
-    for(auto it=final_pos.begin(); it!=final_pos.end(); it++)
+    alloc(rhs.shape);
+    TensorView<T>(*this).assign(rhs);
+    return *this;
+}
+
+template<class T>    // class template
+template<class T2>   // function template
+TensorBase<T>& TensorBase<T>::operator+=(const TensorBase<T2>& rhs)
+{
+    if(vector_type::size()!=rhs.size()) // broadcast
     {
-        size_t shape_0 = shape_all[ (*it)[0] ];
-        if(THROW_BASIC_EXCEPTIONS)
-        {
-            for(auto it2 = it->begin(); it2!=it->end(); it2++)
-            {
-                if(shape_0 != shape_all[ *it2 ])
-                {
-                    throw ShapeMismatch("TensorUtils::TensorBase<T>::dot:: Shape mismatch!");
-                }
-            }
-        }
-        shape_final.push_back(shape_0);
+        TensorView<T>(*this).add(TensorView<T2>(const_cast<T2*>(rhs.data()), rhs.shape, rhs.incr));
+        return *this;
     }
-    // get contraction shape
-    vector<size_t> shape_contr;
-    for(auto it=contr_pos.begin(); it!=contr_pos.end(); it++)
+    T* dst = vector_type::data();
+    const T2* src = rhs.data();
+    Parallel::parallel_for(vector_type::size(), [&](size_t begin, size_t end)
     {
-        size_t shape_0 = shape_all[ (*it)[0] ];
-        if(THROW_BASIC_EXCEPTIONS)
-        {
-            for(auto it2 = it->begin(); it2!=it->end(); it2++)
-            {
-                if(shape_0 != shape_all[ *it2 ])
-                {
-                    throw ShapeMismatch("TensorUtils::TensorBase<T>::dot:: Shape mismatch!");
-                }
-            }
-        }
-        shape_contr.push_back(shape_0);
-    }
+        Simd::add(dst+begin, src+begin, end-begin);
+    });
+    return *this;
+}
 
-    if(THROW_BASIC_EXCEPTIONS && idx_at.size()>shape_final.size())
+template<class T>    // class template
+template<class T2>   // function template
+TensorBase<T>& TensorBase<T>::operator-=(const TensorBase<T2>& rhs)
+{
+    if(vector_type::size()!=rhs.size()) // broadcast
     {
-        throw ShapeMismatch("TensorUtils::TensorBase<T>::dot:: Shape mismatch!");
+        TensorView<T>(*this).substract(TensorView<T2>(const_cast<T2*>(rhs.data()), rhs.shape, rhs.incr));
+        return *this;
     }
-
-    // result, indices and pointer to be captured by lambda functions
-    vector<size_t> index_final(shape_final.size());
-    vector<size_t> index_contr(shape_contr.size());
-    vector<size_t*> idxAptr(shape.size());
-    vector<size_t*> idxBptr(B.shape.size());
-    const unsigned dim_max = shape_final.size()-1;
-
-    // set pointer to indices
-    iterA = final_posA.begin();
-    iterB = final_posB.begin();
-    for(auto it=index_final.begin(); it!=index_final.end(); it++ )
+    T* dst = vector_type::data();
+    const T2* src = rhs.data();
+    Parallel::parallel_for(vector_type::size(), [&](size_t begin, size_t end)
     {
-        for(auto it2=iterA->begin();it2!=iterA->end();it2++)
-        {
-            idxAptr[*it2]=&(*it);
-        }
-        for(auto it2=iterB->begin();it2!=iterB->end();it2++)
-        {
-            idxBptr[*it2]=&(*it);
-        }
-        iterA++;
-        iterB++;
-    }
-    iterA = contr_posA.begin();
-    iterB = contr_posB.begin();
-    for(auto it=index_contr.begin(); it!=index_contr.end(); it++ )
-    {
-        for(auto it2=iterA->begin();it2!=iterA->end();it2++)
-        {
-            idxAptr[*it2]=&(*it);
-        }
-        for(auto it2=iterB->begin();it2!=iterB->end();it2++)
-        {
-            idxBptr[*it2]=&(*it);
-        }
-        iterA++;
-        iterB++;
-    }
+        Simd::substract(dst+begin, src+begin, end-begin);
+    });
+    return *this;
+}
 
-    shape_final.erase(shape_final.begin(), shape_final.begin()+idx_at.size());
-    TensorBase<T> result(shape_final); // to be capured
+template<class T>    // class template
+template<class T2>   // function template
+TensorBase<T>& TensorBase<T>::operator+=(const TensorView<T2>& rhs)
+{
+    TensorView<T>(*this).add(rhs);
+    return *this;
+}
 
-    function<void(unsigned, T&)> iterate_contr = [&](unsigned dim, T &buff)
-    {
-        index_contr[dim] = 0;
-        while(index_contr[dim]<shape_contr[dim])
-        {
-            if( dim == shape_contr.size()-1 )
-            {
-                buff += (*this)(idxAptr) * B(idxBptr);
-            }
-            else
-            {
-                iterate_contr(dim+1,buff);
-            }
-            index_contr[dim]++;
-        }
-    };
+template<class T>    // class template
+template<class T2>   // function template
+TensorBase<T> TensorBase<T>::operator+(const TensorView<T2>& rhs) &
+{
+    PROFILE_SCOPE("TensorBase::operator+");
+    TensorBase<T> result(*this);
+    result += rhs;
+    return result;
+}
 
-    if(idx_at.empty())
-    {
-        function<void(unsigned)> iterate = [&](unsigned dim)
-        {
-            index_final[dim] = 0;
-            while(index_final[dim]<shape_final[dim])
-            {
-                if( dim == dim_max )
-                {
-                    result(index_final) = 0.0;
-                    iterate_contr(0,result(index_final));
-                }
-                else
-                {
-                    iterate(dim+1);
-                }
-                index_final[dim]++;
-            }
-        };
-        function<void(unsigned)> iterate_no_contr = [&](unsigned dim)
-        {
-            index_final[dim] = 0;
-            while(index_final[dim]<shape_final[dim])
-            {
-                if( dim == dim_max )
-                {
-                    result(index_final) = (*this)(idxAptr) * B(idxBptr);
-                }
-                else
-                {
-                    iterate_no_contr(dim+1);
-                }
-                index_final[dim]++;
-            }
-        };
-        // sum over all final and contraction indices
-        if(shape_contr.empty())
-        {
-            if(shape_final.empty()) // return value and arguments are scalars!
-            {
-                result[0]=(*this)[0]*B[0];
-            }
-            else // return value is not a scalar and there are no indices to contract!
-            {
-                iterate_no_contr(0);
-            }
-        }
-        else if(shape_final.empty()) // return value is a scalar!
-        {
-            result[0] = 0.0;
-            iterate_contr(0,result[0]);
-        }
-        else // return value is not a scalar and there are indices to contract!
-        {
-            iterate(0);
-        }
-    }
-    else
-    {
-        vector<size_t*> index_final_ptr(index_final.size());
-        // set index_final for idx_at
-        auto iter_final = index_final.begin();
-        for(auto it=idx_at.begin(); it!=idx_at.end(); it++)
-        {
-            *iter_final = *it;
-            iter_final++;
-        }
-        // set index_final_ptr
-        auto iter_final_ptr = index_final_ptr.begin();
-        for(auto it=index_final.begin(); it!=index_final.end(); it++)
-        {
-            *iter_final_ptr = &(*it);
-            iter_final_ptr++;
-        }
-        // drop indices given by idx_at
-        index_final_ptr.erase(index_final_ptr.begin(), index_final_ptr.begin()+idx_at.size());
+template<class T>    // class template
+template<class T2>   // function template
+TensorBase<T> TensorBase<T>::operator+(const TensorView<T2>& rhs) &&
+{
+    *this += rhs;
+    return std::move(*this);
+}
 
-        function<void(unsigned)> iterate = [&](unsigned dim)
-        {
-            *index_final_ptr[dim] = 0;
-            while(*index_final_ptr[dim]<shape_final[dim])
-            {
-                if( dim == dim_max )
-                {
-                    result(index_final_ptr) = 0.0;
-                    iterate_contr(0,result(index_final_ptr));
-                }
-                else
-                {
-                    iterate(dim+1);
-                }
-                (*index_final_ptr[dim])++;
-            }
-        };
-        function<void(unsigned)> iterate_no_contr = [&](unsigned dim)
-        {
-            *index_final_ptr[dim] = 0;
-            while(*index_final_ptr[dim]<shape_final[dim])
-            {
-                if( dim == dim_max )
-                {
-                    result(index_final_ptr) = (*this)(idxAptr) * B(idxBptr);
-                }
-                else
-                {
-                    iterate_no_contr(dim+1);
-                }
-                (*index_final_ptr[dim])++;
-            }
-        };
-        // sum over all final and contraction indices
-        if(shape_contr.empty())
-        {
-            if(shape_final.empty()) // return value is a scalars!
-            {
-                result[0]=(*this)(idxAptr)*B(idxBptr);
-            }
-            else // return value is not a scalar and there are no indices to contract!
-            {
-                iterate_no_contr(0);
-            }
-        }
-        else if(shape_final.empty()) // return value is a scalar!
-        {
-            result[0] = 0.0;
-            iterate_contr(0,result[0]);
-        }
-        else // return value is not a scalar and there are indices to contract!
-        {
-            iterate(0);
-        }
-    }
+template<class T>    // class template
+template<class T2>   // function template
+TensorBase<T>& TensorBase<T>::operator-=(const TensorView<T2>& rhs)
+{
+    TensorView<T>(*this).substract(rhs);
+    return *this;
+}
 
+template<class T>    // class template
+template<class T2>   // function template
+TensorBase<T> TensorBase<T>::operator-(const TensorView<T2>& rhs) &
+{
+    PROFILE_SCOPE("TensorBase::operator-");
+    TensorBase<T> result(*this);
+    result -= rhs;
     return result;
 }
 
+template<class T>    // class template
+template<class T2>   // function template
+TensorBase<T> TensorBase<T>::operator-(const TensorView<T2>& rhs) &&
+{
+    *this -= rhs;
+    return std::move(*this);
+}
+
 template<class T>
-TensorBase<T> TensorBase<T>::contract(const vector<int> &idx_lhs, const vector<size_t> &idx_at)
+TensorBase<T>& TensorBase<T>::operator*=(const T& rhs)
 {
-    if(THROW_BASIC_EXCEPTIONS && shape.size()!=idx_lhs.size() )
+    T* dst = vector_type::data();
+    Parallel::parallel_for(vector_type::size(), [&](size_t begin, size_t end)
     {
-        throw ShapeMismatch("TensorUtils::TensorBase<T>::contract:: Shape mismatch!");
-    }
+        Simd::multiply(dst+begin, rhs, end-begin);
+    });
+    return *this;
+}
 
-    // get final and contraction indices
-    set<int> idx_contr;
-    set<int> idx_final;
-    for(auto it=idx_lhs.begin(); it!=idx_lhs.end(); it++)
+template<class T>
+TensorBase<T>& TensorBase<T>::operator/=(const T& rhs)
+{
+    T* dst = vector_type::data();
+    Parallel::parallel_for(vector_type::size(), [&](size_t begin, size_t end)
     {
-        if(*it<0)
-        {
-            idx_contr.insert(*it);
-        }
-        else
-        {
-            idx_final.insert(*it);
-        }
-    }
+        Simd::divide(dst+begin, rhs, end-begin);
+    });
+    return *this;
+}
 
-    // get idx_contr positions
-    vector<vector<unsigned>> contr_pos(idx_contr.size());
-    auto iter = contr_pos.begin();
-    for(auto it=idx_contr.begin();it!=idx_contr.end(); it++)
-    {
-        for(unsigned n=0; n<idx_lhs.size(); n++)
-        {
-            if(*it == idx_lhs[n] )
-            {
-                (*iter).push_back(n);
-            }
-        }
-        iter++;
-    }
 
-    // get idx_final positions
-    vector<vector<unsigned>> final_pos(idx_final.size());
-    iter = final_pos.begin();
-    for(auto it=idx_final.begin();it!=idx_final.end(); it++)
-    {
-        for(unsigned n=0; n<idx_lhs.size(); n++)
-        {
-            if(*it == idx_lhs[n] )
-            {
-                (*iter).push_back(n);
-            }
-        }
-        iter++;
-    }
 
-    // get final shape
-    vector<size_t> shape_final;
-    for(auto it=final_pos.begin(); it!=final_pos.end(); it++)
-    {
-        size_t shape_0 = shape[ (*it)[0] ];
-        if(THROW_BASIC_EXCEPTIONS)
-        {
-            for(auto it2 = it->begin(); it2!=it->end(); it2++)
-            {
-                if(shape_0 != shape[ *it2 ])
-                {
-                    throw ShapeMismatch("TensorUtils::TensorBase<T>::contract:: Shape mismatch!");
-                }
-            }
-        }
-        shape_final.push_back(shape_0);
-    }
-    // get contraction shape
-    vector<size_t> shape_contr;
-    for(auto it=contr_pos.begin(); it!=contr_pos.end(); it++)
+template<class T>
+template<class T2>
+TensorBase<T>& TensorBase<T>::operator<<(T2& rhs)
+{
+    if(is_same<T,T2>::value)
     {
-        size_t shape_0 = shape[ (*it)[0] ];
-        if(THROW_BASIC_EXCEPTIONS)
-        {
-            for(auto it2 = it->begin(); it2!=it->end(); it2++)
-            {
-                if(shape_0 != shape[ *it2 ])
-                {
-                    throw ShapeMismatch("TensorUtils::TensorBase<T>::contract:: Shape mismatch!");
-                }
-            }
-        }
-        shape_contr.push_back(shape_0);
+        memcpy( &((*this)[0]), &rhs, sizeof(T)*vector_type::size() );
     }
-
-    if(THROW_BASIC_EXCEPTIONS && idx_at.size()>shape_final.size())
+    else
     {
-        throw ShapeMismatch("TensorUtils::TensorBase<T>::contract:: Shape mismatch!");
+        Simd::assign(vector_type::data(), &rhs, vector_type::size());
     }
+    return *this;
+}
 
-    // result, indices and pointer to be captured by lambda functions
-    vector<size_t> index_final(shape_final.size());
-    vector<size_t> index_contr(shape_contr.size());
-    vector<size_t*> idx_ptr(shape.size());
-    const unsigned dim_max = shape_final.size()-1;
-
-    // set pointer to indices
-    iter = final_pos.begin();
-    for(auto it=index_final.begin(); it!=index_final.end(); it++ )
+template<class T>
+template<class T2>
+T2& TensorBase<T>::operator>>(T2& rhs)
+{
+    if(is_same<T,T2>::value)
     {
-        for(auto it2=iter->begin();it2!=iter->end();it2++)
-        {
-            idx_ptr[*it2]=&(*it);
-        }
-        iter++;
+        memcpy( &rhs, &((*this)[0]), sizeof(T)*vector_type::size() );
     }
-    iter = contr_pos.begin();
-    for(auto it=index_contr.begin(); it!=index_contr.end(); it++ )
+    else
     {
-        for(auto it2=iter->begin();it2!=iter->end();it2++)
-        {
-            idx_ptr[*it2]=&(*it);
-        }
-        iter++;
+        Simd::assign(&rhs, vector_type::data(), vector_type::size());
     }
+    return rhs;
+}
 
-    shape_final.erase(shape_final.begin(), shape_final.begin()+idx_at.size());
-    TensorBase<T> result(shape_final); // to be capured
-
-    function<void(unsigned, T&)> iterate_contr = [&](unsigned dim, T &buff)
-    {
-        index_contr[dim] = 0;
-        while(index_contr[dim]<shape_contr[dim])
-        {
-            if( dim == shape_contr.size()-1 )
-            {
-                buff += (*this)(idx_ptr);
-            }
-            else
-            {
-                iterate_contr(dim+1,buff);
-            }
-            index_contr[dim]++;
-        }
-    };
+template<class T>
+vector<T> TensorBase<T>::to_vector() const
+{
+    return vector<T>(vector_type::begin(), vector_type::end());
+}
 
-    if(idx_at.empty())
+void Expressions::check_size(size_t lhs, size_t rhs, const char* op)
+{
+    // checked in any build, a mismatch would read past the end of the smaller operand
+    if(lhs != rhs)
     {
-        function<void(unsigned)> iterate = [&](unsigned dim)
-        {
-            index_final[dim] = 0;
-            while(index_final[dim]<shape_final[dim])
-            {
-                if( dim == dim_max )
-                {
-                    result(index_final) = 0.0;
-                    iterate_contr(0,result(index_final));
-                }
-                else
-                {
-                    iterate(dim+1);
-                }
-                index_final[dim]++;
-            }
-        };
-        function<void(unsigned)> iterate_no_contr = [&](unsigned dim)
-        {
-            index_final[dim] = 0;
-            while(index_final[dim]<shape_final[dim])
-            {
-                if( dim == dim_max )
-                {
-                    result(index_final) = (*this)(idx_ptr);
-                }
-                else
-                {
-                    iterate_no_contr(dim+1);
-                }
-                index_final[dim]++;
-            }
-        };
-        // sum over all final and contraction indices
-        if(shape_contr.empty())
-        {
-            if(shape_final.empty()) // return value and arguments are scalars!
-            {
-                result[0]=(*this)[0];
-            }
-            else // return value is not a scalar and there are no indices to contract!
-            {
-                iterate_no_contr(0);
-            }
-        }
-        else if(shape_final.empty()) // return value is a scalar!
-        {
-            result[0] = 0.0;
-            iterate_contr(0,result[0]);
-        }
-        else // return value is not a scalar and there are indices to contract!
-        {
-            iterate(0);
-        }
+        throw ShapeMismatch(string("TensorUtils::") + op + ":: Shape mismatch: Arguments have not the same number of elements!");
     }
-    else
-    {
-        vector<size_t*> index_final_ptr(index_final.size());
-        // set index_final for idx_at
-        auto iter_final = index_final.begin();
-        for(auto it=idx_at.begin(); it!=idx_at.end(); it++)
-        {
-            *iter_final = *it;
-            iter_final++;
-        }
-        // set index_final_ptr
-        auto iter_final_ptr = index_final_ptr.begin();
-        for(auto it=index_final.begin(); it!=index_final.end(); it++)
-        {
-            *iter_final_ptr = &(*it);
-            iter_final_ptr++;
-        }
-        // drop indices given by idx_at
-        index_final_ptr.erase(index_final_ptr.begin(), index_final_ptr.begin()+idx_at.size());
+}
 
-        function<void(unsigned)> iterate = [&](unsigned dim)
-        {
-            *index_final_ptr[dim] = 0;
-            while(*index_final_ptr[dim]<shape_final[dim])
-            {
-                if( dim == dim_max )
-                {
-                    result(index_final_ptr) = 0.0;
-                    iterate_contr(0,result(index_final_ptr));
-                }
-                else
-                {
-                    iterate(dim+1);
-                }
-                (*index_final_ptr[dim])++;
-            }
-        };
-        function<void(unsigned)> iterate_no_contr = [&](unsigned dim)
-        {
-            *index_final_ptr[dim] = 0;
-            while(*index_final_ptr[dim]<shape_final[dim])
-            {
-                if( dim == dim_max )
-                {
-                    result(index_final_ptr) = (*this)(idx_ptr) ;
-                }
-                else
-                {
-                    iterate_no_contr(dim+1);
-                }
-                (*index_final_ptr[dim])++;
-            }
-        };
-        // sum over all final and contraction indices
-        if(shape_contr.empty())
-        {
-            if(shape_final.empty()) // return value is a scalars!
-            {
-                result[0]=(*this)(idx_ptr);
-            }
-            else // return value is not a scalar and there are no indices to contract!
-            {
-                iterate_no_contr(0);
-            }
-        }
-        else if(shape_final.empty()) // return value is a scalar!
-        {
-            result[0] = 0.0;
-            iterate_contr(0,result[0]);
-        }
-        else // return value is not a scalar and there are indices to contract!
-        {
-            iterate(0);
-        }
+void Expressions::check_rank(size_t rank, size_t N, const char* op)
+{
+    if(rank != N)
+    {
+        throw RankMismatch(string("TensorUtils::") + op + ":: Rank mismatch!");
     }
-
-    return result;
 }
 
 /**
-    OPERATORS
+    OPERATIONS ON SUB-TENSORS
 **/
 
-template<class T>
-TensorBase<T>& TensorBase<T>::operator= (const std::vector<T>& rhs)
+// number of components of the sub-tensor addressed by the first n_at indices
+static size_t subtensor_size(const vector<size_t> &shape, size_t n_at)
 {
-    if(vector<T>::size() != rhs.size())
+    size_t n = 1;
+    for(size_t dim=min(n_at, shape.size()); dim<shape.size(); dim++)
     {
-        throw ShapeMismatch("TensorBase<T>::operator=(const std::vector<T>&):: Assigment with invalid number of elements!");
+        n *= shape[dim];
     }
-    vector<T>::operator=(rhs);
-    return *this;
+    return n;
 }
 
-template<class T>    // class template
-template<class T2>   // function template
-TensorBase<T>& TensorBase<T>::operator=(const TensorBase<T2>& rhs)
+template<class T>
+template<class T2>
+TensorBase<T>& TensorBase<T>::assign(
+    TensorBase<T2>              &rhs,
+    const vector<size_t>   &at_lhs,
+    const vector<size_t>   &at_rhs)
 {
-    vector<T>::resize(rhs.size());
-    auto it_rhs = rhs.begin();
-    for(auto it=vector<T>::begin(); it!=vector<T>::end(); it++)
+    const size_t n_max = subtensor_size(shape, at_lhs.size());
+    if(n_max != subtensor_size(rhs.shape, at_rhs.size())) // broadcast
     {
-        *it = *it_rhs;
-        it_rhs++;
+        TensorView<T>(*this).slice(at_lhs).assign(TensorView<T2>(rhs).slice(at_rhs));
+        return *this;
     }
-    shape = rhs.shape;
-    incr = rhs.incr;
-    return *this;
-}
 
-template<class T>    // class template
-template<class T2>   // function template
-TensorBase<T>& TensorBase<T>::operator+=(const TensorBase<T2>& rhs)
-{
-    if(THROW_EXCEPTIONS && vector<T>::size()!=rhs.size())
-    {
-        throw ShapeMismatch("TensorUtils::TensorBase<T>::operator+=:: Shape mismatch: Arguments have not the same number of elements!");
-    }
-    auto it_rhs = rhs.begin();
-    for(auto it=vector<T>::begin(); it!=vector<T>::end(); it++)
+    T* lhs_ptr = &(*this)(at_lhs);
+    T2* rhs_ptr = &rhs(at_rhs);
+    Parallel::parallel_for(n_max, [&](size_t begin, size_t end)
     {
-        *it += *it_rhs;
-        it_rhs++;
-    }
+        if(is_same<T,T2>::value)
+        {
+            memcpy(lhs_ptr+begin, rhs_ptr+begin, sizeof(T)*(end-begin));
+        }
+        else
+        {
+            Simd::assign(lhs_ptr+begin, rhs_ptr+begin, end-begin);
+        }
+    });
     return *this;
 }
 
-template<class T>    // class template
-template<class T2>   // function template
-TensorBase<T> TensorBase<T>::operator+(const TensorBase<T2>& rhs)
-{
-    TensorBase<T> result(*this);
-    result += rhs;
-    return result;
-}
-
-template<class T>    // class template
-template<class T2>   // function template
-TensorBase<T>& TensorBase<T>::operator-=(const TensorBase<T2>& rhs)
+template<class T>
+template<class T2>
+TensorBase<T>& TensorBase<T>::add(
+    TensorBase<T2>              &rhs,
+    const vector<size_t>   &at_lhs,
+    const vector<size_t>   &at_rhs)
 {
-    if(THROW_EXCEPTIONS && vector<T>::size()!=rhs.size())
+    const size_t n_max = subtensor_size(shape, at_lhs.size());
+    if(n_max != subtensor_size(rhs.shape, at_rhs.size())) // broadcast
     {
-        throw ShapeMismatch("TensorUtils::TensorBase<T>::operator-=:: Shape mismatch: Arguments have not the same number of elements!");
+        TensorView<T>(*this).slice(at_lhs).add(TensorView<T2>(rhs).slice(at_rhs));
+        return *this;
     }
-    auto it_rhs = rhs.begin();
-    for(auto it=vector<T>::begin(); it!=vector<T>::end(); it++)
+
+    T* lhs_ptr = &(*this)(at_lhs);
+    T2* rhs_ptr = &rhs(at_rhs);
+    Parallel::parallel_for(n_max, [&](size_t begin, size_t end)
     {
-        *it -= *it_rhs;
-        it_rhs++;
-    }
+        Simd::add(lhs_ptr+begin, rhs_ptr+begin, end-begin);
+    });
     return *this;
 }
 
-template<class T>    // class template
-template<class T2>   // function template
-TensorBase<T> TensorBase<T>::operator-(const TensorBase<T2>& rhs)
-{
-    TensorBase<T> result(*this);
-    result -= rhs;
-    return result;
-}
-
 template<class T>
-TensorBase<T>& TensorBase<T>::operator*=(const T& rhs)
+template<class T2>
+TensorBase<T>& TensorBase<T>::substract(
+    TensorBase<T2>              &rhs,
+    const vector<size_t>   &at_lhs,
+    const vector<size_t>   &at_rhs)
 {
-    for(auto it=vector<T>::begin(); it!=vector<T>::end(); it++)
+    const size_t n_max = subtensor_size(shape, at_lhs.size());
+    if(n_max != subtensor_size(rhs.shape, at_rhs.size())) // broadcast
     {
-        *it*=rhs;
+        TensorView<T>(*this).slice(at_lhs).substract(TensorView<T2>(rhs).slice(at_rhs));
+        return *this;
     }
+
+    T* lhs_ptr = &(*this)(at_lhs);
+    T2* rhs_ptr = &rhs(at_rhs);
+    Parallel::parallel_for(n_max, [&](size_t begin, size_t end)
+    {
+        Simd::substract(lhs_ptr+begin, rhs_ptr+begin, end-begin);
+    });
     return *this;
 }
 
 template<class T>
-TensorBase<T> TensorBase<T>::operator*(const T& rhs)
+template<class T2>
+TensorBase<T>& TensorBase<T>::assign(const TensorView<T2> &rhs, const vector<size_t> &at_lhs)
 {
-    TensorBase<T> result(*this);
-    result *= rhs;
-    return result;
+    TensorView<T>(*this).slice(at_lhs).assign(rhs);
+    return *this;
 }
 
 template<class T>
-TensorBase<T>& TensorBase<T>::operator/=(const T& rhs)
+template<class T2>
+TensorBase<T>& TensorBase<T>::add(const TensorView<T2> &rhs, const vector<size_t> &at_lhs)
 {
-    for(auto it=vector<T>::begin(); it!=vector<T>::end(); it++)
-    {
-        *it/=rhs;
-    }
+    TensorView<T>(*this).slice(at_lhs).add(rhs);
     return *this;
 }
 
 template<class T>
-TensorBase<T> TensorBase<T>::operator/(const T& rhs)
+template<class T2>
+TensorBase<T>& TensorBase<T>::substract(const TensorView<T2> &rhs, const vector<size_t> &at_lhs)
 {
-    TensorBase<T> result(*this);
-    result /= rhs;
-    return result;
+    TensorView<T>(*this).slice(at_lhs).substract(rhs);
+    return *this;
 }
 
-
-
 template<class T>
-template<class T2>
-TensorBase<T>& TensorBase<T>::operator<<(T2& rhs)
+TensorBase<T>& TensorBase<T>::multiply( const T &rhs, const vector<size_t> &at_lhs)
 {
-    if(is_same<T,T2>::value)
+    T* lhs_ptr = &(*this)(at_lhs);
+    size_t n_max=1;
+    for(auto it = shape.begin()+at_lhs.size() ; it!=shape.end(); it++)
     {
-        memcpy( &((*this)[0]), &rhs, sizeof(T)*vector<T>::size() );
+        n_max*= *it;
     }
-    else
+    Parallel::parallel_for(n_max, [&](size_t begin, size_t end)
     {
-        T2* ptr = &rhs;
-        for(auto it=vector<T>::begin(); it!=vector<T>::end(); it++)
-        {
-            *ptr = *it;
-            ptr++;
-        }
-    }
+        Simd::multiply(lhs_ptr+begin, rhs, end-begin);
+    });
     return *this;
 }
 
 template<class T>
-template<class T2>
-T2& TensorBase<T>::operator>>(T2& rhs)
+TensorBase<T>& TensorBase<T>::divide( const T &rhs, const vector<size_t>   &at_lhs)
 {
-    if(is_same<T,T2>::value)
+    T* lhs_ptr = &(*this)(at_lhs);
+    size_t n_max=1;
+    for(auto it = shape.begin()+at_lhs.size() ; it!=shape.end(); it++)
     {
-        memcpy( &rhs, &((*this)[0]), sizeof(T)*vector<T>::size() );
+        n_max*= *it;
     }
-    else
+    Parallel::parallel_for(n_max, [&](size_t begin, size_t end)
     {
-        T2* ptr = &rhs;
-        for(auto it=vector<T>::begin(); it!=vector<T>::end(); it++)
-        {
-            *ptr = *it;
-            ptr++;
-        }
-    }
-    return rhs;
+        Simd::divide(lhs_ptr+begin, rhs, end-begin);
+    });
+    return *this;
 }
 
-/**
-    OPERATIONS ON SUB-TENSORS
-**/
-
-template<class T>
-template<class T2>
-TensorBase<T>& TensorBase<T>::assign(
-    TensorBase<T2>              &rhs,
-    const vector<size_t>   &at_lhs,
-    const vector<size_t>   &at_rhs)
+// offsets of the sub-tensors at all prefixes, which must have the same length of at most the rank
+static vector<size_t> prefix_offsets(
+    const vector<size_t>            &shape,
+    const vector<size_t>            &incr,
+    const vector<vector<size_t>>    &prefixes,
+    const char*                     name)
 {
-    if(THROW_EXCEPTIONS)
+    vector<size_t> offsets(prefixes.size(), 0);
+    for(size_t n=0; n<prefixes.size(); n++)
     {
-        vector<size_t> subshape_lhs(shape);
-        vector<size_t> subshape_rhs(rhs.shape);
-        subshape_lhs.erase(subshape_lhs.begin(),subshape_lhs.begin()+at_lhs.size());
-        subshape_rhs.erase(subshape_rhs.begin(),subshape_rhs.begin()+at_rhs.size());
-        size_t n_elems_lhs = 1;
-        size_t n_elems_rhs = 1;
-        for(auto it=subshape_lhs.begin(); it!=subshape_lhs.end(); it++)
-        {
-            n_elems_lhs *= *it;
-        }
-        for(auto it=subshape_rhs.begin(); it!=subshape_rhs.end(); it++)
+        if(THROW_BASIC_EXCEPTIONS && (prefixes[n].size()!=prefixes[0].size() || prefixes[n].size()>shape.size()))
         {
-            n_elems_rhs *= *it;
+            throw ShapeMismatch(string("TensorUtils::TensorBase<T>::")+name+":: All prefixes must have the same length of at most the rank!");
         }
-        if(n_elems_lhs != n_elems_rhs)
+        for(size_t dim=0; dim<prefixes[n].size(); dim++)
         {
-            throw ShapeMismatch("TensorUtils::TensorBase<T>::assign:: Shape mismatch: Arguments have not the same number of elements!");
+            if(THROW_EXCEPTIONS && prefixes[n][dim]>=shape[dim])
+            {
+                throw out_of_range(string("TensorUtils::TensorBase<T>::")+name+":: Index out of range!");
+            }
+            offsets[n] += prefixes[n][dim]*incr[dim];
         }
     }
+    return offsets;
+}
 
-    T* lhs_ptr = &(*this)(at_lhs);
-    T2* rhs_ptr = &rhs(at_rhs);
-    size_t n_max=1;
-    for(auto it = shape.begin()+at_lhs.size() ; it!=shape.end(); it++)
-    {
-        n_max*= *it;
-    }
-    if(is_same<T,T2>::value)
+// true if a sub-tensor of n components read at rhs_offsets overlaps a sub-tensor written by another entry of the batch
+static bool reads_written(const vector<size_t> &lhs_offsets, const vector<size_t> &rhs_offsets, size_t n)
+{
+    vector<pair<size_t,size_t>> written(lhs_offsets.size());
+    for(size_t j=0; j<lhs_offsets.size(); j++)
     {
-        memcpy( lhs_ptr , rhs_ptr, sizeof(T)*n_max);
+        written[j] = {lhs_offsets[j], j};
     }
-    else
+    sort(written.begin(), written.end());
+    for(size_t k=0; k<rhs_offsets.size(); k++)
     {
-        size_t n=0;
-        while(n<n_max)
+        const size_t b = rhs_offsets[k];
+        auto it = lower_bound(written.begin(), written.end(), make_pair(b >= n ? b-n+1 : 0, size_t(0)));
+        for(; it!=written.end() && it->first<b+n; it++)
         {
-            *lhs_ptr = *rhs_ptr;
-            lhs_ptr++;
-            rhs_ptr++;
-            n++;
+            if(rhs_offsets.size() == 1 ? lhs_offsets.size() > 1 : it->second != k)
+            {
+                return true;
+            }
         }
     }
-    return *this;
+    return false;
 }
 
-template<class T>
-template<class T2>
-TensorBase<T>& TensorBase<T>::add(
-    TensorBase<T2>              &rhs,
-    const vector<size_t>   &at_lhs,
-    const vector<size_t>   &at_rhs)
+// Runs kernel(lhs_offset, rhs_offset, m) on all sub-tensors of n components, where rhs_offsets holds one offset per
+// sub-tensor or a single one for all. The components of the whole batch are partitioned across threads, unless a
+// sub-tensor of lhs appears more than once or, if the operands share their storage (aliased), a sub-tensor is read
+// after another entry wrote it.
+template<class KERNEL>
+static void run_batch(const vector<size_t> &lhs_offsets, const vector<size_t> &rhs_offsets, size_t n, bool aliased, KERNEL kernel)
 {
-    if(THROW_EXCEPTIONS)
+    PROFILE_SCOPE("TensorBase::batch_update");
+    auto rows = [&](size_t begin, size_t end)
     {
-        vector<size_t> subshape_lhs(shape);
-        vector<size_t> subshape_rhs(rhs.shape);
-        subshape_lhs.erase(subshape_lhs.begin(),subshape_lhs.begin()+at_lhs.size());
-        subshape_rhs.erase(subshape_rhs.begin(),subshape_rhs.begin()+at_rhs.size());
-        size_t n_elems_lhs = 1;
-        size_t n_elems_rhs = 1;
-        for(auto it=subshape_lhs.begin(); it!=subshape_lhs.end(); it++)
-        {
-            n_elems_lhs *= *it;
-        }
-        for(auto it=subshape_rhs.begin(); it!=subshape_rhs.end(); it++)
+        while(begin < end)
         {
-            n_elems_rhs *= *it;
+            const size_t b = begin/n;
+            const size_t i = begin%n;
+            const size_t m = min(n-i, end-begin);
+            kernel(lhs_offsets[b]+i, rhs_offsets[rhs_offsets.size()==1 ? 0 : b]+i, m);
+            begin += m;
         }
-        if(n_elems_lhs != n_elems_rhs)
+    };
+    if(Parallel::num_threads() > 1)
+    {
+        vector<size_t> sorted(lhs_offsets);
+        sort(sorted.begin(), sorted.end());
+        if(adjacent_find(sorted.begin(), sorted.end()) == sorted.end() && !(aliased && reads_written(lhs_offsets, rhs_offsets, n)))
         {
-            throw ShapeMismatch("TensorUtils::TensorBase<T>::add:: Shape mismatch: Arguments have not the same number of elements!");
+            Parallel::parallel_for(lhs_offsets.size()*n, rows);
+            return;
         }
     }
+    rows(0, lhs_offsets.size()*n);
+}
 
-    T* lhs_ptr = &(*this)(at_lhs);
-    T2* rhs_ptr = &rhs(at_rhs);
-    size_t n_max=1;
-    for(auto it = shape.begin()+at_lhs.size() ; it!=shape.end(); it++)
+// validates the operands of a batched operation once and returns the number of components of each sub-tensor
+template<class T2>
+static size_t batch_setup(
+    const vector<size_t>            &shape,
+    const vector<size_t>            &incr,
+    const TensorBase<T2>            &rhs,
+    const vector<vector<size_t>>    &at_lhs,
+    const vector<vector<size_t>>    &at_rhs,
+    vector<size_t>                  &lhs_offsets,
+    vector<size_t>                  &rhs_offsets,
+    const char*                     name)
+{
+    if(THROW_BASIC_EXCEPTIONS && (at_rhs.empty() || (at_rhs.size()!=at_lhs.size() && at_rhs.size()!=1)))
     {
-        n_max*= *it;
+        throw ShapeMismatch(string("TensorUtils::TensorBase<T>::")+name+":: at_rhs must hold a single prefix or one per prefix of at_lhs!");
     }
-    size_t n=0;
-    while(n<n_max)
+    lhs_offsets = prefix_offsets(shape, incr, at_lhs, name);
+    rhs_offsets = prefix_offsets(rhs.shape, rhs.incr, at_rhs, name);
+    const size_t n = at_lhs.empty() ? 0 : subtensor_size(shape, at_lhs[0].size());
+    if(THROW_BASIC_EXCEPTIONS && !at_lhs.empty() && n != subtensor_size(rhs.shape, at_rhs[0].size()))
     {
-        *lhs_ptr += *rhs_ptr;
-        lhs_ptr++;
-        rhs_ptr++;
-        n++;
+        throw ShapeMismatch(string("TensorUtils::TensorBase<T>::")+name+":: Shape mismatch: Arguments have not the same number of elements!");
     }
-    return *this;
+    return n;
 }
 
 template<class T>
 template<class T2>
-TensorBase<T>& TensorBase<T>::substract(
-    TensorBase<T2>              &rhs,
-    const vector<size_t>   &at_lhs,
-    const vector<size_t>   &at_rhs)
+TensorBase<T>& TensorBase<T>::assign_batch(
+    const TensorBase<T2>            &rhs,
+    const vector<vector<size_t>>    &at_lhs,
+    const vector<vector<size_t>>    &at_rhs)
 {
-    if(THROW_EXCEPTIONS)
+    vector<size_t> lhs_offsets, rhs_offsets;
+    const size_t n = batch_setup(shape, incr, rhs, at_lhs, at_rhs, lhs_offsets, rhs_offsets, "assign_batch");
+    T* dst = vector_type::data();
+    const T2* src = rhs.data();
+    run_batch(lhs_offsets, rhs_offsets, n, static_cast<const void*>(&rhs) == this, [&](size_t a, size_t b, size_t m)
     {
-        vector<size_t> subshape_lhs(shape);
-        vector<size_t> subshape_rhs(rhs.shape);
-        subshape_lhs.erase(subshape_lhs.begin(),subshape_lhs.begin()+at_lhs.size());
-        subshape_rhs.erase(subshape_rhs.begin(),subshape_rhs.begin()+at_rhs.size());
-        size_t n_elems_lhs = 1;
-        size_t n_elems_rhs = 1;
-        for(auto it=subshape_lhs.begin(); it!=subshape_lhs.end(); it++)
-        {
-            n_elems_lhs *= *it;
-        }
-        for(auto it=subshape_rhs.begin(); it!=subshape_rhs.end(); it++)
+        if(is_same<T,T2>::value)
         {
-            n_elems_rhs *= *it;
+            memcpy(dst+a, src+b, sizeof(T)*m);
         }
-        if(n_elems_lhs != n_elems_rhs)
+        else
         {
-            throw ShapeMismatch("TensorUtils::TensorBase<T>::substract:: Shape mismatch: Arguments have not the same number of elements!");
+            Simd::assign(dst+a, src+b, m);
         }
-    }
+    });
+    return *this;
+}
 
-    T* lhs_ptr = &(*this)(at_lhs);
-    T2* rhs_ptr = &rhs(at_rhs);
-    size_t n_max=1;
-    for(auto it = shape.begin()+at_lhs.size() ; it!=shape.end(); it++)
-    {
-        n_max*= *it;
-    }
-    size_t n=0;
-    while(n<n_max)
-    {
-        *lhs_ptr -= *rhs_ptr;
-        lhs_ptr++;
-        rhs_ptr++;
-        n++;
-    }
+template<class T>
+template<class T2>
+TensorBase<T>& TensorBase<T>::add_batch(
+    const TensorBase<T2>            &rhs,
+    const vector<vector<size_t>>    &at_lhs,
+    const vector<vector<size_t>>    &at_rhs)
+{
+    vector<size_t> lhs_offsets, rhs_offsets;
+    const size_t n = batch_setup(shape, incr, rhs, at_lhs, at_rhs, lhs_offsets, rhs_offsets, "add_batch");
+    T* dst = vector_type::data();
+    const T2* src = rhs.data();
+    run_batch(lhs_offsets, rhs_offsets, n, static_cast<const void*>(&rhs) == this, [&](size_t a, size_t b, size_t m)
+    {
+        Simd::add(dst+a, src+b, m);
+    });
     return *this;
 }
 
 template<class T>
-TensorBase<T>& TensorBase<T>::multiply( const T &rhs, const vector<size_t> &at_lhs)
+template<class T2>
+TensorBase<T>& TensorBase<T>::substract_batch(
+    const TensorBase<T2>            &rhs,
+    const vector<vector<size_t>>    &at_lhs,
+    const vector<vector<size_t>>    &at_rhs)
+{
+    vector<size_t> lhs_offsets, rhs_offsets;
+    const size_t n = batch_setup(shape, incr, rhs, at_lhs, at_rhs, lhs_offsets, rhs_offsets, "substract_batch");
+    T* dst = vector_type::data();
+    const T2* src = rhs.data();
+    run_batch(lhs_offsets, rhs_offsets, n, static_cast<const void*>(&rhs) == this, [&](size_t a, size_t b, size_t m)
+    {
+        Simd::substract(dst+a, src+b, m);
+    });
+    return *this;
+}
+
+template<class T>
+TensorBase<T>& TensorBase<T>::multiply_batch(const T &rhs, const vector<vector<size_t>> &at_lhs)
 {
-    T* lhs_ptr = &(*this)(at_lhs);
-    size_t n_max=1;
-    for(auto it = shape.begin()+at_lhs.size() ; it!=shape.end(); it++)
-    {
-        n_max*= *it;
-    }
-    size_t n=0;
-    while(n<n_max)
+    const vector<size_t> lhs_offsets = prefix_offsets(shape, incr, at_lhs, "multiply_batch");
+    const size_t n = at_lhs.empty() ? 0 : subtensor_size(shape, at_lhs[0].size());
+    T* dst = vector_type::data();
+    run_batch(lhs_offsets, {0}, n, false, [&](size_t a, size_t, size_t m)
     {
-        *lhs_ptr *= rhs;
-        lhs_ptr++;
-        n++;
-    }
+        Simd::multiply(dst+a, rhs, m);
+    });
     return *this;
 }
 
 template<class T>
-TensorBase<T>& TensorBase<T>::divide( const T &rhs, const vector<size_t>   &at_lhs)
+TensorBase<T>& TensorBase<T>::divide_batch(const T &rhs, const vector<vector<size_t>> &at_lhs)
 {
-    T* lhs_ptr = &(*this)(at_lhs);
-    size_t n_max=1;
-    for(auto it = shape.begin()+at_lhs.size() ; it!=shape.end(); it++)
-    {
-        n_max*= *it;
-    }
-    size_t n=0;
-    while(n<n_max)
+    const vector<size_t> lhs_offsets = prefix_offsets(shape, incr, at_lhs, "divide_batch");
+    const size_t n = at_lhs.empty() ? 0 : subtensor_size(shape, at_lhs[0].size());
+    T* dst = vector_type::data();
+    run_batch(lhs_offsets, {0}, n, false, [&](size_t a, size_t, size_t m)
     {
-        *lhs_ptr /= rhs;
-        lhs_ptr++;
-        n++;
-    }
+        Simd::divide(dst+a, rhs, m);
+    });
     return *this;
 }
 
@@ -1625,6 +1477,7 @@ TensorBase<T> TensorBase<T>::plus(
     const vector<size_t>   &at_lhs,
     const vector<size_t>   &at_rhs)
 {
+    PROFILE_SCOPE("TensorBase::plus");
     TensorBase<T> result;
     result = this->slice(at_lhs);
     result.add(rhs,{},at_rhs);
@@ -1638,6 +1491,7 @@ TensorBase<T> TensorBase<T>::minus(
     const vector<size_t>   &at_lhs,
     const vector<size_t>   &at_rhs)
 {
+    PROFILE_SCOPE("TensorBase::minus");
     TensorBase<T> result;
     result = this->slice(at_lhs);
     result.substract(rhs,{},at_rhs);
@@ -1647,6 +1501,7 @@ TensorBase<T> TensorBase<T>::minus(
 template<class T>
 TensorBase<T> TensorBase<T>::product(const T &rhs, const vector<size_t> &at_lhs)
 {
+    PROFILE_SCOPE("TensorBase::product");
     TensorBase<T> result;
     result = this->slice(at_lhs);
     result *= rhs;
@@ -1656,6 +1511,7 @@ TensorBase<T> TensorBase<T>::product(const T &rhs, const vector<size_t> &at_lhs)
 template<class T>
 TensorBase<T> TensorBase<T>::quotient(const T &rhs, const vector<size_t> &at_lhs)
 {
+    PROFILE_SCOPE("TensorBase::quotient");
     TensorBase<T> result;
     result = this->slice(at_lhs);
     result /= rhs;
@@ -1663,239 +1519,194 @@ TensorBase<T> TensorBase<T>::quotient(const T &rhs, const vector<size_t> &at_lhs
 }
 
 /**
-    ACCESS ELEMENTS
+    REDUCTIONS
 **/
 
-template<class T>
-T& TensorBase<T>::operator()(const vector<size_t> &indices)
+// flags of the axes of a reduction, which must be distinct and smaller than the rank
+static vector<bool> reduced_axes(size_t rank, const vector<unsigned> &axes, const char* name)
 {
-    if(indices.empty())
-    {
-        if(THROW_EXCEPTIONS)
-        {
-            return vector<T>::at(0);
-        }
-        return (*this)[0];
-    }
-    size_t idx = 0;
-    if(THROW_EXCEPTIONS)
+    vector<bool> reduced(rank, false);
+    for(auto it=axes.begin(); it!=axes.end(); it++)
     {
-        if(indices.size()>shape.size())
+        if(THROW_BASIC_EXCEPTIONS && (*it >= rank || reduced[*it]))
         {
-            throw ShapeMismatch("TensorUtils::TensorBase<T>::operator():: Too many indices!");
-        }
-        auto it2 = incr.begin();
-        auto it3 = shape.begin();
-        for(auto it=indices.begin(); it!=indices.end(); it++)
-        {
-            idx += (*it)*(*it2);
-            if((*it)>=(*it3))
-            {
-                throw out_of_range("TensorUtils::TensorBase<T>::operator():: Index out of range!");
-            }
-            it2++;
-            it3++;
+            throw ShapeMismatch(string("TensorUtils::TensorBase<T>::")+name+":: Axes must be distinct and smaller than the rank!");
         }
+        reduced[*it] = true;
     }
-    else
+    return reduced;
+}
+
+template<class OP, class T>
+static T reduce_all(const TensorBase<T> &src)
+{
+    PROFILE_SCOPE("TensorBase::reduce");
+    T result = OP::identity();
+    if(!src.empty()) // an empty tensor has no shape, like a scalar
     {
-        auto it2 = incr.begin();
-        for(auto it=indices.begin(); it!=indices.end(); it++)
-        {
-            idx += (*it)*(*it2);
-            it2++;
-        }
+        Kernels::reduce<OP>(src.data(), src.shape, src.incr, vector<bool>(src.shape.size(), true), &result);
     }
-    return (*this)[idx];
+    return result;
 }
 
-template<class T>
-T& TensorBase<T>::operator()(const vector<size_t*> &indices)
+template<class OP, class T>
+static TensorBase<T> reduce_axes(const TensorBase<T> &src, const vector<unsigned> &axes, const char* name)
 {
-    if(indices.empty())
+    PROFILE_SCOPE("TensorBase::reduce_axes");
+    const vector<bool> reduced = reduced_axes(src.shape.size(), axes, name);
+    vector<size_t> shape;
+    for(size_t dim=0; dim<src.shape.size(); dim++)
     {
-        if(THROW_EXCEPTIONS)
+        if(!reduced[dim])
         {
-            return vector<T>::at(0);
+            shape.push_back(src.shape[dim]);
         }
-        return (*this)[0];
     }
-    size_t idx = 0;
-    if(THROW_EXCEPTIONS)
+    TensorBase<T> result(shape, OP::identity());
+    if(!src.empty())
     {
-        if(indices.size()>shape.size())
-        {
-            throw ShapeMismatch("TensorUtils::TensorBase<T>::operator():: Too many indices!");
-        }
-        auto it2 = incr.begin();
-        auto it3 = shape.begin();
-        for(auto it=indices.begin(); it!=indices.end(); it++)
-        {
-            idx += (**it)*(*it2);
-            if((**it)>=(*it3))
-            {
-                throw out_of_range("TensorUtils::TensorBase<T>::operator():: Index out of range!");
-            }
-            it2++;
-            it3++;
-        }
+        Kernels::reduce<OP>(src.data(), src.shape, src.incr, reduced, result.data());
     }
-    else
+    return result;
+}
+
+// number of components that are reduced into each component of the result
+static size_t reduced_count(const vector<size_t> &shape, const vector<unsigned> &axes)
+{
+    size_t n = 1;
+    for(auto it=axes.begin(); it!=axes.end(); it++)
     {
-        auto it2 = incr.begin();
-        for(auto it=indices.begin(); it!=indices.end(); it++)
-        {
-            idx += (**it)*(*it2);
-            it2++;
-        }
+        n *= shape[*it];
     }
-    return (*this)[idx];
+    return n;
 }
 
-template<class T>
-T& TensorBase<T>::operator()()
+// multi-index of the component at offset n in lexicographical order
+static vector<size_t> multi_index(const vector<size_t> &incr, size_t n)
 {
-    if(THROW_EXCEPTIONS)
+    vector<size_t> index(incr.size());
+    for(size_t dim=0; dim<incr.size(); dim++)
     {
-        return vector<T>::at(0);
+        index[dim] = n/incr[dim];
+        n %= incr[dim];
     }
-    return (*this)[0];
+    return index;
 }
 
 template<class T>
-T& TensorBase<T>::operator()(size_t n0)
+T TensorBase<T>::sum() const
 {
-    if(THROW_EXCEPTIONS)
-    {
-        if(1>shape.size())
-        {
-            throw ShapeMismatch("TensorUtils::TensorBase<T>::operator():: Too many indices!");
-        }
-        if(n0>=shape[0])
-        {
-            throw out_of_range("TensorUtils::TensorBase<T>::operator():: Index out of range!");
-        }
-    }
-    return (*this)[incr[0]*n0];
+    return reduce_all<Kernels::SumOp<T>>(*this);
 }
 
 template<class T>
-T& TensorBase<T>::operator()(size_t n0, size_t n1)
+TensorBase<T> TensorBase<T>::sum(const vector<unsigned> &axes) const
 {
-    if(THROW_EXCEPTIONS)
-    {
-        if(2>shape.size())
-        {
-            throw ShapeMismatch("TensorUtils::TensorBase<T>::operator():: Too many indices!");
-        }
-        if(n0>=shape[0]||n1>=shape[1])
-        {
-            throw out_of_range("TensorUtils::TensorBase<T>::operator():: Index out of range!");
-        }
-    }
-    return (*this)[incr[0]*n0+incr[1]*n1];
+    return reduce_axes<Kernels::SumOp<T>>(*this, axes, "sum");
 }
 
 template<class T>
-T& TensorBase<T>::operator()(size_t n0, size_t n1, size_t n2)
+T TensorBase<T>::mean() const
 {
-    if(THROW_EXCEPTIONS)
-    {
-        if(3>shape.size() )
-        {
-            throw ShapeMismatch("TensorUtils::TensorBase<T>::operator():: Too many indices!");
-        }
-        if(n0>=shape[0]||n1>=shape[1]||n2>=shape[2])
-        {
-            throw out_of_range("TensorUtils::TensorBase<T>::operator():: Index out of range!");
-        }
-    }
-    return (*this)[incr[0]*n0+incr[1]*n1+incr[2]*n2];
+    return sum()/static_cast<T>(vector_type::size());
 }
 
 template<class T>
-T& TensorBase<T>::operator()(size_t n0, size_t n1, size_t n2, size_t n3)
+TensorBase<T> TensorBase<T>::mean(const vector<unsigned> &axes) const
 {
-    if(THROW_EXCEPTIONS)
-    {
-        if(4>shape.size())
-        {
-            throw ShapeMismatch("TensorUtils::TensorBase<T>::operator():: Too many indices!");
-        }
-        if(n0>=shape[0]||n1>=shape[1]||n2>=shape[2]||n3>=shape[3])
-        {
-            throw out_of_range("TensorUtils::TensorBase<T>::operator():: Index out of range!");
-        }
-    }
-    return (*this)[incr[0]*n0+incr[1]*n1+incr[2]*n2+incr[3]*n3];
+    TensorBase<T> result = reduce_axes<Kernels::SumOp<T>>(*this, axes, "mean");
+    result /= static_cast<T>(reduced_count(shape, axes));
+    return result;
 }
 
 template<class T>
-T& TensorBase<T>::operator()(size_t n0, size_t n1, size_t n2, size_t n3, size_t n4)
+T TensorBase<T>::max() const
 {
-    if(THROW_EXCEPTIONS)
-    {
-        if(5>shape.size() )
-        {
-            throw ShapeMismatch("TensorUtils::TensorBase<T>::operator():: Too many indices!");
-        }
-        if(n0>=shape[0]||n1>=shape[1]||n2>=shape[2]||n3>=shape[3]||n4>=shape[4])
-        {
-            throw out_of_range("TensorUtils::TensorBase<T>::operator():: Index out of range!");
-        }
-    }
-    return (*this)[incr[0]*n0+incr[1]*n1+incr[2]*n2+incr[3]*n3+incr[4]*n4];
+    return reduce_all<Kernels::MaxOp<T>>(*this);
+}
+
+template<class T>
+TensorBase<T> TensorBase<T>::max(const vector<unsigned> &axes) const
+{
+    return reduce_axes<Kernels::MaxOp<T>>(*this, axes, "max");
+}
+
+template<class T>
+T TensorBase<T>::min() const
+{
+    return reduce_all<Kernels::MinOp<T>>(*this);
+}
+
+template<class T>
+TensorBase<T> TensorBase<T>::min(const vector<unsigned> &axes) const
+{
+    return reduce_axes<Kernels::MinOp<T>>(*this, axes, "min");
+}
+
+template<class T>
+T TensorBase<T>::norm1() const
+{
+    return reduce_all<Kernels::SumAbsOp<T>>(*this);
+}
+
+template<class T>
+TensorBase<T> TensorBase<T>::norm1(const vector<unsigned> &axes) const
+{
+    return reduce_axes<Kernels::SumAbsOp<T>>(*this, axes, "norm1");
+}
+
+template<class T>
+T TensorBase<T>::norm2() const
+{
+    return static_cast<T>(sqrt(reduce_all<Kernels::SumSquaresOp<T>>(*this)));
 }
 
 template<class T>
-T& TensorBase<T>::operator()(size_t n0, size_t n1, size_t n2, size_t n3, size_t n4, size_t n5)
+TensorBase<T> TensorBase<T>::norm2(const vector<unsigned> &axes) const
 {
-    if(THROW_EXCEPTIONS)
+    TensorBase<T> result = reduce_axes<Kernels::SumSquaresOp<T>>(*this, axes, "norm2");
+    for(auto it=result.begin(); it!=result.end(); it++)
     {
-        if(6>shape.size() )
-        {
-            throw ShapeMismatch("TensorUtils::TensorBase<T>::operator():: Too many indices!");
-        }
-        if(n0>=shape[0]||n1>=shape[1]||n2>=shape[2]||n3>=shape[3]||n4>=shape[4]||n5>=shape[5])
-        {
-            throw out_of_range("TensorUtils::TensorBase<T>::operator():: Index out of range!");
-        }
+        *it = static_cast<T>(sqrt(*it));
     }
-    return (*this)[incr[0]*n0+incr[1]*n1+incr[2]*n2+incr[3]*n3+incr[4]*n4+incr[5]*n5];
+    return result;
+}
+
+template<class T>
+T TensorBase<T>::norm_inf() const
+{
+    return reduce_all<Kernels::MaxAbsOp<T>>(*this);
+}
+
+template<class T>
+TensorBase<T> TensorBase<T>::norm_inf(const vector<unsigned> &axes) const
+{
+    return reduce_axes<Kernels::MaxAbsOp<T>>(*this, axes, "norm_inf");
 }
 
+// the extremum is found by the vectorized reduction and then located by a linear search, NaN is ignored
 template<class T>
-T& TensorBase<T>::operator()(size_t n0, size_t n1, size_t n2, size_t n3, size_t n4, size_t n5, size_t n6)
+vector<size_t> TensorBase<T>::argmax() const
 {
-    if(THROW_EXCEPTIONS)
+    if(THROW_BASIC_EXCEPTIONS && vector_type::empty())
     {
-        if(7>shape.size() )
-        {
-            throw ShapeMismatch("TensorUtils::TensorBase<T>::operator():: Too many indices!");
-        }
-        if(n0>=shape[0]||n1>=shape[1]||n2>=shape[2]||n3>=shape[3]||n4>=shape[4]||n5>=shape[5]||n6>=shape[6])
-        {
-            throw out_of_range("TensorUtils::TensorBase<T>::operator():: Index out of range!");
-        }
+        throw ShapeMismatch("TensorUtils::TensorBase<T>::argmax:: Tensor is empty!");
     }
-    return (*this)[incr[0]*n0+incr[1]*n1+incr[2]*n2+incr[3]*n3+incr[4]*n4+incr[5]*n5+incr[6]*n6];
+    const T m = max();
+    const size_t n = find(vector_type::begin(), vector_type::end(), m) - vector_type::begin();
+    return multi_index(incr, (n < vector_type::size()) ? n : 0); // 0 if all components are NaN
 }
 
 template<class T>
-T& TensorBase<T>::operator()(size_t n0, size_t n1, size_t n2, size_t n3, size_t n4, size_t n5, size_t n6, size_t n7)
+vector<size_t> TensorBase<T>::argmin() const
 {
-    if(THROW_EXCEPTIONS)
+    if(THROW_BASIC_EXCEPTIONS && vector_type::empty())
     {
-        if(8>shape.size() )
-        {
-            throw ShapeMismatch("TensorUtils::TensorBase<T>::operator():: Too many indices!");
-        }
-        if(n0>=shape[0]||n1>=shape[1]||n2>=shape[2]||n3>=shape[3]||n4>=shape[4]||n5>=shape[5]||n6>=shape[6]||n7>=shape[7])
-        {
-            throw out_of_range("TensorUtils::TensorBase<T>::operator():: Index out of range!");
-        }
+        throw ShapeMismatch("TensorUtils::TensorBase<T>::argmin:: Tensor is empty!");
     }
-    return (*this)[incr[0]*n0+incr[1]*n1+incr[2]*n2+incr[3]*n3+incr[4]*n4+incr[5]*n5+incr[6]*n6+incr[7]*n7];
+    const T m = min();
+    const size_t n = find(vector_type::begin(), vector_type::end(), m) - vector_type::begin();
+    return multi_index(incr, (n < vector_type::size()) ? n : 0); // 0 if all components are NaN
 }
 
 /**
@@ -1904,20 +1715,49 @@ T& TensorBase<T>::operator()(size_t n0, size_t n1, size_t n2, size_t n3, size_t
 
 namespace TensorUtils
 {
+    // Assignment from the same component type is the copy assignment, which GCC does not distinguish from
+    // the specialization of the converting template in an explicit instantiation. The template is therefore
+    // instantiated by returning its address, for different component types only.
+    template<class X, class Y>
+    TensorBase<X>& (TensorBase<X>::*instantiate_conversion())(const TensorBase<Y>&)
+    {
+        if constexpr(!is_same<X,Y>::value)
+        {
+            return &TensorBase<X>::template operator=<Y>;
+        }
+        else
+        {
+            return nullptr;
+        }
+    }
+
     #define INSTANTIATE_FUNCTION_TEMPLATES(X,Y) \
-    template TensorBase<X>& TensorBase<X>::operator=<Y>(const TensorBase<Y>&); \
+    template TensorBase<X>& (TensorBase<X>::*instantiate_conversion<X,Y>())(const TensorBase<Y>&); \
     template TensorBase<X>& TensorBase<X>::operator+=<Y>(const TensorBase<Y>&); \
     template TensorBase<X>& TensorBase<X>::operator-=<Y>(const TensorBase<Y>&); \
-    template TensorBase<X> TensorBase<X>::operator+<Y>(const TensorBase<Y>&); \
-    template TensorBase<X> TensorBase<X>::operator-<Y>(const TensorBase<Y>&); \
     template TensorBase<X>& TensorBase<X>::operator<<<Y>(Y& rhs); \
     template Y& TensorBase<X>::operator>><Y>(Y& rhs); \
     template TensorBase<X>& TensorBase<X>::assign(TensorBase<Y> &rhs, const vector<size_t> &at_lhs, const vector<size_t> &at_rhs); \
     template TensorBase<X>& TensorBase<X>::add(TensorBase<Y> &rhs, const vector<size_t> &at_lhs, const vector<size_t> &at_rhs); \
     template TensorBase<X>& TensorBase<X>::substract(TensorBase<Y> &rhs, const vector<size_t> &at_lhs, const vector<size_t> &at_rhs); \
+    template TensorBase<X>& TensorBase<X>::assign_batch(const TensorBase<Y>&, const vector<vector<size_t>>&, const vector<vector<size_t>>&); \
+    template TensorBase<X>& TensorBase<X>::add_batch(const TensorBase<Y>&, const vector<vector<size_t>>&, const vector<vector<size_t>>&); \
+    template TensorBase<X>& TensorBase<X>::substract_batch(const TensorBase<Y>&, const vector<vector<size_t>>&, const vector<vector<size_t>>&); \
+    template TensorBase<X> TensorBase<X>::dot_batch(const TensorBase<Y>&, const vector<int>&, const vector<int>&, const vector<vector<size_t>>&); \
     template TensorBase<X> TensorBase<X>::plus(TensorBase<Y> &rhs, const vector<size_t> &at_lhs, const vector<size_t> &at_rhs); \
     template TensorBase<X> TensorBase<X>::minus(TensorBase<Y> &rhs, const vector<size_t> &at_lhs, const vector<size_t> &at_rhs); \
     template TensorBase<X> TensorBase<X>::dot(TensorBase<Y>&, const vector<int>&, const vector<int>&, const vector<size_t>&); \
+    template TensorBase<X> TensorBase<X>::dot(const TensorView<Y>&, const vector<int>&, const vector<int>&, const vector<size_t>&); \
+    template TensorBase<X>& TensorBase<X>::operator=<Y>(const TensorView<Y>&); \
+    template TensorBase<X>& TensorBase<X>::operator+=<Y>(const TensorView<Y>&); \
+    template TensorBase<X>& TensorBase<X>::operator-=<Y>(const TensorView<Y>&); \
+    template TensorBase<X> TensorBase<X>::operator+<Y>(const TensorView<Y>&) &; \
+    template TensorBase<X> TensorBase<X>::operator-<Y>(const TensorView<Y>&) &; \
+    template TensorBase<X> TensorBase<X>::operator+<Y>(const TensorView<Y>&) &&; \
+    template TensorBase<X> TensorBase<X>::operator-<Y>(const TensorView<Y>&) &&; \
+    template TensorBase<X>& TensorBase<X>::assign(const TensorView<Y> &rhs, const vector<size_t> &at_lhs); \
+    template TensorBase<X>& TensorBase<X>::add(const TensorView<Y> &rhs, const vector<size_t> &at_lhs); \
+    template TensorBase<X>& TensorBase<X>::substract(const TensorView<Y> &rhs, const vector<size_t> &at_lhs); \
     template void TensorBase<X>::write_bin<Y>(string, string); \
     template void TensorBase<X>::print_helper<Y>(); \
     template void TensorBase<X>::read_txt<Y>(string path); \
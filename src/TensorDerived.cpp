@@ -22,6 +22,8 @@ If not, see <https://www.gnu.org/licenses/>.
 
 #include "ErrorHandler.hpp"
 
+#include <array>
+
 using namespace TensorUtils;
 using namespace ErrorHandler;
 
@@ -99,6 +101,26 @@ TensorDerived<T,-1>& TensorDerived<T,-1>::operator=(const TensorBase<T2> &rhs)
 };
 
 
+template<class T, int N>
+template<class T2>
+TensorDerived<T,N>& TensorDerived<T,N>::operator=(const TensorView<T2> &rhs)
+{
+    if(N != rhs.shape.size())
+    {
+        throw RankMismatch("TensorUtils::TensorDerived<T,N>::operator=:: Rank mismatch!");
+    }
+    TensorBase<T>::operator=(rhs);
+    return *this;
+};
+
+template<class T>
+template<class T2>
+TensorDerived<T,-1>& TensorDerived<T,-1>::operator=(const TensorView<T2> &rhs)
+{
+    TensorBase<T>::operator=(rhs);
+    return *this;
+};
+
 template<class T, int N>
 TensorDerived<T,N>& TensorDerived<T,N>::operator=(const std::vector<T> &rhs)
 {
@@ -113,6 +135,78 @@ TensorDerived<T,-1>& TensorDerived<T,-1>::operator=(const std::vector<T> &rhs)
     return *this;
 };
 
+/**
+    RANK-SPECIALIZED KERNELS
+**/
+
+// Copies src to the contiguous dst in the order of the transposed indices. The loop nest has the depth N,
+// such that the compiler can unroll the index arithmetic of small tensors.
+template<int D, int N, class T>
+static inline void transpose_kernel(
+    const std::array<size_t,N>  &shape,
+    const std::array<size_t,N>  &stride,
+    const T*                    src,
+    T*                          &dst)
+{
+    if constexpr(D == N)
+    {
+        *dst = *src;
+        dst++;
+    }
+    else
+    {
+        for(size_t n=0; n<shape[D]; n++)
+        {
+            transpose_kernel<D+1,N>(shape, stride, src+n*stride[D], dst);
+        }
+    }
+}
+
+template<class T, int N>
+TensorDerived<T,N> TensorDerived<T,N>::transpose(const std::vector<unsigned> &axes) &
+{
+    TensorDerived<T,N> result;
+    if(this->size() > SMALL_TRANSPOSE)
+    {
+        static_cast<TensorBase<T>&>(result) = TensorBase<T>::transpose(axes);
+        return result;
+    }
+
+    std::array<bool,N+1> seen{};
+    bool valid = (axes.size() == N);
+    for(auto it=axes.begin(); valid && it!=axes.end(); it++)
+    {
+        valid = (*it < N) && !seen[*it];
+        if(valid)
+        {
+            seen[*it] = true;
+        }
+    }
+    if(!valid)
+    {
+        throw ShapeMismatch("TensorUtils::TensorDerived<T,N>::transpose:: Axes do not match!");
+    }
+
+    std::array<size_t,N> shape2;
+    std::array<size_t,N> stride;
+    for(int dim=0; dim<N; dim++)
+    {
+        shape2[dim] = this->shape[axes[dim]];
+        stride[dim] = this->incr[axes[dim]];
+    }
+    result.alloc(std::vector<size_t>(shape2.begin(), shape2.end()));
+    T* dst = result.data();
+    transpose_kernel<0,N>(shape2, stride, this->data(), dst);
+    return result;
+}
+
+template<class T, int N>
+TensorDerived<T,N> TensorDerived<T,N>::transpose(const std::vector<unsigned> &axes) &&
+{
+    this->transpose_inplace(axes);
+    return std::move(*this);
+}
+
 /**
     EXPLICIT TEMPLATE INSTANTIATION
 **/
@@ -121,6 +215,7 @@ namespace TensorUtils
 {
     #define INSTANTIATE_FUNCTION_TEMPLATES(X,Y,N) \
     template TensorDerived<X,N>& TensorDerived<X,N>::operator=<Y>(const TensorBase<Y> &rhs); \
+    template TensorDerived<X,N>& TensorDerived<X,N>::operator=<Y>(const TensorView<Y> &rhs); \
 
     #define INSTANTIATE_FUNCTION_TEMPLATES1(X,Y) \
     INSTANTIATE_FUNCTION_TEMPLATES(X,Y,-1) \
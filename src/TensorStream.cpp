@@ -0,0 +1,368 @@
+/*
+TensorUtils Version 0.1
+
+Copyright 2022 Christoph Widder
+
+This file is part of TensorUtils.
+
+TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+the GNU General Public License as published by the Free Software Foundation, either
+version 3 of the License, or (at your option) any later version.
+
+TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with TensorUtils.
+If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include "TensorStream.hpp"
+#include "ErrorHandler.hpp"
+#include "BinaryFormat.hpp"
+#include "Profile.hpp"
+
+#include <algorithm>
+#include <filesystem>
+
+using namespace std;
+using namespace TensorUtils;
+using namespace ErrorHandler;
+
+// number of slabs and components per slab if the first "leading" indices are fixed
+static void split_shape(const vector<size_t> &shape, unsigned leading, size_t &slabs, size_t &slab_size, const string &caller)
+{
+    if(leading > shape.size())
+    {
+        throw ShapeMismatch(caller + ":: Number of fixed leading indices exceeds the rank!");
+    }
+    slabs = BinaryFormat::count(vector<size_t>(shape.begin(), shape.begin()+leading));
+    slab_size = BinaryFormat::count(vector<size_t>(shape.begin()+leading, shape.end()));
+}
+
+/**
+    READER
+**/
+
+template<class T>
+TensorReader<T>::TensorReader(const string &path, unsigned leading) : leading(leading), pos(0)
+{
+    const string extension = filesystem::path(path).extension();
+    if(extension != BinaryFormat::CONTAINER_EXTENSION && extension != BinaryFormat::COMPRESSED_EXTENSION &&
+       BinaryFormat::extension_dtype(extension) == BinaryFormat::DType::NONE)
+    {
+        throw runtime_error("TensorUtils::TensorReader<T>::TensorReader:: Invalid file extension: streaming requires a binary file!");
+    }
+    in.reset(new BinaryFormat::ContainerReader(path));
+    if(in->header().sparse())
+    {
+        throw runtime_error("TensorUtils::TensorReader<T>::TensorReader:: File \"" + path + "\" holds a sparse tensor, use SparseTensor<T>::read instead!");
+    }
+    split_shape(shape(), leading, slabs, slab_size, "TensorUtils::TensorReader<T>::TensorReader");
+}
+
+template<class T>
+TensorReader<T>::~TensorReader()
+{
+    //
+}
+
+template<class T>
+const vector<size_t>& TensorReader<T>::shape() const
+{
+    return in->header().shape;
+}
+
+template<class T>
+vector<size_t> TensorReader<T>::slab_shape() const
+{
+    return vector<size_t>(shape().begin()+leading, shape().end());
+}
+
+template<class T>
+size_t TensorReader<T>::num_slabs() const
+{
+    return slabs;
+}
+
+template<class T>
+size_t TensorReader<T>::tell() const
+{
+    return pos;
+}
+
+template<class T>
+void TensorReader<T>::seek(size_t n)
+{
+    if(n > slabs)
+    {
+        throw ShapeMismatch("TensorUtils::TensorReader<T>::seek:: Slab index out of range!");
+    }
+    in->seek(n*slab_size);
+    pos = n;
+}
+
+template<class T>
+bool TensorReader<T>::next(TensorBase<T> &slab)
+{
+    if(pos >= slabs)
+    {
+        return false;
+    }
+    const vector<size_t> new_shape = slab_shape();
+    if(slab.shape != new_shape)
+    {
+        slab.alloc(new_shape);
+    }
+    PROFILE_SCOPE("TensorReader::read");
+    in->read(slab.data(), slab_size);
+    PROFILE_IO(slab_size*sizeof(T));
+    pos++;
+    return true;
+}
+
+template<class T>
+void TensorReader<T>::read(TensorBase<T> &slab, const vector<size_t> &idx_at)
+{
+    if(idx_at.size() != leading)
+    {
+        throw ShapeMismatch("TensorUtils::TensorReader<T>::read:: Number of indices does not match the number of fixed leading indices!");
+    }
+    size_t n = 0;
+    for(unsigned dim=0; dim<leading; dim++)
+    {
+        if(idx_at[dim] >= shape()[dim])
+        {
+            throw ShapeMismatch("TensorUtils::TensorReader<T>::read:: Index out of range!");
+        }
+        n = n*shape()[dim] + idx_at[dim];
+    }
+    if(n != pos)
+    {
+        seek(n);
+    }
+    next(slab);
+}
+
+/**
+    WRITER
+**/
+
+template<class T>
+TensorWriter<T>::TensorWriter(const string &path, const vector<size_t> &shape, unsigned leading) :
+    full_shape(shape), leading(leading), pos(0)
+{
+    split_shape(shape, leading, slabs, slab_size, "TensorUtils::TensorWriter<T>::TensorWriter");
+
+    const string extension = filesystem::path(path).extension();
+    const BinaryFormat::DType legacy_dtype = BinaryFormat::extension_dtype(extension);
+    if(extension == BinaryFormat::CONTAINER_EXTENSION)
+    {
+        out.reset(new BinaryFormat::ContainerWriter(path, BinaryFormat::dtype<T>(), shape, BinaryFormat::DEFAULT_CHUNK_SIZE));
+    }
+    else if(extension == BinaryFormat::COMPRESSED_EXTENSION)
+    {
+        out.reset(new BinaryFormat::ContainerWriter(path, BinaryFormat::make_compressed_header(BinaryFormat::dtype<T>(), shape)));
+    }
+    else if(legacy_dtype != BinaryFormat::DType::NONE)
+    {
+        out.reset(new BinaryFormat::ContainerWriter(path, BinaryFormat::make_legacy_header(legacy_dtype, shape)));
+    }
+    else
+    {
+        throw runtime_error("TensorUtils::TensorWriter<T>::TensorWriter:: Invalid file extension: streaming requires a binary file!");
+    }
+}
+
+template<class T>
+TensorWriter<T>::~TensorWriter()
+{
+    if(out)
+    {
+        try
+        {
+            out->close();
+        }
+        catch(...)
+        {
+            //
+        }
+    }
+}
+
+template<class T>
+const vector<size_t>& TensorWriter<T>::shape() const
+{
+    return full_shape;
+}
+
+template<class T>
+vector<size_t> TensorWriter<T>::slab_shape() const
+{
+    return vector<size_t>(full_shape.begin()+leading, full_shape.end());
+}
+
+template<class T>
+size_t TensorWriter<T>::num_slabs() const
+{
+    return slabs;
+}
+
+template<class T>
+size_t TensorWriter<T>::tell() const
+{
+    return pos;
+}
+
+template<class T>
+void TensorWriter<T>::write_components(const T* src, const vector<size_t> &shape)
+{
+    if(shape != slab_shape())
+    {
+        throw ShapeMismatch("TensorUtils::TensorWriter<T>::write:: Shape of the slab does not match!");
+    }
+    if(!out || pos >= slabs)
+    {
+        throw ShapeMismatch("TensorUtils::TensorWriter<T>::write:: All slabs have already been written!");
+    }
+    PROFILE_SCOPE("TensorWriter::write");
+    out->write(src, slab_size);
+    PROFILE_IO(slab_size*sizeof(T));
+    pos++;
+}
+
+template<class T>
+void TensorWriter<T>::write(const TensorBase<T> &slab)
+{
+    write_components(slab.data(), slab.shape);
+}
+
+template<class T>
+void TensorWriter<T>::write(const TensorView<T> &slab)
+{
+    if(slab.contiguous())
+    {
+        write_components(slab.data(), slab.shape);
+    }
+    else
+    {
+        write(slab.copy());
+    }
+}
+
+template<class T>
+void TensorWriter<T>::close()
+{
+    if(out)
+    {
+        if(pos != slabs)
+        {
+            throw ShapeMismatch("TensorUtils::TensorWriter<T>::close:: Less slabs than expected from shape!");
+        }
+        out->close();
+        out.reset();
+    }
+}
+
+/**
+    PREFETCHER
+**/
+
+template<class T>
+TensorPrefetcher<T>::TensorPrefetcher(const vector<string> &paths, size_t depth) :
+    paths(paths), depth(max<size_t>(depth, 1)), started(0), pos(0)
+{
+    while(started < paths.size() && pending.size() < this->depth)
+    {
+        start_next();
+    }
+}
+
+template<class T>
+TensorPrefetcher<T>::~TensorPrefetcher()
+{
+    for(auto it=pending.begin(); it!=pending.end(); it++)
+    {
+        it->done.wait();
+    }
+}
+
+template<class T>
+size_t TensorPrefetcher<T>::size() const
+{
+    return paths.size();
+}
+
+template<class T>
+size_t TensorPrefetcher<T>::tell() const
+{
+    return pos;
+}
+
+template<class T>
+void TensorPrefetcher<T>::start_next()
+{
+    Pending p;
+    p.tensor.reset(new TensorBase<T>);
+    p.done = p.tensor->read_async(paths[started]);
+    pending.push_back(std::move(p));
+    started++;
+}
+
+template<class T>
+bool TensorPrefetcher<T>::next(TensorBase<T> &tensor)
+{
+    if(pending.empty())
+    {
+        return false;
+    }
+    Pending p = std::move(pending.front());
+    pending.pop_front();
+    pos++;
+    if(started < paths.size())
+    {
+        start_next();
+    }
+    p.done.get();
+    tensor = std::move(*p.tensor);
+    return true;
+}
+
+/**
+    EXPLICIT TEMPLATE INSTANTIATION
+**/
+
+namespace TensorUtils
+{
+    #ifndef ENABLE_INTEGRAL_TYPES
+    #define ENABLE_INTEGRAL_TYPES 1
+    #endif // ENABLE_INTEGRAL_TYPES
+
+    #define INSTANTIATE(X) \
+    template class TensorReader<X>; \
+    template class TensorWriter<X>; \
+    template class TensorPrefetcher<X>;
+
+    #if ENABLE_INTEGRAL_TYPES == 1
+        INSTANTIATE(double)
+        INSTANTIATE(float)
+        INSTANTIATE(long double)
+        INSTANTIATE(unsigned char)
+        INSTANTIATE(signed char)
+        INSTANTIATE(unsigned short)
+        INSTANTIATE(short)
+        INSTANTIATE(unsigned)
+        INSTANTIATE(int)
+        INSTANTIATE(unsigned long)
+        INSTANTIATE(long)
+        INSTANTIATE(unsigned long long)
+        INSTANTIATE(long long)
+    #else
+        INSTANTIATE(double)
+        INSTANTIATE(float)
+        INSTANTIATE(long double)
+    #endif
+
+    #undef INSTANTIATE
+}
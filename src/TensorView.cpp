@@ -0,0 +1,536 @@
+/*
+TensorUtils Version 0.1
+
+Copyright 2022 Christoph Widder
+
+This file is part of TensorUtils.
+
+TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+the GNU General Public License as published by the Free Software Foundation, either
+version 3 of the License, or (at your option) any later version.
+
+TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with TensorUtils.
+If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef THROW_EXCEPTIONS
+#define THROW_EXCEPTIONS 0
+#endif // THROW_EXCEPTIONS
+
+#ifndef THROW_BASIC_EXCEPTIONS
+#define THROW_BASIC_EXCEPTIONS 1
+#endif // THROW_BASIC_EXCEPTIONS
+
+#include "TensorView.hpp"
+#include "ErrorHandler.hpp"
+#include "ContractionPlan.hpp"
+#include "Permute.hpp"
+#include "ThreadPool.hpp"
+#include "Simd.hpp"
+
+#include <functional>
+#include <set>
+#include <utility>
+
+using namespace std;
+using namespace TensorUtils;
+using namespace ErrorHandler;
+
+/**
+    CONSTRUCTORS
+**/
+
+template<class T>
+TensorView<T>::TensorView() : ptr(nullptr)
+{
+    //
+}
+
+template<class T>
+TensorView<T>::TensorView(TensorBase<T> &tensor) : shape(tensor.shape), incr(tensor.incr), ptr(tensor.data())
+{
+    //
+}
+
+template<class T>
+TensorView<T>::TensorView(T* data, const vector<size_t> &shape, const vector<size_t> &incr) : shape(shape), incr(incr), ptr(data)
+{
+    if(THROW_BASIC_EXCEPTIONS && shape.size()!=incr.size())
+    {
+        throw ShapeMismatch("TensorUtils::TensorView<T>::TensorView:: Shape and strides have different ranks!");
+    }
+}
+
+/**
+    METADATA
+**/
+
+template<class T>
+T* TensorView<T>::data() const
+{
+    return ptr;
+}
+
+template<class T>
+size_t TensorView<T>::size() const
+{
+    size_t n = 1;
+    for(auto it=shape.begin(); it!=shape.end(); it++)
+    {
+        n *= *it;
+    }
+    return n;
+}
+
+template<class T>
+bool TensorView<T>::contiguous() const
+{
+    size_t stride = 1;
+    for(unsigned dim=shape.size(); dim>0; dim--)
+    {
+        if(shape[dim-1] == 0)
+        {
+            return true;
+        }
+        if(shape[dim-1] != 1 && incr[dim-1] != stride)
+        {
+            return false;
+        }
+        stride *= shape[dim-1];
+    }
+    return true;
+}
+
+template<class T>
+TensorView<T> TensorView<T>::slice(const vector<size_t> &idx_at) const
+{
+    if(THROW_BASIC_EXCEPTIONS && idx_at.size()>shape.size())
+    {
+        throw ShapeMismatch("TensorUtils::TensorView<T>::slice:: Too many indices!");
+    }
+    TensorView<T> result(*this);
+    for(unsigned n=0; n<idx_at.size(); n++)
+    {
+        if(THROW_EXCEPTIONS && idx_at[n]>=shape[n])
+        {
+            throw out_of_range("TensorUtils::TensorView<T>::slice:: Index out of range!");
+        }
+        result.ptr += idx_at[n]*incr[n];
+    }
+    result.shape.erase(result.shape.begin(), result.shape.begin()+idx_at.size());
+    result.incr.erase(result.incr.begin(), result.incr.begin()+idx_at.size());
+    return result;
+}
+
+template<class T>
+TensorView<T> TensorView<T>::transpose(const vector<unsigned> &axes) const
+{
+    if(THROW_BASIC_EXCEPTIONS)
+    {
+        set<unsigned> set1;
+        for(unsigned n=0; n<shape.size(); n++)
+        {
+            set1.insert(n);
+        }
+        set<unsigned> set2(axes.begin(), axes.end());
+        if(set1 != set2 || axes.size() != shape.size())
+        {
+            throw ShapeMismatch("TensorUtils::TensorView<T>::transpose:: Axes do not match!");
+        }
+    }
+    TensorView<T> result(*this);
+    for(unsigned dim=0; dim<axes.size(); dim++)
+    {
+        result.shape[dim] = shape[axes[dim]];
+        result.incr[dim] = incr[axes[dim]];
+    }
+    return result;
+}
+
+template<class T>
+TensorView<T> TensorView<T>::reshape(const vector<size_t> &shape) const
+{
+    TensorView<T> result(ptr, shape, vector<size_t>(shape.size()));
+    if(THROW_BASIC_EXCEPTIONS && (!contiguous() || result.size()!=size()))
+    {
+        throw ShapeMismatch("TensorUtils::TensorView<T>::reshape:: Only contiguous views with the same number of components can be reshaped!");
+    }
+    size_t stride = 1;
+    for(unsigned dim=shape.size(); dim>0; dim--)
+    {
+        result.incr[dim-1] = stride;
+        stride *= shape[dim-1];
+    }
+    return result;
+}
+
+template<class T>
+TensorView<T> TensorView<T>::range(unsigned axis, size_t begin, size_t end) const
+{
+    if(THROW_BASIC_EXCEPTIONS && (axis>=shape.size() || begin>end || end>shape[axis]))
+    {
+        throw ShapeMismatch("TensorUtils::TensorView<T>::range:: Invalid range!");
+    }
+    TensorView<T> result(*this);
+    result.ptr += begin*incr[axis];
+    result.shape[axis] = end-begin;
+    return result;
+}
+
+template<class T>
+TensorView<T> TensorView<T>::broadcast(const vector<size_t> &shape) const
+{
+    // the extents are aligned at the last index, missing leading indices and extents 1 are repeated with stride 0
+    if(THROW_BASIC_EXCEPTIONS && !broadcastable(shape))
+    {
+        throw ShapeMismatch("TensorUtils::TensorView<T>::broadcast:: Shape can not be broadcast!");
+    }
+    TensorView<T> result(ptr, shape, vector<size_t>(shape.size(), 0));
+    const size_t lead = shape.size()-this->shape.size();
+    for(unsigned dim=0; dim<this->shape.size(); dim++)
+    {
+        if(this->shape[dim] == shape[lead+dim])
+        {
+            result.incr[lead+dim] = incr[dim];
+        }
+    }
+    return result;
+}
+
+template<class T>
+bool TensorView<T>::broadcastable(const vector<size_t> &shape) const
+{
+    if(this->shape.size() > shape.size())
+    {
+        return false;
+    }
+    const size_t lead = shape.size()-this->shape.size();
+    for(unsigned dim=0; dim<this->shape.size(); dim++)
+    {
+        if(this->shape[dim] != shape[lead+dim] && this->shape[dim] != 1)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+template<class T>
+TensorBase<T> TensorView<T>::copy() const
+{
+    TensorBase<T> result(shape);
+    Kernels::StridedLoop<2> loop;
+    for(unsigned dim=0; dim<shape.size(); dim++)
+    {
+        loop.push_back(shape[dim], {result.incr[dim], incr[dim]});
+    }
+    loop.merge();
+    Kernels::permute(loop, (const T*)ptr, result.data());
+    return result;
+}
+
+/**
+    TENSOR PRODUCTS
+**/
+
+template<class T>
+template<class T2>
+TensorBase<T> TensorView<T>::dot(
+    const TensorView<T2>    &rhs,
+    const vector<int>       &idx_lhs,
+    const vector<int>       &idx_rhs,
+    const vector<size_t>    &idx_at) const
+{
+    ContractionPlan plan(shape, incr, idx_lhs, rhs.shape, rhs.incr, idx_rhs, idx_at);
+    TensorBase<T> result(plan.shape());
+    plan.execute((const T*)ptr, (const T2*)rhs.data(), result.data());
+    return result;
+}
+
+template<class T>
+TensorBase<T> TensorView<T>::contract(const vector<int> &idx_lhs, const vector<size_t> &idx_at) const
+{
+    ContractionPlan plan(shape, incr, idx_lhs, idx_at);
+    TensorBase<T> result(plan.shape());
+    plan.execute((const T*)ptr, result.data());
+    return result;
+}
+
+/**
+    ELEMENT-WISE OPERATIONS
+**/
+
+// Runs the loop concurrently unless the destination (operand 0) visits a component more than once.
+template<unsigned K, class KERNEL>
+static void run_elementwise(const Kernels::StridedLoop<K> &loop, KERNEL &&kernel)
+{
+    for(size_t dim=0; dim<loop.rank(); dim++)
+    {
+        if(loop.stride(dim)[0] == 0 && loop.extent(dim) > 1)
+        {
+            loop.run(typename Kernels::StridedLoop<K>::Offsets{}, kernel);
+            return;
+        }
+    }
+    Parallel::parallel_run(loop, typename Kernels::StridedLoop<K>::Offsets{}, kernel);
+}
+
+// first and one past the last byte addressed by a view
+template<class T>
+static pair<const char*, const char*> storage_range(const TensorView<T> &view)
+{
+    size_t last = 0;
+    for(unsigned dim=0; dim<view.shape.size(); dim++)
+    {
+        last += (view.shape[dim]-1)*view.incr[dim];
+    }
+    const char* begin = reinterpret_cast<const char*>(view.data());
+    return {begin, begin + (last+1)*sizeof(T)};
+}
+
+// true if the operands share storage and a component may be read after another component of lhs was written to it
+template<class T, class T2>
+static bool overlaps(const TensorView<T> &lhs, const TensorView<T2> &rhs)
+{
+    if(lhs.size() == 0 || rhs.size() == 0)
+    {
+        return false;
+    }
+    // identical mappings only read the component that is written, e.g. V.add(V)
+    if(is_same<T,T2>::value && static_cast<const void*>(lhs.data()) == static_cast<const void*>(rhs.data())
+       && lhs.shape == rhs.shape && lhs.incr == rhs.incr)
+    {
+        return false;
+    }
+    const pair<const char*, const char*> L = storage_range(lhs);
+    const pair<const char*, const char*> R = storage_range(rhs);
+    return less<const char*>()(L.first, R.second) && less<const char*>()(R.first, L.second);
+}
+
+// Applies op(lhs_component, rhs_component) to all pairs of components and contiguous(lhs_ptr, rhs_ptr, n) to contiguous rows.
+// Operands of different shapes with the same number of components are matched in lexicographical order by reshaping the
+// contiguous one. Otherwise rhs is broadcast to the shape of lhs and its repeated components are visited with stride 0.
+// If rhs may point into the components of lhs, e.g. for Y += Y.view().transpose({1,0}), it is copied first.
+template<class T, class T2, class OP, class CONTIGUOUS>
+static void apply_elementwise(const TensorView<T> &lhs, const TensorView<T2> &rhs, OP op, CONTIGUOUS contiguous, const char* name)
+{
+    if(overlaps(lhs, rhs))
+    {
+        TensorBase<T2> tmp = rhs.copy();
+        apply_elementwise(lhs, TensorView<T2>(tmp), op, contiguous, name);
+        return;
+    }
+    TensorView<T> L(lhs);
+    TensorView<T2> R(rhs);
+    if(L.shape != R.shape)
+    {
+        if(L.size() != R.size())
+        {
+            if(THROW_BASIC_EXCEPTIONS && !R.broadcastable(L.shape))
+            {
+                throw ShapeMismatch(string("TensorUtils::TensorView<T>::")+name+":: Shape mismatch: Arguments have not the same number of elements and can not be broadcast!");
+            }
+            R = R.broadcast(L.shape);
+        }
+        else if(R.contiguous())
+        {
+            R = R.reshape(L.shape);
+        }
+        else if(L.contiguous())
+        {
+            L = L.reshape(R.shape);
+        }
+        else
+        {
+            throw ShapeMismatch(string("TensorUtils::TensorView<T>::")+name+":: Shape mismatch: Non-contiguous arguments must have the same shape!");
+        }
+    }
+
+    Kernels::StridedLoop<2> loop;
+    for(unsigned dim=0; dim<L.shape.size(); dim++)
+    {
+        loop.push_back(L.shape[dim], {L.incr[dim], R.incr[dim]});
+    }
+    loop.merge();
+
+    T* dst = L.data();
+    const T2* src = R.data();
+    run_elementwise(loop, [&](const array<size_t,2> &off, size_t n, const array<size_t,2> &stride)
+    {
+        T* d = dst+off[0];
+        const T2* s = src+off[1];
+        if(stride[0] == 1 && stride[1] == 1)
+        {
+            contiguous(d, s, n);
+        }
+        else if(stride[0] == 1 && stride[1] == 0) // broadcast component
+        {
+            const T2 val = *s;
+            for(size_t i=0; i<n; i++)
+            {
+                op(d[i], val);
+            }
+        }
+        else
+        {
+            for(size_t i=0; i<n; i++)
+            {
+                op(d[i*stride[0]], s[i*stride[1]]);
+            }
+        }
+    });
+}
+
+// Applies op(component) to all components and contiguous(ptr, n) to contiguous rows.
+template<class T, class OP, class CONTIGUOUS>
+static void apply_elementwise(const TensorView<T> &lhs, OP op, CONTIGUOUS contiguous)
+{
+    Kernels::StridedLoop<1> loop;
+    for(unsigned dim=0; dim<lhs.shape.size(); dim++)
+    {
+        loop.push_back(lhs.shape[dim], {lhs.incr[dim]});
+    }
+    loop.merge();
+
+    T* dst = lhs.data();
+    run_elementwise(loop, [&](const array<size_t,1> &off, size_t n, const array<size_t,1> &stride)
+    {
+        T* d = dst+off[0];
+        if(stride[0] == 1)
+        {
+            contiguous(d, n);
+        }
+        else
+        {
+            for(size_t i=0; i<n; i++)
+            {
+                op(d[i*stride[0]]);
+            }
+        }
+    });
+}
+
+template<class T>
+template<class T2>
+TensorView<T>& TensorView<T>::assign(const TensorView<T2> &rhs)
+{
+    apply_elementwise(*this, rhs, [](T &a, const T2 &b){ a = b; },
+        [](T* a, const T2* b, size_t n){ Simd::assign(a, b, n); }, "assign");
+    return *this;
+}
+
+template<class T>
+template<class T2>
+TensorView<T>& TensorView<T>::add(const TensorView<T2> &rhs)
+{
+    apply_elementwise(*this, rhs, [](T &a, const T2 &b){ a += b; },
+        [](T* a, const T2* b, size_t n){ Simd::add(a, b, n); }, "add");
+    return *this;
+}
+
+template<class T>
+template<class T2>
+TensorView<T>& TensorView<T>::substract(const TensorView<T2> &rhs)
+{
+    apply_elementwise(*this, rhs, [](T &a, const T2 &b){ a -= b; },
+        [](T* a, const T2* b, size_t n){ Simd::substract(a, b, n); }, "substract");
+    return *this;
+}
+
+template<class T>
+template<class T2>
+TensorView<T>& TensorView<T>::operator+=(const TensorView<T2> &rhs)
+{
+    return add(rhs);
+}
+
+template<class T>
+template<class T2>
+TensorView<T>& TensorView<T>::operator-=(const TensorView<T2> &rhs)
+{
+    return substract(rhs);
+}
+
+template<class T>
+TensorView<T>& TensorView<T>::operator*=(const T &rhs)
+{
+    apply_elementwise(*this, [&rhs](T &a){ a *= rhs; }, [&rhs](T* a, size_t n){ Simd::multiply(a, rhs, n); });
+    return *this;
+}
+
+template<class T>
+TensorView<T>& TensorView<T>::operator/=(const T &rhs)
+{
+    apply_elementwise(*this, [&rhs](T &a){ a /= rhs; }, [&rhs](T* a, size_t n){ Simd::divide(a, rhs, n); });
+    return *this;
+}
+
+/**
+    EXPLICIT TEMPLATE INSTANTIATION
+**/
+
+namespace TensorUtils
+{
+    #define INSTANTIATE_FUNCTION_TEMPLATES(X,Y) \
+    template TensorBase<X> TensorView<X>::dot(const TensorView<Y>&, const vector<int>&, const vector<int>&, const vector<size_t>&) const; \
+    template TensorView<X>& TensorView<X>::assign<Y>(const TensorView<Y>&); \
+    template TensorView<X>& TensorView<X>::add<Y>(const TensorView<Y>&); \
+    template TensorView<X>& TensorView<X>::substract<Y>(const TensorView<Y>&); \
+    template TensorView<X>& TensorView<X>::operator+=<Y>(const TensorView<Y>&); \
+    template TensorView<X>& TensorView<X>::operator-=<Y>(const TensorView<Y>&); \
+
+    #define INSTANTIATE_ALL(X) \
+    template class TensorView<X>; \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,double) \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,float) \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,long double) \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,unsigned char) \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,signed char) \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,unsigned short) \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,short) \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,unsigned) \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,int) \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,unsigned long) \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,long) \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,unsigned long long) \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,long long) \
+
+    #define INSTANTIATE_FLOATING_POINT_TYPES(X) \
+    template class TensorView<X>; \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,double) \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,float) \
+    INSTANTIATE_FUNCTION_TEMPLATES(X,long double)
+
+    #ifndef ENABLE_INTEGRAL_TYPES
+    #define ENABLE_INTEGRAL_TYPES 1
+    #endif // ENABLE_INTEGRAL_TYPES
+
+    #if ENABLE_INTEGRAL_TYPES == 1
+        INSTANTIATE_ALL(double)
+        INSTANTIATE_ALL(float)
+        INSTANTIATE_ALL(long double)
+        INSTANTIATE_ALL(unsigned char)
+        INSTANTIATE_ALL(signed char)
+        INSTANTIATE_ALL(unsigned short)
+        INSTANTIATE_ALL(short)
+        INSTANTIATE_ALL(unsigned)
+        INSTANTIATE_ALL(int)
+        INSTANTIATE_ALL(unsigned long)
+        INSTANTIATE_ALL(long)
+        INSTANTIATE_ALL(unsigned long long)
+        INSTANTIATE_ALL(long long)
+    #else
+        INSTANTIATE_FLOATING_POINT_TYPES(double)
+        INSTANTIATE_FLOATING_POINT_TYPES(float)
+        INSTANTIATE_FLOATING_POINT_TYPES(long double)
+    #endif
+
+    #undef INSTANTIATE_ALL
+    #undef INSTANTIATE_FLOATING_POINT_TYPES
+    #undef INSTANTIATE_FUNCTION_TEMPLATES
+}
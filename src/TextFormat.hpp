@@ -0,0 +1,245 @@
+/*
+TensorUtils Version 0.1
+
+Copyright 2022 Christoph Widder
+
+This file is part of TensorUtils.
+
+TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+the GNU General Public License as published by the Free Software Foundation, either
+version 3 of the License, or (at your option) any later version.
+
+TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with TensorUtils.
+If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef TEXTFORMAT_HPP
+#define TEXTFORMAT_HPP
+
+#include <charconv>
+#include <cstddef>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace TensorUtils
+{
+    namespace TextFormat
+    {
+        /*
+            Locale independent text I/O of the format described in TensorBase<T>::read.
+            Values are parsed with std::from_chars and formatted with std::to_chars from large
+            blocks instead of one stream operation per value.
+        */
+
+        // size of the blocks that are read or written at once
+        constexpr size_t IO_BUFFER = size_t(1)<<20;
+
+        // precision for the shortest representation that is read back exactly
+        constexpr int SHORTEST = -1;
+
+        inline bool is_space(char c)
+        {
+            return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+        }
+
+        /*
+            Parses the longest prefix of the token [first,last) that is a value of type B, like operator>> does.
+            Returns the end of the prefix, which is first if there is none.
+        */
+        template<class B>
+        const char* parse(const char* first, const char* last, B &value)
+        {
+            const char* p = first;
+            if(p != last && *p == '+')
+            {
+                p++;
+            }
+            if constexpr(std::is_floating_point<B>::value)
+            {
+                auto res = std::from_chars(p, last, value, std::chars_format::general);
+                return res.ec == std::errc() ? res.ptr : first;
+            }
+            else
+            {
+                if constexpr(std::is_unsigned<B>::value)
+                {
+                    if(p != last && *p == '-')
+                    {
+                        // operator>> accepts negative values for unsigned types and wraps them around
+                        long long tmp;
+                        auto res = std::from_chars(p, last, tmp);
+                        if(res.ec != std::errc())
+                        {
+                            return first;
+                        }
+                        value = static_cast<B>(tmp);
+                        return res.ptr;
+                    }
+                }
+                auto res = std::from_chars(p, last, value);
+                return res.ec == std::errc() ? res.ptr : first;
+            }
+        }
+
+        /*
+            Parses all remaining whitespace separated values of the stream and passes them to store(value),
+            which returns false to stop. If a token is not a value or only its prefix is one, the rest of the line
+            is ignored, which matches the previous line-by-line extraction with operator>>.
+        */
+        template<class B, class F>
+        void scan(std::istream &in, F store)
+        {
+            std::vector<char> buffer(IO_BUFFER);
+            size_t have = 0;
+            bool skip_line = false;
+            while(true)
+            {
+                in.read(buffer.data()+have, buffer.size()-have);
+                have += in.gcount();
+                const bool eof = !in;
+
+                const char* p = buffer.data();
+                const char* end = p + have;
+                // a token at the end of the block may continue in the next block
+                const char* safe = end;
+                if(!eof)
+                {
+                    while(safe != p && !is_space(safe[-1]))
+                    {
+                        safe--;
+                    }
+                    if(safe == p)
+                    {
+                        buffer.resize(2*buffer.size());
+                        continue;
+                    }
+                }
+
+                while(p != safe)
+                {
+                    if(skip_line)
+                    {
+                        const char* nl = static_cast<const char*>(std::memchr(p, '\n', safe-p));
+                        if(!nl)
+                        {
+                            p = safe;
+                            break;
+                        }
+                        p = nl+1;
+                        skip_line = false;
+                    }
+                    while(p != safe && is_space(*p))
+                    {
+                        p++;
+                    }
+                    if(p == safe)
+                    {
+                        break;
+                    }
+                    const char* token_end = p;
+                    while(token_end != safe && !is_space(*token_end))
+                    {
+                        token_end++;
+                    }
+                    B value;
+                    const char* parsed = parse(p, token_end, value);
+                    if(parsed != p && !store(value))
+                    {
+                        return;
+                    }
+                    skip_line = (parsed != token_end);
+                    p = token_end;
+                }
+
+                if(eof)
+                {
+                    return;
+                }
+                have = end - safe;
+                std::memmove(buffer.data(), safe, have);
+            }
+        }
+
+        // buffered output of formatted values
+        class Writer
+        {
+            public:
+                Writer(std::ostream &out) : out(out), buffer(IO_BUFFER), pos(0) {}
+
+                ~Writer() { flush(); }
+
+                void put(char c)
+                {
+                    reserve(1);
+                    buffer[pos++] = c;
+                }
+
+                void put(char c, size_t n)
+                {
+                    reserve(n);
+                    std::memset(buffer.data()+pos, c, n);
+                    pos += n;
+                }
+
+                /*
+                    Floating point values are written in scientific notation with the given number of digits
+                    after the decimal point, like std::scientific with std::setprecision, or with the shortest
+                    representation that is read back exactly if precision is SHORTEST.
+                */
+                template<class B>
+                void value(B v, int precision)
+                {
+                    if constexpr(std::is_floating_point<B>::value)
+                    {
+                        reserve(64 + (precision > 0 ? precision : 0));
+                        char* first = buffer.data()+pos;
+                        char* last = buffer.data()+buffer.size();
+                        auto res = (precision == SHORTEST) ?
+                            std::to_chars(first, last, v, std::chars_format::scientific) :
+                            std::to_chars(first, last, v, std::chars_format::scientific, precision < 0 ? 6 : precision);
+                        pos = res.ptr - buffer.data();
+                    }
+                    else
+                    {
+                        reserve(32);
+                        auto res = std::to_chars(buffer.data()+pos, buffer.data()+buffer.size(), v);
+                        pos = res.ptr - buffer.data();
+                    }
+                }
+
+                void flush()
+                {
+                    out.write(buffer.data(), pos);
+                    pos = 0;
+                }
+
+            private:
+                void reserve(size_t n)
+                {
+                    if(pos + n > buffer.size())
+                    {
+                        flush();
+                        if(n > buffer.size())
+                        {
+                            buffer.resize(n);
+                        }
+                    }
+                }
+
+                std::ostream &out;
+                std::vector<char> buffer;
+                size_t pos;
+        };
+    }
+}
+
+#endif // TEXTFORMAT_HPP
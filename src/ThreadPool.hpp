@@ -0,0 +1,96 @@
+/*
+TensorUtils Version 0.1
+
+Copyright 2022 Christoph Widder
+
+This file is part of TensorUtils.
+
+TensorUtils is free software: you can redistribute it and/or modify it under the terms of
+the GNU General Public License as published by the Free Software Foundation, either
+version 3 of the License, or (at your option) any later version.
+
+TensorUtils is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with TensorUtils.
+If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+
+#include "Parallel.hpp"
+#include "StridedLoop.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <future>
+
+namespace TensorUtils
+{
+    namespace Parallel
+    {
+        /*
+            Runs task(0),...,task(n_tasks-1) on the thread pool and waits for all of them.
+            The calling thread takes part. Nested calls from a task and calls while the pool is busy
+            with another caller run all tasks serially on the calling thread. The first exception
+            thrown by a task is rethrown after all tasks have finished.
+        */
+        void run_tasks(size_t n_tasks, const std::function<void(size_t)> &task);
+
+        /*
+            Queues task for a background I/O thread, see num_io_threads. The future holds the exception
+            thrown by the task. Queued tasks are completed before the program exits.
+        */
+        std::future<void> submit_io(std::function<void()> task);
+
+        /*
+            Runs first(k,buffer) and then second(k,buffer) for all blocks k<n_blocks, where first runs on a helper thread
+            and second on the calling thread, such that both stages of consecutive blocks overlap. Block k uses
+            buffer k%2, i.e. first fills one of two buffers of the caller while second processes the other.
+            The first exception thrown by either stage is rethrown after both stopped.
+        */
+        void pipeline(size_t n_blocks, const std::function<void(size_t,unsigned)> &first, const std::function<void(size_t,unsigned)> &second);
+
+        /*
+            Splits [0,n) into contiguous ranges and calls f(begin,end) for each of them, concurrently
+            if n*work_per_item is at least twice the threshold. The ranges are disjoint, i.e. f may write to
+            everything that is addressed by its range without synchronization.
+        */
+        template<class F>
+        void parallel_for(size_t n, F f, size_t work_per_item=1)
+        {
+            const size_t work = n*std::max<size_t>(work_per_item,1);
+            size_t tasks = std::min<size_t>(num_threads(), work/std::max<size_t>(threshold(),1));
+            tasks = std::min(tasks, n);
+            if(tasks <= 1)
+            {
+                f(size_t(0), n);
+                return;
+            }
+            run_tasks(tasks, [&](size_t t)
+            {
+                f(n*t/tasks, n*(t+1)/tasks);
+            });
+        }
+
+        // runs a strided loop with its iterations partitioned across threads, see StridedLoop::run_range
+        template<unsigned K, class KERNEL>
+        void parallel_run(
+            const Kernels::StridedLoop<K>                       &loop,
+            const typename Kernels::StridedLoop<K>::Offsets     &base,
+            KERNEL                                              &&kernel,
+            size_t                                              work_per_item=1)
+        {
+            parallel_for(loop.size(), [&](size_t first, size_t last)
+            {
+                loop.run_range(base, first, last, kernel);
+            }, work_per_item);
+        }
+    }
+}
+
+#endif // THREADPOOL_HPP